@@ -72,7 +72,10 @@ const music_player_t fl_player =
 #include "lprintf.h"
 #include "midifile.h"
 #include "memio.h"
+#include "md5.h"
+#include "m_file.h"
 #include "w_wad.h"
+#include "z_zone.h"
 
 #include "dsda/args.h"
 #include "dsda/configuration.h"
@@ -102,6 +105,13 @@ static double spmc;
 static double f_delta;
 static int f_soundrate;
 
+// What fl_init loaded, for the music cache key
+static int f_settings[9];
+static int f_soundfont_lump = LUMP_NOT_FOUND;
+static char *f_soundfont_file;
+static unsigned char f_soundfont_digest[16];
+static int f_soundfont_hashed;
+
 #define SYSEX_BUFF_SIZE 1024
 static unsigned char sysexbuff[SYSEX_BUFF_SIZE];
 static int sysexbufflen;
@@ -190,6 +200,16 @@ static int fl_init (int samplerate)
   mus_fluidsynth_reverb_width = dsda_IntConfig(dsda_config_mus_fluidsynth_reverb_width);
   mus_fluidsynth_reverb_room_size = dsda_IntConfig(dsda_config_mus_fluidsynth_reverb_room_size);
 
+  f_settings[0] = mus_fluidsynth_chorus;
+  f_settings[1] = mus_fluidsynth_reverb;
+  f_settings[2] = mus_fluidsynth_gain;
+  f_settings[3] = mus_fluidsynth_chorus_depth;
+  f_settings[4] = mus_fluidsynth_chorus_level;
+  f_settings[5] = mus_fluidsynth_reverb_damp;
+  f_settings[6] = mus_fluidsynth_reverb_level;
+  f_settings[7] = mus_fluidsynth_reverb_width;
+  f_settings[8] = mus_fluidsynth_reverb_room_size;
+
   f_soundrate = samplerate;
   // fluidsynth 1.1.4 supports sample rates as low as 8000hz.  earlier versions only go down to 22050hz
   // since the versions are ABI compatible, detect at runtime, not compile time
@@ -290,6 +310,8 @@ static int fl_init (int samplerate)
       checked_f_font = snd_soundfont;
       filename = I_FindFile2(snd_soundfont, ".sf2");
       f_font = fluid_synth_sfload (f_syn, filename, 1);
+      if (f_font != FLUID_FAILED)
+        f_soundfont_file = Z_Strdup(filename);
     }
 
     if ((!checked_file || f_font == FLUID_FAILED) && lumpnum >= 0)
@@ -302,6 +324,7 @@ static int fl_init (int samplerate)
                                    fl_sftell, fl_sfclose);
       fluid_synth_add_sfloader(f_syn, sfloader);
       f_font = fluid_synth_sfload(f_syn, "SNDFONT", 1);
+      f_soundfont_lump = lumpnum;
     }
 
     if (!checked_f_font)
@@ -333,6 +356,11 @@ static void fl_shutdown (void)
     f_font = 0;
   }
 
+  Z_Free (f_soundfont_file);
+  f_soundfont_file = NULL;
+  f_soundfont_lump = LUMP_NOT_FOUND;
+  f_soundfont_hashed = 0;
+
   if (f_set)
   {
     delete_fluid_settings (f_set);
@@ -424,6 +452,49 @@ static void fl_stop (void)
   }
 }
 
+// The soundfont file is hashed once, since it can be very large
+static void fl_hashsoundfont (void)
+{
+  struct MD5Context md5;
+  unsigned char buffer[65536];
+  size_t length;
+  FILE *file;
+
+  MD5Init (&md5);
+
+  file = M_OpenFile (f_soundfont_file, "rb");
+  if (file)
+  {
+    while ((length = fread (buffer, 1, sizeof (buffer), file)) > 0)
+      MD5Update (&md5, buffer, length);
+    fclose (file);
+  }
+
+  MD5Final (f_soundfont_digest, &md5);
+  f_soundfont_hashed = 1;
+}
+
+static void fl_hashsettings (dsda_startup_cache_t *key)
+{
+  dsda_HashStartupCacheData (key, f_settings, sizeof (f_settings));
+
+  if (f_soundfont_file)
+  {
+    if (!f_soundfont_hashed)
+      fl_hashsoundfont ();
+    dsda_HashStartupCacheData (key, f_soundfont_digest, sizeof (f_soundfont_digest));
+  }
+  else if (f_soundfont_lump != LUMP_NOT_FOUND)
+  {
+    dsda_HashStartupCacheLump (key, f_soundfont_lump);
+  }
+}
+
+static int fl_finished (void)
+{
+  return !f_playing;
+}
+
 static void fl_setvolume (int v)
 {
   f_volume = v;
@@ -639,7 +710,9 @@ const music_player_t fl_player =
   fl_unregistersong,
   fl_play,
   fl_stop,
-  fl_render
+  fl_render,
+  fl_hashsettings,
+  fl_finished
 };
 
 
@@ -32,6 +32,8 @@
 #ifndef MUSICPLAYER_H
 #define MUSICPLAYER_H
 
+#include "dsda/startup_cache.h"
+
 /*
 Anything that implements all of these functions can play music in prboomplus.
 
@@ -82,6 +84,13 @@ typedef struct
   // s16 stereo, with samplerate as specified in init.  player needs to be able to handle
   // just about anything for nsamp.  render can be called even during pause+stop.
   void (*render)(void *dest, unsigned nsamp);
+
+  // optional, lets the song be pre-rendered to the music cache.
+  // hash everything other than the song data that changes the output
+  void (*hashsettings)(dsda_startup_cache_t *key);
+
+  // with hashsettings: return 1 once a song played without looping has ended
+  int (*finished)(void);
 } music_player_t;
 
 #endif // MUSICPLAYER_H
@@ -65,6 +65,9 @@ static uint64_t pause_offset;
 static opl3_chip opl_chip;
 static int opl_opl3mode;
 
+// If non-zero, render with the sample by sample reference synth.
+static int opl_reference;
+
 // Register number that was written.
 static int register_num = 0;
 
@@ -249,7 +252,14 @@ void OPL_Render_Samples (void *dest, unsigned buffer_len)
         }
 
         // Add emulator output to buffer.
-        OPL3_GenerateStream(&opl_chip, buffer + filled * 2, nsamples);
+        if (opl_reference)
+        {
+            OPL3_GenerateStreamReference(&opl_chip, buffer + filled * 2, nsamples);
+        }
+        else
+        {
+            OPL3_GenerateStream(&opl_chip, buffer + filled * 2, nsamples);
+        }
         filled += nsamples;
 
         // Invoke callbacks for this point in time.
@@ -257,6 +267,11 @@ void OPL_Render_Samples (void *dest, unsigned buffer_len)
     }
 }
 
+void OPL_SetReferenceSynth(int reference)
+{
+    opl_reference = reference;
+}
+
 void OPL_WritePort(opl_port_t port, unsigned int value)
 {
     if (port == OPL_REGISTER_PORT)
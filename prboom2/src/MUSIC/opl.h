@@ -120,6 +120,10 @@ extern unsigned int opl_sample_rate;
 
 void OPL_Render_Samples (void *dest, unsigned nsamp);
 
+// Render with the sample by sample synth that the block synth replaced.
+
+void OPL_SetReferenceSynth(int reference);
+
 
 void OPL_SetCallback(uint64_t us, opl_callback_t callback, void *data);
 
@@ -36,6 +36,9 @@ static int mus_opl_gain;
 
 #define RSM_FRAC    10
 
+// Chip samples rendered per pass of OPL3_GenerateStream
+#define OPL_BLOCK_SIZE  256
+
 // Channel types
 
 enum {
@@ -330,6 +333,15 @@ static Bit16s OPL3_EnvelopeCalcSin7(Bit16u phase, Bit16u envelope)
     return OPL3_EnvelopeCalcExp(out + (envelope << 3)) ^ neg;
 }
 
+//
+// Sign of each waveform by phase quadrant, for slots too attenuated
+// for the exp lookup to produce anything else
+//
+
+static const Bit8u envelope_sign[8] = {
+    0x0c, 0x00, 0x00, 0x00, 0x02, 0x00, 0x0c, 0x0c
+};
+
 static const envelope_sinfunc envelope_sin[8] = {
     OPL3_EnvelopeCalcSin0,
     OPL3_EnvelopeCalcSin1,
@@ -507,6 +519,20 @@ static void OPL3_EnvelopeCalc(opl3_slot *slot)
     }
 }
 
+static void OPL3_EnvelopeCalcFast(opl3_slot *slot)
+{
+    // Released and fully attenuated - nothing else can change
+    if (!slot->key && slot->eg_gen == envelope_gen_num_release
+        && slot->eg_rout == 0x1ff)
+    {
+        slot->eg_out = slot->eg_rout + (slot->reg_tl << 2)
+                     + (slot->eg_ksl >> kslshift[slot->reg_ksl]) + *slot->trem;
+        slot->pg_reset = 0;
+        return;
+    }
+    OPL3_EnvelopeCalc(slot);
+}
+
 static void OPL3_EnvelopeKeyOn(opl3_slot *slot, Bit8u type)
 {
     slot->key |= type;
@@ -578,7 +604,8 @@ static void OPL3_PhaseGenerate(opl3_slot *slot)
         chip->rm_tc_bit3 = (phase >> 3) & 1;
         chip->rm_tc_bit5 = (phase >> 5) & 1;
     }
-    if (chip->rhy & 0x20)
+    if ((chip->rhy & 0x20)
+        && (slot->slot_num == 13 || slot->slot_num == 16 || slot->slot_num == 17))
     {
         rm_xor = (chip->rm_hh_bit2 ^ chip->rm_hh_bit7)
                | (chip->rm_hh_bit3 ^ chip->rm_tc_bit5)
@@ -668,6 +695,19 @@ static void OPL3_SlotGenerate(opl3_slot *slot)
     slot->out = envelope_sin[slot->reg_wf](slot->pg_phase_out + *slot->mod, slot->eg_out);
 }
 
+static void OPL3_SlotGenerateFast(opl3_slot *slot)
+{
+    // At this attenuation the exp table shifts out to zero
+    if (slot->eg_out >= 0x1e0)
+    {
+        Bit16u phase = (Bit16u)(slot->pg_phase_out + *slot->mod);
+
+        slot->out = -((envelope_sign[slot->reg_wf] >> ((phase >> 8) & 0x03)) & 0x01);
+        return;
+    }
+    OPL3_SlotGenerate(slot);
+}
+
 static void OPL3_SlotCalcFB(opl3_slot *slot)
 {
     if (slot->channel->fb != 0x00)
@@ -1046,22 +1086,46 @@ static Bit16s OPL3_ClipSample(Bit32s sample)
     return (Bit16s)sample;
 }
 
-void OPL3_Generate(opl3_chip *chip, Bit16s *buf)
+//
+// The reference path skips the shortcuts for silent slots, so that
+// OPL3_GenerateStreamReference matches the unmodified core
+//
+
+static void OPL3_ProcessSlots(opl3_chip *chip, Bit8u first, Bit8u last, Bit8u reference)
 {
     Bit8u ii;
-    Bit8u jj;
-    Bit16s accm;
-    Bit8u shift = 0;
 
-    buf[1] = OPL3_ClipSample(chip->mixbuff[1]);
+    if (reference)
+    {
+        for (ii = first; ii < last; ii++)
+        {
+            OPL3_SlotCalcFB(&chip->slot[ii]);
+            OPL3_EnvelopeCalc(&chip->slot[ii]);
+            OPL3_PhaseGenerate(&chip->slot[ii]);
+            OPL3_SlotGenerate(&chip->slot[ii]);
+        }
+        return;
+    }
 
-    for (ii = 0; ii < 15; ii++)
+    for (ii = first; ii < last; ii++)
     {
         OPL3_SlotCalcFB(&chip->slot[ii]);
-        OPL3_EnvelopeCalc(&chip->slot[ii]);
+        OPL3_EnvelopeCalcFast(&chip->slot[ii]);
         OPL3_PhaseGenerate(&chip->slot[ii]);
-        OPL3_SlotGenerate(&chip->slot[ii]);
+        OPL3_SlotGenerateFast(&chip->slot[ii]);
     }
+}
+
+static void OPL3_GenerateChip(opl3_chip *chip, Bit16s *buf, Bit8u reference)
+{
+    Bit8u ii;
+    Bit8u jj;
+    Bit16s accm;
+    Bit8u shift = 0;
+
+    buf[1] = OPL3_ClipSample(chip->mixbuff[1]);
+
+    OPL3_ProcessSlots(chip, 0, 15, reference);
 
     chip->mixbuff[0] = 0;
     for (ii = 0; ii < 18; ii++)
@@ -1074,23 +1138,11 @@ void OPL3_Generate(opl3_chip *chip, Bit16s *buf)
         chip->mixbuff[0] += (Bit16s)(accm & chip->channel[ii].cha);
     }
 
-    for (ii = 15; ii < 18; ii++)
-    {
-        OPL3_SlotCalcFB(&chip->slot[ii]);
-        OPL3_EnvelopeCalc(&chip->slot[ii]);
-        OPL3_PhaseGenerate(&chip->slot[ii]);
-        OPL3_SlotGenerate(&chip->slot[ii]);
-    }
+    OPL3_ProcessSlots(chip, 15, 18, reference);
 
     buf[0] = OPL3_ClipSample(chip->mixbuff[0]);
 
-    for (ii = 18; ii < 33; ii++)
-    {
-        OPL3_SlotCalcFB(&chip->slot[ii]);
-        OPL3_EnvelopeCalc(&chip->slot[ii]);
-        OPL3_PhaseGenerate(&chip->slot[ii]);
-        OPL3_SlotGenerate(&chip->slot[ii]);
-    }
+    OPL3_ProcessSlots(chip, 18, 33, reference);
 
     chip->mixbuff[1] = 0;
     for (ii = 0; ii < 18; ii++)
@@ -1103,13 +1155,7 @@ void OPL3_Generate(opl3_chip *chip, Bit16s *buf)
         chip->mixbuff[1] += (Bit16s)(accm & chip->channel[ii].chb);
     }
 
-    for (ii = 33; ii < 36; ii++)
-    {
-        OPL3_SlotCalcFB(&chip->slot[ii]);
-        OPL3_EnvelopeCalc(&chip->slot[ii]);
-        OPL3_PhaseGenerate(&chip->slot[ii]);
-        OPL3_SlotGenerate(&chip->slot[ii]);
-    }
+    OPL3_ProcessSlots(chip, 33, 36, reference);
 
     if ((chip->timer & 0x3f) == 0x3f)
     {
@@ -1178,13 +1224,18 @@ void OPL3_Generate(opl3_chip *chip, Bit16s *buf)
     chip->writebuf_samplecnt++;
 }
 
-void OPL3_GenerateResampled(opl3_chip *chip, Bit16s *buf)
+void OPL3_Generate(opl3_chip *chip, Bit16s *buf)
+{
+    OPL3_GenerateChip(chip, buf, 0);
+}
+
+static void OPL3_GenerateResampledChip(opl3_chip *chip, Bit16s *buf, Bit8u reference)
 {
     while (chip->samplecnt >= chip->rateratio)
     {
         chip->oldsamples[0] = chip->samples[0];
         chip->oldsamples[1] = chip->samples[1];
-        OPL3_Generate(chip, chip->samples);
+        OPL3_GenerateChip(chip, chip->samples, reference);
         chip->samplecnt -= chip->rateratio;
     }
     buf[0] = (Bit16s)((chip->oldsamples[0] * (chip->rateratio - chip->samplecnt)
@@ -1194,6 +1245,11 @@ void OPL3_GenerateResampled(opl3_chip *chip, Bit16s *buf)
     chip->samplecnt += 1 << RSM_FRAC;
 }
 
+void OPL3_GenerateResampled(opl3_chip *chip, Bit16s *buf)
+{
+    OPL3_GenerateResampledChip(chip, buf, 0);
+}
+
 void OPL3_Reset(opl3_chip *chip, Bit32u samplerate)
 {
     Bit8u slotnum;
@@ -1371,13 +1427,85 @@ void OPL3_WriteRegBuffered(opl3_chip *chip, Bit16u reg, Bit8u v)
 }
 
 void OPL3_GenerateStream(opl3_chip *chip, Bit16s *sndptr, Bit32u numsamples)
+{
+    Bit16s block[OPL_BLOCK_SIZE * 2];
+    Bit32u i;
+
+    while (numsamples)
+    {
+        Bit32s samplecnt = chip->samplecnt;
+        Bit32u count = 0;
+        Bit32u needed = 0;
+        Bit32u pos = 0;
+
+        // Work out how many chip samples the next run of output needs
+        while (count < numsamples)
+        {
+            Bit32u steps = 0;
+
+            while (samplecnt >= chip->rateratio)
+            {
+                samplecnt -= chip->rateratio;
+                steps++;
+            }
+            if (needed + steps > OPL_BLOCK_SIZE)
+            {
+                break;
+            }
+            needed += steps;
+            samplecnt += 1 << RSM_FRAC;
+            count++;
+        }
+
+        for (i = 0; i < needed; i++)
+        {
+            OPL3_GenerateChip(chip, block + i * 2, 0);
+        }
+
+        // Same interpolation as OPL3_GenerateResampled
+        for (i = 0; i < count; i++)
+        {
+            Bit32s sample;
+
+            while (chip->samplecnt >= chip->rateratio)
+            {
+                chip->oldsamples[0] = chip->samples[0];
+                chip->oldsamples[1] = chip->samples[1];
+                chip->samples[0] = block[pos * 2];
+                chip->samples[1] = block[pos * 2 + 1];
+                chip->samplecnt -= chip->rateratio;
+                pos++;
+            }
+            sndptr[0] = (Bit16s)((chip->oldsamples[0] * (chip->rateratio - chip->samplecnt)
+                                + chip->samples[0] * chip->samplecnt) / chip->rateratio);
+            sndptr[1] = (Bit16s)((chip->oldsamples[1] * (chip->rateratio - chip->samplecnt)
+                                + chip->samples[1] * chip->samplecnt) / chip->rateratio);
+            chip->samplecnt += 1 << RSM_FRAC;
+
+            sample = sndptr[0] * mus_opl_gain / 50;
+            sndptr[0] = OPL3_ClipSample(sample);
+            sample = sndptr[1] * mus_opl_gain / 50;
+            sndptr[1] = OPL3_ClipSample(sample);
+            sndptr += 2;
+        }
+
+        numsamples -= count;
+    }
+}
+
+//
+// The sample by sample stream that OPL3_GenerateStream replaced, on the
+// unmodified slot path. Kept as the reference for I_OPL_Benchmark.
+//
+
+void OPL3_GenerateStreamReference(opl3_chip *chip, Bit16s *sndptr, Bit32u numsamples)
 {
     Bit32u i;
 
     for(i = 0; i < numsamples; i++)
     {
         Bit32s sample;
-        OPL3_GenerateResampled(chip, sndptr);
+        OPL3_GenerateResampledChip(chip, sndptr, 1);
         sample = sndptr[0] * mus_opl_gain / 50;
         sndptr[0] = OPL3_ClipSample(sample);
         sample = sndptr[1] * mus_opl_gain / 50;
@@ -46,6 +46,7 @@
 #include "lprintf.h"
 
 #include "dsda/configuration.h"
+#include "dsda/time.h"
 
 static int opl_opl3mode;
 
@@ -345,6 +346,7 @@ static opl_voice_t *voice_alloced_list[OPL_NUM_VOICES * 2];
 static int voice_free_num;
 static int voice_alloced_num;
 static int opl_opl3mode;
+static int opl_gain; // as applied by OPL_Init
 static int num_opl_voices;
 
 // Data for each channel.
@@ -1694,6 +1696,7 @@ static void I_OPL_ShutdownMusic(void)
 int I_OPL_InitMusic(int samplerate)
 {
     opl_opl3mode = dsda_IntConfig(dsda_config_mus_opl_opl3mode);
+    opl_gain = dsda_IntConfig(dsda_config_mus_opl_gain);
 
     if (!OPL_Init(samplerate))
     {
@@ -1737,6 +1740,20 @@ void I_OPL_RenderSamples (void *dest, unsigned nsamp)
     OPL_Render_Samples (dest, nsamp);
 }
 
+static void I_OPL_HashSettings(dsda_startup_cache_t *key)
+{
+    dsda_HashStartupCacheLump(key, W_GetNumForName("GENMIDI"));
+
+    dsda_HashStartupCacheData(key, &opl_gain, sizeof(opl_gain));
+    dsda_HashStartupCacheData(key, &opl_opl3mode, sizeof(opl_opl3mode));
+    dsda_HashStartupCacheData(key, &opl_drv_ver, sizeof(opl_drv_ver));
+}
+
+static int I_OPL_SongFinished(void)
+{
+    return tracks != NULL && running_tracks == 0;
+}
+
 const music_player_t opl_synth_player =
 {
   I_OPL_SynthName,
@@ -1749,5 +1766,172 @@ const music_player_t opl_synth_player =
   I_OPL_UnRegisterSong,
   I_OPL_PlaySong,
   I_OPL_StopSong,
-  I_OPL_RenderSamples
+  I_OPL_RenderSamples,
+  I_OPL_HashSettings,
+  I_OPL_SongFinished
 };
+
+//
+// I_OPL_Benchmark
+//
+// Renders every MUS and MIDI lump through the OPL player twice, with the
+// sample by sample reference synth and with the block synth, and fails on
+// the first sample where the two differ (-bench_opl)
+//
+
+#define BENCHMARK_RATE 44100
+#define BENCHMARK_FRAMES 512
+
+static int I_OPL_RenderBenchmarkSong(const void *data, size_t len, int reference,
+                                     int16_t *out, int frames,
+                                     unsigned long long *elapsed)
+{
+    const void *handle;
+    int i;
+
+    // Voices keep their pan from the last song, so both passes start clean
+    memset(voices, 0, sizeof(voices));
+
+    if (!I_OPL_InitMusic(BENCHMARK_RATE))
+    {
+        return false;
+    }
+
+    OPL_SetReferenceSynth(reference);
+
+    handle = I_OPL_RegisterSong(data, len);
+    if (handle == NULL)
+    {
+        I_OPL_ShutdownMusic();
+        OPL_SetReferenceSynth(0);
+        return false;
+    }
+
+    I_OPL_PlaySong(handle, 0);
+    I_OPL_ResumeSong();
+    I_OPL_SetMusicVolume(15);
+
+    dsda_StartTimer(dsda_timer_temp);
+    for (i = 0; i < frames; i += BENCHMARK_FRAMES)
+    {
+        int count = frames - i < BENCHMARK_FRAMES ? frames - i : BENCHMARK_FRAMES;
+
+        I_OPL_RenderSamples(out + i * 2, count);
+    }
+    *elapsed += dsda_ElapsedTime(dsda_timer_temp);
+
+    I_OPL_StopSong();
+    I_OPL_UnRegisterSong(handle);
+    I_OPL_ShutdownMusic();
+    OPL_SetReferenceSynth(0);
+
+    return true;
+}
+
+int I_OPL_Benchmark(int seconds)
+{
+    const int frames = BENCHMARK_RATE * seconds;
+    int16_t *out[2];
+    unsigned long long elapsed[2] = { 0, 0 };
+    int songs = 0;
+    int result = 0;
+    int lump;
+
+    if (W_CheckNumForName("GENMIDI") == LUMP_NOT_FOUND)
+    {
+        lprintf(LO_ERROR, "I_OPL_Benchmark: no GENMIDI lump\n");
+        return 1;
+    }
+
+    out[0] = Z_Malloc(frames * 2 * sizeof(*out[0]));
+    out[1] = Z_Malloc(frames * 2 * sizeof(*out[1]));
+
+    for (lump = 0; lump < numlumps && !result; ++lump)
+    {
+        const byte *data;
+        size_t len;
+        void *mid = NULL;
+        size_t mid_len = 0;
+        int pass, i;
+
+        len = W_LumpLength(lump);
+        if (len < 4)
+        {
+            continue;
+        }
+
+        data = W_LumpByNum(lump);
+
+        if (!memcmp(data, "MUS\x1a", 4))
+        {
+            MEMFILE *instream = mem_fopen_read(data, len);
+            MEMFILE *outstream = mem_fopen_write();
+            void *outbuf;
+
+            if (!mus2mid(instream, outstream))
+            {
+                mem_get_buf(outstream, &outbuf, &mid_len);
+                mid = Z_Malloc(mid_len);
+                memcpy(mid, outbuf, mid_len);
+            }
+
+            mem_fclose(instream);
+            mem_fclose(outstream);
+
+            if (!mid)
+            {
+                continue;
+            }
+        }
+        else if (!IsMid((byte *) data, len))
+        {
+            continue;
+        }
+
+        for (pass = 0; pass < 2; ++pass)
+        {
+            if (!I_OPL_RenderBenchmarkSong(mid ? mid : data, mid ? mid_len : len,
+                                           pass == 0, out[pass], frames, &elapsed[pass]))
+            {
+                break;
+            }
+        }
+
+        Z_Free(mid);
+
+        if (pass < 2)
+        {
+            lprintf(LO_WARN, "I_OPL_Benchmark: skipping %.8s\n", W_LumpName(lump));
+            continue;
+        }
+
+        ++songs;
+
+        for (i = 0; i < frames * 2; ++i)
+        {
+            if (out[0][i] != out[1][i])
+            {
+                lprintf(LO_ERROR, "I_OPL_Benchmark: %.8s differs at frame %d (%s): %d instead of %d\n",
+                        W_LumpName(lump), i / 2, (i & 1) ? "right" : "left",
+                        out[1][i], out[0][i]);
+                result = 1;
+                break;
+            }
+        }
+    }
+
+    Z_Free(out[0]);
+    Z_Free(out[1]);
+
+    lprintf(LO_INFO, "I_OPL_Benchmark: %d songs, %d seconds each\n", songs, seconds);
+    lprintf(LO_INFO, "  sample by sample: %llu us\n", elapsed[0]);
+    lprintf(LO_INFO, "  blocks: %llu us\n", elapsed[1]);
+
+    if (!songs)
+    {
+        lprintf(LO_ERROR, "I_OPL_Benchmark: no songs could be rendered\n");
+        result = 1;
+    }
+
+    return result;
+}
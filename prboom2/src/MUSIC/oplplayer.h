@@ -30,5 +30,7 @@
 
 extern const music_player_t opl_synth_player;
 
+int I_OPL_Benchmark(int seconds);
+
 
 #endif
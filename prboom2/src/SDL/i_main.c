@@ -60,6 +60,7 @@
 #include "doomstat.h"
 #include "g_game.h"
 #include "m_misc.h"
+#include "p_setup.h"
 #include "i_sound.h"
 #include "i_main.h"
 #include "r_fps.h"
@@ -78,6 +79,7 @@
 #include "dsda/endoom.h"
 #include "dsda/settings.h"
 #include "dsda/signal_context.h"
+#include "dsda/verify.h"
 #include "dsda/split_tracker.h"
 #include "dsda/text_file.h"
 #include "dsda/time.h"
@@ -205,6 +207,7 @@ static void I_EssentialQuit (void)
   }
   dsda_ExportTextFile();
   dsda_WriteAnalysis();
+  dsda_WriteVerifyResult();
   dsda_WriteSplits();
   dsda_SaveWadStats();
   // We need to close out all wad handles/memory mappings before we can remove
@@ -280,6 +283,20 @@ int main(int argc, char **argv)
     return 0;
   }
 
+  // Play back a manifest of demos in child processes and exit
+  if (dsda_Flag(dsda_arg_verify_batch))
+    return dsda_VerifyBatch();
+
+  // Time the blockmap builder and exit
+  if (dsda_Flag(dsda_arg_bench_blockmap))
+    return P_BenchmarkBlockMap(dsda_Arg(dsda_arg_bench_blockmap)->value.v_int);
+
+  // Time the sound effect mixer and exit
+  if (dsda_Flag(dsda_arg_bench_mixer))
+    return I_BenchmarkSoundMixer(dsda_Arg(dsda_arg_bench_mixer)->value.v_int);
+
+  dsda_InitVerifyResult();
+
   // e6y: Check for conflicts.
   // Conflicting command-line parameters could cause the engine to be confused
   // in some cases. Added checks to prevent this.
@@ -70,7 +70,9 @@
 //e6y
 #include "e6y.h"
 
+#include "dsda/music_cache.h"
 #include "dsda/settings.h"
+#include "dsda/time.h"
 
 static dboolean registered_non_rw = false;
 
@@ -91,12 +93,11 @@ typedef struct
   unsigned int step;
   // ... and a 0.16 bit remainder of last step.
   unsigned int stepremainder;
-  unsigned int samplerate;
-  unsigned int bits;
   // The channel data pointers, start and end.
-  const unsigned char *data;
-  const unsigned char *startdata;
-  const unsigned char *enddata;
+  // The data is 16 bit at the output rate (see I_CacheSfx).
+  const short *data;
+  const short *startdata;
+  const short *enddata;
   // Time/gametic that the channel started playing,
   //  used to determine oldest, which automatically
   //  has lowest priority.
@@ -107,6 +108,8 @@ typedef struct
   int leftvol;
   int rightvol;
   dboolean loop;
+  // Instance of the sound, acknowledged in channel_done when it ends
+  int seq;
 } channel_info_t;
 
 channel_info_t channelinfo[MAX_CHANNELS];
@@ -121,11 +124,60 @@ int   steptable[256];
 static int dumping_sound = 0;
 
 
-// lock for updating any params related to sfx
-SDL_mutex *sfxmutex;
 // lock for updating any params related to music
 SDL_mutex *musmutex;
 
+//
+// The game thread never touches the mixer state directly. It sends sound
+// commands through a single producer, single consumer ring that
+// the mixer applies at the start of each block, so neither thread waits
+// on the other. The mixer reports back which sounds have ended through
+// channel_done, and the game thread keeps its own view of each channel.
+//
+
+#define SOUND_QUEUE_SIZE 1024 // must be a power of 2
+
+typedef enum
+{
+  sound_command_start,
+  sound_command_stop,
+  sound_command_params,
+} sound_command_type_t;
+
+typedef struct
+{
+  sound_command_type_t type;
+  int channel;
+  int id;
+  int seq;
+  int starttime;
+  const short *data;
+  const short *enddata;
+  unsigned int step;
+  int leftvol;
+  int rightvol;
+  dboolean loop;
+} sound_command_t;
+
+static sound_command_t sound_queue[SOUND_QUEUE_SIZE];
+static SDL_atomic_t sound_queue_head; // written by the game thread
+static SDL_atomic_t sound_queue_tail; // written by the mixer
+
+static SDL_atomic_t channel_done[MAX_CHANNELS];
+
+// The game thread's view of the channels
+static int channel_seq[MAX_CHANNELS];
+static dboolean channel_stopped[MAX_CHANNELS];
+static int sound_seq;
+
+// Held while consuming the sound queue or mixing: normally only by the
+// audio callback, so it is uncontended. The game thread takes it to drain
+// the queue itself when it is full or before freeing cached sounds, and
+// mixes under it while dumping sound.
+static SDL_SpinLock mixer_lock;
+
+static void I_ApplySoundCommands(void);
+
 static int pitched_sounds;
 int snd_samplerate; // samples per second
 static int snd_samplecount;
@@ -153,52 +205,146 @@ static void stopchan(int i)
   if (channelinfo[i].data) /* cph - prevent excess unlocks */
   {
     channelinfo[i].data = NULL;
+    SDL_AtomicSet(&channel_done[i], channelinfo[i].seq);
   }
 }
 
-typedef struct wav_data_s
+//
+// Sound effects are decoded and resampled to the output rate once, the
+//  first time they are played, so mixing can step through them at unit
+//  stride. The cache is bounded by SFX_CACHE_SIZE; the least recently
+//  started sounds that aren't playing are dropped first.
+//
+
+#define SFX_CACHE_SIZE (32 * 1024 * 1024)
+
+typedef struct sfx_cache_s
 {
   int sfxid;
-  const unsigned char *data;
-  int samplelen;
-  int samplerate;
-  int bits;
-  struct wav_data_s *next;
-} wav_data_t;
+  short *samples;
+  int length;
+  unsigned int last_used;
+  struct sfx_cache_s *next;
+} sfx_cache_t;
+
+#define SFX_CACHE_HASH_SIZE 32
+static sfx_cache_t *sfx_cache_hash[SFX_CACHE_HASH_SIZE];
+static size_t sfx_cache_bytes;
+static unsigned int sfx_cache_clock;
+
+// Half width of the resampling kernel, in zero crossings
+#define SINC_ZEROS 8
+#define SINC_RESOLUTION 256
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
 
-#define WAV_DATA_HASH_SIZE 32
-static wav_data_t *wav_data_hash[WAV_DATA_HASH_SIZE];
+static float sinc_table[SINC_ZEROS * SINC_RESOLUTION + 2];
 
-static wav_data_t *GetWavData(int sfxid, const unsigned char *data, size_t len)
+// Blackman windowed sinc, tabulated for u in [0, SINC_ZEROS]
+static void I_InitSincTable(void)
 {
-  int key;
-  wav_data_t *target = NULL;
+  int i;
+
+  for (i = 0; i < SINC_ZEROS * SINC_RESOLUTION + 2; i++)
+  {
+    double u = (double) i / SINC_RESOLUTION;
+    double t = u / SINC_ZEROS;
+
+    if (t >= 1.0)
+      sinc_table[i] = 0;
+    else if (i == 0)
+      sinc_table[i] = 1;
+    else
+      sinc_table[i] = (float) (sin(M_PI * u) / (M_PI * u) *
+                               (0.42 + 0.5 * cos(M_PI * t) + 0.08 * cos(2 * M_PI * t)));
+  }
+}
+
+static float I_SincKernel(double u)
+{
+  double pos;
+  int i;
+
+  pos = fabs(u) * SINC_RESOLUTION;
+  i = (int) pos;
+
+  if (i >= SINC_ZEROS * SINC_RESOLUTION)
+    return 0;
+
+  return sinc_table[i] + (sinc_table[i + 1] - sinc_table[i]) * (float) (pos - i);
+}
 
-  key = (sfxid % WAV_DATA_HASH_SIZE);
+//
+// Converts the source samples to the output rate with a windowed sinc
+//  filter, low passing first when the rate goes down. The result has
+//  one extra silent sample so interpolating readers can look ahead.
+//
+static short *I_ResampleSfx(const float *in, int in_length, int in_rate, int *out_length)
+{
+  short *out;
+  double ratio, cutoff;
+  int width;
+  int i;
 
-  if (wav_data_hash[key])
+  if (in_rate == snd_samplerate)
+    *out_length = in_length;
+  else
+    *out_length = (int) ((long long) in_length * snd_samplerate / in_rate);
+
+  if (*out_length < 1)
+    *out_length = 1;
+
+  out = Z_Malloc((*out_length + 1) * sizeof(*out));
+  out[*out_length] = 0;
+
+  ratio = (double) in_rate / snd_samplerate;
+  cutoff = ratio > 1.0 ? 1.0 / ratio : 1.0;
+  width = (int) ceil(SINC_ZEROS / cutoff);
+
+  for (i = 0; i < *out_length; i++)
   {
-    wav_data_t *rover = wav_data_hash[key];
+    double x = i * ratio;
+    double sum = 0, weight = 0;
+    int k, center = (int) x;
+    int value;
 
-    while (rover)
-    {
-      if (rover->sfxid == sfxid)
+    if (in_rate == snd_samplerate)
+      sum = in[i], weight = 1;
+    else
+      for (k = center - width + 1; k <= center + width; k++)
       {
-        target = rover;
-        break;
+        float w = I_SincKernel((x - k) * cutoff);
+
+        if (k >= 0 && k < in_length)
+          sum += in[k] * w;
+        weight += w;
       }
 
-      rover = rover->next;
-    }
+    value = (int) floor(sum / weight + 0.5);
+    out[i] = value > SHRT_MAX ? SHRT_MAX : value < SHRT_MIN ? SHRT_MIN : value;
   }
 
-  if (target == NULL &&
-      len > 44 && !memcmp(data, "RIFF", 4) && !memcmp(data + 8, "WAVEfmt ", 8))
+  return out;
+}
+
+//
+// Decodes a WAV lump, or a DMX lump if it isn't one, into float samples
+//  in the 16 bit range. Returns NULL for unsupported WAVs.
+//
+static float *I_DecodeSfx(const unsigned char *data, size_t len, int *length, int *rate)
+{
+  float *samples;
+  int i;
+
+  if (len > 44 && !memcmp(data, "RIFF", 4) && !memcmp(data + 8, "WAVEfmt ", 8))
   {
     SDL_RWops *RWops;
     SDL_AudioSpec wav_spec;
     Uint8 *wav_buffer = NULL;
-    int bits, samplelen;
+    Uint32 samplelen;
+    int bits;
 
     RWops = SDL_RWFromConstMem(data, len);
 
@@ -230,19 +376,132 @@ static wav_data_t *GetWavData(int sfxid, const unsigned char *data, size_t len)
       return NULL;
     }
 
-    target = Z_Malloc(sizeof(*target));
+    *length = samplelen / (bits / 8);
+    *rate = wav_spec.freq;
+    samples = Z_Malloc(*length * sizeof(*samples));
+
+    if (bits == 16)
+      for (i = 0; i < *length; i++)
+        samples[i] = (short) (wav_buffer[i * 2] | (wav_buffer[i * 2 + 1] << 8));
+    else
+      for (i = 0; i < *length; i++)
+        samples[i] = (wav_buffer[i] - 128) * 256;
 
-    target->sfxid = sfxid;
-    target->data = wav_buffer;
-    target->samplelen = samplelen;
-    target->samplerate = wav_spec.freq;
-    target->bits = bits;
+    SDL_FreeWAV(wav_buffer);
+  }
+  else
+  {
+    *rate = (data[3] << 8) + data[2];
+    if (!*rate)
+      *rate = 11025;
 
-    // use head insertion
-    target->next = wav_data_hash[key];
-    wav_data_hash[key] = target;
+    // Skip header
+    *length = (int) len - 8;
+    samples = Z_Malloc(MAX(*length, 1) * sizeof(*samples));
+
+    for (i = 0; i < *length; i++)
+      samples[i] = (data[8 + i] - 128) * 256;
+  }
+
+  if (*length < 1)
+  {
+    Z_Free(samples);
+    return NULL;
   }
 
+  return samples;
+}
+
+// Call with mixer_lock held
+static dboolean I_SfxIsPlaying(const sfx_cache_t *sfx)
+{
+  int i;
+
+  for (i = 0; i < MAX_CHANNELS; i++)
+    if (channelinfo[i].data && channelinfo[i].startdata == sfx->samples)
+      return true;
+
+  return false;
+}
+
+static void I_TrimSfxCache(size_t needed)
+{
+  if (sfx_cache_bytes + needed <= SFX_CACHE_SIZE)
+    return;
+
+  // Apply the queued commands so channelinfo shows everything that can
+  // still be played
+  SDL_AtomicLock(&mixer_lock);
+  I_ApplySoundCommands();
+
+  while (sfx_cache_bytes + needed > SFX_CACHE_SIZE)
+  {
+    sfx_cache_t **victim = NULL;
+    int key;
+
+    for (key = 0; key < SFX_CACHE_HASH_SIZE; key++)
+    {
+      sfx_cache_t **rover;
+
+      for (rover = &sfx_cache_hash[key]; *rover; rover = &(*rover)->next)
+        if ((!victim || (*rover)->last_used < (*victim)->last_used) && !I_SfxIsPlaying(*rover))
+          victim = rover;
+    }
+
+    if (!victim)
+      break;
+
+    {
+      sfx_cache_t *sfx = *victim;
+
+      *victim = sfx->next;
+      sfx_cache_bytes -= (sfx->length + 1) * sizeof(short);
+      Z_Free(sfx->samples);
+      Z_Free(sfx);
+    }
+  }
+
+  SDL_AtomicUnlock(&mixer_lock);
+}
+
+static sfx_cache_t *I_CacheSfx(int sfxid, const unsigned char *data, size_t len)
+{
+  int key;
+  sfx_cache_t *target;
+  float *samples;
+  int length, rate;
+
+  key = (sfxid % SFX_CACHE_HASH_SIZE);
+
+  for (target = sfx_cache_hash[key]; target; target = target->next)
+    if (target->sfxid == sfxid)
+    {
+      target->last_used = ++sfx_cache_clock;
+      return target;
+    }
+
+  samples = I_DecodeSfx(data, len, &length, &rate);
+  if (!samples)
+    return NULL;
+
+  if (!sinc_table[0])
+    I_InitSincTable();
+
+  target = Z_Malloc(sizeof(*target));
+  target->sfxid = sfxid;
+  target->samples = I_ResampleSfx(samples, length, rate, &target->length);
+  target->last_used = ++sfx_cache_clock;
+
+  Z_Free(samples);
+
+  I_TrimSfxCache((target->length + 1) * sizeof(short));
+
+  sfx_cache_bytes += (target->length + 1) * sizeof(short);
+
+  // use head insertion
+  target->next = sfx_cache_hash[key];
+  sfx_cache_hash[key] = target;
+
   return target;
 }
 
@@ -251,43 +510,83 @@ static wav_data_t *GetWavData(int sfxid, const unsigned char *data, size_t len)
 //  list of currently active sounds,
 //  which is maintained as a given number
 //  (eight, usually) of internal channels.
-// Returns a handle.
 //
-static int addsfx(int sfxid, int channel, const unsigned char *data, size_t len)
+static void addsfx(const sound_command_t *command)
 {
-  channel_info_t *ci = channelinfo + channel;
-  wav_data_t *wav_data = GetWavData(sfxid, data, len);
+  channel_info_t *ci = channelinfo + command->channel;
 
-  stopchan(channel);
+  stopchan(command->channel);
 
-  if (wav_data)
-  {
-    ci->data = wav_data->data;
-    ci->enddata = ci->data + wav_data->samplelen - 1;
-    ci->samplerate = wav_data->samplerate;
-    ci->bits = wav_data->bits;
-  }
-  else
-  {
-    ci->data = data;
-    /* Set pointer to end of raw data. */
-    ci->enddata = ci->data + len - 1;
-    ci->samplerate = (ci->data[3] << 8) + ci->data[2];
-    ci->data += 8; /* Skip header */
-    ci->bits = 8;
-  }
+  ci->data = command->data;
+  ci->enddata = command->enddata;
 
   ci->stepremainder = 0;
-  // Should be gametic, I presume.
-  ci->starttime = gametic;
+  ci->starttime = command->starttime;
 
   ci->startdata = ci->data;
 
   // Preserve sound SFX id,
   //  e.g. for avoiding duplicates of chainsaw.
-  ci->id = sfxid;
+  ci->id = command->id;
+  ci->seq = command->seq;
+}
 
-  return channel;
+// The commands are published together, so the mixer applies all or none
+// of them in a block (count is at most MAX_CHANNELS)
+static void I_QueueSoundCommands(const sound_command_t *commands, int count)
+{
+  int head = SDL_AtomicGet(&sound_queue_head);
+  int i;
+
+  // The mixer drains the queue every block, so this only happens if the
+  // audio thread stalls for a long time (or while dumping sound)
+  if (head - SDL_AtomicGet(&sound_queue_tail) > SOUND_QUEUE_SIZE - count)
+  {
+    SDL_AtomicLock(&mixer_lock);
+    I_ApplySoundCommands();
+    SDL_AtomicUnlock(&mixer_lock);
+  }
+
+  for (i = 0; i < count; i++)
+    sound_queue[(head + i) & (SOUND_QUEUE_SIZE - 1)] = commands[i];
+
+  SDL_AtomicSet(&sound_queue_head, head + count);
+}
+
+static void I_QueueSoundCommand(const sound_command_t *command)
+{
+  I_QueueSoundCommands(command, 1);
+}
+
+// Call with mixer_lock held
+static void I_ApplySoundCommands(void)
+{
+  int tail = SDL_AtomicGet(&sound_queue_tail);
+  int head = SDL_AtomicGet(&sound_queue_head);
+
+  for (; tail != head; tail++)
+  {
+    const sound_command_t *command = &sound_queue[tail & (SOUND_QUEUE_SIZE - 1)];
+    channel_info_t *ci = channelinfo + command->channel;
+
+    switch (command->type)
+    {
+      case sound_command_start:
+        addsfx(command);
+        // fall through
+      case sound_command_params:
+        ci->step = command->step;
+        ci->leftvol = command->leftvol;
+        ci->rightvol = command->rightvol;
+        ci->loop = command->loop;
+        break;
+      case sound_command_stop:
+        stopchan(command->channel);
+        break;
+    }
+  }
+
+  SDL_AtomicSet(&sound_queue_tail, tail);
 }
 
 static int getSliceSize(void)
@@ -316,9 +615,8 @@ static int getSliceSize(void)
   return 1024;
 }
 
-static void updateSoundParams(int handle, sfx_params_t *params)
+static void updateSoundParams(int handle, sfx_params_t *params, sound_command_t *command)
 {
-  int slot = handle;
   int rightvol;
   int leftvol;
   int step = steptable[params->pitch];
@@ -328,17 +626,16 @@ static void updateSoundParams(int handle, sfx_params_t *params)
     I_Error("I_UpdateSoundParams: handle out of range");
 #endif
 
-  channelinfo[slot].loop = params->loop;
+  command->channel = handle;
+  command->loop = params->loop;
 
   // Set stepping
-  // MWM 2000-12-24: Calculates proportion of channel samplerate
-  // to global samplerate for mixing purposes.
-  // Patched to shift left *then* divide, to minimize roundoff errors
-  // as well as to use SAMPLERATE as defined above, not to assume 11025 Hz
+  // The sound data is already at the output rate, so only the pitch
+  // changes the step
   if (pitched_sounds)
-    channelinfo[slot].step = step + (((channelinfo[slot].samplerate << 16) / snd_samplerate) - 65536);
+    command->step = step;
   else
-    channelinfo[slot].step = ((channelinfo[slot].samplerate << 16) / snd_samplerate);
+    command->step = 65536;
 
   // Separation, that is, orientation/stereo.
   //  range is: 1 - 256
@@ -366,15 +663,36 @@ static void updateSoundParams(int handle, sfx_params_t *params)
 
   // Get the proper lookup table piece
   //  for this volume level???
-  channelinfo[slot].leftvol = leftvol;
-  channelinfo[slot].rightvol = rightvol;
+  command->leftvol = leftvol;
+  command->rightvol = rightvol;
 }
 
 void I_UpdateSoundParams(int handle, sfx_params_t *params)
 {
-  SDL_LockMutex (sfxmutex);
-  updateSoundParams(handle, params);
-  SDL_UnlockMutex (sfxmutex);
+  sound_command_t command;
+
+  command.type = sound_command_params;
+  updateSoundParams(handle, params, &command);
+  I_QueueSoundCommand(&command);
+}
+
+void I_UpdateSoundParamsBatch(const int *handles, sfx_params_t *params, int count)
+{
+  sound_command_t commands[MAX_CHANNELS];
+  int i;
+
+#ifdef RANGECHECK
+  if (count > MAX_CHANNELS)
+    I_Error("I_UpdateSoundParamsBatch: too many channels");
+#endif
+
+  for (i = 0; i < count; i++)
+  {
+    commands[i].type = sound_command_params;
+    updateSoundParams(handles[i], &params[i], &commands[i]);
+  }
+
+  I_QueueSoundCommands(commands, count);
 }
 
 //
@@ -453,6 +771,7 @@ int I_GetSfxLumpNum(sfxinfo_t *sfx)
 int I_StartSound(int id, int channel, sfx_params_t *params)
 {
   const unsigned char *data;
+  const sfx_cache_t *sfx;
   int lump;
   size_t len;
 
@@ -481,13 +800,28 @@ int I_StartSound(int id, int channel, sfx_params_t *params)
   // not in a memory mapped one
   data = (const unsigned char *)W_LockLumpNum(lump);
 
-  SDL_LockMutex (sfxmutex);
+  // decode and resample outside the lock too
+  sfx = I_CacheSfx(id, data, len);
+  if (!sfx)
+    return -1;
+
+  {
+    sound_command_t command;
+
+    command.type = sound_command_start;
+    command.id = id;
+    sound_seq = sound_seq % INT_MAX + 1; // 0 means never played
+    command.seq = sound_seq;
+    command.starttime = gametic;
+    command.data = sfx->samples;
+    command.enddata = sfx->samples + sfx->length;
+    updateSoundParams(channel, params, &command);
 
-  // Returns a handle (not used).
-  addsfx(id, channel, data, len);
-  updateSoundParams(channel, params);
+    channel_seq[channel] = command.seq;
+    channel_stopped[channel] = false;
 
-  SDL_UnlockMutex (sfxmutex);
+    I_QueueSoundCommand(&command);
+  }
 
 
   return channel;
@@ -502,9 +836,16 @@ void I_StopSound (int handle)
     I_Error("I_StopSound: handle out of range");
 #endif
 
-  SDL_LockMutex (sfxmutex);
-  stopchan(handle);
-  SDL_UnlockMutex (sfxmutex);
+  {
+    sound_command_t command;
+
+    command.type = sound_command_stop;
+    command.channel = handle;
+
+    channel_stopped[handle] = true;
+
+    I_QueueSoundCommand(&command);
+  }
 }
 
 
@@ -515,7 +856,9 @@ dboolean I_SoundIsPlaying(int handle)
     I_Error("I_SoundIsPlaying: handle out of range");
 #endif
 
-  return channelinfo[handle].data != NULL;
+  return channel_seq[handle] &&
+         !channel_stopped[handle] &&
+         SDL_AtomicGet(&channel_done[handle]) != channel_seq[handle];
 }
 
 
@@ -525,20 +868,157 @@ dboolean I_AnySoundStillPlaying(void)
   int i;
 
   for (i = 0; i < MAX_CHANNELS; i++)
-    result |= channelinfo[i].data != NULL;
+    result |= I_SoundIsPlaying(i);
 
   return result;
 }
 
 
+// Number of output frames mixed at a time
+#define MIX_BLOCK_SIZE 256
+
+//
+// Reads up to count samples from a channel, resampled to the output rate.
+// Returns the number of samples read, which is less than count if the
+//  sound ended.
+//
+static int I_ReadChannel(int chan, int *out, int count)
+{
+  channel_info_t *ci = channelinfo + chan;
+  const short *data = ci->data;
+  const short *enddata = ci->enddata;
+  unsigned int stepremainder = ci->stepremainder;
+  const unsigned int step = ci->step;
+  dboolean stopped = false;
+  int i = 0;
+
+  if (step == 65536)
+  {
+    // Unpitched sounds are at the output rate, so just copy them
+    while (i < count)
+    {
+      int n = count - i;
+      int k;
+
+      if (n > enddata - data)
+        n = enddata - data;
+
+      for (k = 0; k < n; k++)
+        out[i + k] = data[k] * 255;
+
+      i += n;
+      data += n;
+
+      // Check whether we are done.
+      if (data >= enddata)
+      {
+        if (!ci->loop)
+        {
+          stopped = true;
+          break;
+        }
+        data = ci->startdata;
+      }
+    }
+  }
+  else
+  {
+    // linear filtering between output rate samples for pitch shifts
+    while (i < count)
+    {
+      out[i++] = data[0] * (255 - (stepremainder >> 8))
+               + data[1] * (stepremainder >> 8);
+
+      stepremainder += step;
+      data += stepremainder >> 16;
+      stepremainder &= 0xffff;
+
+      if (data >= enddata)
+      {
+        if (!ci->loop)
+        {
+          stopped = true;
+          break;
+        }
+        data = ci->startdata;
+      }
+    }
+  }
+
+  if (stopped)
+    stopchan(chan);
+  else
+  {
+    ci->data = data;
+    ci->stepremainder = stepremainder;
+  }
+
+  return i;
+}
+
 //
-// This function loops all active (internal) sound
-//  channels, retrieves a given number of samples
-//  from the raw sound data, modifies it according
-//  to the current (internal) channel parameters,
-//  mixes the per channel samples into the given
-//  mixing buffer, and clamping it to the allowed
-//  range.
+// Mixes the active channels into the interleaved stereo stream,
+//  one channel at a time over blocks of MIX_BLOCK_SIZE frames.
+// The accumulators are plain int arrays so the volume and clamp
+//  loops can be vectorized by the compiler. Integer addition is
+//  order independent, so the result matches mixing frame by frame.
+//
+static void I_MixSound(signed short *stream, int frames)
+{
+  int left[MIX_BLOCK_SIZE];
+  int right[MIX_BLOCK_SIZE];
+  int samples[MIX_BLOCK_SIZE];
+  int chan, i, count;
+
+  for (; frames > 0; frames -= count, stream += count * 2)
+  {
+    count = MIX_BLOCK_SIZE < frames ? MIX_BLOCK_SIZE : frames;
+
+    // Start from what the music left in the stream
+    for (i = 0; i < count; i++)
+    {
+      left[i] = stream[i * 2];
+      right[i] = stream[i * 2 + 1];
+    }
+
+    for (chan = 0; chan < numChannels; chan++)
+    {
+      int leftvol, rightvol, n;
+
+      if (!channelinfo[chan].data)
+        continue;
+
+      leftvol = channelinfo[chan].leftvol;
+      rightvol = channelinfo[chan].rightvol;
+
+      n = I_ReadChannel(chan, samples, count);
+
+      // full loudness (vol=127) is actually 127/191
+      for (i = 0; i < n; i++)
+      {
+        left[i] += leftvol * samples[i] / 49152;  // >> 15;
+        right[i] += rightvol * samples[i] / 49152; // >> 15;
+      }
+    }
+
+    // Clamp to range.
+    for (i = 0; i < count; i++)
+    {
+      int dl = left[i];
+      int dr = right[i];
+
+      dl = dl > SHRT_MAX ? SHRT_MAX : dl < SHRT_MIN ? SHRT_MIN : dl;
+      dr = dr > SHRT_MAX ? SHRT_MAX : dr < SHRT_MIN ? SHRT_MIN : dr;
+
+      stream[i * 2] = (signed short)dl;
+      stream[i * 2 + 1] = (signed short)dr;
+    }
+  }
+}
+
+//
+// This function mixes all active (internal) sound
+//  channels and the music into the given stream.
 //
 // This function currently supports only 16bit.
 //
@@ -547,22 +1027,6 @@ static void UpdateMusic (void *buff, unsigned nsamp);
 
 static void I_UpdateSound(void *unused, Uint8 *stream, int len)
 {
-  // Mix current sound data.
-  // Data, from raw sound, for right and left.
-  // register unsigned char sample;
-  register int    dl;
-  register int    dr;
-
-  // Pointers in audio stream, left, right, end.
-  signed short   *leftout;
-  signed short   *rightout;
-  signed short   *leftend;
-  // Step in stream, left and right, thus two.
-  int       step;
-
-  // Mixing channel index.
-  int       chan;
-
   if (snd_midiplayer == NULL) // This is but a temporary fix. Please do remove after a more definitive one!
     memset(stream, 0, len);
 
@@ -579,118 +1043,125 @@ static void I_UpdateSound(void *unused, Uint8 *stream, int len)
     SDL_UnlockMutex (musmutex);
   }
 
-  SDL_LockMutex (sfxmutex);
-  // Left and right channel
-  //  are in audio stream, alternating.
-  leftout = (signed short *)stream;
-  rightout = ((signed short *)stream) + 1;
-  step = 2;
-
-  // Determine end, for left channel only
-  //  (right channel is implicit).
-  leftend = leftout + (len / 4) * step;
-
-  // Mix sounds into the mixing buffer.
-  // Loop over step*SAMPLECOUNT,
-  //  that is 512 values for two channels.
-  while (leftout != leftend)
+  SDL_AtomicLock (&mixer_lock);
+  I_ApplySoundCommands ();
+  I_MixSound((signed short *) stream, len / 4);
+  SDL_AtomicUnlock (&mixer_lock);
+}
+
+//
+// The frame by frame mixer that I_MixSound replaced, kept as the
+//  reference for I_BenchmarkSoundMixer.
+//
+static void I_MixSoundReference(signed short *stream, int frames)
+{
+  int i, chan;
+
+  for (i = 0; i < frames; i++)
   {
-    // Reset left/right value.
-    //dl = 0;
-    //dr = 0;
-    dl = *leftout;
-    dr = *rightout;
-
-    // Love thy L2 chache - made this a loop.
-    // Now more channels could be set at compile time
-    //  as well. Thus loop those  channels.
-    for ( chan = 0; chan < numChannels; chan++ )
+    int dl = stream[i * 2];
+    int dr = stream[i * 2 + 1];
+
+    for (chan = 0; chan < numChannels; chan++)
     {
-      channel_info_t *ci = channelinfo + chan;
+      int s;
 
-      // Check channel, if active.
-      if (ci->data)
-      {
-        int s;
-        // Get the raw data from the channel.
-        // no filtering
-        //int s = channelinfo[chan].data[0] * 0x10000 - 0x800000;
-
-        // linear filtering
-        // the old SRC did linear interpolation back into 8 bit, and then expanded to 16 bit.
-        // this does interpolation and 8->16 at same time, allowing slightly higher quality
-        if (ci->bits == 16)
-        {
-          s = (short)(ci->data[0] | (ci->data[1] << 8)) * (255 - (ci->stepremainder >> 8))
-            + (short)(ci->data[2] | (ci->data[3] << 8)) * (ci->stepremainder >> 8);
-        }
-        else
-        {
-          s = ((unsigned int)ci->data[0] * (0x10000 - ci->stepremainder))
-            + ((unsigned int)ci->data[1] * (ci->stepremainder))
-            - 0x800000; // convert to signed
-        }
+      if (!channelinfo[chan].data)
+        continue;
+
+      I_ReadChannel(chan, &s, 1);
 
+      dl += channelinfo[chan].leftvol * s / 49152;
+      dr += channelinfo[chan].rightvol * s / 49152;
+    }
 
-        // Add left and right part
-        //  for this channel (sound)
-        //  to the current data.
-        // Adjust volume accordingly.
+    stream[i * 2] = dl > SHRT_MAX ? SHRT_MAX : dl < SHRT_MIN ? SHRT_MIN : dl;
+    stream[i * 2 + 1] = dr > SHRT_MAX ? SHRT_MAX : dr < SHRT_MIN ? SHRT_MIN : dr;
+  }
+}
 
-        // full loudness (vol=127) is actually 127/191
+static void I_SetupBenchmarkChannels(const short *sound, int length, int channel_count)
+{
+  int i;
 
-        dl += ci->leftvol * s / 49152;  // >> 15;
-        dr += ci->rightvol * s / 49152; // >> 15;
+  for (i = 0; i < channel_count; i++)
+  {
+    channel_info_t *ci = channelinfo + i;
+
+    memset(ci, 0, sizeof(*ci));
+
+    ci->id = i;
+    ci->startdata = ci->data = sound + (i * 997) % (length / 2);
+    ci->enddata = sound + length;
+    // every third channel is pitch shifted
+    ci->step = (i % 3 == 2) ? 65536 + (i % 7) * 2048 - 6144 : 65536;
+    ci->leftvol = (i * 37) % 128;
+    ci->rightvol = 127 - ci->leftvol;
+    ci->loop = (i % 3 != 0);
+  }
+}
 
-        // Increment index ???
-        ci->stepremainder += ci->step;
+//
+// Mixes ten seconds of synthetic audio on the given number of channels
+//  with both mixers, checks that they agree, and prints the timings.
+//
+int I_BenchmarkSoundMixer(int channel_count)
+{
+  const int rate = 44100;
+  const int frames = rate * 10;
+  const int length = rate * 2;
+  short *sound;
+  signed short *stream[2];
+  int old_num_channels;
+  int pass, i;
+  unsigned long long elapsed[2];
+
+  if (channel_count > MAX_CHANNELS)
+    channel_count = MAX_CHANNELS;
+
+  // the interpolation reads one sample past the end
+  sound = Z_Malloc((length + 1) * sizeof(*sound));
+  for (i = 0; i < length + 1; i++)
+    sound[i] = (short) ((i * 7 + (i >> 5) * 13) * 256);
+
+  old_num_channels = numChannels;
+  numChannels = channel_count;
+
+  for (pass = 0; pass < 2; pass++)
+  {
+    stream[pass] = Z_Calloc(frames * 2, sizeof(signed short));
 
-        // MSB is next sample???
-        if (ci->bits == 16)
-          ci->data += (ci->stepremainder >> 16) * 2;
-        else
-          ci->data += ci->stepremainder >> 16;
+    I_SetupBenchmarkChannels(sound, length, channel_count);
 
-        // Limit to LSB???
-        ci->stepremainder &= 0xffff;
+    dsda_StartTimer(dsda_timer_temp);
+    for (i = 0; i < frames; i += 512)
+    {
+      int count = frames - i < 512 ? frames - i : 512;
 
-        // Check whether we are done.
-        if (ci->data >= ci->enddata)
-        {
-          if (ci->loop)
-            ci->data = ci->startdata;
-          else
-            stopchan(chan);
-        }
-      }
+      if (pass)
+        I_MixSound(stream[pass] + i * 2, count);
+      else
+        I_MixSoundReference(stream[pass] + i * 2, count);
     }
+    elapsed[pass] = dsda_ElapsedTime(dsda_timer_temp);
+  }
 
-    // Clamp to range. Left hardware channel.
-    // Has been char instead of short.
-    // if (dl > 127) *leftout = 127;
-    // else if (dl < -128) *leftout = -128;
-    // else *leftout = dl;
+  numChannels = old_num_channels;
+  memset(channelinfo, 0, sizeof(channelinfo));
 
-    if (dl > SHRT_MAX)
-      *leftout = SHRT_MAX;
-    else if (dl < SHRT_MIN)
-      *leftout = SHRT_MIN;
-    else
-      *leftout = (signed short)dl;
+  lprintf(LO_INFO, "I_BenchmarkSoundMixer: %d channels, %d frames\n", channel_count, frames);
+  lprintf(LO_INFO, "  frame by frame: %llu us\n", elapsed[0]);
+  lprintf(LO_INFO, "  channel blocks: %llu us\n", elapsed[1]);
 
-    // Same for right hardware channel.
-    if (dr > SHRT_MAX)
-      *rightout = SHRT_MAX;
-    else if (dr < SHRT_MIN)
-      *rightout = SHRT_MIN;
-    else
-      *rightout = (signed short)dr;
+  i = memcmp(stream[0], stream[1], frames * 2 * sizeof(signed short));
+  if (i)
+    lprintf(LO_ERROR, "I_BenchmarkSoundMixer: mixer output differs from the reference\n");
 
-    // Increment current pointers in stream
-    leftout += step;
-    rightout += step;
-  }
-  SDL_UnlockMutex (sfxmutex);
+  Z_Free(stream[0]);
+  Z_Free(stream[1]);
+  Z_Free(sound);
+
+  return i ? 1 : 0;
 }
 
 static dboolean sound_was_initialized;
@@ -703,12 +1174,6 @@ void I_ShutdownSound(void)
     SDL_CloseAudio();
 
     sound_was_initialized = false;
-
-    if (sfxmutex)
-    {
-      SDL_DestroyMutex (sfxmutex);
-      sfxmutex = NULL;
-    }
   }
 }
 
@@ -758,8 +1223,6 @@ void I_InitSound(void)
 
   I_AtExit(I_ShutdownSound, true, "I_ShutdownSound", exit_priority_normal);
 
-  sfxmutex = SDL_CreateMutex ();
-
   if (!nomusicparm)
     I_InitMusic();
 
@@ -918,6 +1381,60 @@ const char *midiplayers[midi_player_last + 1] = {
 static int current_player = -1;
 static const void *music_handle = NULL;
 
+// Pre-rendered copy of the current song, played instead of the player
+static dsda_music_cache_t *music_cache;
+
+static void cache_setvolume (int v)
+{
+  dsda_SetMusicCacheVolume (music_cache, v);
+}
+
+static void cache_pause (void)
+{
+  dsda_PauseMusicCache (music_cache);
+}
+
+static void cache_resume (void)
+{
+  dsda_ResumeMusicCache (music_cache);
+}
+
+static void cache_play (const void *handle, int looping)
+{
+  dsda_PlayMusicCache (music_cache, looping);
+}
+
+static void cache_stop (void)
+{
+  dsda_StopMusicCache (music_cache);
+}
+
+static void cache_render (void *dest, unsigned nsamp)
+{
+  dsda_ReadMusicCache (music_cache, dest, nsamp);
+}
+
+static const music_player_t cache_player =
+{
+  NULL,
+  NULL,
+  NULL,
+  cache_setvolume,
+  cache_pause,
+  cache_resume,
+  NULL,
+  NULL,
+  cache_play,
+  cache_stop,
+  cache_render
+};
+
+// Call with musmutex held
+static const music_player_t *CurrentPlayer (void)
+{
+  return music_cache ? &cache_player : music_players[current_player];
+}
+
 static void *mus2mid_conversion_data = NULL;
 
 void I_ShutdownMusic(void)
@@ -970,7 +1487,7 @@ void I_ResetMusicVolume(void)
   if (music_handle)
   {
     SDL_LockMutex(musmutex);
-    music_players[current_player]->setvolume(music_volume);
+    CurrentPlayer()->setvolume(music_volume);
     SDL_UnlockMutex(musmutex);
   }
 }
@@ -1114,13 +1631,35 @@ int I_RegisterSong(const void *data, size_t len)
   return (0);
 }
 
+// The first play of an uncached song hands the player to the render task
+static void StartMusicRender (void)
+{
+  const music_player_t *player = music_players[current_player];
+
+  if (dsda_MusicCacheReady (music_cache) || dsda_MusicCacheRendering (music_cache))
+    return;
+
+  player->play (music_handle, 0);
+  player->resume ();
+  player->setvolume (15);
+  if (!dsda_StartMusicRender (music_cache, player->render, player->finished))
+  {
+    // Play the song live instead
+    player->stop ();
+    dsda_CloseMusicCache (music_cache);
+    music_cache = NULL;
+  }
+}
+
 static void PlaySong(int handle, int looping)
 {
   if (music_handle)
   {
     SDL_LockMutex (musmutex);
-    music_players[current_player]->play (music_handle, looping);
-    music_players[current_player]->setvolume (music_volume);
+    if (music_cache)
+      StartMusicRender ();
+    CurrentPlayer()->play (music_handle, looping);
+    CurrentPlayer()->setvolume (music_volume);
     SDL_UnlockMutex (musmutex);
   }
 }
@@ -1134,10 +1673,10 @@ static void PauseSong (int handle)
   switch (dsda_IntConfig(dsda_config_mus_pause_opt))
   {
     case 0:
-      music_players[current_player]->stop ();
+      CurrentPlayer()->stop ();
       break;
     case 1:
-      music_players[current_player]->pause ();
+      CurrentPlayer()->pause ();
       break;
     default: // Default - let music continue
       break;
@@ -1155,10 +1694,10 @@ static void ResumeSong (int handle)
   {
     case 0: // i'm not sure why we can guarantee looping=true here,
             // but that's what the old code did
-      music_players[current_player]->play (music_handle, 1);
+      CurrentPlayer()->play (music_handle, 1);
       break;
     case 1:
-      music_players[current_player]->resume ();
+      CurrentPlayer()->resume ();
       break;
     default: // Default - music was never stopped
       break;
@@ -1169,17 +1708,66 @@ static void ResumeSong (int handle)
 static void StopSong(int handle)
 {
   if (music_handle)
+  {
+    SDL_LockMutex (musmutex);
+    CurrentPlayer()->stop ();
+    SDL_UnlockMutex (musmutex);
+  }
+}
+
+static void CloseMusicCache (void)
+{
+  dsda_music_cache_t *cache = music_cache;
+
+  if (!cache)
+    return;
+
+  // wait for the render task to let go of the player
+  if (dsda_FinishMusicRender (cache))
   {
     SDL_LockMutex (musmutex);
     music_players[current_player]->stop ();
     SDL_UnlockMutex (musmutex);
   }
+
+  SDL_LockMutex (musmutex);
+  music_cache = NULL;
+  SDL_UnlockMutex (musmutex);
+
+  dsda_CloseMusicCache (cache);
+}
+
+static void OpenMusicCache (const void *data, size_t len)
+{
+  const music_player_t *player = music_players[current_player];
+  dsda_startup_cache_t key;
+  dsda_music_cache_t *cache;
+  const char *name;
+
+  // video capture renders music in lockstep with the game
+  if (!dsda_IntConfig(dsda_config_mus_cache) || !player->hashsettings || dumping_sound)
+    return;
+
+  name = player->name ();
+
+  dsda_OpenStartupCache (&key, "music");
+  dsda_HashStartupCacheData (&key, data, (int) len);
+  dsda_HashStartupCacheData (&key, name, strlen (name));
+  player->hashsettings (&key);
+  cache = dsda_OpenMusicCache (&key, snd_samplerate);
+  dsda_CloseStartupCache (&key);
+
+  SDL_LockMutex (musmutex);
+  music_cache = cache;
+  SDL_UnlockMutex (musmutex);
 }
 
 static void UnRegisterSong(int handle)
 {
   if (music_handle)
   {
+    CloseMusicCache ();
+
     SDL_LockMutex (musmutex);
     music_players[current_player]->unregistersong (music_handle);
     music_handle = NULL;
@@ -1316,7 +1904,10 @@ static int RegisterSong (const void *data, size_t len)
   result = RegisterSongEx (data, len, 1);
 
   if (result)
+  {
     registered_non_rw = true;
+    OpenMusicCache (data, len);
+  }
 
   return result;
 }
@@ -1329,7 +1920,7 @@ static void UpdateMusic (void *buff, unsigned nsamp)
     return;
   }
 
-  music_players[current_player]->render (buff, nsamp);
+  CurrentPlayer()->render (buff, nsamp);
 }
 
 void M_ChangeMIDIPlayer(void)
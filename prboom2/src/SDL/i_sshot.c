@@ -37,6 +37,7 @@
 #endif
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "SDL.h"
 
@@ -51,6 +52,7 @@
 #include "i_video.h"
 #include "z_zone.h"
 #include "lprintf.h"
+#include "i_system.h"
 
 #include "dsda/gl/render_scale.h"
 
@@ -71,33 +73,232 @@ void I_UpdateRenderSize(void)
 }
 
 //
-// I_ScreenShot // Modified to work with SDL2 resizeable window and fullscreen desktop - DTIED
+// Screenshots are copied into a small pool of buffers and encoded and
+// written by a worker thread, so the game only waits on the encoder
+// when the pool is full (burst shots are dropped instead).
 //
 
-int I_ScreenShot(const char *fname)
+#define SCREENSHOT_QUEUE_SIZE 8
+
+typedef struct
+{
+  unsigned char *pixels;
+  size_t capacity;
+  int width;
+  int height;
+  char *fname;
+} screenshot_slot_t;
+
+static screenshot_slot_t screenshot_queue[SCREENSHOT_QUEUE_SIZE];
+static int screenshot_head; // written by the game thread
+static int screenshot_tail; // written by the worker
+static dboolean screenshot_closing;
+static SDL_mutex *screenshot_mutex;
+static SDL_cond *screenshot_cond;
+static SDL_Thread *screenshot_thread;
+static SDL_atomic_t screenshot_errors;
+
+static int I_SaveScreenShot(const screenshot_slot_t *slot)
 {
   int result = -1;
-  unsigned char *pixels = I_GrabScreen();
-  SDL_Surface *screenshot = NULL;
+  SDL_Surface *screenshot;
 
-  if (pixels)
-  {
-    screenshot = SDL_CreateRGBSurfaceFrom(pixels, renderW, renderH, 24,
-      renderW * 3, 0x000000ff, 0x0000ff00, 0x00ff0000, 0);
-  }
+  screenshot = SDL_CreateRGBSurfaceFrom(slot->pixels, slot->width, slot->height, 24,
+    slot->width * 3, 0x000000ff, 0x0000ff00, 0x00ff0000, 0);
 
   if (screenshot)
   {
 #ifdef HAVE_LIBSDL2_IMAGE
-    result = IMG_SavePNG(screenshot, fname);
+    result = IMG_SavePNG(screenshot, slot->fname);
 #else
-    result = SDL_SaveBMP(screenshot, fname);
+    result = SDL_SaveBMP(screenshot, slot->fname);
 #endif
     SDL_FreeSurface(screenshot);
   }
+
   return result;
 }
 
+static int I_ScreenShotThread(void *data)
+{
+  while (1)
+  {
+    screenshot_slot_t *slot;
+
+    SDL_LockMutex(screenshot_mutex);
+    while (screenshot_tail == screenshot_head && !screenshot_closing)
+      SDL_CondWait(screenshot_cond, screenshot_mutex);
+    if (screenshot_tail == screenshot_head)
+    {
+      SDL_UnlockMutex(screenshot_mutex);
+      break;
+    }
+    slot = &screenshot_queue[screenshot_tail % SCREENSHOT_QUEUE_SIZE];
+    SDL_UnlockMutex(screenshot_mutex);
+
+    if (I_SaveScreenShot(slot) != 0)
+      SDL_AtomicAdd(&screenshot_errors, 1);
+
+    free(slot->fname);
+    slot->fname = NULL;
+
+    SDL_LockMutex(screenshot_mutex);
+    screenshot_tail++;
+    SDL_CondSignal(screenshot_cond);
+    SDL_UnlockMutex(screenshot_mutex);
+  }
+
+  return 0;
+}
+
+// Waits for queued screenshots to be written
+void I_FinishScreenShots(void)
+{
+  int i;
+
+  if (!screenshot_thread)
+    return;
+
+  SDL_LockMutex(screenshot_mutex);
+  screenshot_closing = true;
+  SDL_CondSignal(screenshot_cond);
+  SDL_UnlockMutex(screenshot_mutex);
+  SDL_WaitThread(screenshot_thread, NULL);
+  screenshot_thread = NULL;
+
+  for (i = 0; i < SCREENSHOT_QUEUE_SIZE; i++)
+  {
+    free(screenshot_queue[i].pixels);
+    screenshot_queue[i].pixels = NULL;
+    screenshot_queue[i].capacity = 0;
+  }
+
+  SDL_DestroyCond(screenshot_cond);
+  SDL_DestroyMutex(screenshot_mutex);
+  screenshot_closing = false;
+}
+
+static dboolean I_StartScreenShots(void)
+{
+  if (screenshot_thread)
+    return true;
+
+  screenshot_mutex = SDL_CreateMutex();
+  screenshot_cond = SDL_CreateCond();
+  if (screenshot_mutex && screenshot_cond)
+    screenshot_thread = SDL_CreateThread(I_ScreenShotThread, "screenshot", NULL);
+
+  if (!screenshot_thread)
+  {
+    if (screenshot_cond)
+      SDL_DestroyCond(screenshot_cond);
+    if (screenshot_mutex)
+      SDL_DestroyMutex(screenshot_mutex);
+    screenshot_cond = NULL;
+    screenshot_mutex = NULL;
+    return false;
+  }
+
+  I_AtExit(I_FinishScreenShots, true, "I_FinishScreenShots", exit_priority_normal);
+
+  return true;
+}
+
+// Returns the number of queued screenshots that failed to save since
+// the last call
+int I_ScreenShotErrors(void)
+{
+  return SDL_AtomicSet(&screenshot_errors, 0);
+}
+
+//
+// I_ScreenShot // Modified to work with SDL2 resizeable window and fullscreen desktop - DTIED
+//
+// Returns 0 once the screenshot is queued (or saved, if the worker can't
+// start), 1 if a burst shot was dropped because the queue is full, and -1
+// on failure.
+//
+
+static int I_QueueScreenShot(const char *fname, dboolean drop)
+{
+  screenshot_slot_t *slot;
+  unsigned char *pixels;
+  size_t size;
+
+  if (!I_StartScreenShots())
+  {
+    screenshot_slot_t direct;
+
+    // No worker, so save it here as before the queue existed
+    direct.pixels = I_GrabScreen();
+    if (!direct.pixels)
+      return -1;
+
+    direct.width = renderW;
+    direct.height = renderH;
+    direct.fname = (char *) fname;
+
+    return I_SaveScreenShot(&direct);
+  }
+
+  SDL_LockMutex(screenshot_mutex);
+  if (screenshot_head - screenshot_tail == SCREENSHOT_QUEUE_SIZE)
+  {
+    if (drop)
+    {
+      SDL_UnlockMutex(screenshot_mutex);
+      return 1;
+    }
+
+    while (screenshot_head - screenshot_tail == SCREENSHOT_QUEUE_SIZE)
+      SDL_CondWait(screenshot_cond, screenshot_mutex);
+  }
+  slot = &screenshot_queue[screenshot_head % SCREENSHOT_QUEUE_SIZE];
+  SDL_UnlockMutex(screenshot_mutex);
+
+  pixels = I_GrabScreen();
+  if (!pixels)
+    return -1;
+
+  size = renderW * renderH * 3;
+  if (size > slot->capacity)
+  {
+    free(slot->pixels);
+    slot->pixels = malloc(size);
+    slot->capacity = slot->pixels ? size : 0;
+  }
+
+  slot->fname = malloc(strlen(fname) + 1);
+  if (!slot->pixels || !slot->fname)
+  {
+    free(slot->fname);
+    slot->fname = NULL;
+    return -1;
+  }
+
+  strcpy(slot->fname, fname);
+  memcpy(slot->pixels, pixels, size);
+  slot->width = renderW;
+  slot->height = renderH;
+
+  SDL_LockMutex(screenshot_mutex);
+  screenshot_head++;
+  SDL_CondSignal(screenshot_cond);
+  SDL_UnlockMutex(screenshot_mutex);
+
+  return 0;
+}
+
+int I_ScreenShot(const char *fname)
+{
+  return I_QueueScreenShot(fname, false);
+}
+
+int I_BurstScreenShot(const char *fname)
+{
+  return I_QueueScreenShot(fname, true);
+}
+
 // NSM
 // returns current screen contents as RGB24 (raw)
 // returned pointer should be freed when done
@@ -114,7 +114,6 @@ extern void M_QuitDOOM(int choice);
 int desired_fullscreen;
 int exclusive_fullscreen;
 SDL_Surface *screen;
-static SDL_Surface *buffer;
 SDL_Window *sdl_window;
 SDL_Renderer *sdl_renderer;
 static SDL_Texture *sdl_texture;
@@ -122,6 +121,9 @@ static SDL_GLContext sdl_glcontext;
 unsigned int windowid = 0;
 SDL_Rect src_rect = { 0, 0, 0, 0 };
 
+// The current palette as texture pixels (SDL_PIXELFORMAT_RGB888)
+static Uint32 palette_lut[256];
+
 ////////////////////////////////////////////////////////////////////////////
 // Input code
 int             leds_always_off = 0; // Expected by m_misc, not relevant
@@ -523,7 +525,47 @@ static void I_UploadNewPalette(int pal, int force)
       pal, num_pals);
 #endif
 
-  SDL_SetPaletteColors(screen->format->palette, playpal_data->colours + 256 * pal, 0, 256);
+  {
+    const SDL_Color *colours = playpal_data->colours + 256 * pal;
+    int i;
+
+    for (i = 0; i < 256; i++)
+      palette_lut[i] = (colours[i].r << 16) | (colours[i].g << 8) | colours[i].b;
+  }
+}
+
+// Expands the paletted screen straight into the locked texture.
+// Unrolled so the table lookups overlap; this replaces the copy into the
+// 8-bit surface, SDL's palette blit and the texture upload.
+static void I_ExpandScreen(Uint32 *dest, int dest_pitch)
+{
+  const byte *src = screens[0].data;
+  int width = SCREENWIDTH;
+  int y;
+
+  for (y = 0; y < SCREENHEIGHT; y++)
+  {
+    int x = 0;
+
+    for (; x + 4 <= width; x += 4)
+    {
+      Uint32 p0 = palette_lut[src[x]];
+      Uint32 p1 = palette_lut[src[x + 1]];
+      Uint32 p2 = palette_lut[src[x + 2]];
+      Uint32 p3 = palette_lut[src[x + 3]];
+
+      dest[x] = p0;
+      dest[x + 1] = p1;
+      dest[x + 2] = p2;
+      dest[x + 3] = p3;
+    }
+
+    for (; x < width; x++)
+      dest[x] = palette_lut[src[x]];
+
+    src += screens[0].pitch;
+    dest = (Uint32 *) ((byte *) dest + dest_pitch);
+  }
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -561,6 +603,12 @@ void I_HandleCapture(void)
     M_ScreenShot();
     queue_screenshot = false;
   }
+
+  M_BurstScreenShot();
+
+  // screenshots are saved in the background
+  if (I_ScreenShotErrors())
+    doom_printf("M_ScreenShot: Error writing screenshot\n");
 }
 
 //
@@ -586,29 +634,6 @@ void I_FinishUpdate (void)
     return;
   }
 
-  if (SDL_MUSTLOCK(screen)) {
-      int h;
-      byte *src;
-      byte *dest;
-
-      if (SDL_LockSurface(screen) < 0) {
-        lprintf(LO_INFO,"I_FinishUpdate: %s\n", SDL_GetError());
-        return;
-      }
-
-      dest=(byte*)screen->pixels;
-      src=screens[0].data;
-      h=screen->h;
-      for (; h>0; h--)
-      {
-        memcpy(dest,src,SCREENWIDTH); //e6y
-        dest+=screen->pitch;
-        src+=screens[0].pitch;
-      }
-
-      SDL_UnlockSurface(screen);
-  }
-
   /* Update the display buffer (flipping video pages if supported)
    * If we need to change palette, that implicitely does a flip */
   if (newpal != NO_PALETTE_CHANGE) {
@@ -616,12 +641,20 @@ void I_FinishUpdate (void)
     newpal = NO_PALETTE_CHANGE;
   }
 
-  // Blit from the paletted 8-bit screen buffer to the intermediate
-  // 32-bit RGBA buffer that we can load into the texture.
-  SDL_LowerBlit(screen, &src_rect, buffer, &src_rect);
+  // Expand the paletted 8-bit screen buffer into the streaming texture.
+  {
+    void *pixels;
+    int pitch;
+
+    if (SDL_LockTexture(sdl_texture, &src_rect, &pixels, &pitch) < 0) {
+      lprintf(LO_INFO,"I_FinishUpdate: %s\n", SDL_GetError());
+      return;
+    }
 
-  // Update the intermediate texture with the contents of the RGBA buffer.
-  SDL_UpdateTexture(sdl_texture, &src_rect, buffer->pixels, buffer->pitch);
+    I_ExpandScreen(pixels, pitch);
+
+    SDL_UnlockTexture(sdl_texture);
+  }
 
   // Make sure the pillarboxes are kept clear each frame.
   SDL_RenderClear(sdl_renderer);
@@ -652,7 +685,6 @@ static void I_ShutdownSDL(void)
 {
   if (sdl_glcontext) SDL_GL_DeleteContext(sdl_glcontext);
   if (screen) SDL_FreeSurface(screen);
-  if (buffer) SDL_FreeSurface(buffer);
   if (sdl_texture) SDL_DestroyTexture(sdl_texture);
   if (sdl_renderer) SDL_DestroyRenderer(sdl_renderer);
   if (sdl_window) SDL_DestroyWindow(sdl_window);
@@ -1238,7 +1270,6 @@ void I_UpdateVideoMode(void)
 
     if (sdl_glcontext) SDL_GL_DeleteContext(sdl_glcontext);
     if (screen) SDL_FreeSurface(screen);
-    if (buffer) SDL_FreeSurface(buffer);
     if (sdl_texture) SDL_DestroyTexture(sdl_texture);
     if (sdl_renderer) SDL_DestroyRenderer(sdl_renderer);
     SDL_DestroyWindow(sdl_window);
@@ -1247,7 +1278,6 @@ void I_UpdateVideoMode(void)
     sdl_window = NULL;
     sdl_glcontext = NULL;
     screen = NULL;
-    buffer = NULL;
     sdl_texture = NULL;
   }
 
@@ -1342,10 +1372,10 @@ void I_UpdateVideoMode(void)
     SDL_RenderSetIntegerScale(sdl_renderer, integer_scaling);
 
     screen = SDL_CreateRGBSurface(0, SCREENWIDTH, SCREENHEIGHT, 8, 0, 0, 0, 0);
-    buffer = SDL_CreateRGBSurface(0, SCREENWIDTH, SCREENHEIGHT, 32, 0, 0, 0, 0);
-    SDL_FillRect(buffer, NULL, 0);
 
-    sdl_texture = SDL_CreateTextureFromSurface(sdl_renderer, buffer);
+    // Written directly by I_FinishUpdate every frame
+    sdl_texture = SDL_CreateTexture(sdl_renderer, SDL_PIXELFORMAT_RGB888,
+                                    SDL_TEXTUREACCESS_STREAMING, SCREENWIDTH, SCREENHEIGHT);
 
     if(screen == NULL) {
       I_Error("Couldn't set %dx%d video mode [%s]", SCREENWIDTH, SCREENHEIGHT, SDL_GetError());
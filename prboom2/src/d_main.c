@@ -77,6 +77,7 @@
 #include "r_draw.h"
 #include "r_main.h"
 #include "r_fps.h"
+#include "r_patch.h"
 #include "d_main.h"
 #include "d_deh.h"  // Ty 04/08/98 - Externalizations
 #include "lprintf.h"  // jff 08/03/98 - declaration of lprintf
@@ -104,6 +105,7 @@
 #include "dsda/skill_info.h"
 #include "dsda/skip.h"
 #include "dsda/sndinfo.h"
+#include "dsda/startup_report.h"
 #include "dsda/time.h"
 #include "dsda/utility.h"
 #include "dsda/wad_stats.h"
@@ -115,6 +117,9 @@
 
 #include "hexen/sn_sonix.h"
 
+#include "MUSIC/musicplayer.h"
+#include "MUSIC/oplplayer.h"
+
 // NSM
 #include "i_capture.h"
 
@@ -370,6 +375,8 @@ void D_Display (fixed_t frac)
   if (!I_StartDisplay())
     return;
 
+  R_UpdatePatchCache();
+
   if (setsizeneeded) {               // change the view size if needed
     R_ExecuteSetViewSize();
     oldgamestate = -1;            // force background redraw
@@ -812,9 +819,9 @@ void D_StartTitle (void)
 // CPhipps - static, const char* parameter
 //         - source is an enum
 //         - modified to allocate & use new wadfiles array
-void D_AddFile (const char *file, wad_source_t source)
+// data and length hold the contents of a file read from a zip
+static void D_AddWadFile(char *name, void *data, size_t length, wad_source_t source)
 {
-  char *gwa_filename=NULL;
   int len;
 
   // There can only be one iwad source!
@@ -828,10 +835,11 @@ void D_AddFile (const char *file, wad_source_t source)
   }
 
   wadfiles = Z_Realloc(wadfiles, sizeof(*wadfiles)*(numwadfiles+1));
-  wadfiles[numwadfiles].name =
-    AddDefaultExtension(strcpy(Z_Malloc(strlen(file)+5), file), ".wad");
+  wadfiles[numwadfiles].name = name;
   wadfiles[numwadfiles].src = source; // Ty 08/29/98
   wadfiles[numwadfiles].handle = 0;
+  wadfiles[numwadfiles].data = data;
+  wadfiles[numwadfiles].length = length;
 
   // No Rest For The Living
   len=strlen(wadfiles[numwadfiles].name);
@@ -839,6 +847,15 @@ void D_AddFile (const char *file, wad_source_t source)
     gamemission = pack_nerve;
 
   numwadfiles++;
+}
+
+void D_AddFile (const char *file, wad_source_t source)
+{
+  char *gwa_filename=NULL;
+
+  D_AddWadFile(AddDefaultExtension(strcpy(Z_Malloc(strlen(file)+5), file), ".wad"),
+               NULL, 0, source);
+
   // proff: automatically try to add the gwa files
   // proff - moved from w_wad.c
   gwa_filename=AddDefaultExtension(strcpy(Z_Malloc(strlen(file)+5), file), ".wad");
@@ -847,12 +864,10 @@ void D_AddFile (const char *file, wad_source_t source)
     char *ext;
     ext = &gwa_filename[strlen(gwa_filename)-4];
     ext[1] = 'g'; ext[2] = 'w'; ext[3] = 'a';
-    wadfiles = Z_Realloc(wadfiles, sizeof(*wadfiles)*(numwadfiles+1));
-    wadfiles[numwadfiles].name = gwa_filename;
-    wadfiles[numwadfiles].src = source_pwad; // Ty 08/29/98
-    wadfiles[numwadfiles].handle = 0;
-    numwadfiles++;
+    D_AddWadFile(gwa_filename, NULL, 0, source_pwad); // Ty 08/29/98
   }
+  else
+    Z_Free(gwa_filename);
 }
 
 // killough 10/98: support -dehout filename
@@ -1370,16 +1385,54 @@ static void LoadDehackedFilesAtPath(const char *path, dboolean defer_loading, de
     I_EndGlob(glob);
 }
 
+static void D_AddZippedFile(const char *zip_path, dsda_zip_entry_t *entry, wad_source_t source)
+{
+  dsda_string_t name;
+
+  dsda_StringPrintF(&name, "%s/%s", zip_path, entry->name);
+  D_AddWadFile(name.string, entry->data, entry->length, source);
+  entry->data = NULL;
+}
+
+// Wads in a zip are loaded from memory, like those of a directory
 static void D_AddZip(const char* zipped_file_name, wad_source_t source, deh_queue_t *deh_queue)
 {
   char* full_zip_path;
-  const char* temporary_directory;
+  const char* deh_directory;
+  dsda_zip_entry_t* entries;
+  int count, i, j;
 
   full_zip_path = I_RequireZip(zipped_file_name);
-  temporary_directory = dsda_UnzipFile(full_zip_path);
+  count = dsda_ReadZipFile(full_zip_path, &entries, &deh_directory);
+
+  for (i = 0; i < count; ++i)
+  {
+    if (!dsda_HasFileExt(entries[i].name, ".wad") && !dsda_HasFileExt(entries[i].name, ".lmp"))
+      continue;
+
+    D_AddZippedFile(full_zip_path, &entries[i], source);
 
-  LoadWADsAtPath(temporary_directory, source);
-  LoadDehackedFilesAtPath(temporary_directory, true, deh_queue);
+    // proff: automatically try to add the gwa files
+    if (dsda_HasFileExt(entries[i].name, ".wad"))
+      for (j = 0; j < count; ++j)
+        if (dsda_HasFileExt(entries[j].name, ".gwa") &&
+            strlen(entries[j].name) == strlen(entries[i].name) &&
+            !strncmp(entries[j].name, entries[i].name, strlen(entries[i].name) - 4))
+        {
+          D_AddZippedFile(full_zip_path, &entries[j], source_pwad);
+          break;
+        }
+  }
+
+  for (i = 0; i < count; ++i)
+  {
+    Z_Free(entries[i].name);
+    Z_Free(entries[i].data);
+  }
+  Z_Free(entries);
+
+  if (deh_directory)
+    LoadDehackedFilesAtPath(deh_directory, true, deh_queue);
 
   Z_Free(full_zip_path);
 }
@@ -1656,6 +1709,8 @@ static void D_DoomMainSetup(void)
     I_SafeExit(0);
   }
 
+  dsda_StartupPhase("command line");
+
   // figgi 09/18/00-- added switch to force classic bsp nodes
   if (dsda_Flag(dsda_arg_forceoldbsp))
     forceOldBsp = true;
@@ -1736,6 +1791,7 @@ static void D_DoomMainSetup(void)
 
   //jff 9/3/98 use logical output routine
   lprintf(LO_DEBUG, "V_Init: allocate screens.\n");
+  dsda_StartupPhase("V_Init");
   V_Init();
 
   //e6y: Calculate the screen resolution and init all buffers
@@ -1750,6 +1806,8 @@ static void D_DoomMainSetup(void)
   // CPhipps - autoloading of wads
   autoload = !dsda_Flag(dsda_arg_noautoload);
 
+  dsda_StartupPhase("wad files");
+
   D_AddFile(port_wad_file, source_auto_load);
 
   HandlePlayback(); // must come before autoload: may detect iwad in footer
@@ -1817,8 +1875,15 @@ static void D_DoomMainSetup(void)
 
   //jff 9/3/98 use logical output routine
   lprintf(LO_DEBUG, "W_Init: Init WADfiles.\n");
+  dsda_StartupPhase("W_Init");
   W_Init(); // CPhipps - handling of wadfiles init changed
 
+  if (dsda_Flag(dsda_arg_bench_lumps))
+    I_SafeExit(W_BenchmarkLumpLookups());
+
+  if (dsda_Flag(dsda_arg_bench_opl))
+    I_SafeExit(I_OPL_Benchmark(dsda_Arg(dsda_arg_bench_opl)->value.v_int));
+
   if (hexen)
   {
     if (!W_LumpNameExists("MAP05"))
@@ -1834,9 +1899,12 @@ static void D_DoomMainSetup(void)
   }
 
   lprintf(LO_DEBUG, "G_ReloadDefaults: Checking OPTIONS.\n");
+  dsda_StartupPhase("options");
   dsda_ParseOptionsLump();
   G_ReloadDefaults();
 
+  dsda_StartupPhase("dehacked");
+
   // e6y
   // option to disable automatic loading of dehacked-in-wad lump
   if (!dsda_Flag(dsda_arg_nodeh))
@@ -1924,6 +1992,7 @@ static void D_DoomMainSetup(void)
   dsda_ApplyDefaultMapFormat();
 
   lprintf(LO_DEBUG, "dsda_InitWadStats: Setting up wad stats.\n");
+  dsda_StartupPhase("dsda_InitWadStats");
   dsda_InitWadStats();
 
   lprintf(LO_INFO, "\n"); // Separator after file loading
@@ -1932,8 +2001,10 @@ static void D_DoomMainSetup(void)
 
   //jff 9/3/98 use logical output routine
   lprintf(LO_DEBUG, "M_Init: Init miscellaneous info.\n");
+  dsda_StartupPhase("M_Init");
   M_Init();
 
+  dsda_StartupPhase("SNDINFO");
   dsda_LoadSndInfo();
 
   if (map_format.sndseq)
@@ -1945,12 +2016,14 @@ static void D_DoomMainSetup(void)
   lprintf(LO_DEBUG, "R_Init: Init DOOM refresh daemon - ");
   R_Init();
 
+  dsda_StartupPhase("MAPINFO");
   dsda_LoadWadPreferences();
   dsda_LoadMapInfo();
   dsda_InitSkills();
 
   //jff 9/3/98 use logical output routine
   lprintf(LO_DEBUG, "\nP_Init: Init Playloop state.\n");
+  dsda_StartupPhase("P_Init");
   P_Init();
 
   // Must be after P_Init
@@ -1961,16 +2034,20 @@ static void D_DoomMainSetup(void)
 
   //jff 9/3/98 use logical output routine
   lprintf(LO_DEBUG, "I_Init: Setting up machine state.\n");
+  dsda_StartupPhase("I_Init");
   I_Init();
 
   //jff 9/3/98 use logical output routine
   lprintf(LO_DEBUG, "S_Init: Setting up sound.\n");
+  dsda_StartupPhase("S_Init");
   S_Init();
 
   //jff 9/3/98 use logical output routine
   lprintf(LO_DEBUG, "dsda_InitFont: Loading the hud fonts.\n");
+  dsda_StartupPhase("dsda_InitFont");
   dsda_InitFont();
 
+  dsda_StartupPhase("I_InitGraphics");
   if (!(dsda_Flag(dsda_arg_nodraw) && dsda_Flag(dsda_arg_nosound)))
     I_InitGraphics();
 
@@ -1983,8 +2060,11 @@ static void D_DoomMainSetup(void)
 
   //jff 9/3/98 use logical output routine
   lprintf(LO_DEBUG, "ST_Init: Init status bar.\n");
+  dsda_StartupPhase("ST_Init");
   ST_Init();
 
+  dsda_StartupPhase("game start");
+
   // start the appropriate game based on parms
 
   arg = dsda_Arg(dsda_arg_record);
@@ -2012,6 +2092,8 @@ static void D_DoomMainSetup(void)
   // do not try to interpolate during timedemo
   M_ChangeUncappedFrameRate();
 
+  dsda_FinishStartupReport();
+
   lprintf(LO_DEBUG, "\n"); // Separator after setup
 }
 
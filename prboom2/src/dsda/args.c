@@ -333,6 +333,51 @@ static arg_config_t arg_config[dsda_arg_count] = {
     "writes level stats to levelstat.txt",
     arg_null,
   },
+  [dsda_arg_verify_batch] = {
+    "-verify_batch", "-verify-batch", NULL,
+    "plays back every demo in the given manifest in parallel and writes a json report",
+    arg_string_array, 0, 0, 1, 2,
+  },
+  [dsda_arg_verify_jobs] = {
+    "-verify_jobs", NULL, NULL,
+    "sets the number of worker processes used by -verify_batch",
+    arg_int, 1, 256,
+  },
+  [dsda_arg_verify_result] = {
+    "-verify_result", NULL, NULL,
+    "writes the playback result for -verify_batch to the given file",
+    arg_string,
+  },
+  [dsda_arg_bench_blockmap] = {
+    "-bench_blockmap", NULL, NULL,
+    "checks and times the blockmap builder on a synthetic map with the given number of lines",
+    arg_int, 1, 4000000,
+  },
+  [dsda_arg_bench_lumps] = {
+    "-bench_lumps", NULL, NULL,
+    "times lump name lookups over the loaded wads and exits",
+    arg_null,
+  },
+  [dsda_arg_bench_mixer] = {
+    "-bench_mixer", NULL, NULL,
+    "times the sound effect mixer with the given number of channels",
+    arg_int, 1, 32,
+  },
+  [dsda_arg_bench_opl] = {
+    "-bench_opl", NULL, NULL,
+    "checks and times the OPL synth on every song for the given number of seconds",
+    arg_int, 1, 600,
+  },
+  [dsda_arg_startup_report] = {
+    "-startup_report", NULL, NULL,
+    "prints the time and memory of each startup phase, or writes them to the given json file",
+    arg_string_array, 0, 0, 0, 1,
+  },
+  [dsda_arg_nocache] = {
+    "-nocache", NULL, NULL,
+    "ignores the startup and level caches and rebuilds them",
+    arg_null,
+  },
   [dsda_arg_export_text_file] = {
     "-export_text_file", NULL, NULL,
     "export a dsda-format text file template",
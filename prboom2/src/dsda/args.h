@@ -77,6 +77,15 @@ typedef enum {
   dsda_arg_update,
   dsda_arg_analysis,
   dsda_arg_levelstat,
+  dsda_arg_verify_batch,
+  dsda_arg_verify_jobs,
+  dsda_arg_verify_result,
+  dsda_arg_bench_blockmap,
+  dsda_arg_bench_lumps,
+  dsda_arg_bench_mixer,
+  dsda_arg_bench_opl,
+  dsda_arg_startup_report,
+  dsda_arg_nocache,
   dsda_arg_export_text_file,
   dsda_arg_track_playback,
   dsda_arg_export_ghost,
@@ -17,18 +17,39 @@
 
 #include <math.h>
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#if defined(HAVE_UNISTD_H) && defined(HAVE_SYS_WAIT_H) && !defined(_WIN32)
+#define BF_WORKERS
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "d_main.h"
 #include "d_player.h"
 #include "d_ticcmd.h"
 #include "doomstat.h"
+#include "g_game.h"
 #include "lprintf.h"
 #include "m_random.h"
+#include "p_saveg.h"
 #include "r_state.h"
+#include "v_video.h"
+#include "z_zone.h"
 
 #include "dsda/build.h"
 #include "dsda/demo.h"
 #include "dsda/features.h"
+#include "dsda/global.h"
 #include "dsda/key_frame.h"
+#include "dsda/save.h"
 #include "dsda/skip.h"
+#include "dsda/thread_pool.h"
 #include "dsda/time.h"
 #include "dsda/utility.h"
 
@@ -36,6 +57,14 @@
 
 #define MAX_BF_DEPTH 35
 #define MAX_BF_CONDITIONS 16
+#define MAX_BF_WORKERS 64
+#define BF_PROGRESS_INTERVAL 10000
+#define BF_TT_MIN_SIZE (1 << 16)
+#define BF_TT_MAX_SIZE (1 << 22)
+#define MAX_BF_SEARCH_DEPTH (35 * 60)
+#define MAX_BF_BEAM_WIDTH 64
+#define MAX_BF_POPULATION 1024
+#define BF_RANDOM_SEED 0x2545f491
 
 typedef struct {
   int min;
@@ -82,6 +111,117 @@ static dsda_key_frame_t nomo_key_frame;
 static bf_target_t bf_target;
 static ticcmd_t bf_result[MAX_BF_DEPTH];
 
+// The candidate space is split by prefix: the first bf_prefix_depth frames
+//   form a prefix index, and each process searches the subtrees of the
+//   prefixes where index % bf_worker_total == bf_worker_index.
+static int bf_worker_count = 1;
+static int bf_worker_total = 1;
+static int bf_worker_index;
+static int bf_prefix_depth;
+static long long bf_prefix_index;
+static long long bf_total_volume_max;
+static long long bf_next_progress;
+
+// Transposition table of states reached at each depth
+// A state that was already reached at the same depth leads to the same
+//   subtree, so the remaining sequences below it are skipped.
+static dsda_bf_prune_t bf_prune_mode;
+static unsigned long long* bf_tt;
+static int bf_tt_size;
+static int bf_tt_count;
+static long long bf_pruned;
+static int bf_pruned_frame = -1;
+
+// Search modes for sequences longer than exhaustive search can cover
+// Every tic draws from the same command range, and the search runs
+//   until the depth is covered or the time budget runs out.
+typedef enum {
+  bf_search_exhaustive,
+  bf_search_beam,
+  bf_search_evolve,
+} bf_search_t;
+
+typedef struct {
+  int reached;
+  fixed_t value;
+} bf_score_t;
+
+typedef struct {
+  dsda_key_frame_t key_frame;
+  bf_score_t score;
+  unsigned long long hash;
+  ticcmd_t* commands;
+} bf_node_t;
+
+typedef struct {
+  ticcmd_t* commands;
+  bf_score_t score;
+  dboolean evaluated;
+} bf_individual_t;
+
+static const char* bf_search_names[] = {
+  [bf_search_exhaustive] = "exhaustive",
+  [bf_search_beam] = "beam",
+  [bf_search_evolve] = "evolution",
+};
+
+static bf_search_t bf_search;
+static bf_t bf_search_range;
+static long long bf_search_volume;
+static unsigned long long bf_search_budget;
+static dsda_key_frame_t bf_search_key_frame;
+static ticcmd_t bf_search_cmd;
+static dboolean bf_search_found;
+static bf_score_t bf_search_best;
+static ticcmd_t* bf_search_result;
+static int bf_search_result_depth;
+static unsigned int bf_random_state;
+
+// Beam search keeps the best bf_beam_width states after each tic
+static bf_node_t* bf_beam;
+static bf_node_t* bf_next_beam;
+static int bf_beam_width;
+static int bf_beam_count;
+static int bf_next_beam_count;
+static int bf_beam_tic;
+static int bf_beam_parent;
+static long long bf_beam_candidate;
+
+// Evolution search breeds full length sequences from the better half
+static bf_individual_t* bf_population;
+static int bf_population_size;
+static int bf_individual;
+static int bf_generation;
+
+typedef enum {
+  bf_message_progress,
+  bf_message_done,
+} bf_message_type_t;
+
+typedef struct {
+  bf_message_type_t type;
+  int result;
+  long long volume;
+  long long pruned;
+  dboolean evaluated;
+  fixed_t best_value;
+  int best_depth;
+  ticcmd_t commands[MAX_BF_DEPTH];
+} bf_message_t;
+
+#ifdef BF_WORKERS
+typedef struct {
+  pid_t pid;
+  int fd;
+  long long volume;
+  long long pruned;
+  dboolean done;
+} bf_worker_t;
+
+static bf_worker_t bf_workers[MAX_BF_WORKERS];
+static int bf_worker_fd = -1;
+#endif
+
 const char* dsda_bf_attribute_names[dsda_bf_attribute_max] = {
   [dsda_bf_x] = "x",
   [dsda_bf_y] = "y",
@@ -123,6 +263,12 @@ const char* dsda_bf_limit_names[dsda_bf_limit_max] = {
   "min",
 };
 
+const char* dsda_bf_prune_names[dsda_bf_prune_max] = {
+  [dsda_bf_prune_off] = "off",
+  [dsda_bf_prune_attributes] = "attr",
+  [dsda_bf_prune_full] = "full",
+};
+
 const char* dsda_bf_item_names[dsda_bf_item_max] = {
   [dsda_bf_red_key_card] = "rkc",
   [dsda_bf_yellow_key_card] = "ykc",
@@ -182,16 +328,42 @@ static dboolean dsda_AdvanceBruteForceFrame(int frame) {
   return true;
 }
 
-static int dsda_AdvanceBruteForce(void) {
+static long long dsda_BFFrameVolume(int i) {
+  return (brute_force[i].forwardmove.max - brute_force[i].forwardmove.min + 1) *
+         (brute_force[i].sidemove.max - brute_force[i].sidemove.min + 1) *
+         (brute_force[i].angleturn.max - brute_force[i].angleturn.min + 1);
+}
+
+static int dsda_AdvanceBruteForcePrefix(void) {
   int i;
 
-  for (i = bf_depth - 1; i >= 0; --i)
+  for (i = bf_prefix_depth - 1; i >= 0; --i)
     if (dsda_AdvanceBruteForceFrame(i))
       break;
 
   return i;
 }
 
+// Skip prefixes that belong to other workers
+// Returns the earliest frame that changed, or -1 if the space is exhausted
+static int dsda_AdvanceToOwnedPrefix(int frame) {
+  while (bf_prefix_index % bf_worker_total != bf_worker_index) {
+    int changed;
+
+    changed = dsda_AdvanceBruteForcePrefix();
+    if (changed < 0)
+      return -1;
+
+    if (changed < frame)
+      frame = changed;
+
+    ++bf_prefix_index;
+  }
+
+  return frame;
+}
+
+
 static void dsda_CopyBFCommandDepth(ticcmd_t* cmd, bf_t* bf) {
   memset(cmd, 0, sizeof(*cmd));
 
@@ -219,15 +391,105 @@ static void dsda_StoreBFKeyFrame(int frame) {
   dsda_StoreKeyFrame(&brute_force[frame].key_frame, true, false);
 }
 
+static long long dsda_BFTotalVolume(void) {
+  long long volume;
+
+  volume = bf_volume;
+
+#ifdef BF_WORKERS
+  {
+    int i;
+
+    for (i = 1; i < bf_worker_total; ++i)
+      volume += bf_workers[i].volume;
+  }
+#endif
+
+  return volume;
+}
+
+static long long dsda_BFTotalPruned(void) {
+  long long pruned;
+
+  pruned = bf_pruned;
+
+#ifdef BF_WORKERS
+  {
+    int i;
+
+    for (i = 1; i < bf_worker_total; ++i)
+      pruned += bf_workers[i].pruned;
+  }
+#endif
+
+  return pruned;
+}
+
 static void dsda_PrintBFProgress(void) {
   int percent;
+  long long volume;
   unsigned long long elapsed_time;
 
-  percent = 100 * bf_volume / bf_volume_max;
+  volume = dsda_BFTotalVolume();
+  percent = bf_total_volume_max ? 100 * volume / bf_total_volume_max : 100;
   elapsed_time = dsda_ElapsedTimeMS(dsda_timer_brute_force);
 
   lprintf(LO_INFO, "  %lld / %lld sequences tested (%d%%) in %.2f seconds!\n",
-          bf_volume, bf_volume_max, percent, (float) elapsed_time / 1000);
+          volume, bf_total_volume_max, percent, (float) elapsed_time / 1000);
+
+  if (bf_worker_total > 1 && elapsed_time)
+    lprintf(LO_INFO, "  %d workers, %.0f sequences per second\n",
+            bf_worker_total, (double) volume * 1000 / elapsed_time);
+
+  if (bf_prune_mode)
+    lprintf(LO_INFO, "  %lld sequences pruned as duplicate states\n", dsda_BFTotalPruned());
+}
+
+static void dsda_PrintBFSearchProgress(void) {
+  unsigned long long elapsed_time;
+
+  elapsed_time = dsda_ElapsedTimeMS(dsda_timer_brute_force);
+
+  if (bf_search == bf_search_beam)
+    lprintf(LO_INFO, "  %d / %d tics searched, %lld sequences tested in %.2f seconds!\n",
+            bf_beam_tic, bf_depth, bf_volume, (float) elapsed_time / 1000);
+  else
+    lprintf(LO_INFO, "  %d generations, %lld sequences tested in %.2f seconds!\n",
+            bf_generation, bf_volume, (float) elapsed_time / 1000);
+}
+
+static void dsda_FreeBFNodes(bf_node_t* nodes) {
+  int i;
+
+  if (!nodes)
+    return;
+
+  for (i = 0; i < bf_beam_width; ++i) {
+    Z_Free(nodes[i].key_frame.buffer);
+    Z_Free(nodes[i].commands);
+  }
+
+  Z_Free(nodes);
+}
+
+static void dsda_FreeBFSearch(void) {
+  dsda_FreeBFNodes(bf_beam);
+  dsda_FreeBFNodes(bf_next_beam);
+  bf_beam = NULL;
+  bf_next_beam = NULL;
+
+  if (bf_population) {
+    int i;
+
+    for (i = 0; i < bf_population_size; ++i)
+      Z_Free(bf_population[i].commands);
+
+    Z_Free(bf_population);
+    bf_population = NULL;
+  }
+
+  Z_Free(bf_search_result);
+  bf_search_result = NULL;
 }
 
 #define BF_FAILURE 0
@@ -240,23 +502,99 @@ dboolean dsda_BruteForceEnded(void) {
   return brute_force_ended;
 }
 
+#ifdef BF_WORKERS
+static void dsda_SendBFMessage(bf_message_type_t type, int result) {
+  bf_message_t message;
+
+  memset(&message, 0, sizeof(message));
+  message.type = type;
+  message.result = result;
+  message.volume = bf_volume;
+  message.pruned = bf_pruned;
+  message.evaluated = bf_target.evaluated;
+  message.best_value = bf_target.best_value;
+  message.best_depth = bf_target.best_depth;
+  memcpy(message.commands, bf_result, sizeof(bf_result));
+
+  // The message is smaller than PIPE_BUF, so the write is atomic
+  while (write(bf_worker_fd, &message, sizeof(message)) < 0 && errno == EINTR);
+}
+
+static void dsda_ExitBFWorker(int result) {
+  dsda_SendBFMessage(bf_message_done, result);
+  close(bf_worker_fd);
+
+  // Skip the exit handlers - they belong to the parent
+  _exit(0);
+}
+
+static void dsda_StopBFWorkers(void) {
+  int i;
+
+  for (i = 1; i < bf_worker_total; ++i) {
+    if (!bf_workers[i].done) {
+      kill(bf_workers[i].pid, SIGKILL);
+      close(bf_workers[i].fd);
+      bf_workers[i].done = true;
+    }
+
+    waitpid(bf_workers[i].pid, NULL, 0);
+  }
+}
+#endif
+
+static void dsda_ReportBFProgress(void) {
+#ifdef BF_WORKERS
+  if (bf_worker_index) {
+    dsda_SendBFMessage(bf_message_progress, BF_FAILURE);
+    return;
+  }
+#endif
+
+  dsda_PrintBFProgress();
+}
+
 static void dsda_EndBF(int result) {
+#ifdef BF_WORKERS
+  if (bf_worker_index)
+    dsda_ExitBFWorker(result);
+#endif
+
   brute_force_ended = true;
 
   lprintf(LO_INFO, "Brute force complete (%s)!\n", bf_result_text[result]);
-  dsda_PrintBFProgress();
+
+  if (bf_search == bf_search_exhaustive)
+    dsda_PrintBFProgress();
+  else
+    dsda_PrintBFSearchProgress();
+
+#ifdef BF_WORKERS
+  dsda_StopBFWorkers();
+#endif
+
+  Z_Free(bf_tt);
+  bf_tt = NULL;
 
   if (bf_nomonsters)
     dsda_RestoreKeyFrame(&nomo_key_frame, true);
-  else
+  else if (bf_search == bf_search_exhaustive)
     dsda_RestoreBFKeyFrame(0);
+  else
+    dsda_RestoreKeyFrame(&bf_search_key_frame, true);
 
   bf_mode = false;
 
-  if (result == BF_SUCCESS)
-    dsda_QueueBuildCommands(bf_result, bf_depth);
+  if (result == BF_SUCCESS) {
+    if (bf_search == bf_search_exhaustive)
+      dsda_QueueBuildCommands(bf_result, bf_depth);
+    else
+      dsda_QueueBuildCommands(bf_search_result, bf_search_result_depth);
+  }
   else
     dsda_ExitSkipMode();
+
+  dsda_FreeBFSearch();
 }
 
 static fixed_t dsda_BFAttribute(int attribute) {
@@ -386,24 +724,19 @@ static dboolean dsda_BFConditionReached(int i) {
   }
 }
 
-static void dsda_BFUpdateBestResult(fixed_t value) {
-  int i;
-  char str[FIXED_STRING_LENGTH];
-  char cmd_str[COMMAND_MOVEMENT_STRING_LENGTH];
-
-  bf_target.evaluated = true;
-  bf_target.best_value = value;
-  bf_target.best_depth = true_logictic - bf_logictic;
-
-  for (i = 0; i < bf_target.best_depth; ++i)
-    bf_target.best_bf[i] = brute_force[i];
-
-  dsda_CopyBFResult(bf_target.best_bf, bf_target.best_depth);
-
+static void dsda_BFTargetString(char* str, fixed_t value) {
   if (fixed_point_attribute[bf_target.attribute])
     dsda_FixedToString(str, value);
   else
     snprintf(str, FIXED_STRING_LENGTH, "%i", value);
+}
+
+static void dsda_PrintBFBestResult(fixed_t value) {
+  int i;
+  char str[FIXED_STRING_LENGTH];
+  char cmd_str[COMMAND_MOVEMENT_STRING_LENGTH];
+
+  dsda_BFTargetString(str, value);
 
   lprintf(LO_INFO, "New best: %s = %s\n", dsda_bf_attribute_names[bf_target.attribute], str);
 
@@ -415,22 +748,43 @@ static void dsda_BFUpdateBestResult(fixed_t value) {
   lprintf(LO_INFO, "\n");
 }
 
-static dboolean dsda_BFNewBestResult(fixed_t value) {
-  if (!bf_target.evaluated)
-    return true;
+static void dsda_BFUpdateBestResult(fixed_t value) {
+  int i;
+
+  bf_target.evaluated = true;
+  bf_target.best_value = value;
+  bf_target.best_depth = true_logictic - bf_logictic;
+
+  for (i = 0; i < bf_target.best_depth; ++i)
+    bf_target.best_bf[i] = brute_force[i];
+
+  dsda_CopyBFResult(bf_target.best_bf, bf_target.best_depth);
+
+  // Workers only report their best result when they finish
+  if (!bf_worker_index)
+    dsda_PrintBFBestResult(value);
+}
 
+static dboolean dsda_BFBetterValue(fixed_t value, fixed_t best_value) {
   switch (bf_target.limit) {
     case dsda_bf_acap:
-      return abs(value - bf_target.value) < abs(bf_target.best_value - bf_target.value);
+      return abs(value - bf_target.value) < abs(best_value - bf_target.value);
     case dsda_bf_max:
-      return value > bf_target.best_value;
+      return value > best_value;
     case dsda_bf_min:
-      return value < bf_target.best_value;
+      return value < best_value;
     default:
       return false;
   }
 }
 
+static dboolean dsda_BFNewBestResult(fixed_t value) {
+  if (!bf_target.evaluated)
+    return true;
+
+  return dsda_BFBetterValue(value, bf_target.best_value);
+}
+
 static void dsda_BFEvaluateTarget(void) {
   fixed_t value;
 
@@ -457,132 +811,423 @@ static dboolean dsda_BFConditionsReached(void) {
   return reached == bf_condition_count;
 }
 
-dboolean dsda_BruteForce(void) {
-  return bf_mode;
+#define BF_HASH_PRIME 0x100000001b3ULL
+#define BF_HASH_OFFSET 0xcbf29ce484222325ULL
+
+static unsigned long long dsda_BFHashBytes(unsigned long long hash, const void* data, size_t size) {
+  const byte* p = data;
+
+  while (size--) {
+    hash ^= *p++;
+    hash *= BF_HASH_PRIME;
+  }
+
+  return hash;
 }
 
-void dsda_ResetBruteForceConditions(void) {
-  bf_condition_count = 0;
-  memset(&bf_target, 0, sizeof(bf_target));
+static unsigned long long dsda_BFHashInt(unsigned long long hash, int value) {
+  return dsda_BFHashBytes(hash, &value, sizeof(value));
 }
 
-void dsda_AddMiscBruteForceCondition(dsda_bf_attribute_t attribute, fixed_t value) {
-  if (bf_condition_count == MAX_BF_CONDITIONS)
-    return;
+// Hash the attributes that the conditions and target depend on,
+//   plus the player movement state and rng that drive the next tics
+static unsigned long long dsda_BFAttributeHash(unsigned long long hash) {
+  int i;
+  mobj_t* mo;
 
-  bf_condition[bf_condition_count].attribute = attribute;
-  bf_condition[bf_condition_count].operator = dsda_bf_operator_misc;
-  bf_condition[bf_condition_count].value = value;
+  mo = players[displayplayer].mo;
 
-  switch (attribute) {
-    case dsda_bf_line_skip:
-    case dsda_bf_line_activation:
-      bf_condition[bf_condition_count].secondary_value = lines[value].player_activations;
-      break;
-    default:
-      break;
-  }
+  hash = dsda_BFHashInt(hash, mo->x);
+  hash = dsda_BFHashInt(hash, mo->y);
+  hash = dsda_BFHashInt(hash, mo->z);
+  hash = dsda_BFHashInt(hash, mo->momx);
+  hash = dsda_BFHashInt(hash, mo->momy);
+  hash = dsda_BFHashInt(hash, mo->momz);
+  hash = dsda_BFHashInt(hash, mo->angle);
+  hash = dsda_BFHashBytes(hash, &rng, sizeof(rng));
 
-  ++bf_condition_count;
+  for (i = 0; i < bf_condition_count; ++i)
+    if (bf_condition[i].operator == dsda_bf_operator_misc)
+      hash = dsda_BFHashInt(hash, dsda_BFMiscConditionReached(i));
+    else
+      hash = dsda_BFHashInt(hash, dsda_BFAttribute(bf_condition[i].attribute));
 
-  lprintf(LO_INFO, "Added brute force condition: %s %d\n",
-                   dsda_bf_misc_names[attribute],
-                   value);
+  if (bf_target.enabled)
+    hash = dsda_BFHashInt(hash, dsda_BFAttribute(bf_target.attribute));
+
+  return hash;
 }
 
-void dsda_AddBruteForceCondition(dsda_bf_attribute_t attribute,
-                                 dsda_bf_operator_t operator, fixed_t value) {
-  if (bf_condition_count == MAX_BF_CONDITIONS)
-    return;
+// Hash the complete archived game state
+static unsigned long long dsda_BFFullHash(unsigned long long hash) {
+  ticcmd_t cmds[MAX_MAXPLAYERS];
+  int i;
 
-  bf_condition[bf_condition_count].attribute = attribute;
-  bf_condition[bf_condition_count].operator = operator;
-  bf_condition[bf_condition_count].value = value;
+  // The previous command is overwritten before the next tic runs
+  for (i = 0; i < g_maxplayers; ++i) {
+    cmds[i] = players[i].cmd;
+    memset(&players[i].cmd, 0, sizeof(players[i].cmd));
+  }
 
-  if (fixed_point_attribute[attribute])
-    bf_condition[bf_condition_count].value <<= FRACBITS;
+  P_InitSaveBuffer();
+  dsda_ArchiveAll();
+  hash = dsda_BFHashBytes(hash, savebuffer, save_p - savebuffer);
+  Z_Free(savebuffer);
+  P_ForgetSaveBuffer();
 
-  ++bf_condition_count;
+  for (i = 0; i < g_maxplayers; ++i)
+    players[i].cmd = cmds[i];
 
-  lprintf(LO_INFO, "Added brute force condition: %s %s %d\n",
-                   dsda_bf_attribute_names[attribute],
-                   dsda_bf_operator_names[operator],
-                   value);
+  return hash;
 }
 
-void dsda_SetBruteForceTarget(dsda_bf_attribute_t attribute,
-                              dsda_bf_limit_t limit, fixed_t value, dboolean has_value) {
-  bf_target.attribute = attribute;
-  bf_target.limit = limit;
-  bf_target.value = value;
-  bf_target.best_value = dsda_BFAttribute(attribute);
-  bf_target.enabled = true;
+static unsigned long long dsda_BFStateHash(int frame) {
+  unsigned long long hash;
 
-  if (has_value)
-    lprintf(LO_INFO, "Set brute force target: %s %s %d\n",
-                    dsda_bf_attribute_names[attribute],
-                    dsda_bf_limit_names[limit],
-                    value);
+  hash = dsda_BFHashInt(BF_HASH_OFFSET, frame);
+
+  if (bf_prune_mode == dsda_bf_prune_full)
+    hash = dsda_BFFullHash(hash);
   else
-    lprintf(LO_INFO, "Set brute force target: %s %s\n",
-                    dsda_bf_attribute_names[attribute],
-                    dsda_bf_limit_names[limit]);
-}
+    hash = dsda_BFAttributeHash(hash);
 
-static void dsda_SortIntPair(int* a, int* b) {
-  if (*a > *b) {
-    int temp;
+  // 0 marks an empty slot
+  return hash ? hash : 1;
+}
 
-    temp = *a;
-    *a = *b;
-    *b = temp;
+static void dsda_ResetBFTranspositionTable(void) {
+  Z_Free(bf_tt);
+  bf_tt = NULL;
+  bf_tt_size = 0;
+  bf_tt_count = 0;
+  bf_pruned = 0;
+  bf_pruned_frame = -1;
+
+  if (bf_prune_mode) {
+    bf_tt_size = BF_TT_MIN_SIZE;
+    bf_tt = Z_Calloc(bf_tt_size, sizeof(*bf_tt));
   }
 }
 
-int dsda_KeepBruteForceFrame(int i) {
-  ticcmd_t cmd;
+static dboolean dsda_InsertBFTransposition(unsigned long long* table, int size,
+                                           unsigned long long key) {
+  int i;
 
-  if (!dsda_CopyPendingCmd(&cmd, i))
-    return false;
+  for (i = key & (size - 1); table[i]; i = (i + 1) & (size - 1))
+    if (table[i] == key)
+      return false;
 
-  brute_force[i].forwardmove.min = cmd.forwardmove;
-  brute_force[i].forwardmove.max = cmd.forwardmove;
+  table[i] = key;
 
-  brute_force[i].sidemove.min = cmd.sidemove;
-  brute_force[i].sidemove.max = cmd.sidemove;
+  return true;
+}
 
-  brute_force[i].angleturn.min = cmd.angleturn >> 8;
-  brute_force[i].angleturn.max = cmd.angleturn >> 8;
+static void dsda_GrowBFTranspositionTable(void) {
+  unsigned long long* old_tt;
+  int old_size;
+  int i;
 
-  brute_force[i].buttons = cmd.buttons;
+  old_tt = bf_tt;
+  old_size = bf_tt_size;
 
-  return true;
-}
+  bf_tt_size *= 2;
+  bf_tt = Z_Calloc(bf_tt_size, sizeof(*bf_tt));
 
-int dsda_AddBruteForceFrame(int i,
-                            int forwardmove_min, int forwardmove_max,
-                            int sidemove_min, int sidemove_max,
-                            int angleturn_min, int angleturn_max,
-                            byte buttons) {
-  if (i < 0 || i >= MAX_BF_DEPTH)
-    return false;
+  for (i = 0; i < old_size; ++i)
+    if (old_tt[i])
+      dsda_InsertBFTransposition(bf_tt, bf_tt_size, old_tt[i]);
 
-  dsda_SortIntPair(&forwardmove_min, &forwardmove_max);
-  dsda_SortIntPair(&sidemove_min, &sidemove_max);
-  dsda_SortIntPair(&angleturn_min, &angleturn_max);
+  Z_Free(old_tt);
+}
 
-  brute_force[i].forwardmove.min = forwardmove_min;
-  brute_force[i].forwardmove.max = forwardmove_max;
+// Returns true if the state was already in the table
+static dboolean dsda_BFTranspositionSeen(unsigned long long key) {
+  int i;
 
-  brute_force[i].sidemove.min = sidemove_min;
-  brute_force[i].sidemove.max = sidemove_max;
+  if (bf_tt_count >= bf_tt_size / 2) {
+    if (bf_tt_size < BF_TT_MAX_SIZE)
+      dsda_GrowBFTranspositionTable();
+    else if (bf_tt_count >= bf_tt_size / 4 * 3) {
+      // The table is full - keep looking up, but stop inserting
+      for (i = key & (bf_tt_size - 1); bf_tt[i]; i = (i + 1) & (bf_tt_size - 1))
+        if (bf_tt[i] == key)
+          return true;
 
-  brute_force[i].angleturn.min = angleturn_min;
-  brute_force[i].angleturn.max = angleturn_max;
+      return false;
+    }
+  }
 
-  brute_force[i].buttons = buttons;
+  if (!dsda_InsertBFTransposition(bf_tt, bf_tt_size, key))
+    return true;
 
-  return true;
+  ++bf_tt_count;
+
+  return false;
+}
+
+static long long dsda_BFSuffixVolume(int frame) {
+  long long volume;
+
+  for (volume = 1; frame < bf_depth; ++frame)
+    volume *= dsda_BFFrameVolume(frame);
+
+  return volume;
+}
+
+static int dsda_AdvanceBruteForceFrom(int frame) {
+  int i;
+
+  for (i = frame; i >= 0; --i)
+    if (dsda_AdvanceBruteForceFrame(i))
+      break;
+
+  if (i >= 0 && i < bf_prefix_depth) {
+    ++bf_prefix_index;
+    i = dsda_AdvanceToOwnedPrefix(i);
+  }
+
+  return i;
+}
+
+#ifdef BF_WORKERS
+static dboolean dsda_MergeBFMessage(bf_message_t* message) {
+  if (!bf_target.enabled) {
+    if (message->result != BF_SUCCESS)
+      return false;
+
+    memcpy(bf_result, message->commands, sizeof(bf_result));
+
+    return true;
+  }
+
+  if (message->evaluated && dsda_BFNewBestResult(message->best_value)) {
+    bf_target.evaluated = true;
+    bf_target.best_value = message->best_value;
+    bf_target.best_depth = message->best_depth;
+    memcpy(bf_result, message->commands, sizeof(bf_result));
+
+    dsda_PrintBFBestResult(message->best_value);
+  }
+
+  return false;
+}
+
+// Returns true if the worker found a sequence that ends the search
+static dboolean dsda_ReadBFWorker(int i) {
+  bf_message_t message;
+  ssize_t length;
+
+  do {
+    length = read(bf_workers[i].fd, &message, sizeof(message));
+  } while (length < 0 && errno == EINTR);
+
+  // The worker died without reporting
+  if (length != sizeof(message)) {
+    lprintf(LO_WARN, "Brute force worker %d exited unexpectedly!\n", i);
+    close(bf_workers[i].fd);
+    bf_workers[i].done = true;
+
+    return false;
+  }
+
+  bf_workers[i].volume = message.volume;
+  bf_workers[i].pruned = message.pruned;
+
+  if (message.type == bf_message_done) {
+    close(bf_workers[i].fd);
+    bf_workers[i].done = true;
+
+    return dsda_MergeBFMessage(&message);
+  }
+
+  return false;
+}
+
+static dboolean dsda_PollBFWorkers(int timeout) {
+  struct pollfd fds[MAX_BF_WORKERS];
+  int worker[MAX_BF_WORKERS];
+  int count;
+  int i;
+
+  count = 0;
+  for (i = 1; i < bf_worker_total; ++i)
+    if (!bf_workers[i].done) {
+      fds[count].fd = bf_workers[i].fd;
+      fds[count].events = POLLIN;
+      fds[count].revents = 0;
+      worker[count] = i;
+      ++count;
+    }
+
+  if (!count || poll(fds, count, timeout) <= 0)
+    return false;
+
+  for (i = 0; i < count; ++i)
+    if (fds[i].revents && dsda_ReadBFWorker(worker[i]))
+      return true;
+
+  return false;
+}
+
+static dboolean dsda_BFWorkersRunning(void) {
+  int i;
+
+  for (i = 1; i < bf_worker_total; ++i)
+    if (!bf_workers[i].done)
+      return true;
+
+  return false;
+}
+
+static dboolean dsda_WaitForBFWorkers(void) {
+  while (dsda_BFWorkersRunning()) {
+    if (dsda_PollBFWorkers(1000))
+      return true;
+
+    dsda_PrintBFProgress();
+  }
+
+  return false;
+}
+
+static void dsda_RunBFWorker(void) {
+  // Workers share the window and audio device with the parent,
+  //   so they never return to the main loop and only run game logic.
+  while (1) {
+    G_BuildTiccmd(&local_cmds[consoleplayer][maketic % BACKUPTICS]);
+    G_Ticker();
+    ++gametic;
+    ++maketic;
+  }
+}
+#endif
+
+dboolean dsda_BruteForce(void) {
+  return bf_mode;
+}
+
+void dsda_ResetBruteForceConditions(void) {
+  bf_condition_count = 0;
+  memset(&bf_target, 0, sizeof(bf_target));
+}
+
+void dsda_AddMiscBruteForceCondition(dsda_bf_attribute_t attribute, fixed_t value) {
+  if (bf_condition_count == MAX_BF_CONDITIONS)
+    return;
+
+  bf_condition[bf_condition_count].attribute = attribute;
+  bf_condition[bf_condition_count].operator = dsda_bf_operator_misc;
+  bf_condition[bf_condition_count].value = value;
+
+  switch (attribute) {
+    case dsda_bf_line_skip:
+    case dsda_bf_line_activation:
+      bf_condition[bf_condition_count].secondary_value = lines[value].player_activations;
+      break;
+    default:
+      break;
+  }
+
+  ++bf_condition_count;
+
+  lprintf(LO_INFO, "Added brute force condition: %s %d\n",
+                   dsda_bf_misc_names[attribute],
+                   value);
+}
+
+void dsda_AddBruteForceCondition(dsda_bf_attribute_t attribute,
+                                 dsda_bf_operator_t operator, fixed_t value) {
+  if (bf_condition_count == MAX_BF_CONDITIONS)
+    return;
+
+  bf_condition[bf_condition_count].attribute = attribute;
+  bf_condition[bf_condition_count].operator = operator;
+  bf_condition[bf_condition_count].value = value;
+
+  if (fixed_point_attribute[attribute])
+    bf_condition[bf_condition_count].value <<= FRACBITS;
+
+  ++bf_condition_count;
+
+  lprintf(LO_INFO, "Added brute force condition: %s %s %d\n",
+                   dsda_bf_attribute_names[attribute],
+                   dsda_bf_operator_names[operator],
+                   value);
+}
+
+void dsda_SetBruteForceTarget(dsda_bf_attribute_t attribute,
+                              dsda_bf_limit_t limit, fixed_t value, dboolean has_value) {
+  bf_target.attribute = attribute;
+  bf_target.limit = limit;
+  bf_target.value = value;
+  bf_target.best_value = dsda_BFAttribute(attribute);
+  bf_target.enabled = true;
+
+  if (has_value)
+    lprintf(LO_INFO, "Set brute force target: %s %s %d\n",
+                    dsda_bf_attribute_names[attribute],
+                    dsda_bf_limit_names[limit],
+                    value);
+  else
+    lprintf(LO_INFO, "Set brute force target: %s %s\n",
+                    dsda_bf_attribute_names[attribute],
+                    dsda_bf_limit_names[limit]);
+}
+
+static void dsda_SortIntPair(int* a, int* b) {
+  if (*a > *b) {
+    int temp;
+
+    temp = *a;
+    *a = *b;
+    *b = temp;
+  }
+}
+
+int dsda_KeepBruteForceFrame(int i) {
+  ticcmd_t cmd;
+
+  if (!dsda_CopyPendingCmd(&cmd, i))
+    return false;
+
+  brute_force[i].forwardmove.min = cmd.forwardmove;
+  brute_force[i].forwardmove.max = cmd.forwardmove;
+
+  brute_force[i].sidemove.min = cmd.sidemove;
+  brute_force[i].sidemove.max = cmd.sidemove;
+
+  brute_force[i].angleturn.min = cmd.angleturn >> 8;
+  brute_force[i].angleturn.max = cmd.angleturn >> 8;
+
+  brute_force[i].buttons = cmd.buttons;
+
+  return true;
+}
+
+int dsda_AddBruteForceFrame(int i,
+                            int forwardmove_min, int forwardmove_max,
+                            int sidemove_min, int sidemove_max,
+                            int angleturn_min, int angleturn_max,
+                            byte buttons) {
+  if (i < 0 || i >= MAX_BF_DEPTH)
+    return false;
+
+  dsda_SortIntPair(&forwardmove_min, &forwardmove_max);
+  dsda_SortIntPair(&sidemove_min, &sidemove_max);
+  dsda_SortIntPair(&angleturn_min, &angleturn_max);
+
+  brute_force[i].forwardmove.min = forwardmove_min;
+  brute_force[i].forwardmove.max = forwardmove_max;
+
+  brute_force[i].sidemove.min = sidemove_min;
+  brute_force[i].sidemove.max = sidemove_max;
+
+  brute_force[i].angleturn.min = angleturn_min;
+  brute_force[i].angleturn.max = angleturn_max;
+
+  brute_force[i].buttons = buttons;
+
+  return true;
 }
 
 void dsda_BruteForceWithoutMonsters(void) {
@@ -593,6 +1238,143 @@ void dsda_BruteForceWithMonsters(void) {
   bf_nomonsters = false;
 }
 
+void dsda_SetBruteForcePruneMode(dsda_bf_prune_t mode) {
+  bf_prune_mode = mode;
+}
+
+dboolean dsda_SetBruteForceWorkers(int count) {
+  if (count < 1 || count > MAX_BF_WORKERS)
+    return false;
+
+  bf_worker_count = count;
+
+#ifndef BF_WORKERS
+  if (bf_worker_count > 1)
+    lprintf(LO_WARN, "Brute force workers are not supported on this platform!\n");
+#endif
+
+  return true;
+}
+
+static void dsda_StartBFWorkers(void) {
+#ifdef BF_WORKERS
+  long long prefix_count;
+  int i;
+
+  if (bf_worker_count <= 1)
+    return;
+
+  if (V_IsOpenGLMode()) {
+    lprintf(LO_WARN, "Brute force workers require the software renderer!\n");
+    return;
+  }
+
+  // Use enough prefixes to keep the workers balanced
+  prefix_count = 1;
+  while (bf_prefix_depth < bf_depth && prefix_count < 4LL * bf_worker_count) {
+    prefix_count *= dsda_BFFrameVolume(bf_prefix_depth);
+    ++bf_prefix_depth;
+  }
+
+  // Nothing may be running on a pool thread when the workers are forked
+  dsda_WaitThreadPool();
+
+  fflush(stdout);
+  fflush(stderr);
+
+  for (i = 1; i < bf_worker_count; ++i) {
+    int fds[2];
+    pid_t pid;
+
+    if (pipe(fds) < 0)
+      break;
+
+    pid = fork();
+
+    if (pid < 0) {
+      close(fds[0]);
+      close(fds[1]);
+      break;
+    }
+
+    if (pid == 0) {
+      int j;
+
+      for (j = 1; j < i; ++j)
+        close(bf_workers[j].fd);
+      close(fds[0]);
+
+      bf_worker_fd = fds[1];
+      bf_worker_index = i;
+      bf_worker_total = bf_worker_count;
+
+      // Only the calling thread survives the fork: the audio callback and
+      //   the pool threads are gone, possibly holding their locks, so the
+      //   workers stay silent and run every task inline
+      nosfxparm = true;
+      nomusicparm = true;
+      dsda_DisableThreadPool();
+
+      return;
+    }
+
+    close(fds[1]);
+
+    bf_workers[i].pid = pid;
+    bf_workers[i].fd = fds[0];
+    bf_workers[i].volume = 0;
+    bf_workers[i].pruned = 0;
+    bf_workers[i].done = false;
+
+    bf_worker_total = i + 1;
+  }
+
+  if (bf_worker_total != bf_worker_count) {
+    lprintf(LO_WARN, "Unable to start brute force workers (%s)!\n", strerror(errno));
+    dsda_StopBFWorkers();
+    bf_worker_total = 1;
+    bf_prefix_depth = 0;
+
+    return;
+  }
+
+  lprintf(LO_INFO, "Started %d brute force workers\n\n", bf_worker_total);
+#endif
+}
+
+static void dsda_SliceBFVolume(void) {
+  long long prefix_count;
+  long long owned_prefix_count;
+  int i;
+
+  if (bf_worker_total == 1)
+    return;
+
+  prefix_count = 1;
+  for (i = 0; i < bf_prefix_depth; ++i)
+    prefix_count *= dsda_BFFrameVolume(i);
+
+  if (bf_worker_index >= prefix_count)
+    owned_prefix_count = 0;
+  else
+    owned_prefix_count =
+      (prefix_count - bf_worker_index + bf_worker_total - 1) / bf_worker_total;
+
+  bf_volume_max = bf_total_volume_max / prefix_count * owned_prefix_count;
+}
+
+static void dsda_BeginBF(void) {
+  if (bf_nomonsters) {
+    lprintf(LO_INFO, "Warning: ignoring monsters! The result may desync with monsters!\n");
+    dsda_StoreKeyFrame(&nomo_key_frame, true, false);
+    P_RemoveMonsters();
+  }
+
+  dsda_EnterSkipMode();
+
+  dsda_StartTimer(dsda_timer_brute_force);
+}
+
 dboolean dsda_StartBruteForce(int depth) {
   int i;
 
@@ -620,9 +1402,7 @@ dboolean dsda_StartBruteForce(int depth) {
             brute_force[i].angleturn.min, brute_force[i].angleturn.max,
             brute_force[i].buttons);
 
-    bf_volume_max *= (brute_force[i].forwardmove.max - brute_force[i].forwardmove.min + 1) *
-                     (brute_force[i].sidemove.max - brute_force[i].sidemove.min + 1) *
-                     (brute_force[i].angleturn.max - brute_force[i].angleturn.min + 1);
+    bf_volume_max *= dsda_BFFrameVolume(i);
 
     brute_force[i].forwardmove.i = brute_force[i].forwardmove.min;
     brute_force[i].sidemove.i = brute_force[i].sidemove.min;
@@ -632,16 +1412,461 @@ dboolean dsda_StartBruteForce(int depth) {
   lprintf(LO_INFO, "Testing %lld sequences with depth %d\n\n", bf_volume_max, bf_depth);
 
   bf_mode = true;
+  bf_search = bf_search_exhaustive;
+  bf_total_volume_max = bf_volume_max;
+  bf_worker_total = 1;
+  bf_worker_index = 0;
+  bf_prefix_depth = 0;
+  bf_prefix_index = 0;
+  bf_next_progress = BF_PROGRESS_INTERVAL;
 
-  if (bf_nomonsters) {
-    lprintf(LO_INFO, "Warning: ignoring monsters! The result may desync with monsters!\n");
-    dsda_StoreKeyFrame(&nomo_key_frame, true, false);
-    P_RemoveMonsters();
+  dsda_ResetBFTranspositionTable();
+
+  dsda_BeginBF();
+
+  dsda_StartBFWorkers();
+  dsda_SliceBFVolume();
+
+#ifdef BF_WORKERS
+  if (bf_worker_index) {
+    if (!bf_volume_max || dsda_AdvanceToOwnedPrefix(bf_depth) < 0)
+      dsda_ExitBFWorker(BF_FAILURE);
+
+    dsda_RunBFWorker();
   }
+#endif
 
-  dsda_EnterSkipMode();
+  return true;
+}
 
-  dsda_StartTimer(dsda_timer_brute_force);
+// The search modes use their own generator so the game rng is untouched
+static unsigned int dsda_BFRandom(void) {
+  bf_random_state ^= bf_random_state << 13;
+  bf_random_state ^= bf_random_state >> 17;
+  bf_random_state ^= bf_random_state << 5;
+
+  return bf_random_state;
+}
+
+static int dsda_BFRangeSize(bf_range_t* range) {
+  return range->max - range->min + 1;
+}
+
+// Decode a candidate index into a command within the search range
+static void dsda_BFSearchCommand(ticcmd_t* cmd, long long index) {
+  bf_t* bf;
+
+  bf = &bf_search_range;
+
+  bf->angleturn.i = bf->angleturn.min + index % dsda_BFRangeSize(&bf->angleturn);
+  index /= dsda_BFRangeSize(&bf->angleturn);
+  bf->sidemove.i = bf->sidemove.min + index % dsda_BFRangeSize(&bf->sidemove);
+  index /= dsda_BFRangeSize(&bf->sidemove);
+  bf->forwardmove.i = bf->forwardmove.min + index;
+
+  dsda_CopyBFCommandDepth(cmd, bf);
+}
+
+static void dsda_RandomBFSearchCommand(ticcmd_t* cmd) {
+  dsda_BFSearchCommand(cmd, dsda_BFRandom() % bf_search_volume);
+}
+
+static void dsda_ScoreBFSearch(bf_score_t* score) {
+  int i;
+
+  score->reached = 0;
+  for (i = 0; i < bf_condition_count; ++i)
+    score->reached += dsda_BFConditionReached(i);
+
+  score->value = bf_target.enabled ? dsda_BFAttribute(bf_target.attribute) : 0;
+}
+
+// Meeting more conditions always wins, then the target decides
+static dboolean dsda_BFBetterScore(const bf_score_t* score, const bf_score_t* best) {
+  if (score->reached != best->reached)
+    return score->reached > best->reached;
+
+  return bf_target.enabled && dsda_BFBetterValue(score->value, best->value);
+}
+
+static dboolean dsda_BFSearchSolved(const bf_score_t* score) {
+  return score->reached == bf_condition_count;
+}
+
+static void dsda_PrintBFSearchScore(const char* label, const bf_score_t* score, int depth) {
+  if (bf_target.enabled) {
+    char str[FIXED_STRING_LENGTH];
+
+    dsda_BFTargetString(str, score->value);
+
+    lprintf(LO_INFO, "%s: %s = %s, %d / %d conditions, depth %d\n", label,
+            dsda_bf_attribute_names[bf_target.attribute], str,
+            score->reached, bf_condition_count, depth);
+  }
+  else
+    lprintf(LO_INFO, "%s: %d / %d conditions, depth %d\n", label,
+            score->reached, bf_condition_count, depth);
+}
+
+static void dsda_SetBFSearchResult(ticcmd_t* commands, int depth, const bf_score_t* score) {
+  memcpy(bf_search_result, commands, depth * sizeof(*commands));
+  bf_search_result_depth = depth;
+  bf_search_best = *score;
+  bf_search_found = true;
+}
+
+static void dsda_EndBFSearch(void) {
+  if (bf_search_found) {
+    dsda_PrintBFSearchScore("Best", &bf_search_best, bf_search_result_depth);
+
+    if (dsda_BFSearchSolved(&bf_search_best)) {
+      dsda_EndBF(BF_SUCCESS);
+      return;
+    }
+  }
+
+  dsda_EndBF(BF_FAILURE);
+}
+
+static dboolean dsda_BFSearchBudgetReached(void) {
+  return dsda_ElapsedTimeMS(dsda_timer_brute_force) >= bf_search_budget;
+}
+
+static bf_node_t* dsda_AllocateBFNodes(void) {
+  bf_node_t* nodes;
+  int i;
+
+  nodes = Z_Calloc(bf_beam_width, sizeof(*nodes));
+
+  for (i = 0; i < bf_beam_width; ++i)
+    nodes[i].commands = Z_Malloc(bf_depth * sizeof(*nodes[i].commands));
+
+  return nodes;
+}
+
+static void dsda_EndBFBeam(void) {
+  int i, best;
+
+  if (bf_beam_tic) {
+    best = 0;
+    for (i = 1; i < bf_beam_count; ++i)
+      if (dsda_BFBetterScore(&bf_beam[i].score, &bf_beam[best].score))
+        best = i;
+
+    dsda_SetBFSearchResult(bf_beam[best].commands, bf_beam_tic, &bf_beam[best].score);
+  }
+
+  dsda_EndBFSearch();
+}
+
+static void dsda_InsertBFBeamNode(const bf_score_t* score) {
+  int i, slot;
+  unsigned long long hash;
+  bf_node_t* node;
+
+  // Different commands often reach the same state - keep only one of them
+  hash = dsda_BFStateHash(bf_beam_tic + 1);
+
+  for (i = 0; i < bf_next_beam_count; ++i)
+    if (bf_next_beam[i].hash == hash)
+      return;
+
+  if (bf_next_beam_count < bf_beam_width)
+    slot = bf_next_beam_count++;
+  else {
+    slot = 0;
+    for (i = 1; i < bf_beam_width; ++i)
+      if (dsda_BFBetterScore(&bf_next_beam[slot].score, &bf_next_beam[i].score))
+        slot = i;
+
+    if (!dsda_BFBetterScore(score, &bf_next_beam[slot].score))
+      return;
+  }
+
+  node = &bf_next_beam[slot];
+  node->score = *score;
+  node->hash = hash;
+  dsda_StoreKeyFrame(&node->key_frame, true, false);
+  memcpy(node->commands, bf_beam[bf_beam_parent].commands,
+         bf_beam_tic * sizeof(*node->commands));
+  node->commands[bf_beam_tic] = bf_search_cmd;
+}
+
+static void dsda_AdvanceBFBeam(void) {
+  bf_node_t* nodes;
+
+  if (++bf_beam_candidate < bf_search_volume)
+    return;
+
+  bf_beam_candidate = 0;
+
+  if (++bf_beam_parent < bf_beam_count)
+    return;
+
+  bf_beam_parent = 0;
+
+  nodes = bf_beam;
+  bf_beam = bf_next_beam;
+  bf_next_beam = nodes;
+  bf_beam_count = bf_next_beam_count;
+  bf_next_beam_count = 0;
+
+  ++bf_beam_tic;
+
+  if (bf_beam_tic % 35 == 0)
+    dsda_PrintBFSearchProgress();
+}
+
+static void dsda_UpdateBFBeam(void) {
+  dsda_RestoreKeyFrame(&bf_beam[bf_beam_parent].key_frame, true);
+  dsda_BFSearchCommand(&bf_search_cmd, bf_beam_candidate);
+}
+
+static void dsda_EvaluateBFBeam(void) {
+  bf_score_t score;
+
+  if (true_logictic - bf_logictic != bf_beam_tic + 1)
+    return;
+
+  ++bf_volume;
+
+  dsda_ScoreBFSearch(&score);
+
+  // Without a target, the first sequence that meets the conditions is the answer
+  if (!bf_target.enabled && dsda_BFSearchSolved(&score)) {
+    memcpy(bf_search_result, bf_beam[bf_beam_parent].commands,
+           bf_beam_tic * sizeof(*bf_search_result));
+    bf_search_result[bf_beam_tic] = bf_search_cmd;
+    bf_search_result_depth = bf_beam_tic + 1;
+    bf_search_best = score;
+    bf_search_found = true;
+
+    dsda_EndBFSearch();
+    return;
+  }
+
+  dsda_InsertBFBeamNode(&score);
+  dsda_AdvanceBFBeam();
+
+  if (bf_beam_tic == bf_depth || dsda_BFSearchBudgetReached())
+    dsda_EndBFBeam();
+}
+
+static int dsda_CompareBFIndividuals(const void* a, const void* b) {
+  const bf_individual_t* x = a;
+  const bf_individual_t* y = b;
+
+  if (dsda_BFBetterScore(&x->score, &y->score))
+    return -1;
+
+  if (dsda_BFBetterScore(&y->score, &x->score))
+    return 1;
+
+  return 0;
+}
+
+// Replace a short run of tics with one command, since a single tic
+//   rarely changes the outcome on its own
+static void dsda_MutateBFCommands(ticcmd_t* commands) {
+  int i, count;
+  ticcmd_t cmd;
+
+  i = dsda_BFRandom() % bf_depth;
+  count = 1 + dsda_BFRandom() % 8;
+  dsda_RandomBFSearchCommand(&cmd);
+
+  for (; count && i < bf_depth; --count, ++i)
+    commands[i] = cmd;
+}
+
+// Keep the better half and replace the rest with mutated crossovers
+static void dsda_BreedBFPopulation(void) {
+  int i, elite;
+
+  qsort(bf_population, bf_population_size, sizeof(*bf_population), dsda_CompareBFIndividuals);
+
+  elite = bf_population_size / 2;
+
+  for (i = elite; i < bf_population_size; ++i) {
+    int cut;
+    bf_individual_t* child;
+    bf_individual_t* a;
+    bf_individual_t* b;
+
+    child = &bf_population[i];
+    a = &bf_population[dsda_BFRandom() % elite];
+    b = &bf_population[dsda_BFRandom() % elite];
+    cut = dsda_BFRandom() % bf_depth;
+
+    memcpy(child->commands, a->commands, cut * sizeof(*child->commands));
+    memcpy(child->commands + cut, b->commands + cut,
+           (bf_depth - cut) * sizeof(*child->commands));
+    dsda_MutateBFCommands(child->commands);
+    child->evaluated = false;
+  }
+
+  ++bf_generation;
+
+  if (bf_generation % 10 == 0)
+    dsda_PrintBFSearchProgress();
+}
+
+static void dsda_UpdateBFEvolution(void) {
+  if (true_logictic - bf_logictic == bf_depth)
+    dsda_RestoreKeyFrame(&bf_search_key_frame, true);
+}
+
+static void dsda_EvaluateBFEvolution(void) {
+  bf_individual_t* individual;
+
+  if (true_logictic - bf_logictic != bf_depth)
+    return;
+
+  ++bf_volume;
+
+  individual = &bf_population[bf_individual];
+  dsda_ScoreBFSearch(&individual->score);
+  individual->evaluated = true;
+
+  if (!bf_search_found || dsda_BFBetterScore(&individual->score, &bf_search_best)) {
+    dsda_SetBFSearchResult(individual->commands, bf_depth, &individual->score);
+    dsda_PrintBFSearchScore("New best", &bf_search_best, bf_depth);
+
+    if (!bf_target.enabled && dsda_BFSearchSolved(&bf_search_best)) {
+      dsda_EndBFSearch();
+      return;
+    }
+  }
+
+  if (dsda_BFSearchBudgetReached()) {
+    dsda_EndBFSearch();
+    return;
+  }
+
+  do {
+    if (++bf_individual == bf_population_size) {
+      dsda_BreedBFPopulation();
+      bf_individual = 0;
+    }
+  } while (bf_population[bf_individual].evaluated);
+}
+
+void dsda_SetBruteForceSearchRange(int forwardmove_min, int forwardmove_max,
+                                   int sidemove_min, int sidemove_max,
+                                   int angleturn_min, int angleturn_max,
+                                   byte buttons) {
+  dsda_SortIntPair(&forwardmove_min, &forwardmove_max);
+  dsda_SortIntPair(&sidemove_min, &sidemove_max);
+  dsda_SortIntPair(&angleturn_min, &angleturn_max);
+
+  bf_search_range.forwardmove.min = forwardmove_min;
+  bf_search_range.forwardmove.max = forwardmove_max;
+
+  bf_search_range.sidemove.min = sidemove_min;
+  bf_search_range.sidemove.max = sidemove_max;
+
+  bf_search_range.angleturn.min = angleturn_min;
+  bf_search_range.angleturn.max = angleturn_max;
+
+  bf_search_range.buttons = buttons;
+}
+
+static dboolean dsda_StartBFSearch(bf_search_t search, int depth, int seconds) {
+  if (!dsda_BuildMode()) {
+    lprintf(LO_WARN, "You cannot start brute force outside of build mode!\n");
+    return false;
+  }
+
+  if (depth <= 0 || depth > MAX_BF_SEARCH_DEPTH || seconds <= 0)
+    return false;
+
+  dsda_TrackFeature(uf_bruteforce);
+
+  lprintf(LO_INFO, "Brute force starting (%s search):\n", bf_search_names[search]);
+  lprintf(LO_INFO, "  F %d:%d S %d:%d T %d:%d B %d\n",
+          bf_search_range.forwardmove.min, bf_search_range.forwardmove.max,
+          bf_search_range.sidemove.min, bf_search_range.sidemove.max,
+          bf_search_range.angleturn.min, bf_search_range.angleturn.max,
+          bf_search_range.buttons);
+
+  lprintf(LO_INFO, "Searching sequences with depth %d for up to %d seconds\n\n",
+          depth, seconds);
+
+  if (bf_worker_count > 1)
+    lprintf(LO_WARN, "Brute force workers only apply to exhaustive search!\n");
+
+  bf_search_volume = (long long) dsda_BFRangeSize(&bf_search_range.forwardmove) *
+                     dsda_BFRangeSize(&bf_search_range.sidemove) *
+                     dsda_BFRangeSize(&bf_search_range.angleturn);
+
+  bf_mode = true;
+  bf_search = search;
+  bf_depth = depth;
+  bf_logictic = true_logictic;
+  bf_volume = 0;
+  bf_worker_total = 1;
+  bf_worker_index = 0;
+  bf_prefix_depth = 0;
+  bf_search_budget = seconds * 1000ULL;
+  bf_search_found = false;
+  bf_search_result = Z_Malloc(depth * sizeof(*bf_search_result));
+  bf_search_result_depth = 0;
+  bf_random_state = BF_RANDOM_SEED;
+
+  dsda_BeginBF();
+
+  dsda_StoreKeyFrame(&bf_search_key_frame, true, false);
+
+  return true;
+}
+
+dboolean dsda_StartBeamSearch(int depth, int width, int seconds) {
+  if (width <= 0 || width > MAX_BF_BEAM_WIDTH)
+    return false;
+
+  if (!dsda_StartBFSearch(bf_search_beam, depth, seconds))
+    return false;
+
+  bf_beam_width = width;
+  bf_beam = dsda_AllocateBFNodes();
+  bf_next_beam = dsda_AllocateBFNodes();
+  bf_beam_count = 1;
+  bf_next_beam_count = 0;
+  bf_beam_tic = 0;
+  bf_beam_parent = 0;
+  bf_beam_candidate = 0;
+
+  dsda_StoreKeyFrame(&bf_beam[0].key_frame, true, false);
+  dsda_ScoreBFSearch(&bf_beam[0].score);
+
+  return true;
+}
+
+dboolean dsda_StartEvolutionSearch(int depth, int population, int seconds) {
+  int i, j;
+
+  if (population < 2 || population > MAX_BF_POPULATION)
+    return false;
+
+  if (!dsda_StartBFSearch(bf_search_evolve, depth, seconds))
+    return false;
+
+  bf_population_size = population;
+  bf_population = Z_Calloc(bf_population_size, sizeof(*bf_population));
+  bf_individual = 0;
+  bf_generation = 0;
+
+  for (i = 0; i < bf_population_size; ++i) {
+    bf_population[i].commands = Z_Malloc(bf_depth * sizeof(*bf_population[i].commands));
+
+    for (j = 0; j < bf_depth; ++j)
+      dsda_RandomBFSearchCommand(&bf_population[i].commands[j]);
+  }
+
+  // Seed the first sequence with the existing build commands, if any
+  for (j = 0; j < bf_depth; ++j)
+    if (!dsda_CopyPendingCmd(&bf_population[0].commands[j], j))
+      break;
 
   return true;
 }
@@ -649,13 +1874,32 @@ dboolean dsda_StartBruteForce(int depth) {
 void dsda_UpdateBruteForce(void) {
   int frame;
 
+  if (bf_search == bf_search_beam) {
+    dsda_UpdateBFBeam();
+    return;
+  }
+
+  if (bf_search == bf_search_evolve) {
+    dsda_UpdateBFEvolution();
+    return;
+  }
+
+  if (bf_pruned_frame >= 0) {
+    dsda_RestoreBFKeyFrame(bf_pruned_frame);
+    bf_pruned_frame = -1;
+
+    return;
+  }
+
   frame = true_logictic - bf_logictic;
 
   if (frame == bf_depth) {
-    if (bf_volume % 10000 == 0)
-      dsda_PrintBFProgress();
+    if (bf_volume >= bf_next_progress) {
+      dsda_ReportBFProgress();
+      bf_next_progress = bf_volume + BF_PROGRESS_INTERVAL;
+    }
 
-    frame = dsda_AdvanceBruteForce();
+    frame = dsda_AdvanceBruteForceFrom(bf_depth - 1);
 
     if (frame >= 0)
       dsda_RestoreBFKeyFrame(frame);
@@ -664,9 +1908,61 @@ void dsda_UpdateBruteForce(void) {
     dsda_StoreBFKeyFrame(frame);
 }
 
+static void dsda_EndBFSearchSpace(void) {
+#ifdef BF_WORKERS
+  if (!bf_worker_index && dsda_WaitForBFWorkers())
+    dsda_EndBF(BF_SUCCESS);
+  else
+#endif
+  if (bf_target.enabled && bf_target.evaluated)
+    dsda_EndBF(BF_SUCCESS);
+  else
+    dsda_EndBF(BF_FAILURE);
+}
+
+static void dsda_PruneBruteForce(int frame) {
+  int changed;
+
+  // Prefix frames are split between workers, so only prune below them
+  if (!bf_prune_mode || frame <= bf_prefix_depth)
+    return;
+
+  if (!dsda_BFTranspositionSeen(dsda_BFStateHash(frame)))
+    return;
+
+  // The sequences below this frame are still at their first value
+  bf_pruned += dsda_BFSuffixVolume(frame);
+  bf_volume += dsda_BFSuffixVolume(frame);
+
+  if (bf_volume >= bf_volume_max) {
+    dsda_EndBFSearchSpace();
+    return;
+  }
+
+  changed = dsda_AdvanceBruteForceFrom(frame - 1);
+  if (changed >= 0)
+    bf_pruned_frame = changed;
+}
+
 void dsda_EvaluateBruteForce(void) {
-  if (true_logictic - bf_logictic != bf_depth)
+  int frame;
+
+  if (bf_search == bf_search_beam) {
+    dsda_EvaluateBFBeam();
+    return;
+  }
+
+  if (bf_search == bf_search_evolve) {
+    dsda_EvaluateBFEvolution();
     return;
+  }
+
+  frame = true_logictic - bf_logictic;
+
+  if (frame != bf_depth) {
+    dsda_PruneBruteForce(frame);
+    return;
+  }
 
   ++bf_volume;
 
@@ -674,11 +1970,13 @@ void dsda_EvaluateBruteForce(void) {
     dsda_CopyBFResult(brute_force, bf_depth);
     dsda_EndBF(BF_SUCCESS);
   }
+#ifdef BF_WORKERS
+  else if (!bf_worker_index && dsda_PollBFWorkers(0)) {
+    dsda_EndBF(BF_SUCCESS);
+  }
+#endif
   else if (bf_volume >= bf_volume_max) {
-    if (bf_target.enabled && bf_target.evaluated)
-      dsda_EndBF(BF_SUCCESS);
-    else
-      dsda_EndBF(BF_FAILURE);
+    dsda_EndBFSearchSpace();
   }
 }
 
@@ -693,5 +1991,10 @@ void dsda_CopyBruteForceCommand(ticcmd_t* cmd) {
     return;
   }
 
-  dsda_CopyBFCommandDepth(cmd, &brute_force[depth]);
+  if (bf_search == bf_search_beam)
+    *cmd = bf_search_cmd;
+  else if (bf_search == bf_search_evolve)
+    *cmd = bf_population[bf_individual].commands[depth];
+  else
+    dsda_CopyBFCommandDepth(cmd, &brute_force[depth]);
 }
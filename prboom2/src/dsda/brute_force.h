@@ -87,10 +87,18 @@ typedef enum {
   dsda_bf_limit_max = dsda_bf_limit_duo_max
 } dsda_bf_limit_t;
 
+typedef enum {
+  dsda_bf_prune_off,
+  dsda_bf_prune_attributes,
+  dsda_bf_prune_full,
+  dsda_bf_prune_max,
+} dsda_bf_prune_t;
+
 extern const char* dsda_bf_attribute_names[dsda_bf_attribute_max];
 extern const char* dsda_bf_operator_names[dsda_bf_operator_max];
 extern const char* dsda_bf_item_names[dsda_bf_item_max];
 extern const char* dsda_bf_limit_names[dsda_bf_limit_max];
+extern const char* dsda_bf_prune_names[dsda_bf_prune_max];
 
 dboolean dsda_BruteForce(void);
 dboolean dsda_BruteForceEnded(void);
@@ -101,6 +109,12 @@ void dsda_AddMiscBruteForceCondition(dsda_bf_attribute_t attribute, fixed_t valu
 void dsda_AddBruteForceCondition(dsda_bf_attribute_t attribute,
                                  dsda_bf_operator_t operator, fixed_t value);
 dboolean dsda_StartBruteForce(int depth);
+dboolean dsda_StartBeamSearch(int depth, int width, int seconds);
+dboolean dsda_StartEvolutionSearch(int depth, int population, int seconds);
+void dsda_SetBruteForceSearchRange(int forwardmove_min, int forwardmove_max,
+                                   int sidemove_min, int sidemove_max,
+                                   int angleturn_min, int angleturn_max,
+                                   byte buttons);
 int dsda_KeepBruteForceFrame(int i);
 int dsda_AddBruteForceFrame(int i,
                             int forwardmove_min, int forwardmove_max,
@@ -109,6 +123,8 @@ int dsda_AddBruteForceFrame(int i,
                             byte buttons);
 void dsda_BruteForceWithoutMonsters(void);
 void dsda_BruteForceWithMonsters(void);
+dboolean dsda_SetBruteForceWorkers(int count);
+void dsda_SetBruteForcePruneMode(dsda_bf_prune_t mode);
 void dsda_UpdateBruteForce(void);
 void dsda_EvaluateBruteForce(void);
 void dsda_CopyBruteForceCommand(ticcmd_t* cmd);
@@ -701,6 +701,10 @@ dsda_config_t dsda_config[dsda_config_count] = {
     "mus_pause_opt", dsda_config_mus_pause_opt,
     dsda_config_int, 0, 2, { 1 }
   },
+  [dsda_config_mus_cache] = {
+    "mus_cache", dsda_config_mus_cache,
+    CONF_BOOL(0)
+  },
   [dsda_config_snd_channels] = {
     "snd_channels", dsda_config_snd_channels,
     dsda_config_int, 1, MAX_CHANNELS, { 32 }, NULL, NOT_STRICT, S_Init
@@ -787,7 +791,7 @@ dsda_config_t dsda_config[dsda_config_count] = {
   },
   [dsda_config_cap_videocommand] = {
     "cap_videocommand", dsda_config_cap_videocommand,
-    CONF_STRING("ffmpeg -f rawvideo -pix_fmt rgb24 -r %r -s %wx%h -i - -c:v libx264 -y temp_v.nut")
+    CONF_STRING("ffmpeg -f rawvideo -pix_fmt %p -r %r -s %wx%h -i - -c:v libx264 -y temp_v.nut")
   },
   [dsda_config_cap_muxcommand] = {
     "cap_muxcommand", dsda_config_cap_muxcommand,
@@ -813,6 +817,18 @@ dsda_config_t dsda_config[dsda_config_count] = {
     "cap_fps", dsda_config_cap_fps,
     dsda_config_int, 16, 300, { 60 }
   },
+  [dsda_config_cap_queue_frames] = {
+    "cap_queue_frames", dsda_config_cap_queue_frames,
+    dsda_config_int, 2, 64, { 8 }
+  },
+  [dsda_config_cap_drop_frames] = {
+    "cap_drop_frames", dsda_config_cap_drop_frames,
+    CONF_BOOL(0)
+  },
+  [dsda_config_cap_pixel_format] = {
+    "cap_pixel_format", dsda_config_cap_pixel_format,
+    dsda_config_int, 0, 1, { 0 }
+  },
   [dsda_config_hudadd_crosshair_color] = {
     "hudadd_crosshair_color", dsda_config_hudadd_crosshair_color,
     CONF_CR(3)
@@ -1220,6 +1236,10 @@ dsda_config_t dsda_config[dsda_config_count] = {
     "announce_map", dsda_config_announce_map,
     CONF_BOOL(0),
   },
+  [dsda_config_patch_cache_size] = {
+    "patch_cache_size", dsda_config_patch_cache_size,
+    dsda_config_int, 0, 65536, { 256 }
+  },
 };
 
 static void dsda_PersistIntConfig(dsda_config_t* conf) {
@@ -146,6 +146,7 @@ typedef enum {
   dsda_config_sfx_volume,
   dsda_config_music_volume,
   dsda_config_mus_pause_opt,
+  dsda_config_mus_cache,
   dsda_config_snd_channels,
   dsda_config_snd_midiplayer,
   dsda_config_snd_mididev,
@@ -174,6 +175,9 @@ typedef enum {
   dsda_config_cap_remove_tempfiles,
   dsda_config_cap_wipescreen,
   dsda_config_cap_fps,
+  dsda_config_cap_queue_frames,
+  dsda_config_cap_drop_frames,
+  dsda_config_cap_pixel_format,
   dsda_config_hudadd_crosshair_color,
   dsda_config_hudadd_crosshair_target_color,
   dsda_config_hud_displayed,
@@ -274,6 +278,7 @@ typedef enum {
   dsda_config_invert_analog_look,
   dsda_config_ansi_endoom,
   dsda_config_announce_map,
+  dsda_config_patch_cache_size,
   dsda_config_count,
 } dsda_config_identifier_t;
 
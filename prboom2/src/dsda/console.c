@@ -35,6 +35,7 @@
 #include "p_spec.h"
 #include "p_tick.h"
 #include "p_user.h"
+#include "r_patch.h"
 #include "s_sound.h"
 #include "smooth.h"
 #include "v_video.h"
@@ -618,6 +619,12 @@ static dboolean console_GameQuit(const char* command, const char* args) {
   return true;
 }
 
+static dboolean console_ScreenShotBurst(const char* command, const char* args) {
+  M_ToggleScreenShotBurst();
+
+  return true;
+}
+
 static dboolean console_GameDescribe(const char* command, const char* args) {
   extern dsda_string_t hud_title;
 
@@ -848,6 +855,34 @@ static dboolean console_BruteForceMonsters(const char* command, const char* args
   return true;
 }
 
+static dboolean console_BruteForceWorkers(const char* command, const char* args) {
+  int count;
+
+  if (sscanf(args, "%d", &count) != 1)
+    return false;
+
+  return dsda_SetBruteForceWorkers(count);
+}
+
+static dboolean console_BruteForcePrune(const char* command, const char* args) {
+  char mode_s[5] = { 0 };
+  int mode;
+
+  if (sscanf(args, "%4s", mode_s) != 1)
+    return false;
+
+  for (mode = 0; mode < dsda_bf_prune_max; ++mode)
+    if (!strcmp(mode_s, dsda_bf_prune_names[mode]))
+      break;
+
+  if (mode == dsda_bf_prune_max)
+    return false;
+
+  dsda_SetBruteForcePruneMode(mode);
+
+  return true;
+}
+
 static dboolean console_BruteForceFrame(const char* command, const char* args) {
   int frame;
   int forwardmove_min, forwardmove_max;
@@ -899,6 +934,104 @@ static dboolean console_BruteForceFrame(const char* command, const char* args) {
                                  buttons);
 }
 
+static dboolean console_ParseBruteForceConditions(char* condition_args) {
+  int i;
+  char** conditions;
+
+  conditions = dsda_SplitString(condition_args, ",");
+
+  if (!conditions)
+    return false;
+
+  for (i = 0; conditions[i]; ++i) {
+    fixed_t value;
+    char attr_s[4] = { 0 };
+    char oper_s[5] = { 0 };
+
+    if (sscanf(conditions[i], " skip %i", &value) == 1) {
+      if (value >= numlines || value < 0)
+        return false;
+
+      dsda_AddMiscBruteForceCondition(dsda_bf_line_skip, value);
+    }
+    else if (sscanf(conditions[i], " act %i", &value) == 1) {
+      if (value >= numlines || value < 0)
+        return false;
+
+      dsda_AddMiscBruteForceCondition(dsda_bf_line_activation, value);
+    }
+    else if (sscanf(conditions[i], " have %3[a-zA-Z]", attr_s) == 1) {
+      int attr_i;
+
+      for (attr_i = 0; attr_i < dsda_bf_item_max; ++attr_i)
+        if (!strcmp(attr_s, dsda_bf_item_names[attr_i]))
+          break;
+
+      if (attr_i == dsda_bf_item_max)
+        return false;
+
+      dsda_AddMiscBruteForceCondition(dsda_bf_have_item, attr_i);
+    }
+    else if (sscanf(conditions[i], " %3[a-zA-Z] %4[a-zA-Z><!=] %i", attr_s, oper_s, &value) == 3) {
+      int attr_i, oper_i;
+
+      if (oper_s[0] == '=' && !oper_s[1])
+        oper_s[1] = '=';
+
+      for (attr_i = 0; attr_i < dsda_bf_attribute_max; ++attr_i)
+        if (!strcmp(attr_s, dsda_bf_attribute_names[attr_i]))
+          break;
+
+      if (attr_i == dsda_bf_attribute_max)
+        return false;
+
+      for (oper_i = dsda_bf_limit_trio_zero; oper_i < dsda_bf_limit_trio_max; ++oper_i)
+        if (!strcmp(oper_s, dsda_bf_limit_names[oper_i]))
+          break;
+
+      if (oper_i != dsda_bf_limit_trio_max) {
+        dsda_SetBruteForceTarget(attr_i, oper_i, value, true);
+        continue;
+      }
+
+      for (oper_i = 0; oper_i < dsda_bf_operator_max; ++oper_i)
+        if (!strcmp(oper_s, dsda_bf_operator_names[oper_i]))
+          break;
+
+      if (oper_i == dsda_bf_operator_max)
+        return false;
+
+      dsda_AddBruteForceCondition(attr_i, oper_i, value);
+    }
+    else if (sscanf(conditions[i], " %3s %4s", attr_s, oper_s) == 2) {
+      int attr_i, oper_i;
+
+      for (attr_i = 0; attr_i < dsda_bf_attribute_max; ++attr_i)
+        if (!strcmp(attr_s, dsda_bf_attribute_names[attr_i]))
+          break;
+
+      if (attr_i == dsda_bf_attribute_max)
+        return false;
+
+      for (oper_i = dsda_bf_limit_duo_zero; oper_i < dsda_bf_limit_duo_max; ++oper_i)
+        if (!strcmp(oper_s, dsda_bf_limit_names[oper_i]))
+          break;
+
+      if (oper_i == dsda_bf_limit_duo_max)
+        return false;
+
+      dsda_SetBruteForceTarget(attr_i, oper_i, 0, false);
+    }
+    else {
+      return false;
+    }
+  }
+
+  Z_Free(conditions);
+
+  return true;
+}
+
 static dboolean console_BruteForceStart(const char* command, const char* args) {
   int depth;
   int forwardmove_min, forwardmove_max;
@@ -934,103 +1067,57 @@ static dboolean console_BruteForceStart(const char* command, const char* args) {
       return false;
   }
 
-  {
-    int i;
-    char** conditions;
-
-    conditions = dsda_SplitString(condition_args, ",");
-
-    if (!conditions)
-      return false;
-
-    for (i = 0; conditions[i]; ++i) {
-      fixed_t value;
-      char attr_s[4] = { 0 };
-      char oper_s[5] = { 0 };
-
-      if (sscanf(conditions[i], " skip %i", &value) == 1) {
-        if (value >= numlines || value < 0)
-          return false;
-
-        dsda_AddMiscBruteForceCondition(dsda_bf_line_skip, value);
-      }
-      else if (sscanf(conditions[i], " act %i", &value) == 1) {
-        if (value >= numlines || value < 0)
-          return false;
-
-        dsda_AddMiscBruteForceCondition(dsda_bf_line_activation, value);
-      }
-      else if (sscanf(conditions[i], " have %3[a-zA-Z]", attr_s) == 1) {
-        int attr_i;
-
-        for (attr_i = 0; attr_i < dsda_bf_item_max; ++attr_i)
-          if (!strcmp(attr_s, dsda_bf_item_names[attr_i]))
-            break;
-
-        if (attr_i == dsda_bf_item_max)
-          return false;
-
-        dsda_AddMiscBruteForceCondition(dsda_bf_have_item, attr_i);
-      }
-      else if (sscanf(conditions[i], " %3[a-zA-Z] %4[a-zA-Z><!=] %i", attr_s, oper_s, &value) == 3) {
-        int attr_i, oper_i;
-
-        if (oper_s[0] == '=' && !oper_s[1])
-          oper_s[1] = '=';
-
-        for (attr_i = 0; attr_i < dsda_bf_attribute_max; ++attr_i)
-          if (!strcmp(attr_s, dsda_bf_attribute_names[attr_i]))
-            break;
+  if (!console_ParseBruteForceConditions(condition_args))
+    return false;
 
-        if (attr_i == dsda_bf_attribute_max)
-          return false;
+  return dsda_StartBruteForce(depth);
+}
 
-        for (oper_i = dsda_bf_limit_trio_zero; oper_i < dsda_bf_limit_trio_max; ++oper_i)
-          if (!strcmp(oper_s, dsda_bf_limit_names[oper_i]))
-            break;
+static dboolean console_BruteForceSearchArgs(const char* args,
+                                             int* depth, int* size, int* seconds) {
+  int forwardmove_min, forwardmove_max;
+  int sidemove_min, sidemove_max;
+  int angleturn_min, angleturn_max;
+  char condition_args[CONSOLE_ENTRY_SIZE];
+  int arg_count;
 
-        if (oper_i != dsda_bf_limit_trio_max) {
-          dsda_SetBruteForceTarget(attr_i, oper_i, value, true);
-          continue;
-        }
+  dsda_ResetBruteForceConditions();
 
-        for (oper_i = 0; oper_i < dsda_bf_operator_max; ++oper_i)
-          if (!strcmp(oper_s, dsda_bf_operator_names[oper_i]))
-            break;
+  arg_count = sscanf(
+    args, "%i %i %i %i:%i %i:%i %i:%i %[^;]", depth, size, seconds,
+    &forwardmove_min, &forwardmove_max,
+    &sidemove_min, &sidemove_max,
+    &angleturn_min, &angleturn_max,
+    condition_args
+  );
 
-        if (oper_i == dsda_bf_operator_max)
-          return false;
+  if (arg_count != 10)
+    return false;
 
-        dsda_AddBruteForceCondition(attr_i, oper_i, value);
-      }
-      else if (sscanf(conditions[i], " %3s %4s", attr_s, oper_s) == 2) {
-        int attr_i, oper_i;
+  dsda_SetBruteForceSearchRange(forwardmove_min, forwardmove_max,
+                                sidemove_min, sidemove_max,
+                                angleturn_min, angleturn_max,
+                                0);
 
-        for (attr_i = 0; attr_i < dsda_bf_attribute_max; ++attr_i)
-          if (!strcmp(attr_s, dsda_bf_attribute_names[attr_i]))
-            break;
+  return console_ParseBruteForceConditions(condition_args);
+}
 
-        if (attr_i == dsda_bf_attribute_max)
-          return false;
+static dboolean console_BruteForceBeam(const char* command, const char* args) {
+  int depth, width, seconds;
 
-        for (oper_i = dsda_bf_limit_duo_zero; oper_i < dsda_bf_limit_duo_max; ++oper_i)
-          if (!strcmp(oper_s, dsda_bf_limit_names[oper_i]))
-            break;
+  if (!console_BruteForceSearchArgs(args, &depth, &width, &seconds))
+    return false;
 
-        if (oper_i == dsda_bf_limit_duo_max)
-          return false;
+  return dsda_StartBeamSearch(depth, width, seconds);
+}
 
-        dsda_SetBruteForceTarget(attr_i, oper_i, 0, false);
-      }
-      else {
-        return false;
-      }
-    }
+static dboolean console_BruteForceEvolve(const char* command, const char* args) {
+  int depth, population, seconds;
 
-    Z_Free(conditions);
-  }
+  if (!console_BruteForceSearchArgs(args, &depth, &population, &seconds))
+    return false;
 
-  return dsda_StartBruteForce(depth);
+  return dsda_StartEvolutionSearch(depth, population, seconds);
 }
 
 static dboolean console_BuildTurbo(const char* command, const char* args) {
@@ -2227,6 +2314,12 @@ static dboolean console_MusicRestart(const char* command, const char* args) {
   return true;
 }
 
+static dboolean console_PatchCacheStats(const char* command, const char* args) {
+  R_PrintPatchCacheStats();
+
+  return true;
+}
+
 static dboolean console_AllGhosts(const char* command, const char* args) {
   if (bmapwidth)
     bmapwidth = 0;
@@ -2269,6 +2362,8 @@ static console_command_entry_t console_commands[] = {
 
   { "music.restart", console_MusicRestart, CF_ALWAYS },
 
+  { "patch_cache.stats", console_PatchCacheStats, CF_ALWAYS },
+
   { "level.exit", console_LevelExit, CF_NEVER },
   { "level.secret_exit", console_LevelSecretExit, CF_NEVER },
 
@@ -2390,6 +2485,10 @@ static console_command_entry_t console_commands[] = {
   // build mode
   { "brute_force.start", console_BruteForceStart, CF_DEMO },
   { "bf.start", console_BruteForceStart, CF_DEMO },
+  { "brute_force.beam", console_BruteForceBeam, CF_DEMO },
+  { "bf.beam", console_BruteForceBeam, CF_DEMO },
+  { "brute_force.evolve", console_BruteForceEvolve, CF_DEMO },
+  { "bf.evolve", console_BruteForceEvolve, CF_DEMO },
   { "brute_force.frame", console_BruteForceFrame, CF_DEMO },
   { "bf.frame", console_BruteForceFrame, CF_DEMO },
   { "brute_force.keep", console_BruteForceKeep, CF_DEMO },
@@ -2398,6 +2497,10 @@ static console_command_entry_t console_commands[] = {
   { "bf.nomo", console_BruteForceNoMonsters, CF_DEMO },
   { "brute_force.monsters", console_BruteForceMonsters, CF_DEMO },
   { "bf.mo", console_BruteForceMonsters, CF_DEMO },
+  { "brute_force.workers", console_BruteForceWorkers, CF_DEMO },
+  { "bf.workers", console_BruteForceWorkers, CF_DEMO },
+  { "brute_force.prune", console_BruteForcePrune, CF_DEMO },
+  { "bf.prune", console_BruteForcePrune, CF_DEMO },
   { "build.turbo", console_BuildTurbo, CF_DEMO },
   { "b.turbo", console_BuildTurbo, CF_DEMO },
   { "mf", console_BuildMF, CF_DEMO },
@@ -2422,6 +2525,7 @@ static console_command_entry_t console_commands[] = {
 
   { "game.quit", console_GameQuit, CF_ALWAYS },
   { "game.describe", console_GameDescribe, CF_ALWAYS },
+  { "screenshot.burst", console_ScreenShotBurst, CF_ALWAYS },
 
   // cheats
   { "idchoppers", console_BasicCheat, CF_DEMO },
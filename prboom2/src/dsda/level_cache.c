@@ -0,0 +1,269 @@
+//
+// Copyright(C) 2023 by Ryan Krafnick
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	DSDA Level Cache
+//
+//	Stores the results of the expensive level setup stages (node
+//	decompression and blockmap construction) for large maps, keyed by
+//	the checksum of the map lumps, the compatibility level, and the
+//	map format.
+//
+
+#include <string.h>
+
+#include "doomstat.h"
+#include "lprintf.h"
+#include "m_file.h"
+#include "md5.h"
+#include "w_wad.h"
+#include "z_zone.h"
+
+#include "dsda/args.h"
+#include "dsda/data_organizer.h"
+#include "dsda/utility.h"
+
+#include "level_cache.h"
+
+// Bump this whenever the cached data or the code that produces it changes
+#define LEVEL_CACHE_VERSION 1
+
+// Small maps load faster than the cache can be read
+#define LEVEL_CACHE_MIN_SIZE (256 * 1024)
+
+static const char level_cache_magic[8] = "DSDALVL";
+
+typedef struct {
+  int section;
+  int length;
+} lc_section_header_t;
+
+typedef struct {
+  const byte* data;
+  int length;
+  dboolean owned;
+} lc_section_t;
+
+static char* level_cache_dir;
+static char* level_cache_file;
+static byte* level_cache_buffer;
+static lc_section_t level_cache_sections[dsda_lc_section_max];
+static dboolean level_cache_open;
+static dboolean level_cache_dirty;
+
+static void dsda_InitLevelCacheDir(void) {
+  int length;
+  const char* data_root;
+
+  data_root = dsda_DataRoot();
+
+  length = strlen(data_root) + 13; // "/level_cache\0"
+  level_cache_dir = Z_Malloc(length);
+  snprintf(level_cache_dir, length, "%s/level_cache", data_root);
+
+  M_MakeDir(level_cache_dir, true);
+}
+
+static void dsda_ResetLevelCacheSections(void) {
+  int i;
+
+  for (i = 0; i < dsda_lc_section_max; ++i)
+    if (level_cache_sections[i].owned)
+      Z_Free((void*) level_cache_sections[i].data);
+
+  memset(level_cache_sections, 0, sizeof(level_cache_sections));
+}
+
+static dboolean dsda_ParseLevelCache(int length) {
+  const byte* p;
+  const byte* end;
+  int version;
+
+  p = level_cache_buffer;
+  end = level_cache_buffer + length;
+
+  if (length < (int) (sizeof(level_cache_magic) + sizeof(version)) ||
+      memcmp(p, level_cache_magic, sizeof(level_cache_magic)))
+    return false;
+
+  p += sizeof(level_cache_magic);
+
+  memcpy(&version, p, sizeof(version));
+  p += sizeof(version);
+
+  if (version != LEVEL_CACHE_VERSION)
+    return false;
+
+  while (p < end) {
+    lc_section_header_t header;
+
+    if (end - p < (int) sizeof(header))
+      return false;
+
+    memcpy(&header, p, sizeof(header));
+    p += sizeof(header);
+
+    if (header.section < 0 || header.section >= dsda_lc_section_max ||
+        header.length < 0 || end - p < header.length)
+      return false;
+
+    level_cache_sections[header.section].data = p;
+    level_cache_sections[header.section].length = header.length;
+
+    // Sections stay 4-byte aligned so they can be used in place
+    p += (header.length + 3) & ~3;
+  }
+
+  return true;
+}
+
+static void dsda_WriteLevelCache(void) {
+  int i;
+  int version;
+  int length;
+  byte* buffer;
+  byte* p;
+
+  length = sizeof(level_cache_magic) + sizeof(version);
+  for (i = 0; i < dsda_lc_section_max; ++i)
+    if (level_cache_sections[i].data)
+      length += sizeof(lc_section_header_t) + ((level_cache_sections[i].length + 3) & ~3);
+
+  buffer = Z_Calloc(length, 1);
+  p = buffer;
+
+  memcpy(p, level_cache_magic, sizeof(level_cache_magic));
+  p += sizeof(level_cache_magic);
+
+  version = LEVEL_CACHE_VERSION;
+  memcpy(p, &version, sizeof(version));
+  p += sizeof(version);
+
+  for (i = 0; i < dsda_lc_section_max; ++i)
+    if (level_cache_sections[i].data) {
+      lc_section_header_t header;
+
+      header.section = i;
+      header.length = level_cache_sections[i].length;
+      memcpy(p, &header, sizeof(header));
+      p += sizeof(header);
+
+      memcpy(p, level_cache_sections[i].data, header.length);
+      p += (header.length + 3) & ~3;
+    }
+
+  if (!M_WriteFile(level_cache_file, buffer, length))
+    lprintf(LO_WARN, "dsda_WriteLevelCache: unable to write %s\n", level_cache_file);
+
+  Z_Free(buffer);
+}
+
+void dsda_OpenLevelCache(const int* lumps, int lump_count, int format) {
+  int i;
+  int size;
+  int length;
+  struct MD5Context md5;
+  dsda_cksum_t cksum;
+
+  dsda_CloseLevelCache();
+
+  size = 0;
+  for (i = 0; i < lump_count; ++i)
+    if (lumps[i] != LUMP_NOT_FOUND)
+      size += W_LumpLength(lumps[i]);
+
+  if (size < LEVEL_CACHE_MIN_SIZE)
+    return;
+
+  MD5Init(&md5);
+
+  {
+    int key[3] = { LEVEL_CACHE_VERSION, compatibility_level, format };
+
+    MD5Update(&md5, (const byte*) key, sizeof(key));
+  }
+
+  for (i = 0; i < lump_count; ++i)
+    if (lumps[i] != LUMP_NOT_FOUND) {
+      length = W_LumpLength(lumps[i]);
+
+      MD5Update(&md5, (const byte*) &length, sizeof(length));
+      MD5Update(&md5, W_LumpByNum(lumps[i]), length);
+    }
+
+  MD5Final(cksum.bytes, &md5);
+  dsda_TranslateCheckSum(&cksum);
+
+  if (!level_cache_dir)
+    dsda_InitLevelCacheDir();
+
+  length = strlen(level_cache_dir) + 38; // "/<cksum (32)>.lvl\0"
+  level_cache_file = Z_Malloc(length);
+  snprintf(level_cache_file, length, "%s/%s.lvl", level_cache_dir, cksum.string);
+
+  level_cache_open = true;
+
+  if (dsda_Flag(dsda_arg_nocache))
+    return;
+
+  length = M_ReadFile(level_cache_file, &level_cache_buffer);
+
+  if (level_cache_buffer && !dsda_ParseLevelCache(length)) {
+    lprintf(LO_WARN, "dsda_OpenLevelCache: ignoring invalid cache %s\n", level_cache_file);
+    dsda_ResetLevelCacheSections();
+    Z_Free(level_cache_buffer);
+    level_cache_buffer = NULL;
+  }
+}
+
+void dsda_CloseLevelCache(void) {
+  if (level_cache_dirty)
+    dsda_WriteLevelCache();
+
+  dsda_ResetLevelCacheSections();
+
+  Z_Free(level_cache_buffer);
+  Z_Free(level_cache_file);
+  level_cache_buffer = NULL;
+  level_cache_file = NULL;
+  level_cache_open = false;
+  level_cache_dirty = false;
+}
+
+const void* dsda_LevelCacheSection(dsda_lc_section_t section, int* length) {
+  if (!level_cache_sections[section].data)
+    return NULL;
+
+  *length = level_cache_sections[section].length;
+
+  return level_cache_sections[section].data;
+}
+
+void dsda_StoreLevelCacheSection(dsda_lc_section_t section, const void* data, int length) {
+  byte* copy;
+
+  if (!level_cache_open)
+    return;
+
+  if (level_cache_sections[section].owned)
+    Z_Free((void*) level_cache_sections[section].data);
+
+  copy = Z_Malloc(length);
+  memcpy(copy, data, length);
+
+  level_cache_sections[section].data = copy;
+  level_cache_sections[section].length = length;
+  level_cache_sections[section].owned = true;
+
+  level_cache_dirty = true;
+}
@@ -0,0 +1,32 @@
+//
+// Copyright(C) 2023 by Ryan Krafnick
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	DSDA Level Cache
+//
+
+#ifndef __DSDA_LEVEL_CACHE__
+#define __DSDA_LEVEL_CACHE__
+
+typedef enum {
+  dsda_lc_blockmap,
+  dsda_lc_znodes,
+  dsda_lc_section_max,
+} dsda_lc_section_t;
+
+void dsda_OpenLevelCache(const int* lumps, int lump_count, int format);
+void dsda_CloseLevelCache(void);
+const void* dsda_LevelCacheSection(dsda_lc_section_t section, int* length);
+void dsda_StoreLevelCacheSection(dsda_lc_section_t section, const void* data, int length);
+
+#endif
@@ -0,0 +1,460 @@
+//
+// Copyright(C) 2023 by Ryan Krafnick
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	DSDA Music Cache
+//
+//	Synthesized songs are rendered once, a few seconds ahead of playback,
+//	by a render thread. The audio callback streams the rendered PCM
+//	instead of running the synth, and a render that reaches the end of
+//	the song is written to a compressed cache file so later sessions skip
+//	synthesis entirely.
+//
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <zlib.h>
+
+#include "SDL.h"
+
+#include "lprintf.h"
+#include "m_file.h"
+#include "z_zone.h"
+
+#include "dsda/args.h"
+
+#include "music_cache.h"
+
+// Stereo frames per buffer; the buffers never move once rendered,
+// so the callback can read them while the render thread appends more
+#define MUSIC_CHUNK_FRAMES 65536
+
+// Frames per call into the player
+#define MUSIC_RENDER_FRAMES 4096
+
+// Rendered on the calling thread so playback never starts out empty
+#define MUSIC_LEAD_FRAMES (4 * MUSIC_RENDER_FRAMES)
+
+// How far the render thread gets ahead of playback before it waits
+#define MUSIC_AHEAD_SECONDS 10
+
+// Songs that have not ended by now loop here and are not saved
+#define MUSIC_MAX_SECONDS (20 * 60)
+
+// Older renders are deleted to keep the music files under this size
+#define MUSIC_CACHE_LIMIT (256 * 1024 * 1024)
+
+static const char music_cache_magic[8] = "DSDAMU2";
+
+typedef struct {
+  char magic[8];
+  int frames;
+} music_cache_header_t;
+
+struct dsda_music_cache_s {
+  char* file;
+  short** chunks;
+  short* block; // backs all chunks when loaded from a file
+  int max_frames;
+  int ahead_frames;
+
+  // Rendering
+  dsda_music_render_t render;
+  dsda_music_finished_t finished;
+  SDL_Thread* thread;
+  SDL_mutex* pace_mutex;
+  SDL_cond* pace_cond; // signalled as playback advances
+  dboolean started;
+  SDL_atomic_t frames;
+  SDL_atomic_t played;
+  SDL_atomic_t complete;
+  SDL_atomic_t abort;
+  int rendered;
+  dboolean truncated;
+  byte* file_data;
+  size_t file_length;
+
+  // Playback
+  int position;
+  dboolean playing;
+  dboolean looping;
+  dboolean paused;
+  int volume_scale;
+};
+
+static dboolean dsda_LoadMusicCacheFile(dsda_music_cache_t* cache) {
+  int file_length;
+  byte* buffer = NULL;
+  music_cache_header_t header;
+  uLongf length;
+  int i, chunk_count;
+
+  file_length = M_ReadFile(cache->file, &buffer);
+
+  if (file_length < (int) sizeof(header)) {
+    Z_Free(buffer);
+    return false;
+  }
+
+  memcpy(&header, buffer, sizeof(header));
+
+  if (memcmp(header.magic, music_cache_magic, sizeof(music_cache_magic)) ||
+      header.frames <= 0 || header.frames > cache->max_frames) {
+    lprintf(LO_WARN, "dsda_LoadMusicCacheFile: ignoring invalid cache %s\n", cache->file);
+    Z_Free(buffer);
+    return false;
+  }
+
+  length = (uLongf) header.frames * 4;
+  cache->block = malloc(length);
+
+  if (!cache->block ||
+      uncompress((Bytef*) cache->block, &length,
+                 buffer + sizeof(header), file_length - sizeof(header)) != Z_OK ||
+      length != (uLongf) header.frames * 4) {
+    lprintf(LO_WARN, "dsda_LoadMusicCacheFile: ignoring invalid cache %s\n", cache->file);
+    free(cache->block);
+    cache->block = NULL;
+    Z_Free(buffer);
+    return false;
+  }
+
+  Z_Free(buffer);
+
+  // Undo the delta filter applied when saving
+  for (i = 2; i < header.frames * 2; ++i)
+    cache->block[i] += cache->block[i - 2];
+
+  chunk_count = (header.frames + MUSIC_CHUNK_FRAMES - 1) / MUSIC_CHUNK_FRAMES;
+  for (i = 0; i < chunk_count; ++i)
+    cache->chunks[i] = cache->block + i * MUSIC_CHUNK_FRAMES * 2;
+
+  SDL_AtomicSet(&cache->frames, header.frames);
+  SDL_AtomicSet(&cache->complete, 1);
+
+  return true;
+}
+
+dsda_music_cache_t* dsda_OpenMusicCache(dsda_startup_cache_t* key, int samplerate) {
+  dsda_music_cache_t* cache;
+
+  dsda_HashStartupCacheData(key, &samplerate, sizeof(samplerate));
+
+  cache = Z_Calloc(1, sizeof(*cache));
+  cache->file = Z_Strdup(dsda_StartupCacheFile(key));
+  cache->max_frames = samplerate * MUSIC_MAX_SECONDS;
+  cache->max_frames -= cache->max_frames % MUSIC_RENDER_FRAMES;
+  cache->ahead_frames = samplerate * MUSIC_AHEAD_SECONDS;
+  cache->chunks = Z_Calloc((cache->max_frames + MUSIC_CHUNK_FRAMES - 1) / MUSIC_CHUNK_FRAMES,
+                           sizeof(*cache->chunks));
+  cache->volume_scale = 65536;
+
+  if (!dsda_Flag(dsda_arg_nocache))
+    dsda_LoadMusicCacheFile(cache);
+
+  return cache;
+}
+
+dboolean dsda_MusicCacheReady(dsda_music_cache_t* cache) {
+  return SDL_AtomicGet(&cache->complete);
+}
+
+dboolean dsda_MusicCacheRendering(dsda_music_cache_t* cache) {
+  return cache->started;
+}
+
+// Returns false once the song is over or the render can't continue
+static dboolean dsda_RenderMusicFrames(dsda_music_cache_t* cache, int frames) {
+  while (frames > 0) {
+    int chunk, offset;
+
+    if (cache->rendered == cache->max_frames) {
+      cache->truncated = true;
+      return false;
+    }
+
+    chunk = cache->rendered / MUSIC_CHUNK_FRAMES;
+    offset = cache->rendered % MUSIC_CHUNK_FRAMES;
+
+    if (!cache->chunks[chunk]) {
+      cache->chunks[chunk] = malloc(MUSIC_CHUNK_FRAMES * 4);
+
+      if (!cache->chunks[chunk]) {
+        cache->truncated = true;
+        return false;
+      }
+    }
+
+    cache->render(cache->chunks[chunk] + offset * 2, MUSIC_RENDER_FRAMES);
+    cache->rendered += MUSIC_RENDER_FRAMES;
+    frames -= MUSIC_RENDER_FRAMES;
+
+    SDL_AtomicSet(&cache->frames, cache->rendered);
+
+    if (cache->finished())
+      return false;
+  }
+
+  return true;
+}
+
+// Delta filter each channel and deflate; runs on the render thread
+static void dsda_CompressMusicCache(dsda_music_cache_t* cache) {
+  z_stream stream;
+  music_cache_header_t header;
+  short* filtered;
+  short previous[2] = { 0, 0 };
+  size_t capacity;
+  int frame, result;
+
+  filtered = malloc(MUSIC_CHUNK_FRAMES * 4);
+  capacity = sizeof(header) + compressBound((uLong) cache->rendered * 4);
+  cache->file_data = malloc(capacity);
+
+  memset(&stream, 0, sizeof(stream));
+
+  if (!filtered || !cache->file_data || deflateInit(&stream, Z_BEST_SPEED) != Z_OK) {
+    free(filtered);
+    free(cache->file_data);
+    cache->file_data = NULL;
+    return;
+  }
+
+  stream.next_out = cache->file_data + sizeof(header);
+  stream.avail_out = capacity - sizeof(header);
+
+  result = Z_OK;
+  for (frame = 0; frame < cache->rendered && result == Z_OK; frame += MUSIC_CHUNK_FRAMES) {
+    const short* source = cache->chunks[frame / MUSIC_CHUNK_FRAMES];
+    int i, count;
+
+    count = MIN(MUSIC_CHUNK_FRAMES, cache->rendered - frame);
+
+    for (i = 0; i < count * 2; ++i) {
+      filtered[i] = source[i] - previous[i & 1];
+      previous[i & 1] = source[i];
+    }
+
+    stream.next_in = (Bytef*) filtered;
+    stream.avail_in = count * 4;
+    result = deflate(&stream, frame + count == cache->rendered ? Z_FINISH : Z_NO_FLUSH);
+
+    // The output can't run short of the bound, but filtered is reused
+    if (stream.avail_in)
+      result = Z_BUF_ERROR;
+  }
+
+  deflateEnd(&stream);
+  free(filtered);
+
+  if (result != Z_STREAM_END) {
+    free(cache->file_data);
+    cache->file_data = NULL;
+    return;
+  }
+
+  memcpy(header.magic, music_cache_magic, sizeof(music_cache_magic));
+  header.frames = cache->rendered;
+  memcpy(cache->file_data, &header, sizeof(header));
+  cache->file_length = sizeof(header) + stream.total_out;
+}
+
+static void dsda_CompleteMusicRender(dsda_music_cache_t* cache) {
+  SDL_AtomicSet(&cache->complete, 1);
+
+  if (!cache->truncated)
+    dsda_CompressMusicCache(cache);
+}
+
+static dboolean dsda_MusicRenderAhead(dsda_music_cache_t* cache) {
+  return cache->rendered - SDL_AtomicGet(&cache->played) >= cache->ahead_frames;
+}
+
+// Runs on its own thread, so a song that plays for minutes doesn't hold
+// a pool worker, and only renders what playback is about to need
+static int SDLCALL dsda_RenderMusicThread(void* data) {
+  dsda_music_cache_t* cache = data;
+
+  while (!SDL_AtomicGet(&cache->abort)) {
+    if (dsda_MusicRenderAhead(cache)) {
+      // The timeout covers a signal sent between the check and the wait
+      SDL_LockMutex(cache->pace_mutex);
+      if (!SDL_AtomicGet(&cache->abort) && dsda_MusicRenderAhead(cache))
+        SDL_CondWaitTimeout(cache->pace_cond, cache->pace_mutex, 100);
+      SDL_UnlockMutex(cache->pace_mutex);
+      continue;
+    }
+
+    if (!dsda_RenderMusicFrames(cache, MUSIC_RENDER_FRAMES)) {
+      dsda_CompleteMusicRender(cache);
+      break;
+    }
+  }
+
+  return 0;
+}
+
+// The player must be playing the song, without looping, at full volume.
+// It belongs to the render until dsda_FinishMusicRender.
+// Returns false if the render thread can't be started; stop the player
+// and close the cache then.
+dboolean dsda_StartMusicRender(dsda_music_cache_t* cache,
+                               dsda_music_render_t render, dsda_music_finished_t finished) {
+  cache->render = render;
+  cache->finished = finished;
+
+  if (!dsda_RenderMusicFrames(cache, MUSIC_LEAD_FRAMES)) {
+    cache->started = true;
+    dsda_CompleteMusicRender(cache);
+    return true;
+  }
+
+  cache->pace_mutex = SDL_CreateMutex();
+  cache->pace_cond = SDL_CreateCond();
+
+  if (cache->pace_mutex && cache->pace_cond)
+    cache->thread = SDL_CreateThread(dsda_RenderMusicThread, "dsda_RenderMusicThread", cache);
+
+  if (!cache->thread) {
+    lprintf(LO_WARN, "dsda_StartMusicRender: unable to start the render thread: %s\n",
+            SDL_GetError());
+    return false;
+  }
+
+  cache->started = true;
+
+  return true;
+}
+
+// Returns true if the player was rendering (and needs to be stopped)
+dboolean dsda_FinishMusicRender(dsda_music_cache_t* cache) {
+  if (!cache->started)
+    return false;
+
+  if (cache->thread) {
+    SDL_AtomicSet(&cache->abort, 1);
+
+    SDL_LockMutex(cache->pace_mutex);
+    SDL_CondSignal(cache->pace_cond);
+    SDL_UnlockMutex(cache->pace_mutex);
+
+    SDL_WaitThread(cache->thread, NULL);
+    cache->thread = NULL;
+  }
+
+  cache->started = false;
+
+  return true;
+}
+
+void dsda_CloseMusicCache(dsda_music_cache_t* cache) {
+  int i;
+
+  if (cache->file_data) {
+    dsda_LimitStartupCacheTable("music", MUSIC_CACHE_LIMIT, cache->file_length);
+
+    if (!M_WriteFile(cache->file, cache->file_data, cache->file_length))
+      lprintf(LO_WARN, "dsda_CloseMusicCache: unable to write %s\n", cache->file);
+
+    free(cache->file_data);
+  }
+
+  if (cache->block)
+    free(cache->block);
+  else
+    for (i = 0; i * MUSIC_CHUNK_FRAMES < cache->max_frames; ++i)
+      free(cache->chunks[i]);
+
+  // The callback may have signalled these until the cache was detached
+  if (cache->pace_cond)
+    SDL_DestroyCond(cache->pace_cond);
+
+  if (cache->pace_mutex)
+    SDL_DestroyMutex(cache->pace_mutex);
+
+  Z_Free(cache->chunks);
+  Z_Free(cache->file);
+  Z_Free(cache);
+}
+
+void dsda_PlayMusicCache(dsda_music_cache_t* cache, int looping) {
+  cache->position = 0;
+  cache->playing = true;
+  cache->looping = looping;
+}
+
+void dsda_PauseMusicCache(dsda_music_cache_t* cache) {
+  cache->paused = true;
+}
+
+void dsda_ResumeMusicCache(dsda_music_cache_t* cache) {
+  cache->paused = false;
+}
+
+void dsda_StopMusicCache(dsda_music_cache_t* cache) {
+  cache->playing = false;
+}
+
+// Same 0 - 15 range as the players
+void dsda_SetMusicCacheVolume(dsda_music_cache_t* cache, int volume) {
+  cache->volume_scale = volume * 65536 / 15;
+}
+
+void dsda_ReadMusicCache(dsda_music_cache_t* cache, void* dest, unsigned frames) {
+  short* out = dest;
+  int complete, available;
+
+  // The frame count is final once complete is set
+  complete = SDL_AtomicGet(&cache->complete);
+  available = SDL_AtomicGet(&cache->frames);
+
+  while (frames && cache->playing && !cache->paused) {
+    const short* source;
+    int i, count, offset;
+
+    if (cache->position >= available) {
+      // If the render fell behind, wait for it rather than skip ahead
+      if (!complete)
+        break;
+
+      if (!cache->looping) {
+        cache->playing = false;
+        break;
+      }
+
+      cache->position = 0;
+    }
+
+    offset = cache->position % MUSIC_CHUNK_FRAMES;
+    source = cache->chunks[cache->position / MUSIC_CHUNK_FRAMES] + offset * 2;
+
+    count = MIN((int) frames, available - cache->position);
+    count = MIN(count, MUSIC_CHUNK_FRAMES - offset);
+
+    for (i = 0; i < count * 2; ++i)
+      out[i] = (short) ((source[i] * cache->volume_scale) >> 16);
+
+    out += count * 2;
+    frames -= count;
+    cache->position += count;
+  }
+
+  // Let the render thread catch up with playback
+  if (!complete && cache->pace_cond) {
+    SDL_AtomicSet(&cache->played, cache->position);
+    SDL_CondSignal(cache->pace_cond);
+  }
+
+  memset(out, 0, frames * 4);
+}
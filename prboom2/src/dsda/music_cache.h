@@ -0,0 +1,46 @@
+//
+// Copyright(C) 2023 by Ryan Krafnick
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	DSDA Music Cache
+//
+
+#ifndef __DSDA_MUSIC_CACHE__
+#define __DSDA_MUSIC_CACHE__
+
+#include "doomtype.h"
+
+#include "dsda/startup_cache.h"
+
+typedef struct dsda_music_cache_s dsda_music_cache_t;
+
+typedef void (*dsda_music_render_t)(void* dest, unsigned frames);
+typedef int (*dsda_music_finished_t)(void);
+
+dsda_music_cache_t* dsda_OpenMusicCache(dsda_startup_cache_t* key, int samplerate);
+dboolean dsda_MusicCacheReady(dsda_music_cache_t* cache);
+dboolean dsda_MusicCacheRendering(dsda_music_cache_t* cache);
+dboolean dsda_StartMusicRender(dsda_music_cache_t* cache,
+                               dsda_music_render_t render, dsda_music_finished_t finished);
+dboolean dsda_FinishMusicRender(dsda_music_cache_t* cache);
+void dsda_CloseMusicCache(dsda_music_cache_t* cache);
+
+// Call these and dsda_ReadMusicCache with the music lock held
+void dsda_PlayMusicCache(dsda_music_cache_t* cache, int looping);
+void dsda_PauseMusicCache(dsda_music_cache_t* cache);
+void dsda_ResumeMusicCache(dsda_music_cache_t* cache);
+void dsda_StopMusicCache(dsda_music_cache_t* cache);
+void dsda_SetMusicCacheVolume(dsda_music_cache_t* cache, int volume);
+void dsda_ReadMusicCache(dsda_music_cache_t* cache, void* dest, unsigned frames);
+
+#endif
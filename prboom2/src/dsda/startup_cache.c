@@ -0,0 +1,320 @@
+//
+// Copyright(C) 2023 by Ryan Krafnick
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	DSDA Startup Cache
+//
+//	Stores tables that are slow to derive at startup. Each table is
+//	keyed by the checksum of exactly the data it is derived from, so
+//	a cache file can only ever match identical inputs.
+//
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef _MSC_VER
+#include <io.h>
+#endif
+
+#include "i_glob.h"
+#include "lprintf.h"
+#include "m_file.h"
+#include "w_wad.h"
+#include "z_zone.h"
+
+#include "dsda/args.h"
+#include "dsda/data_organizer.h"
+#include "dsda/thread_pool.h"
+#include "dsda/utility.h"
+
+#include "startup_cache.h"
+
+// Bump this whenever the cached data or the code that produces it changes
+#define STARTUP_CACHE_VERSION 1
+
+static const char startup_cache_magic[8] = "DSDASTC";
+
+static char* startup_cache_dir;
+
+typedef struct {
+  byte digest[16];
+  dboolean valid;
+} wad_cksum_t;
+
+static wad_cksum_t* wad_cksums;
+static size_t wad_cksum_count;
+
+static void dsda_InitStartupCacheDir(void) {
+  int length;
+  const char* data_root;
+
+  data_root = dsda_DataRoot();
+
+  length = strlen(data_root) + 15; // "/startup_cache\0"
+  startup_cache_dir = Z_Malloc(length);
+  snprintf(startup_cache_dir, length, "%s/startup_cache", data_root);
+
+  M_MakeDir(startup_cache_dir, true);
+}
+
+void dsda_OpenStartupCache(dsda_startup_cache_t* cache, const char* table) {
+  int version = STARTUP_CACHE_VERSION;
+
+  cache->table = table;
+  cache->file = NULL;
+
+  MD5Init(&cache->md5);
+  MD5Update(&cache->md5, (const byte*) &version, sizeof(version));
+  MD5Update(&cache->md5, (const byte*) table, strlen(table));
+}
+
+void dsda_HashStartupCacheData(dsda_startup_cache_t* cache, const void* data, int length) {
+  MD5Update(&cache->md5, (const byte*) &length, sizeof(length));
+  MD5Update(&cache->md5, data, length);
+}
+
+void dsda_HashStartupCacheLump(dsda_startup_cache_t* cache, int lump) {
+  dsda_HashStartupCacheData(cache, W_LumpByNum(lump), W_LumpLength(lump));
+}
+
+#define WAD_HASH_BUFFER_SIZE (1024 * 1024)
+
+// Runs on the thread pool: each task reads through its own wad's handle
+static void dsda_HashWadFile(int index, void* data) {
+  wadfile_info_t* wadfile = &wadfiles[index];
+  wad_cksum_t* wad_cksum = &wad_cksums[index];
+  struct MD5Context md5;
+
+  MD5Init(&md5);
+  wad_cksum->valid = true;
+
+  if (wadfile->data) {
+    MD5Update(&md5, wadfile->data, wadfile->length);
+  }
+  else if (wadfile->handle > 0) {
+    byte* buffer;
+    int length = 0;
+
+    buffer = malloc(WAD_HASH_BUFFER_SIZE);
+
+    if (!buffer || lseek(wadfile->handle, 0, SEEK_SET) < 0)
+      wad_cksum->valid = false;
+    else
+      while ((length = read(wadfile->handle, buffer, WAD_HASH_BUFFER_SIZE)) > 0)
+        MD5Update(&md5, buffer, length);
+
+    if (length < 0)
+      wad_cksum->valid = false;
+
+    free(buffer);
+  }
+
+  MD5Final(wad_cksum->digest, &md5);
+}
+
+// Hashes the ordered checksums of every loaded wad, which covers the whole
+//   lump directory and every lump in it. The file name matters as well,
+//   since single lump files are named after it.
+dboolean dsda_HashStartupCacheWads(dsda_startup_cache_t* cache) {
+  size_t i;
+
+  if (wad_cksum_count != numwadfiles) {
+    Z_Free(wad_cksums);
+    wad_cksums = Z_Calloc(numwadfiles, sizeof(*wad_cksums));
+    wad_cksum_count = numwadfiles;
+
+    dsda_ParallelFor((int) numwadfiles, dsda_HashWadFile, NULL);
+  }
+
+  for (i = 0; i < wad_cksum_count; ++i) {
+    const char* name;
+    int src;
+
+    if (!wad_cksums[i].valid)
+      return false;
+
+    name = dsda_BaseName(wadfiles[i].name);
+    src = wadfiles[i].src;
+
+    dsda_HashStartupCacheData(cache, name, strlen(name));
+    dsda_HashStartupCacheData(cache, &src, sizeof(src));
+    dsda_HashStartupCacheData(cache, wad_cksums[i].digest, sizeof(wad_cksums[i].digest));
+  }
+
+  return true;
+}
+
+static void dsda_FinishStartupCacheKey(dsda_startup_cache_t* cache) {
+  int length;
+  dsda_cksum_t cksum;
+
+  if (cache->file)
+    return;
+
+  MD5Final(cksum.bytes, &cache->md5);
+  dsda_TranslateCheckSum(&cksum);
+
+  if (!startup_cache_dir)
+    dsda_InitStartupCacheDir();
+
+  length = strlen(startup_cache_dir) + strlen(cache->table) + 39; // "/<table>-<cksum (32)>.bin\0"
+  cache->file = Z_Malloc(length);
+  snprintf(cache->file, length, "%s/%s-%s.bin", startup_cache_dir, cache->table, cksum.string);
+}
+
+// For tables with their own file format
+const char* dsda_StartupCacheFile(dsda_startup_cache_t* cache) {
+  dsda_FinishStartupCacheKey(cache);
+
+  return cache->file;
+}
+
+// Returns the cached table and its length, if it exists
+void* dsda_ReadStartupCacheTable(dsda_startup_cache_t* cache, int* length) {
+  int file_length;
+  byte* buffer = NULL;
+  void* data;
+
+  dsda_FinishStartupCacheKey(cache);
+
+  if (dsda_Flag(dsda_arg_nocache))
+    return NULL;
+
+  file_length = M_ReadFile(cache->file, &buffer);
+
+  if (file_length < (int) sizeof(startup_cache_magic) ||
+      memcmp(buffer, startup_cache_magic, sizeof(startup_cache_magic))) {
+    if (buffer && file_length >= 0)
+      lprintf(LO_WARN, "dsda_ReadStartupCache: ignoring invalid cache %s\n", cache->file);
+
+    Z_Free(buffer);
+
+    return NULL;
+  }
+
+  *length = file_length - sizeof(startup_cache_magic);
+  data = Z_Malloc(*length);
+  memcpy(data, buffer + sizeof(startup_cache_magic), *length);
+  Z_Free(buffer);
+
+  return data;
+}
+
+// Returns the cached table if it exists and has the expected length
+void* dsda_ReadStartupCache(dsda_startup_cache_t* cache, int length) {
+  int file_length;
+  void* data;
+
+  data = dsda_ReadStartupCacheTable(cache, &file_length);
+
+  if (data && file_length != length) {
+    lprintf(LO_WARN, "dsda_ReadStartupCache: ignoring invalid cache %s\n", cache->file);
+    Z_Free(data);
+
+    return NULL;
+  }
+
+  return data;
+}
+
+void dsda_WriteStartupCache(dsda_startup_cache_t* cache, const void* data, int length) {
+  byte* buffer;
+
+  dsda_FinishStartupCacheKey(cache);
+
+  buffer = Z_Malloc(sizeof(startup_cache_magic) + length);
+  memcpy(buffer, startup_cache_magic, sizeof(startup_cache_magic));
+  memcpy(buffer + sizeof(startup_cache_magic), data, length);
+
+  if (!M_WriteFile(cache->file, buffer, sizeof(startup_cache_magic) + length))
+    lprintf(LO_WARN, "dsda_WriteStartupCache: unable to write %s\n", cache->file);
+
+  Z_Free(buffer);
+}
+
+typedef struct {
+  char* name;
+  size_t size;
+  time_t mtime;
+} startup_cache_file_t;
+
+static int dsda_CompareStartupCacheFiles(const void* a, const void* b) {
+  const startup_cache_file_t* file_a = a;
+  const startup_cache_file_t* file_b = b;
+
+  return (file_a->mtime > file_b->mtime) - (file_a->mtime < file_b->mtime);
+}
+
+// Deletes the oldest files of a table until they and a new file of the
+// given length fit in limit bytes
+void dsda_LimitStartupCacheTable(const char* table, size_t limit, size_t length) {
+  startup_cache_file_t* files = NULL;
+  int count = 0, capacity = 0, i;
+  size_t total = length;
+  int pattern_length;
+  char* pattern;
+  const char* name;
+  glob_t* glob;
+
+  if (!startup_cache_dir)
+    dsda_InitStartupCacheDir();
+
+  pattern_length = strlen(table) + 7; // "<table>-*.bin\0"
+  pattern = Z_Malloc(pattern_length);
+  snprintf(pattern, pattern_length, "%s-*.bin", table);
+  glob = I_StartGlob(startup_cache_dir, pattern, 0);
+  Z_Free(pattern);
+
+  if (!glob)
+    return;
+
+  while ((name = I_NextGlob(glob))) {
+    startup_cache_file_t file;
+
+    if (!M_FileInfo(name, &file.size, &file.mtime))
+      continue;
+
+    if (count == capacity) {
+      capacity = capacity ? capacity * 2 : 64;
+      files = Z_Realloc(files, capacity * sizeof(*files));
+    }
+
+    file.name = Z_Strdup(name);
+    files[count++] = file;
+    total += file.size;
+  }
+
+  I_EndGlob(glob);
+
+  qsort(files, count, sizeof(*files), dsda_CompareStartupCacheFiles);
+
+  for (i = 0; i < count; ++i) {
+    if (total > limit && !M_remove(files[i].name))
+      total -= files[i].size;
+
+    Z_Free(files[i].name);
+  }
+
+  Z_Free(files);
+}
+
+void dsda_CloseStartupCache(dsda_startup_cache_t* cache) {
+  Z_Free(cache->file);
+  cache->file = NULL;
+}
@@ -0,0 +1,41 @@
+//
+// Copyright(C) 2023 by Ryan Krafnick
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	DSDA Startup Cache
+//
+
+#ifndef __DSDA_STARTUP_CACHE__
+#define __DSDA_STARTUP_CACHE__
+
+#include "doomtype.h"
+#include "md5.h"
+
+typedef struct {
+  const char* table;
+  struct MD5Context md5;
+  char* file;
+} dsda_startup_cache_t;
+
+void dsda_OpenStartupCache(dsda_startup_cache_t* cache, const char* table);
+void dsda_HashStartupCacheData(dsda_startup_cache_t* cache, const void* data, int length);
+void dsda_HashStartupCacheLump(dsda_startup_cache_t* cache, int lump);
+dboolean dsda_HashStartupCacheWads(dsda_startup_cache_t* cache);
+const char* dsda_StartupCacheFile(dsda_startup_cache_t* cache);
+void* dsda_ReadStartupCacheTable(dsda_startup_cache_t* cache, int* length);
+void* dsda_ReadStartupCache(dsda_startup_cache_t* cache, int length);
+void dsda_WriteStartupCache(dsda_startup_cache_t* cache, const void* data, int length);
+void dsda_LimitStartupCacheTable(const char* table, size_t limit, size_t length);
+void dsda_CloseStartupCache(dsda_startup_cache_t* cache);
+
+#endif
@@ -0,0 +1,145 @@
+//
+// Copyright(C) 2023 by Ryan Krafnick
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	DSDA Startup Report
+//
+//	Each phase runs until the next one starts. With -startup_report,
+//	the wall time and zone allocations of every phase are printed as
+//	a table, or written as json when a file name is given.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "i_system.h"
+#include "lprintf.h"
+#include "m_file.h"
+#include "z_zone.h"
+
+#include "dsda/args.h"
+#include "dsda/time.h"
+
+#include "startup_report.h"
+
+typedef struct {
+  const char* name;
+  unsigned long long time;
+  unsigned long long allocated;
+} startup_phase_t;
+
+static startup_phase_t* startup_phases;
+static int startup_phase_count;
+static unsigned long long start_allocated;
+static unsigned long long phase_allocated;
+static unsigned long long total_time;
+
+static void dsda_EndStartupPhase(void) {
+  startup_phase_t* phase;
+  unsigned long long allocated;
+
+  if (!startup_phase_count)
+    return;
+
+  phase = &startup_phases[startup_phase_count - 1];
+  allocated = Z_TotalAllocated();
+
+  phase->time = dsda_ElapsedTime(dsda_timer_startup);
+  phase->allocated = allocated - phase_allocated;
+  phase_allocated = allocated;
+  total_time += phase->time;
+}
+
+void dsda_StartupPhase(const char* name) {
+  if (!dsda_Flag(dsda_arg_startup_report))
+    return;
+
+  dsda_EndStartupPhase();
+
+  startup_phases = Z_Realloc(startup_phases, (startup_phase_count + 1) * sizeof(*startup_phases));
+  startup_phases[startup_phase_count].name = name;
+  startup_phase_count++;
+
+  if (startup_phase_count == 1)
+    start_allocated = phase_allocated = Z_TotalAllocated();
+
+  dsda_StartTimer(dsda_timer_startup);
+}
+
+static int dsda_ComparePhaseTime(const void* a, const void* b) {
+  const startup_phase_t* phase_a = a;
+  const startup_phase_t* phase_b = b;
+
+  if (phase_a->time == phase_b->time)
+    return 0;
+
+  return phase_a->time < phase_b->time ? 1 : -1;
+}
+
+static void dsda_WriteStartupReport(const char* report) {
+  FILE* file;
+  int i;
+
+  file = M_OpenFile(report, "w");
+  if (!file)
+    I_Error("Unable to open %s for writing", report);
+
+  fprintf(file, "{\n");
+  fprintf(file, "  \"total_time\": %.3f,\n", (double) total_time / 1000);
+  fprintf(file, "  \"total_allocated\": %llu,\n", phase_allocated - start_allocated);
+  fprintf(file, "  \"phases\": [");
+
+  for (i = 0; i < startup_phase_count; ++i)
+    fprintf(file, "%s\n    { \"name\": \"%s\", \"time\": %.3f, \"allocated\": %llu }",
+            i ? "," : "", startup_phases[i].name,
+            (double) startup_phases[i].time / 1000, startup_phases[i].allocated);
+
+  fprintf(file, "\n  ]\n}\n");
+  fclose(file);
+}
+
+static void dsda_PrintStartupReport(void) {
+  int i;
+
+  lprintf(LO_INFO, "Startup report:\n");
+  lprintf(LO_INFO, "  %-28s %10s %12s\n", "phase", "time (ms)", "alloc (KB)");
+
+  for (i = 0; i < startup_phase_count; ++i)
+    lprintf(LO_INFO, "  %-28s %10.2f %12llu\n", startup_phases[i].name,
+            (double) startup_phases[i].time / 1000, startup_phases[i].allocated / 1024);
+
+  lprintf(LO_INFO, "  %-28s %10.2f %12llu\n", "total",
+          (double) total_time / 1000, (phase_allocated - start_allocated) / 1024);
+}
+
+void dsda_FinishStartupReport(void) {
+  dsda_arg_t* arg;
+
+  arg = dsda_Arg(dsda_arg_startup_report);
+  if (!arg->found || !startup_phase_count)
+    return;
+
+  dsda_EndStartupPhase();
+
+  // Phases keep their order in the json, the table shows the slowest first
+  if (arg->count)
+    dsda_WriteStartupReport(arg->value.v_string_array[0]);
+  else {
+    qsort(startup_phases, startup_phase_count, sizeof(*startup_phases), dsda_ComparePhaseTime);
+    dsda_PrintStartupReport();
+  }
+
+  Z_Free(startup_phases);
+  startup_phases = NULL;
+  startup_phase_count = 0;
+}
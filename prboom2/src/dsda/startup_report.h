@@ -0,0 +1,24 @@
+//
+// Copyright(C) 2023 by Ryan Krafnick
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	DSDA Startup Report
+//
+
+#ifndef __DSDA_STARTUP_REPORT__
+#define __DSDA_STARTUP_REPORT__
+
+void dsda_StartupPhase(const char* name);
+void dsda_FinishStartupReport(void);
+
+#endif
@@ -0,0 +1,279 @@
+//
+// Copyright(C) 2023 by Ryan Krafnick
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	DSDA Thread Pool
+//
+
+#include <stdlib.h>
+
+#include "SDL.h"
+
+#include "doomtype.h"
+#include "lprintf.h"
+
+#include "thread_pool.h"
+
+#define MAX_POOL_THREADS 16
+
+struct dsda_task_s {
+  dsda_task_func_t func;
+  void* data;
+  dboolean started;
+  dboolean done;
+  struct dsda_task_s* next;
+};
+
+typedef struct {
+  dsda_range_func_t func;
+  void* data;
+  int index;
+} range_task_t;
+
+static SDL_mutex* pool_mutex;
+static SDL_cond* pool_work_cond;
+static SDL_cond* pool_done_cond;
+static dsda_task_t* pool_head;
+static dsda_task_t* pool_tail;
+static int pool_thread_count = -1;
+static int pool_busy_count;
+
+static dsda_task_t* dsda_PopTask(void) {
+  dsda_task_t* task;
+
+  task = pool_head;
+  pool_head = task->next;
+  if (!pool_head)
+    pool_tail = NULL;
+
+  task->started = true;
+  ++pool_busy_count;
+
+  return task;
+}
+
+static void dsda_CompleteTask(dsda_task_t* task) {
+  SDL_LockMutex(pool_mutex);
+  task->done = true;
+  --pool_busy_count;
+  SDL_CondBroadcast(pool_done_cond);
+  SDL_UnlockMutex(pool_mutex);
+}
+
+static int dsda_PoolWorker(void* unused) {
+  while (1) {
+    dsda_task_t* task;
+
+    SDL_LockMutex(pool_mutex);
+
+    while (!pool_head)
+      SDL_CondWait(pool_work_cond, pool_mutex);
+
+    task = dsda_PopTask();
+
+    SDL_UnlockMutex(pool_mutex);
+
+    task->func(task->data);
+
+    dsda_CompleteTask(task);
+  }
+
+  return 0;
+}
+
+static void dsda_InitThreadPool(void) {
+  int i, count;
+
+  pool_thread_count = 0;
+
+  count = SDL_GetCPUCount() - 1;
+  if (count > MAX_POOL_THREADS)
+    count = MAX_POOL_THREADS;
+
+  if (count <= 0)
+    return;
+
+  pool_mutex = SDL_CreateMutex();
+  pool_work_cond = SDL_CreateCond();
+  pool_done_cond = SDL_CreateCond();
+
+  if (!pool_mutex || !pool_work_cond || !pool_done_cond) {
+    lprintf(LO_WARN, "dsda_InitThreadPool: %s\n", SDL_GetError());
+    return;
+  }
+
+  for (i = 0; i < count; ++i) {
+    SDL_Thread* thread;
+
+    thread = SDL_CreateThread(dsda_PoolWorker, "dsda_PoolWorker", NULL);
+
+    if (!thread) {
+      lprintf(LO_WARN, "dsda_InitThreadPool: %s\n", SDL_GetError());
+      break;
+    }
+
+    // The workers live until the process exits
+    SDL_DetachThread(thread);
+    ++pool_thread_count;
+  }
+}
+
+// Includes the calling thread, which helps with queued tasks while it waits
+int dsda_ThreadPoolSize(void) {
+  if (pool_thread_count < 0)
+    dsda_InitThreadPool();
+
+  return pool_thread_count + 1;
+}
+
+dsda_task_t* dsda_StartTask(dsda_task_func_t func, void* data) {
+  dsda_task_t* task;
+
+  task = calloc(1, sizeof(*task));
+  if (!task)
+    I_Error("dsda_StartTask: out of memory");
+
+  task->func = func;
+  task->data = data;
+
+  if (dsda_ThreadPoolSize() == 1) {
+    task->started = true;
+    func(data);
+    task->done = true;
+
+    return task;
+  }
+
+  SDL_LockMutex(pool_mutex);
+
+  if (pool_tail)
+    pool_tail->next = task;
+  else
+    pool_head = task;
+  pool_tail = task;
+
+  SDL_CondSignal(pool_work_cond);
+  SDL_UnlockMutex(pool_mutex);
+
+  return task;
+}
+
+void dsda_FinishTask(dsda_task_t* task) {
+  dboolean run_here = false;
+
+  if (dsda_ThreadPoolSize() == 1) {
+    // Only possible for a task queued before dsda_DisableThreadPool
+    if (!task->started)
+      task->func(task->data);
+
+    free(task);
+    return;
+  }
+
+  SDL_LockMutex(pool_mutex);
+
+  // A task nobody picked up yet runs on the waiting thread
+  if (!task->started) {
+    dsda_task_t* prev = NULL;
+    dsda_task_t* cur;
+
+    for (cur = pool_head; cur != task; cur = cur->next)
+      prev = cur;
+
+    if (prev)
+      prev->next = task->next;
+    else
+      pool_head = task->next;
+
+    if (pool_tail == task)
+      pool_tail = prev;
+
+    task->started = true;
+    run_here = true;
+  }
+  else {
+    while (!task->done)
+      SDL_CondWait(pool_done_cond, pool_mutex);
+  }
+
+  SDL_UnlockMutex(pool_mutex);
+
+  if (run_here)
+    task->func(task->data);
+
+  free(task);
+}
+
+// Waits until no queued or running tasks remain
+void dsda_WaitThreadPool(void) {
+  if (dsda_ThreadPoolSize() == 1)
+    return;
+
+  SDL_LockMutex(pool_mutex);
+
+  while (pool_head || pool_busy_count)
+    SDL_CondWait(pool_done_cond, pool_mutex);
+
+  SDL_UnlockMutex(pool_mutex);
+}
+
+// For a forked child: the pool threads were not copied, and the mutex
+//   may have been held by one of them, so everything runs inline from here
+void dsda_DisableThreadPool(void) {
+  pool_thread_count = 0;
+  pool_head = NULL;
+  pool_tail = NULL;
+}
+
+static void dsda_RunRangeTask(void* data) {
+  range_task_t* range_task = data;
+
+  range_task->func(range_task->index, range_task->data);
+}
+
+// Runs func(0 .. count - 1) across the pool and returns when all are done
+void dsda_ParallelFor(int count, dsda_range_func_t func, void* data) {
+  int i;
+  range_task_t* range_tasks;
+  dsda_task_t** tasks;
+
+  if (count <= 0)
+    return;
+
+  if (count == 1 || dsda_ThreadPoolSize() == 1) {
+    for (i = 0; i < count; ++i)
+      func(i, data);
+
+    return;
+  }
+
+  range_tasks = malloc(count * sizeof(*range_tasks));
+  tasks = malloc(count * sizeof(*tasks));
+  if (!range_tasks || !tasks)
+    I_Error("dsda_ParallelFor: out of memory");
+
+  for (i = 1; i < count; ++i) {
+    range_tasks[i].func = func;
+    range_tasks[i].data = data;
+    range_tasks[i].index = i;
+    tasks[i] = dsda_StartTask(dsda_RunRangeTask, &range_tasks[i]);
+  }
+
+  func(0, data);
+
+  for (i = 1; i < count; ++i)
+    dsda_FinishTask(tasks[i]);
+
+  free(range_tasks);
+  free(tasks);
+}
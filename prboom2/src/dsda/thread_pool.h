@@ -0,0 +1,36 @@
+//
+// Copyright(C) 2023 by Ryan Krafnick
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	DSDA Thread Pool
+//
+//	Tasks run on background threads, so they must not touch the zone
+//	allocator, the console, or any other shared engine state.
+//
+
+#ifndef __DSDA_THREAD_POOL__
+#define __DSDA_THREAD_POOL__
+
+typedef struct dsda_task_s dsda_task_t;
+
+typedef void (*dsda_task_func_t)(void* data);
+typedef void (*dsda_range_func_t)(int index, void* data);
+
+int dsda_ThreadPoolSize(void);
+dsda_task_t* dsda_StartTask(dsda_task_func_t func, void* data);
+void dsda_FinishTask(dsda_task_t* task);
+void dsda_ParallelFor(int count, dsda_range_func_t func, void* data);
+void dsda_WaitThreadPool(void);
+void dsda_DisableThreadPool(void);
+
+#endif
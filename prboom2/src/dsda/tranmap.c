@@ -24,6 +24,7 @@
 #include "z_zone.h"
 
 #include "dsda/data_organizer.h"
+#include "dsda/thread_pool.h"
 #include "dsda/utility.h"
 
 #include "tranmap.h"
@@ -86,20 +87,32 @@ static void dsda_InitTranMapPaletteDir(void) {
 
 #define TSC 12 /* number of fixed point digits in filter percent */
 
-static byte* dsda_GenerateTranMap(unsigned int alpha) {
-  byte* buffer;
-  const byte* playpal;
+#define TRANMAP_ROW_BLOCKS 16
+
+typedef struct {
   int pal[3][256];
-  int tot[256];
   int pal_w1[3][256];
-  int w1, w2;
+  int tot[256];
+  int w2;
+  byte* buffer;
+} tranmap_generator_t;
 
-  playpal = W_LumpByName("PLAYPAL");
+typedef struct {
+  tranmap_generator_t generator;
+  dsda_task_t* task;
+  char* filename;
+} tranmap_job_t;
 
-  w1 = (alpha << TSC) / 100;
-  w2 = (1l << TSC) - w1;
+static dboolean tranmap_batch_open;
+static tranmap_job_t* tranmap_jobs[100];
+
+static void dsda_InitTranMapGenerator(tranmap_generator_t* gen, const byte* playpal,
+                                      unsigned int alpha, byte* buffer) {
+  int w1;
 
-  buffer = Z_Malloc(tranmap_length);
+  w1 = (alpha << TSC) / 100;
+  gen->w2 = (1l << TSC) - w1;
+  gen->buffer = buffer;
 
   // First, convert playpal into long int type, and transpose array,
   // for fast inner-loop calculations. Precompute tot array.
@@ -109,49 +122,103 @@ static byte* dsda_GenerateTranMap(unsigned int alpha) {
 
     do {
       register int t, d;
-      pal_w1[0][i] = (pal[0][i] = t = p[0]) * w1;
+      gen->pal_w1[0][i] = (gen->pal[0][i] = t = p[0]) * w1;
       d = t * t;
-      pal_w1[1][i] = (pal[1][i] = t = p[1]) * w1;
+      gen->pal_w1[1][i] = (gen->pal[1][i] = t = p[1]) * w1;
       d += t * t;
-      pal_w1[2][i] = (pal[2][i] = t = p[2]) * w1;
+      gen->pal_w1[2][i] = (gen->pal[2][i] = t = p[2]) * w1;
       d += t * t;
       p -= 3;
-      tot[i] = d << (TSC - 1);
+      gen->tot[i] = d << (TSC - 1);
     }
     while (--i >= 0);
   }
+}
 
-  // Next, compute all entries using minimum arithmetic.
-  {
-    int i, j;
-    byte *tp = buffer;
-
-    for (i = 0; i < 256; i++) {
-      int r1 = pal[0][i] * w2;
-      int g1 = pal[1][i] * w2;
-      int b1 = pal[2][i] * w2;
-
-      for (j = 0; j < 256; j++, tp++) {
-        register int color = 255;
-        register int err;
-        int r = pal_w1[0][j] + r1;
-        int g = pal_w1[1][j] + g1;
-        int b = pal_w1[2][j] + b1;
-        int best = INT_MAX;
-
-        do {
-          err = tot[color] - pal[0][color] * r - pal[1][color] * g - pal[2][color] * b;
-          if (err < best) {
-            best = err;
-            *tp = color;
-          }
-        }
-        while (--color >= 0);
-      }
+// Next, compute all entries using minimum arithmetic.
+// The error of every palette color is computed first and then reduced,
+// which lets the compiler vectorize both loops. Ties go to the highest
+// color index, matching the original descending search.
+static void dsda_GenerateTranMapRows(int block, void* data) {
+  tranmap_generator_t* gen = data;
+  const int* pal_r = gen->pal[0];
+  const int* pal_g = gen->pal[1];
+  const int* pal_b = gen->pal[2];
+  const int* tot = gen->tot;
+  int err[256];
+  int i, j;
+
+  for (i = block * (256 / TRANMAP_ROW_BLOCKS); i < (block + 1) * (256 / TRANMAP_ROW_BLOCKS); i++) {
+    byte *tp = gen->buffer + i * 256;
+    int r1 = pal_r[i] * gen->w2;
+    int g1 = pal_g[i] * gen->w2;
+    int b1 = pal_b[i] * gen->w2;
+
+    for (j = 0; j < 256; j++, tp++) {
+      int color;
+      int r = gen->pal_w1[0][j] + r1;
+      int g = gen->pal_w1[1][j] + g1;
+      int b = gen->pal_w1[2][j] + b1;
+      int best = INT_MAX;
+
+      for (color = 0; color < 256; color++)
+        err[color] = tot[color] - pal_r[color] * r - pal_g[color] * g - pal_b[color] * b;
+
+      for (color = 0; color < 256; color++)
+        if (err[color] < best)
+          best = err[color];
+
+      color = 255;
+      while (err[color] != best)
+        color--;
+
+      *tp = color;
     }
   }
+}
+
+static void dsda_GenerateTranMap(void* data) {
+  dsda_ParallelFor(TRANMAP_ROW_BLOCKS, dsda_GenerateTranMapRows, data);
+}
+
+static char* dsda_TranMapFileName(unsigned int alpha) {
+  int length;
+  char* filename;
+
+  if (!tranmap_palette_dir)
+    dsda_InitTranMapPaletteDir();
 
-  return buffer;
+  length = strlen(tranmap_palette_dir) + 16; // "/tranmap_99.dat\0"
+  filename = Z_Malloc(length);
+  snprintf(filename, length, "%s/tranmap_%02d.dat", tranmap_palette_dir, alpha);
+
+  return filename;
+}
+
+// While a batch is open, missing maps are generated concurrently in the
+// background; the returned buffers are filled by dsda_EndTranMapBatch.
+void dsda_BeginTranMapBatch(void) {
+  tranmap_batch_open = true;
+}
+
+void dsda_EndTranMapBatch(void) {
+  int alpha;
+
+  tranmap_batch_open = false;
+
+  for (alpha = 0; alpha < 100; ++alpha) {
+    tranmap_job_t* job = tranmap_jobs[alpha];
+
+    if (!job)
+      continue;
+
+    dsda_FinishTask(job->task);
+    M_WriteFile(job->filename, job->generator.buffer, tranmap_length);
+
+    Z_Free(job->filename);
+    Z_Free(job);
+    tranmap_jobs[alpha] = NULL;
+  }
 }
 
 const byte* dsda_TranMap(unsigned int alpha) {
@@ -164,12 +231,7 @@ const byte* dsda_TranMap(unsigned int alpha) {
   if (!tranmap_data[alpha]) {
     char* filename;
 
-    if (!tranmap_palette_dir)
-      dsda_InitTranMapPaletteDir();
-
-    length = strlen(tranmap_palette_dir) + 16; // "/tranmap_99.dat\0"
-    filename = Z_Malloc(length);
-    snprintf(filename, length, "%s/tranmap_%02d.dat", tranmap_palette_dir, alpha);
+    filename = dsda_TranMapFileName(alpha);
 
     length = M_ReadFile(filename, &buffer);
     if (buffer && length != tranmap_length) {
@@ -178,11 +240,28 @@ const byte* dsda_TranMap(unsigned int alpha) {
     }
 
     if (!buffer) {
-      buffer = dsda_GenerateTranMap(alpha);
+      tranmap_job_t* job;
+
+      buffer = Z_Malloc(tranmap_length);
 
-      M_WriteFile(filename, buffer, tranmap_length);
+      job = Z_Malloc(sizeof(*job));
+      dsda_InitTranMapGenerator(&job->generator, W_LumpByName("PLAYPAL"), alpha, buffer);
+
+      if (tranmap_batch_open) {
+        job->task = dsda_StartTask(dsda_GenerateTranMap, &job->generator);
+        job->filename = filename;
+        tranmap_jobs[alpha] = job;
+        filename = NULL;
+      }
+      else {
+        dsda_GenerateTranMap(&job->generator);
+        M_WriteFile(filename, buffer, tranmap_length);
+        Z_Free(job);
+      }
     }
 
+    Z_Free(filename);
+
     tranmap_data[alpha] = buffer;
   }
 
@@ -22,5 +22,7 @@
 
 const byte* dsda_TranMap(unsigned int alpha);
 const byte* dsda_DefaultTranMap(void);
+void dsda_BeginTranMapBatch(void);
+void dsda_EndTranMapBatch(void);
 
 #endif
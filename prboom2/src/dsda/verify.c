@@ -0,0 +1,450 @@
+//
+// Copyright(C) 2023 by Ryan Krafnick
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	DSDA Verify
+//
+//  Batch demo verification: each manifest entry is played back in its own
+//  child process (-fastdemo -nodraw) on a pool of worker threads, and the
+//  results are collected into a single json report.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "SDL.h"
+#include "SDL_thread.h"
+
+#include "doomstat.h"
+#include "lprintf.h"
+#include "m_file.h"
+#include "z_zone.h"
+
+#include "dsda/analysis.h"
+#include "dsda/args.h"
+#include "dsda/utility.h"
+
+#include "verify.h"
+
+#define VERIFY_LINE_LENGTH 1024
+#define VERIFY_FIELD_LENGTH 64
+
+typedef enum {
+  verify_pending,
+  verify_sync,
+  verify_desync,
+  verify_error,
+} verify_status_t;
+
+static const char* verify_status_names[] = {
+  [verify_pending] = "pending",
+  [verify_sync] = "sync",
+  [verify_desync] = "desync",
+  [verify_error] = "error",
+};
+
+typedef struct {
+  char* iwad;
+  char* pwads;
+  char* lmp;
+  char* expected;
+  dboolean expect_time;
+
+  char* command;
+  char* result_path;
+
+  verify_status_t status;
+  int exit_code;
+  int total_tics;
+  char total_time[VERIFY_FIELD_LENGTH];
+  char category[VERIFY_FIELD_LENGTH];
+  double wall_time;
+} verify_job_t;
+
+static verify_job_t* verify_jobs;
+static int verify_job_count;
+static SDL_atomic_t verify_next_job;
+static SDL_atomic_t verify_finished_jobs;
+static SDL_mutex* verify_print_mutex;
+
+static char* dsda_TrimString(char* str) {
+  char* end;
+
+  while (*str == ' ' || *str == '\t')
+    ++str;
+
+  end = str + strlen(str);
+  while (end > str && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r' || end[-1] == '\n'))
+    --end;
+  *end = '\0';
+
+  return str;
+}
+
+static dboolean dsda_IsVerifyTime(const char* str) {
+  int minutes, seconds;
+  char extra;
+
+  return sscanf(str, "%d:%d%c", &minutes, &seconds, &extra) == 2;
+}
+
+static void dsda_FormatVerifyTime(char* str, size_t size, int tics) {
+  snprintf(str, size, "%d:%02d", tics / TICRATE / 60, (tics % (60 * TICRATE)) / TICRATE);
+}
+
+// Manifest format, one demo per line:
+//   iwad; pwad1 pwad2 ...; lmp; expected
+// The pwad list may be empty. The expected value is either a total time
+//   (as printed by -levelstat, e.g. 17:55) or a category name (e.g. UV Max).
+// Blank lines and lines starting with # are ignored.
+static void dsda_AddVerifyJob(char* line, const char* manifest, int line_number) {
+  char* fields[4];
+  verify_job_t* job;
+  int count;
+
+  // Split by hand - strtok would collapse an empty pwad list
+  for (count = 0; count < 4 && line; ++count) {
+    char* delimiter;
+
+    delimiter = strchr(line, ';');
+    if (delimiter)
+      *delimiter++ = '\0';
+
+    fields[count] = dsda_TrimString(line);
+    line = delimiter;
+  }
+
+  if (count != 4 || line || !fields[0][0] || !fields[2][0] || !fields[3][0])
+    I_Error("%s:%d: expected \"iwad; pwads; lmp; expected\"", manifest, line_number);
+
+  verify_jobs = Z_Realloc(verify_jobs, (verify_job_count + 1) * sizeof(*verify_jobs));
+  job = &verify_jobs[verify_job_count];
+  memset(job, 0, sizeof(*job));
+
+  job->iwad = Z_Strdup(fields[0]);
+  job->pwads = Z_Strdup(fields[1]);
+  job->lmp = Z_Strdup(fields[2]);
+  job->expected = Z_Strdup(fields[3]);
+  job->expect_time = dsda_IsVerifyTime(job->expected);
+  job->total_tics = -1;
+
+  ++verify_job_count;
+}
+
+static void dsda_ReadVerifyManifest(const char* manifest) {
+  char* buffer;
+  char** lines;
+  int i;
+
+  if (M_ReadFileToString(manifest, &buffer) < 0)
+    I_Error("Unable to read verify manifest %s", manifest);
+
+  lines = dsda_SplitString(buffer, "\n");
+
+  for (i = 0; lines[i]; ++i) {
+    char* line;
+
+    line = dsda_TrimString(lines[i]);
+
+    if (!line[0] || line[0] == '#')
+      continue;
+
+    dsda_AddVerifyJob(line, manifest, i + 1);
+  }
+
+  Z_Free(lines);
+  Z_Free(buffer);
+}
+
+static void dsda_BuildVerifyCommand(verify_job_t* job, const char* exe, const char* report, int index) {
+  dsda_string_t command;
+
+  dsda_StringPrintF(&command, "\"%s\" -iwad \"%s\"", exe, job->iwad);
+
+  if (job->pwads[0]) {
+    char* pwads;
+    char** pwad_list;
+    int i;
+
+    pwads = Z_Strdup(job->pwads);
+    pwad_list = dsda_SplitString(pwads, " ");
+
+    dsda_StringCat(&command, " -file");
+    for (i = 0; pwad_list[i]; ++i)
+      dsda_StringCatF(&command, " \"%s\"", pwad_list[i]);
+
+    Z_Free(pwad_list);
+    Z_Free(pwads);
+  }
+
+  job->result_path = Z_Malloc(strlen(report) + 16);
+  sprintf(job->result_path, "%s.%d.tmp", report, index);
+
+  dsda_StringCatF(&command, " -fastdemo \"%s\"", job->lmp);
+  dsda_StringCat(&command, " -nodraw -nosound -nomusic -quiet");
+  dsda_StringCatF(&command, " -verify_result \"%s\"", job->result_path);
+
+#ifdef _WIN32
+  // cmd.exe strips the outer quotes when the command starts with one
+  {
+    dsda_string_t quoted;
+
+    dsda_StringPrintF(&quoted, "\"%s\"", command.string);
+    dsda_FreeString(&command);
+    command = quoted;
+  }
+#endif
+
+  job->command = command.string;
+}
+
+// Runs on worker threads - must not touch the zone allocator
+static void dsda_ReadVerifyResult(verify_job_t* job) {
+  FILE* file;
+  char line[VERIFY_LINE_LENGTH];
+
+  file = fopen(job->result_path, "r");
+  if (!file) {
+    job->status = verify_error;
+    return;
+  }
+
+  while (fgets(line, sizeof(line), file)) {
+    char* value;
+
+    value = strchr(line, ' ');
+    if (!value)
+      continue;
+
+    *value++ = '\0';
+    value[strcspn(value, "\r\n")] = '\0';
+
+    if (!strcmp(line, "total_tics"))
+      job->total_tics = atoi(value);
+    else if (!strcmp(line, "category"))
+      snprintf(job->category, sizeof(job->category), "%s", value);
+  }
+
+  fclose(file);
+  remove(job->result_path);
+
+  if (job->total_tics < 0) {
+    job->status = verify_error;
+    return;
+  }
+
+  dsda_FormatVerifyTime(job->total_time, sizeof(job->total_time), job->total_tics);
+
+  if (job->expect_time)
+    job->status = strcmp(job->total_time, job->expected) ? verify_desync : verify_sync;
+  else
+    job->status = strcasecmp(job->category, job->expected) ? verify_desync : verify_sync;
+}
+
+static int dsda_VerifyWorker(void* data) {
+  Uint64 frequency;
+
+  frequency = SDL_GetPerformanceFrequency();
+
+  while (1) {
+    verify_job_t* job;
+    Uint64 start;
+    int index;
+    int finished;
+
+    index = SDL_AtomicAdd(&verify_next_job, 1);
+    if (index >= verify_job_count)
+      break;
+
+    job = &verify_jobs[index];
+
+    start = SDL_GetPerformanceCounter();
+    job->exit_code = system(job->command);
+    job->wall_time = (double) (SDL_GetPerformanceCounter() - start) / frequency;
+
+    if (job->exit_code)
+      job->status = verify_error;
+    else
+      dsda_ReadVerifyResult(job);
+
+    finished = SDL_AtomicAdd(&verify_finished_jobs, 1) + 1;
+
+    SDL_LockMutex(verify_print_mutex);
+    lprintf(LO_INFO, "[%d/%d] %s: %s (%s, %.1fs)\n",
+            finished, verify_job_count, job->lmp,
+            verify_status_names[job->status],
+            job->expect_time ? job->total_time : job->category,
+            job->wall_time);
+    SDL_UnlockMutex(verify_print_mutex);
+  }
+
+  return 0;
+}
+
+static void dsda_WriteJSONString(FILE* file, const char* str) {
+  fputc('"', file);
+
+  for (; *str; ++str) {
+    if (*str == '"' || *str == '\\')
+      fprintf(file, "\\%c", *str);
+    else if ((unsigned char) *str < 0x20)
+      fprintf(file, "\\u%04x", (unsigned char) *str);
+    else
+      fputc(*str, file);
+  }
+
+  fputc('"', file);
+}
+
+static void dsda_WriteVerifyReport(const char* report, int worker_count, double wall_time) {
+  FILE* file;
+  int counts[4] = { 0 };
+  int i;
+
+  for (i = 0; i < verify_job_count; ++i)
+    ++counts[verify_jobs[i].status];
+
+  file = M_OpenFile(report, "w");
+  if (!file)
+    I_Error("Unable to open %s for writing", report);
+
+  fprintf(file, "{\n");
+  fprintf(file, "  \"workers\": %d,\n", worker_count);
+  fprintf(file, "  \"wall_time\": %.3f,\n", wall_time);
+  fprintf(file, "  \"total\": %d,\n", verify_job_count);
+  fprintf(file, "  \"sync\": %d,\n", counts[verify_sync]);
+  fprintf(file, "  \"desync\": %d,\n", counts[verify_desync]);
+  fprintf(file, "  \"error\": %d,\n", counts[verify_error]);
+  fprintf(file, "  \"demos\": [");
+
+  for (i = 0; i < verify_job_count; ++i) {
+    verify_job_t* job = &verify_jobs[i];
+
+    fprintf(file, "%s\n    {\n", i ? "," : "");
+    fprintf(file, "      \"iwad\": ");
+    dsda_WriteJSONString(file, job->iwad);
+    fprintf(file, ",\n      \"pwads\": ");
+    dsda_WriteJSONString(file, job->pwads);
+    fprintf(file, ",\n      \"lmp\": ");
+    dsda_WriteJSONString(file, job->lmp);
+    fprintf(file, ",\n      \"expected\": ");
+    dsda_WriteJSONString(file, job->expected);
+    fprintf(file, ",\n      \"result\": ");
+    dsda_WriteJSONString(file, verify_status_names[job->status]);
+    fprintf(file, ",\n      \"exit_code\": %d", job->exit_code);
+    fprintf(file, ",\n      \"total_time\": ");
+    dsda_WriteJSONString(file, job->total_time);
+    fprintf(file, ",\n      \"total_tics\": %d", job->total_tics);
+    fprintf(file, ",\n      \"category\": ");
+    dsda_WriteJSONString(file, job->category);
+    fprintf(file, ",\n      \"wall_time\": %.3f\n    }", job->wall_time);
+  }
+
+  fprintf(file, "\n  ]\n}\n");
+  fclose(file);
+
+  lprintf(LO_INFO, "\nVerified %d demos in %.1fs: %d sync, %d desync, %d error\n",
+          verify_job_count, wall_time,
+          counts[verify_sync], counts[verify_desync], counts[verify_error]);
+  lprintf(LO_INFO, "Report written to %s\n", report);
+}
+
+int dsda_VerifyBatch(void) {
+  extern char** dsda_argv;
+  dsda_arg_t* arg;
+  const char* report;
+  SDL_Thread** workers;
+  int worker_count;
+  Uint64 start;
+  double wall_time;
+  int i;
+
+  arg = dsda_Arg(dsda_arg_verify_batch);
+  report = arg->count > 1 ? arg->value.v_string_array[1] : "verify.json";
+
+  dsda_ReadVerifyManifest(arg->value.v_string_array[0]);
+
+  if (!verify_job_count)
+    I_Error("No demos found in verify manifest %s", arg->value.v_string_array[0]);
+
+  for (i = 0; i < verify_job_count; ++i)
+    dsda_BuildVerifyCommand(&verify_jobs[i], dsda_argv[0], report, i);
+
+  worker_count = dsda_SimpleIntArg(dsda_arg_verify_jobs);
+  if (!worker_count)
+    worker_count = SDL_GetCPUCount();
+  if (worker_count > verify_job_count)
+    worker_count = verify_job_count;
+
+  lprintf(LO_INFO, "Verifying %d demos with %d workers\n", verify_job_count, worker_count);
+
+  verify_print_mutex = SDL_CreateMutex();
+  workers = Z_Malloc(worker_count * sizeof(*workers));
+
+  start = SDL_GetPerformanceCounter();
+
+  for (i = 0; i < worker_count; ++i) {
+    workers[i] = SDL_CreateThread(dsda_VerifyWorker, "dsda_VerifyWorker", NULL);
+    if (!workers[i])
+      I_Error("dsda_VerifyBatch: unable to create worker thread (%s)", SDL_GetError());
+  }
+
+  for (i = 0; i < worker_count; ++i)
+    SDL_WaitThread(workers[i], NULL);
+
+  wall_time = (double) (SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+
+  Z_Free(workers);
+  SDL_DestroyMutex(verify_print_mutex);
+
+  dsda_WriteVerifyReport(report, worker_count, wall_time);
+
+  for (i = 0; i < verify_job_count; ++i)
+    if (verify_jobs[i].status != verify_sync)
+      return 1;
+
+  return 0;
+}
+
+void dsda_InitVerifyResult(void) {
+  void M_ForgetCurrentConfig(void);
+  void M_ForgetWadStats(void);
+
+  if (!dsda_Flag(dsda_arg_verify_result))
+    return;
+
+  // Batch workers run side by side - leave shared files alone
+  M_ForgetCurrentConfig();
+  M_ForgetWadStats();
+}
+
+void dsda_WriteVerifyResult(void) {
+  dsda_arg_t* arg;
+  FILE* file;
+
+  arg = dsda_Arg(dsda_arg_verify_result);
+  if (!arg->found)
+    return;
+
+  file = M_OpenFile(arg->value.v_string, "w");
+  if (!file) {
+    lprintf(LO_ERROR, "Unable to open %s for writing\n", arg->value.v_string);
+    return;
+  }
+
+  fprintf(file, "total_tics %d\n", totalleveltimes);
+  fprintf(file, "category %s\n", dsda_DetectCategory());
+
+  fclose(file);
+}
@@ -16,6 +16,8 @@
 //
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <zip.h>
 
 #include "i_system.h"
@@ -25,6 +27,8 @@
 
 #include "dsda/utility.h"
 
+#include "zipfile.h"
+
 static char **temp_dirs;
 
 /* Allow a maximum of 1GB to be uncompressed to prevent zip-bombs */
@@ -56,72 +60,85 @@ static void dsda_WriteContentToFile(zip_file_t *input_file, FILE *dest_file, zip
   }
 }
 
-static void dsda_WriteZippedFilesToDest(zip_t *archive, const char *destination_directory) {
-  zip_int64_t i;
+static void dsda_ReadContent(zip_file_t *input_file, byte *dest, zip_uint64_t data_size) {
+  while (data_size != 0) {
+    zip_int64_t bytes_read;
 
-  for (i = 0; i < zip_get_num_entries(archive, ZIP_FL_UNCHANGED); i++) {
-    dsda_string_t full_path;
-    zip_file_t *zipped_file;
-    zip_stat_t stat;
-    FILE *dest_file;
-    const char *file_name = dsda_BaseName(zip_get_name(archive, i, ZIP_FL_UNCHANGED));
+    bytes_read = zip_fread(input_file, dest, data_size);
+    if (bytes_read <= 0)
+      I_Error("dsda_ReadContent: Unable to read data from archive.");
 
-    /* Intermediate directories have a trailing '/', so their base name is empty */
-    if (*file_name == '\0') {
-      continue;
-    }
+    dest += bytes_read;
+    data_size -= bytes_read;
+    total_bytes_read += bytes_read;
+    if (total_bytes_read >= UNZIPPED_BYTES_LIMIT)
+      I_Error("dsda_ReadContent: Too much data to decompress.");
+  }
+}
 
-    dsda_StringPrintF(&full_path, "%s/%s", destination_directory, file_name);
+static zip_file_t *dsda_OpenZippedFile(zip_t *archive, zip_int64_t index,
+                                       const char *file_name, zip_uint64_t *size) {
+  zip_file_t *zipped_file;
+  zip_stat_t stat;
 
-    zip_stat_index(archive, i, ZIP_FL_UNCHANGED, &stat);
-    if ((stat.valid & ZIP_STAT_SIZE) == 0)
-      I_Error("dsda_WriteZippedFilesToDest: Failed to read size of zipped file %s.", file_name);
+  zip_stat_index(archive, index, ZIP_FL_UNCHANGED, &stat);
+  if ((stat.valid & ZIP_STAT_SIZE) == 0)
+    I_Error("dsda_OpenZippedFile: Failed to read size of zipped file %s.", file_name);
 
-    zipped_file = zip_fopen_index(archive, i, ZIP_FL_UNCHANGED);
-    if (zipped_file == NULL)
-      I_Error("dsda_WriteZippedFilesToDest: Failed to open zipped file %s.", file_name);
+  zipped_file = zip_fopen_index(archive, index, ZIP_FL_UNCHANGED);
+  if (zipped_file == NULL)
+    I_Error("dsda_OpenZippedFile: Failed to open zipped file %s.", file_name);
 
-    dest_file = M_OpenFile(full_path.string, "wb");
-    if (dest_file == NULL)
-      I_Error("dsda_WriteZippedFilesToDest: Failed to open destination file %s.", full_path.string);
+  *size = stat.size;
 
-    dsda_WriteContentToFile(zipped_file, dest_file, stat.size);
+  return zipped_file;
+}
 
-    zip_fclose(zipped_file);
-    fclose(dest_file);
-    dsda_FreeString(&full_path);
-  }
+static void dsda_WriteZippedFileToDest(zip_t *archive, zip_int64_t index,
+                                       const char *file_name, const char *destination_directory) {
+  dsda_string_t full_path;
+  zip_file_t *zipped_file;
+  zip_uint64_t size;
+  FILE *dest_file;
+
+  dsda_StringPrintF(&full_path, "%s/%s", destination_directory, file_name);
+
+  zipped_file = dsda_OpenZippedFile(archive, index, file_name, &size);
+
+  dest_file = M_OpenFile(full_path.string, "wb");
+  if (dest_file == NULL)
+    I_Error("dsda_WriteZippedFileToDest: Failed to open destination file %s.", full_path.string);
+
+  dsda_WriteContentToFile(zipped_file, dest_file, size);
+
+  zip_fclose(zipped_file);
+  fclose(dest_file);
+  dsda_FreeString(&full_path);
 }
 
-static void dsda_UnzipFileToDestination(const char *zipped_file_name, const char *destination_directory) {
-  int error_code;
-  zip_t *archive_handle;
+static void dsda_ReadZippedFile(zip_t *archive, zip_int64_t index, dsda_zip_entry_t *entry) {
+  zip_file_t *zipped_file;
+  zip_uint64_t size;
 
-  total_bytes_read = 0;
-  archive_handle = zip_open(zipped_file_name, ZIP_RDONLY, &error_code);
-  if (archive_handle == NULL) {
-    zip_error_t error;
-    zip_error_init_with_code(&error, error_code);
-    I_Error("dsda_UnzipFileToDestination: Unable to open %s: %s.\n", zipped_file_name, zip_error_strerror(&error));
-  }
+  zipped_file = dsda_OpenZippedFile(archive, index, entry->name, &size);
 
-  dsda_WriteZippedFilesToDest(archive_handle, destination_directory);
+  entry->length = size;
+  entry->data = Z_Malloc(size ? size : 1);
+  dsda_ReadContent(zipped_file, entry->data, size);
 
-  zip_close(archive_handle);
+  zip_fclose(zipped_file);
 }
 
-const char* dsda_UnzipFile(const char *zipped_file_name) {
+static const char *dsda_MakeZipTempDir(const char *zipped_file_name) {
   dsda_string_t temporary_directory;
   static unsigned int file_counter = 0;
 
   dsda_StringPrintF(&temporary_directory, "%s/%u-%s", I_GetTempDir(), file_counter, dsda_BaseName(zipped_file_name));
   if (M_IsDir(temporary_directory.string))
     if (!M_RemoveFilesAtPath(temporary_directory.string))
-      I_Error("dsda_UnzipFile: unable to clear tempdir %s\n", temporary_directory.string);
+      I_Error("dsda_MakeZipTempDir: unable to clear tempdir %s\n", temporary_directory.string);
   M_MakeDir(temporary_directory.string, true);
 
-  dsda_UnzipFileToDestination(zipped_file_name, temporary_directory.string);
-
   temp_dirs = Z_Realloc(temp_dirs, (file_counter + 2) * sizeof(*temp_dirs));
   temp_dirs[file_counter] = temporary_directory.string;
   temp_dirs[file_counter + 1] = NULL;
@@ -130,6 +147,89 @@ const char* dsda_UnzipFile(const char *zipped_file_name) {
   return temporary_directory.string;
 }
 
+static int dsda_CompareZipEntries(const void *a, const void *b) {
+  const dsda_zip_entry_t *entry_a = a;
+  const dsda_zip_entry_t *entry_b = b;
+
+  return strcasecmp(entry_a->name, entry_b->name);
+}
+
+//
+// Wads and lumps are read straight into memory, sorted by name the way
+// a directory glob would list them. Dehacked files are included by path,
+// so those are still written to a temporary directory.
+//
+
+int dsda_ReadZipFile(const char *zipped_file_name, dsda_zip_entry_t **entries,
+                     const char **deh_directory) {
+  int error_code;
+  int count = 0;
+  zip_t *archive;
+  zip_int64_t i, j;
+  zip_int64_t entry_count;
+
+  *entries = NULL;
+  *deh_directory = NULL;
+
+  total_bytes_read = 0;
+  archive = zip_open(zipped_file_name, ZIP_RDONLY, &error_code);
+  if (archive == NULL) {
+    zip_error_t error;
+    zip_error_init_with_code(&error, error_code);
+    I_Error("dsda_ReadZipFile: Unable to open %s: %s.\n", zipped_file_name, zip_error_strerror(&error));
+  }
+
+  entry_count = zip_get_num_entries(archive, ZIP_FL_UNCHANGED);
+
+  for (i = 0; i < entry_count; i++) {
+    dsda_zip_entry_t *entry;
+    const char *file_name = dsda_BaseName(zip_get_name(archive, i, ZIP_FL_UNCHANGED));
+
+    /* Intermediate directories have a trailing '/', so their base name is empty */
+    if (*file_name == '\0') {
+      continue;
+    }
+
+    if (dsda_HasFileExt(file_name, ".deh") || dsda_HasFileExt(file_name, ".bex")) {
+      if (!*deh_directory)
+        *deh_directory = dsda_MakeZipTempDir(zipped_file_name);
+
+      dsda_WriteZippedFileToDest(archive, i, file_name, *deh_directory);
+      continue;
+    }
+
+    if (!dsda_HasFileExt(file_name, ".wad") &&
+        !dsda_HasFileExt(file_name, ".lmp") &&
+        !dsda_HasFileExt(file_name, ".gwa")) {
+      continue;
+    }
+
+    /* Files in different folders of the archive flatten to one name, and the last one wins */
+    for (j = 0; j < count; j++)
+      if (!strcmp((*entries)[j].name, file_name))
+        break;
+
+    if (j == count) {
+      *entries = Z_Realloc(*entries, (count + 1) * sizeof(**entries));
+      (*entries)[count].name = Z_Strdup(file_name);
+      count++;
+    }
+    else {
+      Z_Free((*entries)[j].data);
+    }
+
+    entry = &(*entries)[j];
+    dsda_ReadZippedFile(archive, i, entry);
+  }
+
+  zip_close(archive);
+
+  if (count)
+    qsort(*entries, count, sizeof(**entries), dsda_CompareZipEntries);
+
+  return count;
+}
+
 void dsda_CleanZipTempDirs(void) {
   int i;
 
@@ -18,7 +18,16 @@
 #ifndef __DSDA_ZIPFILE__
 #define __DSDA_ZIPFILE__
 
-const char* dsda_UnzipFile(const char *zipped_file_name);
+#include <stddef.h>
+
+typedef struct {
+  char *name;
+  void *data;
+  size_t length;
+} dsda_zip_entry_t;
+
+int dsda_ReadZipFile(const char *zipped_file_name, dsda_zip_entry_t **entries,
+                     const char **deh_directory);
 
 void dsda_CleanZipTempDirs(void);
 
@@ -64,120 +64,277 @@ typedef struct {
 #pragma pack(pop)
 #endif //_MSC_VER
 
+// Hexen's instruction set, numbered as in BEHAVIOR lumps
+typedef enum
+{
+    PCD_NOP,
+    PCD_TERMINATE,
+    PCD_SUSPEND,
+    PCD_PUSHNUMBER,
+    PCD_LSPEC1,
+    PCD_LSPEC2,
+    PCD_LSPEC3,
+    PCD_LSPEC4,
+    PCD_LSPEC5,
+    PCD_LSPEC1DIRECT,
+    PCD_LSPEC2DIRECT,
+    PCD_LSPEC3DIRECT,
+    PCD_LSPEC4DIRECT,
+    PCD_LSPEC5DIRECT,
+    PCD_ADD,
+    PCD_SUBTRACT,
+    PCD_MULTIPLY,
+    PCD_DIVIDE,
+    PCD_MODULUS,
+    PCD_EQ,
+    PCD_NE,
+    PCD_LT,
+    PCD_GT,
+    PCD_LE,
+    PCD_GE,
+    PCD_ASSIGNSCRIPTVAR,
+    PCD_ASSIGNMAPVAR,
+    PCD_ASSIGNWORLDVAR,
+    PCD_PUSHSCRIPTVAR,
+    PCD_PUSHMAPVAR,
+    PCD_PUSHWORLDVAR,
+    PCD_ADDSCRIPTVAR,
+    PCD_ADDMAPVAR,
+    PCD_ADDWORLDVAR,
+    PCD_SUBSCRIPTVAR,
+    PCD_SUBMAPVAR,
+    PCD_SUBWORLDVAR,
+    PCD_MULSCRIPTVAR,
+    PCD_MULMAPVAR,
+    PCD_MULWORLDVAR,
+    PCD_DIVSCRIPTVAR,
+    PCD_DIVMAPVAR,
+    PCD_DIVWORLDVAR,
+    PCD_MODSCRIPTVAR,
+    PCD_MODMAPVAR,
+    PCD_MODWORLDVAR,
+    PCD_INCSCRIPTVAR,
+    PCD_INCMAPVAR,
+    PCD_INCWORLDVAR,
+    PCD_DECSCRIPTVAR,
+    PCD_DECMAPVAR,
+    PCD_DECWORLDVAR,
+    PCD_GOTO,
+    PCD_IFGOTO,
+    PCD_DROP,
+    PCD_DELAY,
+    PCD_DELAYDIRECT,
+    PCD_RANDOM,
+    PCD_RANDOMDIRECT,
+    PCD_THINGCOUNT,
+    PCD_THINGCOUNTDIRECT,
+    PCD_TAGWAIT,
+    PCD_TAGWAITDIRECT,
+    PCD_POLYWAIT,
+    PCD_POLYWAITDIRECT,
+    PCD_CHANGEFLOOR,
+    PCD_CHANGEFLOORDIRECT,
+    PCD_CHANGECEILING,
+    PCD_CHANGECEILINGDIRECT,
+    PCD_RESTART,
+    PCD_ANDLOGICAL,
+    PCD_ORLOGICAL,
+    PCD_ANDBITWISE,
+    PCD_ORBITWISE,
+    PCD_EORBITWISE,
+    PCD_NEGATELOGICAL,
+    PCD_LSHIFT,
+    PCD_RSHIFT,
+    PCD_UNARYMINUS,
+    PCD_IFNOTGOTO,
+    PCD_LINESIDE,
+    PCD_SCRIPTWAIT,
+    PCD_SCRIPTWAITDIRECT,
+    PCD_CLEARLINESPECIAL,
+    PCD_CASEGOTO,
+    PCD_BEGINPRINT,
+    PCD_ENDPRINT,
+    PCD_PRINTSTRING,
+    PCD_PRINTNUMBER,
+    PCD_PRINTCHARACTER,
+    PCD_PLAYERCOUNT,
+    PCD_GAMETYPE,
+    PCD_GAMESKILL,
+    PCD_TIMER,
+    PCD_SECTORSOUND,
+    PCD_AMBIENTSOUND,
+    PCD_SOUNDSEQUENCE,
+    PCD_SETLINETEXTURE,
+    PCD_SETLINEBLOCKING,
+    PCD_SETLINESPECIAL,
+    PCD_THINGSOUND,
+    PCD_ENDPRINTBOLD,
+    NUMPCODES,
+
+    // Code that failed to decode. Hexen only rejects bad code when it runs
+    // it, so the error is kept in the trap and raised when it executes.
+    PCD_TRAP = NUMPCODES
+} pcd_t;
+
+// Negative / invalid pairs are kept next to each other
+typedef enum
+{
+    ACSE_END_OF_LUMP,
+    ACSE_NEGATIVE_CMD,
+    ACSE_INVALID_CMD,
+    ACSE_NEGATIVE_SCRIPT_VAR,
+    ACSE_INVALID_SCRIPT_VAR,
+    ACSE_NEGATIVE_MAP_VAR,
+    ACSE_INVALID_MAP_VAR,
+    ACSE_NEGATIVE_WORLD_VAR,
+    ACSE_INVALID_WORLD_VAR,
+    ACSE_NEGATIVE_OFFSET,
+    ACSE_INVALID_OFFSET,
+    ACSE_NEGATIVE_STRING,
+    ACSE_INVALID_STRING,
+    ACSE_STACK_OVERFLOW,
+    ACSE_POP_EMPTY,
+    ACSE_TOP_EMPTY,
+    ACSE_DROP_EMPTY,
+    ACSE_NO_CODE
+} acsError_t;
+
+#define MAX_PCODE_ARGS 6
+
+// An instruction decoded from the lump, with its operands read and checked.
+// Branch targets and next are indices into ACSCode.
+typedef struct
+{
+    int cmd;
+    unsigned int offset;        // in the lump, for saved games and errors
+    int next;
+    int args[MAX_PCODE_ARGS];   // error, values, cmd and whether it was read for PCD_TRAP
+} acsInstruction_t;
+
+// Interpreter state for one run of a script
+typedef struct
+{
+    acs_t *script;
+    acsInfo_t *info;
+    const acsInstruction_t *insn;       // executing
+    const acsInstruction_t *next;       // to execute after it
+} acs_vm_t;
+
 static void StartOpenACS(int number, int infoIndex, int offset);
 static void ScriptFinished(int number);
 static dboolean TagBusy(int tag);
 static dboolean AddToACSStore(int map, int number, byte * args);
 static int GetACSIndex(int number);
-static void Push(int value);
-static int Pop(void);
-static int Top(void);
-static void Drop(void);
-
-static int CmdNOP(void);
-static int CmdTerminate(void);
-static int CmdSuspend(void);
-static int CmdPushNumber(void);
-static int CmdLSpec1(void);
-static int CmdLSpec2(void);
-static int CmdLSpec3(void);
-static int CmdLSpec4(void);
-static int CmdLSpec5(void);
-static int CmdLSpec1Direct(void);
-static int CmdLSpec2Direct(void);
-static int CmdLSpec3Direct(void);
-static int CmdLSpec4Direct(void);
-static int CmdLSpec5Direct(void);
-static int CmdAdd(void);
-static int CmdSubtract(void);
-static int CmdMultiply(void);
-static int CmdDivide(void);
-static int CmdModulus(void);
-static int CmdEQ(void);
-static int CmdNE(void);
-static int CmdLT(void);
-static int CmdGT(void);
-static int CmdLE(void);
-static int CmdGE(void);
-static int CmdAssignScriptVar(void);
-static int CmdAssignMapVar(void);
-static int CmdAssignWorldVar(void);
-static int CmdPushScriptVar(void);
-static int CmdPushMapVar(void);
-static int CmdPushWorldVar(void);
-static int CmdAddScriptVar(void);
-static int CmdAddMapVar(void);
-static int CmdAddWorldVar(void);
-static int CmdSubScriptVar(void);
-static int CmdSubMapVar(void);
-static int CmdSubWorldVar(void);
-static int CmdMulScriptVar(void);
-static int CmdMulMapVar(void);
-static int CmdMulWorldVar(void);
-static int CmdDivScriptVar(void);
-static int CmdDivMapVar(void);
-static int CmdDivWorldVar(void);
-static int CmdModScriptVar(void);
-static int CmdModMapVar(void);
-static int CmdModWorldVar(void);
-static int CmdIncScriptVar(void);
-static int CmdIncMapVar(void);
-static int CmdIncWorldVar(void);
-static int CmdDecScriptVar(void);
-static int CmdDecMapVar(void);
-static int CmdDecWorldVar(void);
-static int CmdGoto(void);
-static int CmdIfGoto(void);
-static int CmdDrop(void);
-static int CmdDelay(void);
-static int CmdDelayDirect(void);
-static int CmdRandom(void);
-static int CmdRandomDirect(void);
-static int CmdThingCount(void);
-static int CmdThingCountDirect(void);
-static int CmdTagWait(void);
-static int CmdTagWaitDirect(void);
-static int CmdPolyWait(void);
-static int CmdPolyWaitDirect(void);
-static int CmdChangeFloor(void);
-static int CmdChangeFloorDirect(void);
-static int CmdChangeCeiling(void);
-static int CmdChangeCeilingDirect(void);
-static int CmdRestart(void);
-static int CmdAndLogical(void);
-static int CmdOrLogical(void);
-static int CmdAndBitwise(void);
-static int CmdOrBitwise(void);
-static int CmdEorBitwise(void);
-static int CmdNegateLogical(void);
-static int CmdLShift(void);
-static int CmdRShift(void);
-static int CmdUnaryMinus(void);
-static int CmdIfNotGoto(void);
-static int CmdLineSide(void);
-static int CmdScriptWait(void);
-static int CmdScriptWaitDirect(void);
-static int CmdClearLineSpecial(void);
-static int CmdCaseGoto(void);
-static int CmdBeginPrint(void);
-static int CmdEndPrint(void);
-static int CmdPrintString(void);
-static int CmdPrintNumber(void);
-static int CmdPrintCharacter(void);
-static int CmdPlayerCount(void);
-static int CmdGameType(void);
-static int CmdGameSkill(void);
-static int CmdTimer(void);
-static int CmdSectorSound(void);
-static int CmdAmbientSound(void);
-static int CmdSoundSequence(void);
-static int CmdSetLineTexture(void);
-static int CmdSetLineBlocking(void);
-static int CmdSetLineSpecial(void);
-static int CmdThingSound(void);
-static int CmdEndPrintBold(void);
-
-static void ThingCount(int type, int tid);
+static void Push(acs_vm_t *vm, int value);
+static int Pop(acs_vm_t *vm);
+static int Top(acs_vm_t *vm);
+static void Drop(acs_vm_t *vm);
+
+static int CmdNOP(acs_vm_t *vm);
+static int CmdTerminate(acs_vm_t *vm);
+static int CmdSuspend(acs_vm_t *vm);
+static int CmdPushNumber(acs_vm_t *vm);
+static int CmdLSpec1(acs_vm_t *vm);
+static int CmdLSpec2(acs_vm_t *vm);
+static int CmdLSpec3(acs_vm_t *vm);
+static int CmdLSpec4(acs_vm_t *vm);
+static int CmdLSpec5(acs_vm_t *vm);
+static int CmdLSpec1Direct(acs_vm_t *vm);
+static int CmdLSpec2Direct(acs_vm_t *vm);
+static int CmdLSpec3Direct(acs_vm_t *vm);
+static int CmdLSpec4Direct(acs_vm_t *vm);
+static int CmdLSpec5Direct(acs_vm_t *vm);
+static int CmdAdd(acs_vm_t *vm);
+static int CmdSubtract(acs_vm_t *vm);
+static int CmdMultiply(acs_vm_t *vm);
+static int CmdDivide(acs_vm_t *vm);
+static int CmdModulus(acs_vm_t *vm);
+static int CmdEQ(acs_vm_t *vm);
+static int CmdNE(acs_vm_t *vm);
+static int CmdLT(acs_vm_t *vm);
+static int CmdGT(acs_vm_t *vm);
+static int CmdLE(acs_vm_t *vm);
+static int CmdGE(acs_vm_t *vm);
+static int CmdAssignScriptVar(acs_vm_t *vm);
+static int CmdAssignMapVar(acs_vm_t *vm);
+static int CmdAssignWorldVar(acs_vm_t *vm);
+static int CmdPushScriptVar(acs_vm_t *vm);
+static int CmdPushMapVar(acs_vm_t *vm);
+static int CmdPushWorldVar(acs_vm_t *vm);
+static int CmdAddScriptVar(acs_vm_t *vm);
+static int CmdAddMapVar(acs_vm_t *vm);
+static int CmdAddWorldVar(acs_vm_t *vm);
+static int CmdSubScriptVar(acs_vm_t *vm);
+static int CmdSubMapVar(acs_vm_t *vm);
+static int CmdSubWorldVar(acs_vm_t *vm);
+static int CmdMulScriptVar(acs_vm_t *vm);
+static int CmdMulMapVar(acs_vm_t *vm);
+static int CmdMulWorldVar(acs_vm_t *vm);
+static int CmdDivScriptVar(acs_vm_t *vm);
+static int CmdDivMapVar(acs_vm_t *vm);
+static int CmdDivWorldVar(acs_vm_t *vm);
+static int CmdModScriptVar(acs_vm_t *vm);
+static int CmdModMapVar(acs_vm_t *vm);
+static int CmdModWorldVar(acs_vm_t *vm);
+static int CmdIncScriptVar(acs_vm_t *vm);
+static int CmdIncMapVar(acs_vm_t *vm);
+static int CmdIncWorldVar(acs_vm_t *vm);
+static int CmdDecScriptVar(acs_vm_t *vm);
+static int CmdDecMapVar(acs_vm_t *vm);
+static int CmdDecWorldVar(acs_vm_t *vm);
+static int CmdGoto(acs_vm_t *vm);
+static int CmdIfGoto(acs_vm_t *vm);
+static int CmdDrop(acs_vm_t *vm);
+static int CmdDelay(acs_vm_t *vm);
+static int CmdDelayDirect(acs_vm_t *vm);
+static int CmdRandom(acs_vm_t *vm);
+static int CmdRandomDirect(acs_vm_t *vm);
+static int CmdThingCount(acs_vm_t *vm);
+static int CmdThingCountDirect(acs_vm_t *vm);
+static int CmdTagWait(acs_vm_t *vm);
+static int CmdTagWaitDirect(acs_vm_t *vm);
+static int CmdPolyWait(acs_vm_t *vm);
+static int CmdPolyWaitDirect(acs_vm_t *vm);
+static int CmdChangeFloor(acs_vm_t *vm);
+static int CmdChangeFloorDirect(acs_vm_t *vm);
+static int CmdChangeCeiling(acs_vm_t *vm);
+static int CmdChangeCeilingDirect(acs_vm_t *vm);
+static int CmdRestart(acs_vm_t *vm);
+static int CmdAndLogical(acs_vm_t *vm);
+static int CmdOrLogical(acs_vm_t *vm);
+static int CmdAndBitwise(acs_vm_t *vm);
+static int CmdOrBitwise(acs_vm_t *vm);
+static int CmdEorBitwise(acs_vm_t *vm);
+static int CmdNegateLogical(acs_vm_t *vm);
+static int CmdLShift(acs_vm_t *vm);
+static int CmdRShift(acs_vm_t *vm);
+static int CmdUnaryMinus(acs_vm_t *vm);
+static int CmdIfNotGoto(acs_vm_t *vm);
+static int CmdLineSide(acs_vm_t *vm);
+static int CmdScriptWait(acs_vm_t *vm);
+static int CmdScriptWaitDirect(acs_vm_t *vm);
+static int CmdClearLineSpecial(acs_vm_t *vm);
+static int CmdCaseGoto(acs_vm_t *vm);
+static int CmdBeginPrint(acs_vm_t *vm);
+static int CmdEndPrint(acs_vm_t *vm);
+static int CmdPrintString(acs_vm_t *vm);
+static int CmdPrintNumber(acs_vm_t *vm);
+static int CmdPrintCharacter(acs_vm_t *vm);
+static int CmdPlayerCount(acs_vm_t *vm);
+static int CmdGameType(acs_vm_t *vm);
+static int CmdGameSkill(acs_vm_t *vm);
+static int CmdTimer(acs_vm_t *vm);
+static int CmdSectorSound(acs_vm_t *vm);
+static int CmdAmbientSound(acs_vm_t *vm);
+static int CmdSoundSequence(acs_vm_t *vm);
+static int CmdSetLineTexture(acs_vm_t *vm);
+static int CmdSetLineBlocking(acs_vm_t *vm);
+static int CmdSetLineSpecial(acs_vm_t *vm);
+static int CmdThingSound(acs_vm_t *vm);
+static int CmdEndPrintBold(acs_vm_t *vm);
+static int CmdTrap(acs_vm_t *vm);
+
+static void ThingCount(acs_vm_t *vm, int type, int tid);
 
 int ACScriptCount;
 const byte *ActionCodeBase;
@@ -187,124 +344,182 @@ int MapVars[MAX_ACS_MAP_VARS];
 int WorldVars[MAX_ACS_WORLD_VARS];
 acsstore_t ACSStore[MAX_ACS_STORE + 1]; // +1 for termination marker
 
-static char EvalContext[64];
-static acs_t *ACScript;
-static unsigned int PCodeOffset;
+static acsInstruction_t *ACSCode;       // sorted by offset
+static int ACSCodeCount;
+static int *ACSEntries;                 // ACSCode index of each script's start
+static acs_t *ACScript;                 // last script run
 static int SpecArgs[8];
 static int ACStringCount;
 static const char **ACStrings;
 static char PrintBuffer[PRINT_BUFFER_SIZE];
 static acs_t *NewScript;
 
-static int (*PCodeCmds[]) (void) =
-{
-        CmdNOP,
-        CmdTerminate,
-        CmdSuspend,
-        CmdPushNumber,
-        CmdLSpec1,
-        CmdLSpec2,
-        CmdLSpec3,
-        CmdLSpec4,
-        CmdLSpec5,
-        CmdLSpec1Direct,
-        CmdLSpec2Direct,
-        CmdLSpec3Direct,
-        CmdLSpec4Direct,
-        CmdLSpec5Direct,
-        CmdAdd,
-        CmdSubtract,
-        CmdMultiply,
-        CmdDivide,
-        CmdModulus,
-        CmdEQ,
-        CmdNE,
-        CmdLT,
-        CmdGT,
-        CmdLE,
-        CmdGE,
-        CmdAssignScriptVar,
-        CmdAssignMapVar,
-        CmdAssignWorldVar,
-        CmdPushScriptVar,
-        CmdPushMapVar,
-        CmdPushWorldVar,
-        CmdAddScriptVar,
-        CmdAddMapVar,
-        CmdAddWorldVar,
-        CmdSubScriptVar,
-        CmdSubMapVar,
-        CmdSubWorldVar,
-        CmdMulScriptVar,
-        CmdMulMapVar,
-        CmdMulWorldVar,
-        CmdDivScriptVar,
-        CmdDivMapVar,
-        CmdDivWorldVar,
-        CmdModScriptVar,
-        CmdModMapVar,
-        CmdModWorldVar,
-        CmdIncScriptVar,
-        CmdIncMapVar,
-        CmdIncWorldVar,
-        CmdDecScriptVar,
-        CmdDecMapVar,
-        CmdDecWorldVar,
-        CmdGoto,
-        CmdIfGoto,
-        CmdDrop,
-        CmdDelay,
-        CmdDelayDirect,
-        CmdRandom,
-        CmdRandomDirect,
-        CmdThingCount,
-        CmdThingCountDirect,
-        CmdTagWait,
-        CmdTagWaitDirect,
-        CmdPolyWait,
-        CmdPolyWaitDirect,
-        CmdChangeFloor,
-        CmdChangeFloorDirect,
-        CmdChangeCeiling,
-        CmdChangeCeilingDirect,
-        CmdRestart,
-        CmdAndLogical,
-        CmdOrLogical,
-        CmdAndBitwise,
-        CmdOrBitwise,
-        CmdEorBitwise,
-        CmdNegateLogical,
-        CmdLShift,
-        CmdRShift,
-        CmdUnaryMinus,
-        CmdIfNotGoto,
-        CmdLineSide,
-        CmdScriptWait,
-        CmdScriptWaitDirect,
-        CmdClearLineSpecial,
-        CmdCaseGoto,
-        CmdBeginPrint,
-        CmdEndPrint,
-        CmdPrintString,
-        CmdPrintNumber,
-        CmdPrintCharacter,
-        CmdPlayerCount,
-        CmdGameType,
-        CmdGameSkill,
-        CmdTimer,
-        CmdSectorSound,
-        CmdAmbientSound,
-        CmdSoundSequence,
-        CmdSetLineTexture,
-        CmdSetLineBlocking,
-        CmdSetLineSpecial,
-        CmdThingSound,
-        CmdEndPrintBold,
+// Where the interpreter is, for assertion failures. Only filled in when
+// an assertion fails.
+static int ContextLump = -1; // header parsing, when not -1
+static int ContextScript;
+static unsigned int ContextOffset;
+static int ContextCmd;
+static dboolean ContextHasCmd;
+
+// Operands of each instruction, one letter each: i = number, s / m / w =
+// script / map / world variable, o = lump offset to branch to, t = string
+static const char *PCodeArgs[NUMPCODES] =
+{
+        "",             // NOP
+        "",             // TERMINATE
+        "",             // SUSPEND
+        "i",            // PUSHNUMBER
+        "i",            // LSPEC1
+        "i",            // LSPEC2
+        "i",            // LSPEC3
+        "i",            // LSPEC4
+        "i",            // LSPEC5
+        "ii",           // LSPEC1DIRECT
+        "iii",          // LSPEC2DIRECT
+        "iiii",         // LSPEC3DIRECT
+        "iiiii",        // LSPEC4DIRECT
+        "iiiiii",       // LSPEC5DIRECT
+        "",             // ADD
+        "",             // SUBTRACT
+        "",             // MULTIPLY
+        "",             // DIVIDE
+        "",             // MODULUS
+        "",             // EQ
+        "",             // NE
+        "",             // LT
+        "",             // GT
+        "",             // LE
+        "",             // GE
+        "s",            // ASSIGNSCRIPTVAR
+        "m",            // ASSIGNMAPVAR
+        "w",            // ASSIGNWORLDVAR
+        "s",            // PUSHSCRIPTVAR
+        "m",            // PUSHMAPVAR
+        "w",            // PUSHWORLDVAR
+        "s",            // ADDSCRIPTVAR
+        "m",            // ADDMAPVAR
+        "w",            // ADDWORLDVAR
+        "s",            // SUBSCRIPTVAR
+        "m",            // SUBMAPVAR
+        "w",            // SUBWORLDVAR
+        "s",            // MULSCRIPTVAR
+        "m",            // MULMAPVAR
+        "w",            // MULWORLDVAR
+        "s",            // DIVSCRIPTVAR
+        "m",            // DIVMAPVAR
+        "w",            // DIVWORLDVAR
+        "s",            // MODSCRIPTVAR
+        "m",            // MODMAPVAR
+        "w",            // MODWORLDVAR
+        "s",            // INCSCRIPTVAR
+        "m",            // INCMAPVAR
+        "w",            // INCWORLDVAR
+        "s",            // DECSCRIPTVAR
+        "m",            // DECMAPVAR
+        "w",            // DECWORLDVAR
+        "o",            // GOTO
+        "o",            // IFGOTO
+        "",             // DROP
+        "",             // DELAY
+        "i",            // DELAYDIRECT
+        "",             // RANDOM
+        "ii",           // RANDOMDIRECT
+        "",             // THINGCOUNT
+        "ii",           // THINGCOUNTDIRECT
+        "",             // TAGWAIT
+        "i",            // TAGWAITDIRECT
+        "",             // POLYWAIT
+        "i",            // POLYWAITDIRECT
+        "",             // CHANGEFLOOR
+        "it",           // CHANGEFLOORDIRECT
+        "",             // CHANGECEILING
+        "it",           // CHANGECEILINGDIRECT
+        "",             // RESTART
+        "",             // ANDLOGICAL
+        "",             // ORLOGICAL
+        "",             // ANDBITWISE
+        "",             // ORBITWISE
+        "",             // EORBITWISE
+        "",             // NEGATELOGICAL
+        "",             // LSHIFT
+        "",             // RSHIFT
+        "",             // UNARYMINUS
+        "o",            // IFNOTGOTO
+        "",             // LINESIDE
+        "",             // SCRIPTWAIT
+        "i",            // SCRIPTWAITDIRECT
+        "",             // CLEARLINESPECIAL
+        "io",           // CASEGOTO
+        "",             // BEGINPRINT
+        "",             // ENDPRINT
+        "",             // PRINTSTRING
+        "",             // PRINTNUMBER
+        "",             // PRINTCHARACTER
+        "",             // PLAYERCOUNT
+        "",             // GAMETYPE
+        "",             // GAMESKILL
+        "",             // TIMER
+        "",             // SECTORSOUND
+        "",             // AMBIENTSOUND
+        "",             // SOUNDSEQUENCE
+        "",             // SETLINETEXTURE
+        "",             // SETLINEBLOCKING
+        "",             // SETLINESPECIAL
+        "",             // THINGSOUND
+        "",             // ENDPRINTBOLD
 };
 
-static void ACSAssert(int condition, const char *fmt, ...)
+static const char *ACSErrorMessages[] =
+{
+        "unexpectedly reached end of ACS lump",
+        "negative ACS instruction %d",
+        "invalid ACS instruction %d (maybe this WAD is designed "
+        "for an advanced source port and is not vanilla compatible)",
+        "negative script variable: %d < 0",
+        "invalid script variable: %d >= %d",
+        "negative map variable: %d < 0",
+        "invalid map variable: %d >= %d",
+        "negative world variable: %d < 0",
+        "invalid world variable: %d >= %d",
+        "negative lump offset %d",
+        "invalid lump offset: %d >= %d",
+        "negative string index: %d < 0",
+        "invalid string index: %d >= %d",
+        "maximum stack depth exceeded: %d >= %d",
+        "pop of empty stack",
+        "read from top of empty stack",
+        "drop on empty stack",
+        "no code at saved offset %d",
+};
+
+static void ACSError(const char *fmt, va_list args)
 {
+    char context[64];
     char buf[128];
+
+    if (ContextLump != -1)
+    {
+        snprintf(context, sizeof(context), "header parsing of lump #%d",
+                 ContextLump);
+    }
+    else if (ContextHasCmd)
+    {
+        snprintf(context, sizeof(context), "script %d @0x%x, cmd=%d",
+                 ContextScript, ContextOffset + 4, ContextCmd);
+    }
+    else
+    {
+        snprintf(context, sizeof(context), "script %d @0x%x",
+                 ContextScript, ContextOffset);
+    }
+
+    vsnprintf(buf, sizeof(buf), fmt, args);
+    I_Error("ACS assertion failure: in %s: %s", context, buf);
+}
+
+static void ACSAssert(int condition, const char *fmt, ...)
+{
     va_list args;
 
     if (condition)
@@ -313,86 +528,334 @@ static void ACSAssert(int condition, const char *fmt, ...)
     }
 
     va_start(args, fmt);
-    vsnprintf(buf, sizeof(buf), fmt, args);
+    ACSError(fmt, args);
     va_end(args);
-    I_Error("ACS assertion failure: in %s: %s", EvalContext, buf);
 }
 
-static int ReadCodeInt(void)
+// Fails the instruction the interpreter is running, or the trap it
+// was decoded to
+static void ACSFail(const acs_vm_t *vm, acsError_t error, int value, int limit)
+{
+    const acsInstruction_t *insn = vm->insn;
+
+    ContextLump = -1;
+    ContextScript = vm->info->number;
+    ContextOffset = insn->offset;
+
+    if (insn->cmd == PCD_TRAP)
+    {
+        ContextCmd = insn->args[3];
+        ContextHasCmd = insn->args[4];
+    }
+    else
+    {
+        ContextCmd = insn->cmd;
+        ContextHasCmd = true;
+    }
+
+    ACSAssert(false, ACSErrorMessages[error], value, limit);
+}
+
+static int ReadCodeInt(unsigned int *offset)
 {
     int result;
     const int *ptr;
 
-    ACSAssert(PCodeOffset + 3 < ActionCodeSize,
+    ACSAssert(*offset + 3 < ActionCodeSize,
               "unexpectedly reached end of ACS lump");
 
-    ptr = (const int *) (ActionCodeBase + PCodeOffset);
+    ptr = (const int *) (ActionCodeBase + *offset);
     result = LittleLong(*ptr);
-    PCodeOffset += 4;
+    *offset += 4;
+
+    return result;
+}
 
+static int ReadOffset(unsigned int *offset)
+{
+    int result = ReadCodeInt(offset);
+    ACSAssert(result >= 0, "negative lump offset %d", result);
+    ACSAssert(result < ActionCodeSize, "invalid lump offset: %d >= %d",
+              result, ActionCodeSize);
     return result;
 }
 
-static int ReadScriptVar(void)
+//
+// Decoding
+//
+// The lump is decoded once, by following the code from every script's
+// start. Operands are checked the way they used to be when an instruction
+// ran; code that would have failed becomes a trap with the same error.
+//
+
+static void DecodeTrap(acsInstruction_t *insn, acsError_t error,
+                       int value, int limit, dboolean hasCmd)
+{
+    insn->args[0] = error;
+    insn->args[1] = value;
+    insn->args[2] = limit;
+    insn->args[3] = insn->cmd;
+    insn->args[4] = hasCmd;
+    insn->cmd = PCD_TRAP;
+    insn->next = insn->offset;
+}
+
+static dboolean DecodeInt(unsigned int *offset, int *value)
 {
-    int var = ReadCodeInt();
-    ACSAssert(var >= 0, "negative script variable: %d < 0", var);
-    ACSAssert(var < MAX_ACS_SCRIPT_VARS,
-              "invalid script variable: %d >= %d", var, MAX_ACS_SCRIPT_VARS);
-    return var;
+    if (*offset + 3 >= ActionCodeSize)
+    {
+        return false;
+    }
+
+    *value = LittleLong(*(const int *) (ActionCodeBase + *offset));
+    *offset += 4;
+
+    return true;
 }
 
-static int ReadMapVar(void)
+static dboolean DecodeOperand(acsInstruction_t *insn, int value, int limit,
+                              acsError_t negative)
 {
-    int var = ReadCodeInt();
-    ACSAssert(var >= 0, "negative map variable: %d < 0", var);
-    ACSAssert(var < MAX_ACS_MAP_VARS,
-              "invalid map variable: %d >= %d", var, MAX_ACS_MAP_VARS);
-    return var;
+    if (value < 0)
+    {
+        DecodeTrap(insn, negative, value, 0, true);
+        return false;
+    }
+    if (value >= limit)
+    {
+        DecodeTrap(insn, negative + 1, value, limit, true);
+        return false;
+    }
+    return true;
 }
 
-static int ReadWorldVar(void)
+// Index of the operand that is a branch target, or -1
+static int BranchArg(int cmd)
 {
-    int var = ReadCodeInt();
-    ACSAssert(var >= 0, "negative world variable: %d < 0", var);
-    ACSAssert(var < MAX_ACS_WORLD_VARS,
-              "invalid world variable: %d >= %d", var, MAX_ACS_WORLD_VARS);
-    return var;
+    const char *arg;
+
+    if (cmd == PCD_TRAP)
+    {
+        return -1;
+    }
+
+    arg = strchr(PCodeArgs[cmd], 'o');
+    return arg ? arg - PCodeArgs[cmd] : -1;
 }
 
-static const char *StringLookup(int string_index)
+// Decodes the instruction at offset, leaving the branch target and next
+// as lump offsets. Code doesn't continue past an instruction that always
+// leaves it, so next is its own offset then.
+static void DecodeInstruction(unsigned int offset, acsInstruction_t *insn)
 {
-    ACSAssert(string_index >= 0,
-              "negative string index: %d < 0", string_index);
-    ACSAssert(string_index < ACStringCount,
-              "invalid string index: %d >= %d", string_index, ACStringCount);
-    return ACStrings[string_index];
+    unsigned int pos;
+    const char *arg;
+    int i;
+
+    memset(insn, 0, sizeof(*insn));
+    insn->offset = offset;
+    pos = offset;
+
+    if (!DecodeInt(&pos, &insn->cmd))
+    {
+        DecodeTrap(insn, ACSE_END_OF_LUMP, 0, 0, false);
+        return;
+    }
+
+    if ((unsigned int) insn->cmd >= NUMPCODES)
+    {
+        DecodeTrap(insn, insn->cmd < 0 ? ACSE_NEGATIVE_CMD : ACSE_INVALID_CMD,
+                   insn->cmd, 0, true);
+        return;
+    }
+
+    for (i = 0, arg = PCodeArgs[insn->cmd]; *arg; ++i, ++arg)
+    {
+        int value;
+        dboolean valid;
+
+        if (!DecodeInt(&pos, &value))
+        {
+            DecodeTrap(insn, ACSE_END_OF_LUMP, 0, 0, true);
+            return;
+        }
+
+        switch (*arg)
+        {
+            case 's':
+                valid = DecodeOperand(insn, value, MAX_ACS_SCRIPT_VARS,
+                                      ACSE_NEGATIVE_SCRIPT_VAR);
+                break;
+            case 'm':
+                valid = DecodeOperand(insn, value, MAX_ACS_MAP_VARS,
+                                      ACSE_NEGATIVE_MAP_VAR);
+                break;
+            case 'w':
+                valid = DecodeOperand(insn, value, MAX_ACS_WORLD_VARS,
+                                      ACSE_NEGATIVE_WORLD_VAR);
+                break;
+            case 'o':
+                valid = DecodeOperand(insn, value, ActionCodeSize,
+                                      ACSE_NEGATIVE_OFFSET);
+                break;
+            case 't':
+                valid = DecodeOperand(insn, value, ACStringCount,
+                                      ACSE_NEGATIVE_STRING);
+                break;
+            default:
+                valid = true;
+                break;
+        }
+
+        if (!valid)
+        {
+            return;
+        }
+
+        insn->args[i] = value;
+    }
+
+    if (insn->cmd == PCD_TERMINATE || insn->cmd == PCD_GOTO
+        || insn->cmd == PCD_RESTART)
+    {
+        insn->next = offset;
+    }
+    else
+    {
+        insn->next = pos;
+    }
+}
+
+static void MarkCode(int *index, int *stack, int *count, unsigned int offset)
+{
+    if (index[offset] == -1)
+    {
+        index[offset] = 0;
+        stack[(*count)++] = offset;
+    }
+}
+
+static void DecodeACScripts(void)
+{
+    acsInstruction_t insn;
+    int *index;
+    int *stack;
+    int count;
+    int offset;
+    int target;
+    int i;
+
+    // Code can run up to the end of the lump, which decodes to a trap
+    index = Z_Malloc((ActionCodeSize + 1) * sizeof(*index));
+    stack = Z_Malloc((ActionCodeSize + 1) * sizeof(*stack));
+
+    for (offset = 0; offset <= ActionCodeSize; ++offset)
+    {
+        index[offset] = -1;
+    }
+
+    count = 0;
+    for (i = 0; i < ACScriptCount; ++i)
+    {
+        MarkCode(index, stack, &count, ACSInfo[i].offset);
+    }
+
+    while (count)
+    {
+        DecodeInstruction(stack[--count], &insn);
+
+        MarkCode(index, stack, &count, insn.next);
+
+        target = BranchArg(insn.cmd);
+        if (target != -1)
+        {
+            MarkCode(index, stack, &count, insn.args[target]);
+        }
+    }
+
+    ACSCodeCount = 0;
+    for (offset = 0; offset <= ActionCodeSize; ++offset)
+    {
+        if (index[offset] != -1)
+        {
+            index[offset] = ACSCodeCount++;
+        }
+    }
+
+    ACSCode = Z_MallocLevel(ACSCodeCount * sizeof(*ACSCode));
+
+    for (offset = 0; offset <= ActionCodeSize; ++offset)
+    {
+        if (index[offset] != -1)
+        {
+            acsInstruction_t *code = &ACSCode[index[offset]];
+
+            DecodeInstruction(offset, code);
+
+            code->next = index[code->next];
+
+            target = BranchArg(code->cmd);
+            if (target != -1)
+            {
+                code->args[target] = index[code->args[target]];
+            }
+        }
+    }
+
+    ACSEntries = Z_MallocLevel(ACScriptCount * sizeof(*ACSEntries));
+    for (i = 0; i < ACScriptCount; ++i)
+    {
+        ACSEntries[i] = index[ACSInfo[i].offset];
+    }
+
+    Z_Free(index);
+    Z_Free(stack);
 }
 
-static int ReadOffset(void)
+// Saved games keep the lump offset of the next instruction
+static int ACSCodeIndex(unsigned int offset)
 {
-    int offset = ReadCodeInt();
-    ACSAssert(offset >= 0, "negative lump offset %d", offset);
-    ACSAssert(offset < ActionCodeSize, "invalid lump offset: %d >= %d",
-              offset, ActionCodeSize);
-    return offset;
+    int low = 0;
+    int high = ACSCodeCount - 1;
+
+    while (low <= high)
+    {
+        int mid = (low + high) / 2;
+
+        if (ACSCode[mid].offset == offset)
+        {
+            return mid;
+        }
+
+        if (ACSCode[mid].offset < offset)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid - 1;
+        }
+    }
+
+    return -1;
 }
 
 void P_LoadACScripts(int lump)
 {
     int i, offset;
+    unsigned int pos;
     const acsHeader_t *header;
     acsInfo_t *info;
 
     ActionCodeBase = W_LumpByNum(lump);
     ActionCodeSize = W_LumpLength(lump);
 
-    snprintf(EvalContext, sizeof(EvalContext), "header parsing of lump #%d", lump);
+    ContextLump = lump;
 
     header = (const acsHeader_t *) ActionCodeBase;
-    PCodeOffset = LittleLong(header->infoOffset);
+    pos = LittleLong(header->infoOffset);
 
-    ACScriptCount = ReadCodeInt();
+    ACScriptCount = ReadCodeInt(&pos);
 
     if (ACScriptCount == 0)
     {                           // Empty behavior lump
@@ -403,10 +866,9 @@ void P_LoadACScripts(int lump)
     memset(ACSInfo, 0, ACScriptCount * sizeof(acsInfo_t));
     for (i = 0, info = ACSInfo; i < ACScriptCount; i++, info++)
     {
-        info->number = ReadCodeInt();
-        info->offset = ReadOffset();
-        info->argCount = ReadCodeInt();
-
+        info->number = ReadCodeInt(&pos);
+        info->offset = ReadOffset(&pos);
+        info->argCount = ReadCodeInt(&pos);
         if (info->argCount > MAX_SCRIPT_ARGS)
         {
             fprintf(stderr, "Warning: ACS script #%i has %i arguments, more "
@@ -429,19 +891,21 @@ void P_LoadACScripts(int lump)
         }
     }
 
-    ACStringCount = ReadCodeInt();
+    ACStringCount = ReadCodeInt(&pos);
     ACSAssert(ACStringCount >= 0, "negative string count %d", ACStringCount);
     ACStrings = Z_MallocLevel(ACStringCount * sizeof(char *));
 
     for (i=0; i<ACStringCount; ++i)
     {
-        offset = ReadOffset();
+        offset = ReadOffset(&pos);
         ACStrings[i] = (const char *) ActionCodeBase + offset;
         ACSAssert(memchr(ACStrings[i], '\0', ActionCodeSize - offset) != NULL,
                   "string %d missing terminating NUL", i);
     }
 
     memset(MapVars, 0, sizeof(MapVars));
+
+    DecodeACScripts();
 }
 
 static void StartOpenACS(int number, int infoIndex, int offset)
@@ -641,7 +1105,8 @@ void P_ACSInitNewGame(void)
 
 void T_InterpretACS(acs_t * script)
 {
-    int cmd;
+    acs_vm_t vm;
+    int index;
     int action;
 
     if (ACSInfo[script->infoIndex].state == ASTE_TERMINATING)
@@ -661,24 +1126,135 @@ void T_InterpretACS(acs_t * script)
         return;
     }
     ACScript = script;
-    PCodeOffset = ACScript->ip;
+
+    vm.script = script;
+    vm.info = &ACSInfo[script->infoIndex];
+
+    index = ACSCodeIndex(script->ip);
+    if (index == -1)
+    {
+        ContextLump = -1;
+        ContextScript = vm.info->number;
+        ContextOffset = script->ip;
+        ContextHasCmd = false;
+        ACSAssert(false, ACSErrorMessages[ACSE_NO_CODE], script->ip);
+    }
+    vm.next = &ACSCode[index];
 
     do
     {
-        snprintf(EvalContext, sizeof(EvalContext), "script %d @0x%x",
-                 ACSInfo[script->infoIndex].number, PCodeOffset);
-        cmd = ReadCodeInt();
-        snprintf(EvalContext, sizeof(EvalContext), "script %d @0x%x, cmd=%d",
-                 ACSInfo[script->infoIndex].number, PCodeOffset, cmd);
-        ACSAssert(cmd >= 0, "negative ACS instruction %d", cmd);
-        ACSAssert(cmd < arrlen(PCodeCmds),
-                  "invalid ACS instruction %d (maybe this WAD is designed "
-                  "for an advanced source port and is not vanilla "
-                  "compatible)", cmd);
-        action = PCodeCmds[cmd]();
+        vm.insn = vm.next;
+        vm.next = &ACSCode[vm.insn->next];
+
+        switch (vm.insn->cmd)
+        {
+            case PCD_NOP: action = CmdNOP(&vm); break;
+            case PCD_TERMINATE: action = CmdTerminate(&vm); break;
+            case PCD_SUSPEND: action = CmdSuspend(&vm); break;
+            case PCD_PUSHNUMBER: action = CmdPushNumber(&vm); break;
+            case PCD_LSPEC1: action = CmdLSpec1(&vm); break;
+            case PCD_LSPEC2: action = CmdLSpec2(&vm); break;
+            case PCD_LSPEC3: action = CmdLSpec3(&vm); break;
+            case PCD_LSPEC4: action = CmdLSpec4(&vm); break;
+            case PCD_LSPEC5: action = CmdLSpec5(&vm); break;
+            case PCD_LSPEC1DIRECT: action = CmdLSpec1Direct(&vm); break;
+            case PCD_LSPEC2DIRECT: action = CmdLSpec2Direct(&vm); break;
+            case PCD_LSPEC3DIRECT: action = CmdLSpec3Direct(&vm); break;
+            case PCD_LSPEC4DIRECT: action = CmdLSpec4Direct(&vm); break;
+            case PCD_LSPEC5DIRECT: action = CmdLSpec5Direct(&vm); break;
+            case PCD_ADD: action = CmdAdd(&vm); break;
+            case PCD_SUBTRACT: action = CmdSubtract(&vm); break;
+            case PCD_MULTIPLY: action = CmdMultiply(&vm); break;
+            case PCD_DIVIDE: action = CmdDivide(&vm); break;
+            case PCD_MODULUS: action = CmdModulus(&vm); break;
+            case PCD_EQ: action = CmdEQ(&vm); break;
+            case PCD_NE: action = CmdNE(&vm); break;
+            case PCD_LT: action = CmdLT(&vm); break;
+            case PCD_GT: action = CmdGT(&vm); break;
+            case PCD_LE: action = CmdLE(&vm); break;
+            case PCD_GE: action = CmdGE(&vm); break;
+            case PCD_ASSIGNSCRIPTVAR: action = CmdAssignScriptVar(&vm); break;
+            case PCD_ASSIGNMAPVAR: action = CmdAssignMapVar(&vm); break;
+            case PCD_ASSIGNWORLDVAR: action = CmdAssignWorldVar(&vm); break;
+            case PCD_PUSHSCRIPTVAR: action = CmdPushScriptVar(&vm); break;
+            case PCD_PUSHMAPVAR: action = CmdPushMapVar(&vm); break;
+            case PCD_PUSHWORLDVAR: action = CmdPushWorldVar(&vm); break;
+            case PCD_ADDSCRIPTVAR: action = CmdAddScriptVar(&vm); break;
+            case PCD_ADDMAPVAR: action = CmdAddMapVar(&vm); break;
+            case PCD_ADDWORLDVAR: action = CmdAddWorldVar(&vm); break;
+            case PCD_SUBSCRIPTVAR: action = CmdSubScriptVar(&vm); break;
+            case PCD_SUBMAPVAR: action = CmdSubMapVar(&vm); break;
+            case PCD_SUBWORLDVAR: action = CmdSubWorldVar(&vm); break;
+            case PCD_MULSCRIPTVAR: action = CmdMulScriptVar(&vm); break;
+            case PCD_MULMAPVAR: action = CmdMulMapVar(&vm); break;
+            case PCD_MULWORLDVAR: action = CmdMulWorldVar(&vm); break;
+            case PCD_DIVSCRIPTVAR: action = CmdDivScriptVar(&vm); break;
+            case PCD_DIVMAPVAR: action = CmdDivMapVar(&vm); break;
+            case PCD_DIVWORLDVAR: action = CmdDivWorldVar(&vm); break;
+            case PCD_MODSCRIPTVAR: action = CmdModScriptVar(&vm); break;
+            case PCD_MODMAPVAR: action = CmdModMapVar(&vm); break;
+            case PCD_MODWORLDVAR: action = CmdModWorldVar(&vm); break;
+            case PCD_INCSCRIPTVAR: action = CmdIncScriptVar(&vm); break;
+            case PCD_INCMAPVAR: action = CmdIncMapVar(&vm); break;
+            case PCD_INCWORLDVAR: action = CmdIncWorldVar(&vm); break;
+            case PCD_DECSCRIPTVAR: action = CmdDecScriptVar(&vm); break;
+            case PCD_DECMAPVAR: action = CmdDecMapVar(&vm); break;
+            case PCD_DECWORLDVAR: action = CmdDecWorldVar(&vm); break;
+            case PCD_GOTO: action = CmdGoto(&vm); break;
+            case PCD_IFGOTO: action = CmdIfGoto(&vm); break;
+            case PCD_DROP: action = CmdDrop(&vm); break;
+            case PCD_DELAY: action = CmdDelay(&vm); break;
+            case PCD_DELAYDIRECT: action = CmdDelayDirect(&vm); break;
+            case PCD_RANDOM: action = CmdRandom(&vm); break;
+            case PCD_RANDOMDIRECT: action = CmdRandomDirect(&vm); break;
+            case PCD_THINGCOUNT: action = CmdThingCount(&vm); break;
+            case PCD_THINGCOUNTDIRECT: action = CmdThingCountDirect(&vm); break;
+            case PCD_TAGWAIT: action = CmdTagWait(&vm); break;
+            case PCD_TAGWAITDIRECT: action = CmdTagWaitDirect(&vm); break;
+            case PCD_POLYWAIT: action = CmdPolyWait(&vm); break;
+            case PCD_POLYWAITDIRECT: action = CmdPolyWaitDirect(&vm); break;
+            case PCD_CHANGEFLOOR: action = CmdChangeFloor(&vm); break;
+            case PCD_CHANGEFLOORDIRECT: action = CmdChangeFloorDirect(&vm); break;
+            case PCD_CHANGECEILING: action = CmdChangeCeiling(&vm); break;
+            case PCD_CHANGECEILINGDIRECT: action = CmdChangeCeilingDirect(&vm); break;
+            case PCD_RESTART: action = CmdRestart(&vm); break;
+            case PCD_ANDLOGICAL: action = CmdAndLogical(&vm); break;
+            case PCD_ORLOGICAL: action = CmdOrLogical(&vm); break;
+            case PCD_ANDBITWISE: action = CmdAndBitwise(&vm); break;
+            case PCD_ORBITWISE: action = CmdOrBitwise(&vm); break;
+            case PCD_EORBITWISE: action = CmdEorBitwise(&vm); break;
+            case PCD_NEGATELOGICAL: action = CmdNegateLogical(&vm); break;
+            case PCD_LSHIFT: action = CmdLShift(&vm); break;
+            case PCD_RSHIFT: action = CmdRShift(&vm); break;
+            case PCD_UNARYMINUS: action = CmdUnaryMinus(&vm); break;
+            case PCD_IFNOTGOTO: action = CmdIfNotGoto(&vm); break;
+            case PCD_LINESIDE: action = CmdLineSide(&vm); break;
+            case PCD_SCRIPTWAIT: action = CmdScriptWait(&vm); break;
+            case PCD_SCRIPTWAITDIRECT: action = CmdScriptWaitDirect(&vm); break;
+            case PCD_CLEARLINESPECIAL: action = CmdClearLineSpecial(&vm); break;
+            case PCD_CASEGOTO: action = CmdCaseGoto(&vm); break;
+            case PCD_BEGINPRINT: action = CmdBeginPrint(&vm); break;
+            case PCD_ENDPRINT: action = CmdEndPrint(&vm); break;
+            case PCD_PRINTSTRING: action = CmdPrintString(&vm); break;
+            case PCD_PRINTNUMBER: action = CmdPrintNumber(&vm); break;
+            case PCD_PRINTCHARACTER: action = CmdPrintCharacter(&vm); break;
+            case PCD_PLAYERCOUNT: action = CmdPlayerCount(&vm); break;
+            case PCD_GAMETYPE: action = CmdGameType(&vm); break;
+            case PCD_GAMESKILL: action = CmdGameSkill(&vm); break;
+            case PCD_TIMER: action = CmdTimer(&vm); break;
+            case PCD_SECTORSOUND: action = CmdSectorSound(&vm); break;
+            case PCD_AMBIENTSOUND: action = CmdAmbientSound(&vm); break;
+            case PCD_SOUNDSEQUENCE: action = CmdSoundSequence(&vm); break;
+            case PCD_SETLINETEXTURE: action = CmdSetLineTexture(&vm); break;
+            case PCD_SETLINEBLOCKING: action = CmdSetLineBlocking(&vm); break;
+            case PCD_SETLINESPECIAL: action = CmdSetLineSpecial(&vm); break;
+            case PCD_THINGSOUND: action = CmdThingSound(&vm); break;
+            case PCD_ENDPRINTBOLD: action = CmdEndPrintBold(&vm); break;
+            default: action = CmdTrap(&vm); break;
+        }
     } while (action == SCRIPT_CONTINUE);
 
-    ACScript->ip = PCodeOffset;
+    script->ip = vm.next->offset;
 
     if (action == SCRIPT_TERMINATE)
     {
@@ -776,511 +1352,539 @@ void CheckACSPresent(int number)
     }
 }
 
-static void Push(int value)
+static void Push(acs_vm_t *vm, int value)
 {
-    ACSAssert(ACScript->stackPtr < ACS_STACK_DEPTH,
-              "maximum stack depth exceeded: %d >= %d",
-              ACScript->stackPtr, ACS_STACK_DEPTH);
-    ACScript->stack[ACScript->stackPtr++] = value;
+    acs_t *script = vm->script;
+
+    if (script->stackPtr >= ACS_STACK_DEPTH)
+        ACSFail(vm, ACSE_STACK_OVERFLOW, script->stackPtr, ACS_STACK_DEPTH);
+    script->stack[script->stackPtr++] = value;
 }
 
-static int Pop(void)
+static int Pop(acs_vm_t *vm)
 {
-    ACSAssert(ACScript->stackPtr > 0, "pop of empty stack");
-    return ACScript->stack[--ACScript->stackPtr];
+    acs_t *script = vm->script;
+
+    if (script->stackPtr <= 0)
+        ACSFail(vm, ACSE_POP_EMPTY, 0, 0);
+    return script->stack[--script->stackPtr];
 }
 
-static int Top(void)
+static int Top(acs_vm_t *vm)
 {
-    ACSAssert(ACScript->stackPtr > 0, "read from top of empty stack");
-    return ACScript->stack[ACScript->stackPtr - 1];
+    acs_t *script = vm->script;
+
+    if (script->stackPtr <= 0)
+        ACSFail(vm, ACSE_TOP_EMPTY, 0, 0);
+    return script->stack[script->stackPtr - 1];
 }
 
-static void Drop(void)
+static void Drop(acs_vm_t *vm)
 {
-    ACSAssert(ACScript->stackPtr > 0, "drop on empty stack");
-    ACScript->stackPtr--;
+    acs_t *script = vm->script;
+
+    if (script->stackPtr <= 0)
+        ACSFail(vm, ACSE_DROP_EMPTY, 0, 0);
+    script->stackPtr--;
 }
 
-static int CmdNOP(void)
+static const char *StringLookup(acs_vm_t *vm, int string_index)
+{
+    if (string_index < 0 || string_index >= ACStringCount)
+    {
+        ACSFail(vm, string_index < 0 ? ACSE_NEGATIVE_STRING : ACSE_INVALID_STRING,
+                string_index, ACStringCount);
+    }
+    return ACStrings[string_index];
+}
+
+static int CmdTrap(acs_vm_t *vm)
+{
+    const int *args = vm->insn->args;
+
+    ACSFail(vm, args[0], args[1], args[2]);
+    return SCRIPT_TERMINATE;
+}
+
+static int CmdNOP(acs_vm_t *vm)
 {
     return SCRIPT_CONTINUE;
 }
 
-static int CmdTerminate(void)
+static int CmdTerminate(acs_vm_t *vm)
 {
     return SCRIPT_TERMINATE;
 }
 
-static int CmdSuspend(void)
+static int CmdSuspend(acs_vm_t *vm)
 {
-    ACSInfo[ACScript->infoIndex].state = ASTE_SUSPENDED;
+    vm->info->state = ASTE_SUSPENDED;
     return SCRIPT_STOP;
 }
 
-static int CmdPushNumber(void)
+static int CmdPushNumber(acs_vm_t *vm)
 {
-    Push(ReadCodeInt());
+    Push(vm, vm->insn->args[0]);
     return SCRIPT_CONTINUE;
 }
 
-static int CmdLSpec1(void)
+static int CmdLSpec1(acs_vm_t *vm)
 {
     int special;
 
-    special = ReadCodeInt();
-    SpecArgs[0] = Pop();
-    map_format.execute_line_special(special, SpecArgs, ACScript->line,
-                                    ACScript->side, ACScript->activator);
+    special = vm->insn->args[0];
+    SpecArgs[0] = Pop(vm);
+    map_format.execute_line_special(special, SpecArgs, vm->script->line,
+                                    vm->script->side, vm->script->activator);
     return SCRIPT_CONTINUE;
 }
 
-static int CmdLSpec2(void)
+static int CmdLSpec2(acs_vm_t *vm)
 {
     int special;
 
-    special = ReadCodeInt();
-    SpecArgs[1] = Pop();
-    SpecArgs[0] = Pop();
-    map_format.execute_line_special(special, SpecArgs, ACScript->line,
-                                    ACScript->side, ACScript->activator);
+    special = vm->insn->args[0];
+    SpecArgs[1] = Pop(vm);
+    SpecArgs[0] = Pop(vm);
+    map_format.execute_line_special(special, SpecArgs, vm->script->line,
+                                    vm->script->side, vm->script->activator);
     return SCRIPT_CONTINUE;
 }
 
-static int CmdLSpec3(void)
+static int CmdLSpec3(acs_vm_t *vm)
 {
     int special;
 
-    special = ReadCodeInt();
-    SpecArgs[2] = Pop();
-    SpecArgs[1] = Pop();
-    SpecArgs[0] = Pop();
-    map_format.execute_line_special(special, SpecArgs, ACScript->line,
-                                    ACScript->side, ACScript->activator);
+    special = vm->insn->args[0];
+    SpecArgs[2] = Pop(vm);
+    SpecArgs[1] = Pop(vm);
+    SpecArgs[0] = Pop(vm);
+    map_format.execute_line_special(special, SpecArgs, vm->script->line,
+                                    vm->script->side, vm->script->activator);
     return SCRIPT_CONTINUE;
 }
 
-static int CmdLSpec4(void)
+static int CmdLSpec4(acs_vm_t *vm)
 {
     int special;
 
-    special = ReadCodeInt();
-    SpecArgs[3] = Pop();
-    SpecArgs[2] = Pop();
-    SpecArgs[1] = Pop();
-    SpecArgs[0] = Pop();
-    map_format.execute_line_special(special, SpecArgs, ACScript->line,
-                                    ACScript->side, ACScript->activator);
+    special = vm->insn->args[0];
+    SpecArgs[3] = Pop(vm);
+    SpecArgs[2] = Pop(vm);
+    SpecArgs[1] = Pop(vm);
+    SpecArgs[0] = Pop(vm);
+    map_format.execute_line_special(special, SpecArgs, vm->script->line,
+                                    vm->script->side, vm->script->activator);
     return SCRIPT_CONTINUE;
 }
 
-static int CmdLSpec5(void)
+static int CmdLSpec5(acs_vm_t *vm)
 {
     int special;
 
-    special = ReadCodeInt();
-    SpecArgs[4] = Pop();
-    SpecArgs[3] = Pop();
-    SpecArgs[2] = Pop();
-    SpecArgs[1] = Pop();
-    SpecArgs[0] = Pop();
-    map_format.execute_line_special(special, SpecArgs, ACScript->line,
-                                    ACScript->side, ACScript->activator);
+    special = vm->insn->args[0];
+    SpecArgs[4] = Pop(vm);
+    SpecArgs[3] = Pop(vm);
+    SpecArgs[2] = Pop(vm);
+    SpecArgs[1] = Pop(vm);
+    SpecArgs[0] = Pop(vm);
+    map_format.execute_line_special(special, SpecArgs, vm->script->line,
+                                    vm->script->side, vm->script->activator);
     return SCRIPT_CONTINUE;
 }
 
-static int CmdLSpec1Direct(void)
+static int CmdLSpec1Direct(acs_vm_t *vm)
 {
     int special;
 
-    special = ReadCodeInt();
-    SpecArgs[0] = ReadCodeInt();
-    map_format.execute_line_special(special, SpecArgs, ACScript->line,
-                                    ACScript->side, ACScript->activator);
+    special = vm->insn->args[0];
+    SpecArgs[0] = vm->insn->args[1];
+    map_format.execute_line_special(special, SpecArgs, vm->script->line,
+                                    vm->script->side, vm->script->activator);
     return SCRIPT_CONTINUE;
 }
 
-static int CmdLSpec2Direct(void)
+static int CmdLSpec2Direct(acs_vm_t *vm)
 {
     int special;
 
-    special = ReadCodeInt();
-    SpecArgs[0] = ReadCodeInt();
-    SpecArgs[1] = ReadCodeInt();
-    map_format.execute_line_special(special, SpecArgs, ACScript->line,
-                                    ACScript->side, ACScript->activator);
+    special = vm->insn->args[0];
+    SpecArgs[0] = vm->insn->args[1];
+    SpecArgs[1] = vm->insn->args[2];
+    map_format.execute_line_special(special, SpecArgs, vm->script->line,
+                                    vm->script->side, vm->script->activator);
     return SCRIPT_CONTINUE;
 }
 
-static int CmdLSpec3Direct(void)
+static int CmdLSpec3Direct(acs_vm_t *vm)
 {
     int special;
 
-    special = ReadCodeInt();
-    SpecArgs[0] = ReadCodeInt();
-    SpecArgs[1] = ReadCodeInt();
-    SpecArgs[2] = ReadCodeInt();
-    map_format.execute_line_special(special, SpecArgs, ACScript->line,
-                                    ACScript->side, ACScript->activator);
+    special = vm->insn->args[0];
+    SpecArgs[0] = vm->insn->args[1];
+    SpecArgs[1] = vm->insn->args[2];
+    SpecArgs[2] = vm->insn->args[3];
+    map_format.execute_line_special(special, SpecArgs, vm->script->line,
+                                    vm->script->side, vm->script->activator);
     return SCRIPT_CONTINUE;
 }
 
-static int CmdLSpec4Direct(void)
+static int CmdLSpec4Direct(acs_vm_t *vm)
 {
     int special;
 
-    special = ReadCodeInt();
-    SpecArgs[0] = ReadCodeInt();
-    SpecArgs[1] = ReadCodeInt();
-    SpecArgs[2] = ReadCodeInt();
-    SpecArgs[3] = ReadCodeInt();
-    map_format.execute_line_special(special, SpecArgs, ACScript->line,
-                                    ACScript->side, ACScript->activator);
+    special = vm->insn->args[0];
+    SpecArgs[0] = vm->insn->args[1];
+    SpecArgs[1] = vm->insn->args[2];
+    SpecArgs[2] = vm->insn->args[3];
+    SpecArgs[3] = vm->insn->args[4];
+    map_format.execute_line_special(special, SpecArgs, vm->script->line,
+                                    vm->script->side, vm->script->activator);
     return SCRIPT_CONTINUE;
 }
 
-static int CmdLSpec5Direct(void)
+static int CmdLSpec5Direct(acs_vm_t *vm)
 {
     int special;
 
-    special = ReadCodeInt();
-    SpecArgs[0] = ReadCodeInt();
-    SpecArgs[1] = ReadCodeInt();
-    SpecArgs[2] = ReadCodeInt();
-    SpecArgs[3] = ReadCodeInt();
-    SpecArgs[4] = ReadCodeInt();
-    map_format.execute_line_special(special, SpecArgs, ACScript->line,
-                                    ACScript->side, ACScript->activator);
+    special = vm->insn->args[0];
+    SpecArgs[0] = vm->insn->args[1];
+    SpecArgs[1] = vm->insn->args[2];
+    SpecArgs[2] = vm->insn->args[3];
+    SpecArgs[3] = vm->insn->args[4];
+    SpecArgs[4] = vm->insn->args[5];
+    map_format.execute_line_special(special, SpecArgs, vm->script->line,
+                                    vm->script->side, vm->script->activator);
     return SCRIPT_CONTINUE;
 }
 
-static int CmdAdd(void)
+static int CmdAdd(acs_vm_t *vm)
 {
-    Push(Pop() + Pop());
+    Push(vm, Pop(vm) + Pop(vm));
     return SCRIPT_CONTINUE;
 }
 
-static int CmdSubtract(void)
+static int CmdSubtract(acs_vm_t *vm)
 {
     int operand2;
 
-    operand2 = Pop();
-    Push(Pop() - operand2);
+    operand2 = Pop(vm);
+    Push(vm, Pop(vm) - operand2);
     return SCRIPT_CONTINUE;
 }
 
-static int CmdMultiply(void)
+static int CmdMultiply(acs_vm_t *vm)
 {
-    Push(Pop() * Pop());
+    Push(vm, Pop(vm) * Pop(vm));
     return SCRIPT_CONTINUE;
 }
 
-static int CmdDivide(void)
+static int CmdDivide(acs_vm_t *vm)
 {
     int operand2;
 
-    operand2 = Pop();
-    Push(Pop() / operand2);
+    operand2 = Pop(vm);
+    Push(vm, Pop(vm) / operand2);
     return SCRIPT_CONTINUE;
 }
 
-static int CmdModulus(void)
+static int CmdModulus(acs_vm_t *vm)
 {
     int operand2;
 
-    operand2 = Pop();
-    Push(Pop() % operand2);
+    operand2 = Pop(vm);
+    Push(vm, Pop(vm) % operand2);
     return SCRIPT_CONTINUE;
 }
 
-static int CmdEQ(void)
+static int CmdEQ(acs_vm_t *vm)
 {
-    Push(Pop() == Pop());
+    Push(vm, Pop(vm) == Pop(vm));
     return SCRIPT_CONTINUE;
 }
 
-static int CmdNE(void)
+static int CmdNE(acs_vm_t *vm)
 {
-    Push(Pop() != Pop());
+    Push(vm, Pop(vm) != Pop(vm));
     return SCRIPT_CONTINUE;
 }
 
-static int CmdLT(void)
+static int CmdLT(acs_vm_t *vm)
 {
     int operand2;
 
-    operand2 = Pop();
-    Push(Pop() < operand2);
+    operand2 = Pop(vm);
+    Push(vm, Pop(vm) < operand2);
     return SCRIPT_CONTINUE;
 }
 
-static int CmdGT(void)
+static int CmdGT(acs_vm_t *vm)
 {
     int operand2;
 
-    operand2 = Pop();
-    Push(Pop() > operand2);
+    operand2 = Pop(vm);
+    Push(vm, Pop(vm) > operand2);
     return SCRIPT_CONTINUE;
 }
 
-static int CmdLE(void)
+static int CmdLE(acs_vm_t *vm)
 {
     int operand2;
 
-    operand2 = Pop();
-    Push(Pop() <= operand2);
+    operand2 = Pop(vm);
+    Push(vm, Pop(vm) <= operand2);
     return SCRIPT_CONTINUE;
 }
 
-static int CmdGE(void)
+static int CmdGE(acs_vm_t *vm)
 {
     int operand2;
 
-    operand2 = Pop();
-    Push(Pop() >= operand2);
+    operand2 = Pop(vm);
+    Push(vm, Pop(vm) >= operand2);
     return SCRIPT_CONTINUE;
 }
 
-static int CmdAssignScriptVar(void)
+static int CmdAssignScriptVar(acs_vm_t *vm)
 {
-    ACScript->vars[ReadScriptVar()] = Pop();
+    vm->script->vars[vm->insn->args[0]] = Pop(vm);
     return SCRIPT_CONTINUE;
 }
 
-static int CmdAssignMapVar(void)
+static int CmdAssignMapVar(acs_vm_t *vm)
 {
-    MapVars[ReadMapVar()] = Pop();
+    MapVars[vm->insn->args[0]] = Pop(vm);
     return SCRIPT_CONTINUE;
 }
 
-static int CmdAssignWorldVar(void)
+static int CmdAssignWorldVar(acs_vm_t *vm)
 {
-    WorldVars[ReadWorldVar()] = Pop();
+    WorldVars[vm->insn->args[0]] = Pop(vm);
     return SCRIPT_CONTINUE;
 }
 
-static int CmdPushScriptVar(void)
+static int CmdPushScriptVar(acs_vm_t *vm)
 {
-    Push(ACScript->vars[ReadScriptVar()]);
+    Push(vm, vm->script->vars[vm->insn->args[0]]);
     return SCRIPT_CONTINUE;
 }
 
-static int CmdPushMapVar(void)
+static int CmdPushMapVar(acs_vm_t *vm)
 {
-    Push(MapVars[ReadMapVar()]);
+    Push(vm, MapVars[vm->insn->args[0]]);
     return SCRIPT_CONTINUE;
 }
 
-static int CmdPushWorldVar(void)
+static int CmdPushWorldVar(acs_vm_t *vm)
 {
-    Push(WorldVars[ReadWorldVar()]);
+    Push(vm, WorldVars[vm->insn->args[0]]);
     return SCRIPT_CONTINUE;
 }
 
-static int CmdAddScriptVar(void)
+static int CmdAddScriptVar(acs_vm_t *vm)
 {
-    ACScript->vars[ReadScriptVar()] += Pop();
+    vm->script->vars[vm->insn->args[0]] += Pop(vm);
     return SCRIPT_CONTINUE;
 }
 
-static int CmdAddMapVar(void)
+static int CmdAddMapVar(acs_vm_t *vm)
 {
-    MapVars[ReadMapVar()] += Pop();
+    MapVars[vm->insn->args[0]] += Pop(vm);
     return SCRIPT_CONTINUE;
 }
 
-static int CmdAddWorldVar(void)
+static int CmdAddWorldVar(acs_vm_t *vm)
 {
-    WorldVars[ReadWorldVar()] += Pop();
+    WorldVars[vm->insn->args[0]] += Pop(vm);
     return SCRIPT_CONTINUE;
 }
 
-static int CmdSubScriptVar(void)
+static int CmdSubScriptVar(acs_vm_t *vm)
 {
-    ACScript->vars[ReadScriptVar()] -= Pop();
+    vm->script->vars[vm->insn->args[0]] -= Pop(vm);
     return SCRIPT_CONTINUE;
 }
 
-static int CmdSubMapVar(void)
+static int CmdSubMapVar(acs_vm_t *vm)
 {
-    MapVars[ReadMapVar()] -= Pop();
+    MapVars[vm->insn->args[0]] -= Pop(vm);
     return SCRIPT_CONTINUE;
 }
 
-static int CmdSubWorldVar(void)
+static int CmdSubWorldVar(acs_vm_t *vm)
 {
-    WorldVars[ReadWorldVar()] -= Pop();
+    WorldVars[vm->insn->args[0]] -= Pop(vm);
     return SCRIPT_CONTINUE;
 }
 
-static int CmdMulScriptVar(void)
+static int CmdMulScriptVar(acs_vm_t *vm)
 {
-    ACScript->vars[ReadScriptVar()] *= Pop();
+    vm->script->vars[vm->insn->args[0]] *= Pop(vm);
     return SCRIPT_CONTINUE;
 }
 
-static int CmdMulMapVar(void)
+static int CmdMulMapVar(acs_vm_t *vm)
 {
-    MapVars[ReadMapVar()] *= Pop();
+    MapVars[vm->insn->args[0]] *= Pop(vm);
     return SCRIPT_CONTINUE;
 }
 
-static int CmdMulWorldVar(void)
+static int CmdMulWorldVar(acs_vm_t *vm)
 {
-    WorldVars[ReadWorldVar()] *= Pop();
+    WorldVars[vm->insn->args[0]] *= Pop(vm);
     return SCRIPT_CONTINUE;
 }
 
-static int CmdDivScriptVar(void)
+static int CmdDivScriptVar(acs_vm_t *vm)
 {
-    ACScript->vars[ReadScriptVar()] /= Pop();
+    vm->script->vars[vm->insn->args[0]] /= Pop(vm);
     return SCRIPT_CONTINUE;
 }
 
-static int CmdDivMapVar(void)
+static int CmdDivMapVar(acs_vm_t *vm)
 {
-    MapVars[ReadMapVar()] /= Pop();
+    MapVars[vm->insn->args[0]] /= Pop(vm);
     return SCRIPT_CONTINUE;
 }
 
-static int CmdDivWorldVar(void)
+static int CmdDivWorldVar(acs_vm_t *vm)
 {
-    WorldVars[ReadWorldVar()] /= Pop();
+    WorldVars[vm->insn->args[0]] /= Pop(vm);
     return SCRIPT_CONTINUE;
 }
 
-static int CmdModScriptVar(void)
+static int CmdModScriptVar(acs_vm_t *vm)
 {
-    ACScript->vars[ReadScriptVar()] %= Pop();
+    vm->script->vars[vm->insn->args[0]] %= Pop(vm);
     return SCRIPT_CONTINUE;
 }
 
-static int CmdModMapVar(void)
+static int CmdModMapVar(acs_vm_t *vm)
 {
-    MapVars[ReadMapVar()] %= Pop();
+    MapVars[vm->insn->args[0]] %= Pop(vm);
     return SCRIPT_CONTINUE;
 }
 
-static int CmdModWorldVar(void)
+static int CmdModWorldVar(acs_vm_t *vm)
 {
-    WorldVars[ReadWorldVar()] %= Pop();
+    WorldVars[vm->insn->args[0]] %= Pop(vm);
     return SCRIPT_CONTINUE;
 }
 
-static int CmdIncScriptVar(void)
+static int CmdIncScriptVar(acs_vm_t *vm)
 {
-    ++ACScript->vars[ReadScriptVar()];
+    ++vm->script->vars[vm->insn->args[0]];
     return SCRIPT_CONTINUE;
 }
 
-static int CmdIncMapVar(void)
+static int CmdIncMapVar(acs_vm_t *vm)
 {
-    ++MapVars[ReadMapVar()];
+    ++MapVars[vm->insn->args[0]];
     return SCRIPT_CONTINUE;
 }
 
-static int CmdIncWorldVar(void)
+static int CmdIncWorldVar(acs_vm_t *vm)
 {
-    ++WorldVars[ReadWorldVar()];
+    ++WorldVars[vm->insn->args[0]];
     return SCRIPT_CONTINUE;
 }
 
-static int CmdDecScriptVar(void)
+static int CmdDecScriptVar(acs_vm_t *vm)
 {
-    --ACScript->vars[ReadScriptVar()];
+    --vm->script->vars[vm->insn->args[0]];
     return SCRIPT_CONTINUE;
 }
 
-static int CmdDecMapVar(void)
+static int CmdDecMapVar(acs_vm_t *vm)
 {
-    --MapVars[ReadMapVar()];
+    --MapVars[vm->insn->args[0]];
     return SCRIPT_CONTINUE;
 }
 
-static int CmdDecWorldVar(void)
+static int CmdDecWorldVar(acs_vm_t *vm)
 {
-    --WorldVars[ReadWorldVar()];
+    --WorldVars[vm->insn->args[0]];
     return SCRIPT_CONTINUE;
 }
 
-static int CmdGoto(void)
+static int CmdGoto(acs_vm_t *vm)
 {
-    PCodeOffset = ReadOffset();
+    vm->next = &ACSCode[vm->insn->args[0]];
     return SCRIPT_CONTINUE;
 }
 
-static int CmdIfGoto(void)
+static int CmdIfGoto(acs_vm_t *vm)
 {
-    int offset;
+    int target;
 
-    offset = ReadOffset();
+    target = vm->insn->args[0];
 
-    if (Pop() != 0)
+    if (Pop(vm) != 0)
     {
-        PCodeOffset = offset;
+        vm->next = &ACSCode[target];
     }
     return SCRIPT_CONTINUE;
 }
 
-static int CmdDrop(void)
+static int CmdDrop(acs_vm_t *vm)
 {
-    Drop();
+    Drop(vm);
     return SCRIPT_CONTINUE;
 }
 
-static int CmdDelay(void)
+static int CmdDelay(acs_vm_t *vm)
 {
-    ACScript->delayCount = Pop();
+    vm->script->delayCount = Pop(vm);
     return SCRIPT_STOP;
 }
 
-static int CmdDelayDirect(void)
+static int CmdDelayDirect(acs_vm_t *vm)
 {
-    ACScript->delayCount = ReadCodeInt();
+    vm->script->delayCount = vm->insn->args[0];
     return SCRIPT_STOP;
 }
 
-static int CmdRandom(void)
+static int CmdRandom(acs_vm_t *vm)
 {
     int low;
     int high;
 
-    high = Pop();
-    low = Pop();
-    Push(low + (P_Random(pr_hexen) % (high - low + 1)));
+    high = Pop(vm);
+    low = Pop(vm);
+    Push(vm, low + (P_Random(pr_hexen) % (high - low + 1)));
     return SCRIPT_CONTINUE;
 }
 
-static int CmdRandomDirect(void)
+static int CmdRandomDirect(acs_vm_t *vm)
 {
     int low;
     int high;
 
-    low = ReadCodeInt();
-    high = ReadCodeInt();
-    Push(low + (P_Random(pr_hexen) % (high - low + 1)));
+    low = vm->insn->args[0];
+    high = vm->insn->args[1];
+    Push(vm, low + (P_Random(pr_hexen) % (high - low + 1)));
     return SCRIPT_CONTINUE;
 }
 
-static int CmdThingCount(void)
+static int CmdThingCount(acs_vm_t *vm)
 {
     int tid;
 
-    tid = Pop();
-    ThingCount(Pop(), tid);
+    tid = Pop(vm);
+    ThingCount(vm, Pop(vm), tid);
     return SCRIPT_CONTINUE;
 }
 
-static int CmdThingCountDirect(void)
+static int CmdThingCountDirect(acs_vm_t *vm)
 {
     int type;
 
-    type = ReadCodeInt();
-    ThingCount(type, ReadCodeInt());
+    type = vm->insn->args[0];
+    ThingCount(vm, type, vm->insn->args[1]);
     return SCRIPT_CONTINUE;
 }
 
-static void ThingCount(int type, int tid)
+static void ThingCount(acs_vm_t *vm, int type, int tid)
 {
     int count;
     int searcher;
@@ -1334,45 +1938,45 @@ static void ThingCount(int type, int tid)
             count++;
         }
     }
-    Push(count);
+    Push(vm, count);
 }
 
-static int CmdTagWait(void)
+static int CmdTagWait(acs_vm_t *vm)
 {
-    ACSInfo[ACScript->infoIndex].waitValue = Pop();
-    ACSInfo[ACScript->infoIndex].state = ASTE_WAITINGFORTAG;
+    vm->info->waitValue = Pop(vm);
+    vm->info->state = ASTE_WAITINGFORTAG;
     return SCRIPT_STOP;
 }
 
-static int CmdTagWaitDirect(void)
+static int CmdTagWaitDirect(acs_vm_t *vm)
 {
-    ACSInfo[ACScript->infoIndex].waitValue = ReadCodeInt();
-    ACSInfo[ACScript->infoIndex].state = ASTE_WAITINGFORTAG;
+    vm->info->waitValue = vm->insn->args[0];
+    vm->info->state = ASTE_WAITINGFORTAG;
     return SCRIPT_STOP;
 }
 
-static int CmdPolyWait(void)
+static int CmdPolyWait(acs_vm_t *vm)
 {
-    ACSInfo[ACScript->infoIndex].waitValue = Pop();
-    ACSInfo[ACScript->infoIndex].state = ASTE_WAITINGFORPOLY;
+    vm->info->waitValue = Pop(vm);
+    vm->info->state = ASTE_WAITINGFORPOLY;
     return SCRIPT_STOP;
 }
 
-static int CmdPolyWaitDirect(void)
+static int CmdPolyWaitDirect(acs_vm_t *vm)
 {
-    ACSInfo[ACScript->infoIndex].waitValue = ReadCodeInt();
-    ACSInfo[ACScript->infoIndex].state = ASTE_WAITINGFORPOLY;
+    vm->info->waitValue = vm->insn->args[0];
+    vm->info->state = ASTE_WAITINGFORPOLY;
     return SCRIPT_STOP;
 }
 
-static int CmdChangeFloor(void)
+static int CmdChangeFloor(acs_vm_t *vm)
 {
     int tag;
     int flat;
     const int *id_p;
 
-    flat = R_FlatNumForName(StringLookup(Pop()));
-    tag = Pop();
+    flat = R_FlatNumForName(StringLookup(vm, Pop(vm)));
+    tag = Pop(vm);
     FIND_SECTORS(id_p, tag)
     {
         sectors[*id_p].floorpic = flat;
@@ -1380,14 +1984,14 @@ static int CmdChangeFloor(void)
     return SCRIPT_CONTINUE;
 }
 
-static int CmdChangeFloorDirect(void)
+static int CmdChangeFloorDirect(acs_vm_t *vm)
 {
     int tag;
     int flat;
     const int *id_p;
 
-    tag = ReadCodeInt();
-    flat = R_FlatNumForName(StringLookup(ReadCodeInt()));
+    tag = vm->insn->args[0];
+    flat = R_FlatNumForName(ACStrings[vm->insn->args[1]]);
     FIND_SECTORS(id_p, tag)
     {
         sectors[*id_p].floorpic = flat;
@@ -1395,14 +1999,14 @@ static int CmdChangeFloorDirect(void)
     return SCRIPT_CONTINUE;
 }
 
-static int CmdChangeCeiling(void)
+static int CmdChangeCeiling(acs_vm_t *vm)
 {
     int tag;
     int flat;
     const int *id_p;
 
-    flat = R_FlatNumForName(StringLookup(Pop()));
-    tag = Pop();
+    flat = R_FlatNumForName(StringLookup(vm, Pop(vm)));
+    tag = Pop(vm);
     FIND_SECTORS(id_p, tag)
     {
         sectors[*id_p].ceilingpic = flat;
@@ -1410,14 +2014,14 @@ static int CmdChangeCeiling(void)
     return SCRIPT_CONTINUE;
 }
 
-static int CmdChangeCeilingDirect(void)
+static int CmdChangeCeilingDirect(acs_vm_t *vm)
 {
     int tag;
     int flat;
     const int *id_p;
 
-    tag = ReadCodeInt();
-    flat = R_FlatNumForName(StringLookup(ReadCodeInt()));
+    tag = vm->insn->args[0];
+    flat = R_FlatNumForName(ACStrings[vm->insn->args[1]]);
     FIND_SECTORS(id_p, tag)
     {
         sectors[*id_p].ceilingpic = flat;
@@ -1425,144 +2029,144 @@ static int CmdChangeCeilingDirect(void)
     return SCRIPT_CONTINUE;
 }
 
-static int CmdRestart(void)
+static int CmdRestart(acs_vm_t *vm)
 {
-    PCodeOffset = ACSInfo[ACScript->infoIndex].offset;
+    vm->next = &ACSCode[ACSEntries[vm->script->infoIndex]];
     return SCRIPT_CONTINUE;
 }
 
-static int CmdAndLogical(void)
+static int CmdAndLogical(acs_vm_t *vm)
 {
-    Push(Pop() && Pop());
+    Push(vm, Pop(vm) && Pop(vm));
     return SCRIPT_CONTINUE;
 }
 
-static int CmdOrLogical(void)
+static int CmdOrLogical(acs_vm_t *vm)
 {
-    Push(Pop() || Pop());
+    Push(vm, Pop(vm) || Pop(vm));
     return SCRIPT_CONTINUE;
 }
 
-static int CmdAndBitwise(void)
+static int CmdAndBitwise(acs_vm_t *vm)
 {
-    Push(Pop() & Pop());
+    Push(vm, Pop(vm) & Pop(vm));
     return SCRIPT_CONTINUE;
 }
 
-static int CmdOrBitwise(void)
+static int CmdOrBitwise(acs_vm_t *vm)
 {
-    Push(Pop() | Pop());
+    Push(vm, Pop(vm) | Pop(vm));
     return SCRIPT_CONTINUE;
 }
 
-static int CmdEorBitwise(void)
+static int CmdEorBitwise(acs_vm_t *vm)
 {
-    Push(Pop() ^ Pop());
+    Push(vm, Pop(vm) ^ Pop(vm));
     return SCRIPT_CONTINUE;
 }
 
-static int CmdNegateLogical(void)
+static int CmdNegateLogical(acs_vm_t *vm)
 {
-    Push(!Pop());
+    Push(vm, !Pop(vm));
     return SCRIPT_CONTINUE;
 }
 
-static int CmdLShift(void)
+static int CmdLShift(acs_vm_t *vm)
 {
     int operand2;
 
-    operand2 = Pop();
-    Push(Pop() << operand2);
+    operand2 = Pop(vm);
+    Push(vm, Pop(vm) << operand2);
     return SCRIPT_CONTINUE;
 }
 
-static int CmdRShift(void)
+static int CmdRShift(acs_vm_t *vm)
 {
     int operand2;
 
-    operand2 = Pop();
-    Push(Pop() >> operand2);
+    operand2 = Pop(vm);
+    Push(vm, Pop(vm) >> operand2);
     return SCRIPT_CONTINUE;
 }
 
-static int CmdUnaryMinus(void)
+static int CmdUnaryMinus(acs_vm_t *vm)
 {
-    Push(-Pop());
+    Push(vm, -Pop(vm));
     return SCRIPT_CONTINUE;
 }
 
-static int CmdIfNotGoto(void)
+static int CmdIfNotGoto(acs_vm_t *vm)
 {
-    int offset;
+    int target;
 
-    offset = ReadOffset();
+    target = vm->insn->args[0];
 
-    if (Pop() == 0)
+    if (Pop(vm) == 0)
     {
-        PCodeOffset = offset;
+        vm->next = &ACSCode[target];
     }
     return SCRIPT_CONTINUE;
 }
 
-static int CmdLineSide(void)
+static int CmdLineSide(acs_vm_t *vm)
 {
-    Push(ACScript->side);
+    Push(vm, vm->script->side);
     return SCRIPT_CONTINUE;
 }
 
-static int CmdScriptWait(void)
+static int CmdScriptWait(acs_vm_t *vm)
 {
-    ACSInfo[ACScript->infoIndex].waitValue = Pop();
-    ACSInfo[ACScript->infoIndex].state = ASTE_WAITINGFORSCRIPT;
+    vm->info->waitValue = Pop(vm);
+    vm->info->state = ASTE_WAITINGFORSCRIPT;
     return SCRIPT_STOP;
 }
 
-static int CmdScriptWaitDirect(void)
+static int CmdScriptWaitDirect(acs_vm_t *vm)
 {
-    ACSInfo[ACScript->infoIndex].waitValue = ReadCodeInt();
-    ACSInfo[ACScript->infoIndex].state = ASTE_WAITINGFORSCRIPT;
+    vm->info->waitValue = vm->insn->args[0];
+    vm->info->state = ASTE_WAITINGFORSCRIPT;
     return SCRIPT_STOP;
 }
 
-static int CmdClearLineSpecial(void)
+static int CmdClearLineSpecial(acs_vm_t *vm)
 {
-    if (ACScript->line)
+    if (vm->script->line)
     {
-        ACScript->line->special = 0;
+        vm->script->line->special = 0;
     }
     return SCRIPT_CONTINUE;
 }
 
-static int CmdCaseGoto(void)
+static int CmdCaseGoto(acs_vm_t *vm)
 {
     int value;
-    int offset;
+    int target;
 
-    value = ReadCodeInt();
-    offset = ReadOffset();
+    value = vm->insn->args[0];
+    target = vm->insn->args[1];
 
-    if (Top() == value)
+    if (Top(vm) == value)
     {
-        PCodeOffset = offset;
-        Drop();
+        vm->next = &ACSCode[target];
+        Drop(vm);
     }
 
     return SCRIPT_CONTINUE;
 }
 
-static int CmdBeginPrint(void)
+static int CmdBeginPrint(acs_vm_t *vm)
 {
     *PrintBuffer = 0;
     return SCRIPT_CONTINUE;
 }
 
-static int CmdEndPrint(void)
+static int CmdEndPrint(acs_vm_t *vm)
 {
     player_t *player;
 
-    if (ACScript->activator && ACScript->activator->player)
+    if (vm->script->activator && vm->script->activator->player)
     {
-        player = ACScript->activator->player;
+        player = vm->script->activator->player;
     }
     else
     {
@@ -1572,7 +2176,7 @@ static int CmdEndPrint(void)
     return SCRIPT_CONTINUE;
 }
 
-static int CmdEndPrintBold(void)
+static int CmdEndPrintBold(acs_vm_t *vm)
 {
     int i;
 
@@ -1586,33 +2190,33 @@ static int CmdEndPrintBold(void)
     return SCRIPT_CONTINUE;
 }
 
-static int CmdPrintString(void)
+static int CmdPrintString(acs_vm_t *vm)
 {
-    M_StringConcat(PrintBuffer, StringLookup(Pop()), sizeof(PrintBuffer));
+    M_StringConcat(PrintBuffer, StringLookup(vm, Pop(vm)), sizeof(PrintBuffer));
     return SCRIPT_CONTINUE;
 }
 
-static int CmdPrintNumber(void)
+static int CmdPrintNumber(acs_vm_t *vm)
 {
     char tempStr[16];
 
-    snprintf(tempStr, sizeof(tempStr), "%d", Pop());
+    snprintf(tempStr, sizeof(tempStr), "%d", Pop(vm));
     M_StringConcat(PrintBuffer, tempStr, sizeof(PrintBuffer));
     return SCRIPT_CONTINUE;
 }
 
-static int CmdPrintCharacter(void)
+static int CmdPrintCharacter(acs_vm_t *vm)
 {
     char tempStr[2];
 
-    tempStr[0] = Pop();
+    tempStr[0] = Pop(vm);
     tempStr[1] = '\0';
     M_StringConcat(PrintBuffer, tempStr, sizeof(PrintBuffer));
 
     return SCRIPT_CONTINUE;
 }
 
-static int CmdPlayerCount(void)
+static int CmdPlayerCount(acs_vm_t *vm)
 {
     int i;
     int count;
@@ -1622,11 +2226,11 @@ static int CmdPlayerCount(void)
     {
         count += playeringame[i];
     }
-    Push(count);
+    Push(vm, count);
     return SCRIPT_CONTINUE;
 }
 
-static int CmdGameType(void)
+static int CmdGameType(acs_vm_t *vm)
 {
     int gametype;
 
@@ -1642,38 +2246,38 @@ static int CmdGameType(void)
     {
         gametype = GAME_NET_COOPERATIVE;
     }
-    Push(gametype);
+    Push(vm, gametype);
     return SCRIPT_CONTINUE;
 }
 
-static int CmdGameSkill(void)
+static int CmdGameSkill(acs_vm_t *vm)
 {
-    Push(gameskill);
+    Push(vm, gameskill);
     return SCRIPT_CONTINUE;
 }
 
-static int CmdTimer(void)
+static int CmdTimer(acs_vm_t *vm)
 {
-    Push(leveltime);
+    Push(vm, leveltime);
     return SCRIPT_CONTINUE;
 }
 
-static int CmdSectorSound(void)
+static int CmdSectorSound(acs_vm_t *vm)
 {
     int volume;
     mobj_t *mobj;
 
     mobj = NULL;
-    if (ACScript->line)
+    if (vm->script->line)
     {
-        mobj = (mobj_t *) & ACScript->line->frontsector->soundorg;
+        mobj = (mobj_t *) & vm->script->line->frontsector->soundorg;
     }
-    volume = Pop();
-    S_StartSoundAtVolume(mobj, S_GetSoundID(StringLookup(Pop())), volume, 0);
+    volume = Pop(vm);
+    S_StartSoundAtVolume(mobj, S_GetSoundID(StringLookup(vm, Pop(vm))), volume, 0);
     return SCRIPT_CONTINUE;
 }
 
-static int CmdThingSound(void)
+static int CmdThingSound(acs_vm_t *vm)
 {
     int tid;
     int sound;
@@ -1681,9 +2285,9 @@ static int CmdThingSound(void)
     mobj_t *mobj;
     int searcher;
 
-    volume = Pop();
-    sound = S_GetSoundID(StringLookup(Pop()));
-    tid = Pop();
+    volume = Pop(vm);
+    sound = S_GetSoundID(StringLookup(vm, Pop(vm)));
+    tid = Pop(vm);
     searcher = -1;
     while ((mobj = P_FindMobjFromTID(tid, &searcher)) != NULL)
     {
@@ -1692,29 +2296,29 @@ static int CmdThingSound(void)
     return SCRIPT_CONTINUE;
 }
 
-static int CmdAmbientSound(void)
+static int CmdAmbientSound(acs_vm_t *vm)
 {
     int volume;
 
-    volume = Pop();
-    S_StartSoundAtVolume(NULL, S_GetSoundID(StringLookup(Pop())), volume, 0);
+    volume = Pop(vm);
+    S_StartSoundAtVolume(NULL, S_GetSoundID(StringLookup(vm, Pop(vm))), volume, 0);
     return SCRIPT_CONTINUE;
 }
 
-static int CmdSoundSequence(void)
+static int CmdSoundSequence(acs_vm_t *vm)
 {
     mobj_t *mobj;
 
     mobj = NULL;
-    if (ACScript->line)
+    if (vm->script->line)
     {
-        mobj = (mobj_t *) & ACScript->line->frontsector->soundorg;
+        mobj = (mobj_t *) & vm->script->line->frontsector->soundorg;
     }
-    SN_StartSequenceName(mobj, StringLookup(Pop()));
+    SN_StartSequenceName(mobj, StringLookup(vm, Pop(vm)));
     return SCRIPT_CONTINUE;
 }
 
-static int CmdSetLineTexture(void)
+static int CmdSetLineTexture(acs_vm_t *vm)
 {
     line_t *line;
     int lineTag;
@@ -1723,10 +2327,10 @@ static int CmdSetLineTexture(void)
     int texture;
     int searcher;
 
-    texture = R_TextureNumForName(StringLookup(Pop()));
-    position = Pop();
-    side = Pop();
-    lineTag = Pop();
+    texture = R_TextureNumForName(StringLookup(vm, Pop(vm)));
+    position = Pop(vm);
+    side = Pop(vm);
+    lineTag = Pop(vm);
     searcher = -1;
     while ((line = P_FindLine(lineTag, &searcher)) != NULL)
     {
@@ -1746,15 +2350,15 @@ static int CmdSetLineTexture(void)
     return SCRIPT_CONTINUE;
 }
 
-static int CmdSetLineBlocking(void)
+static int CmdSetLineBlocking(acs_vm_t *vm)
 {
     line_t *line;
     int lineTag;
     dboolean blocking;
     int searcher;
 
-    blocking = Pop()? ML_BLOCKING : 0;
-    lineTag = Pop();
+    blocking = Pop(vm)? ML_BLOCKING : 0;
+    lineTag = Pop(vm);
     searcher = -1;
     while ((line = P_FindLine(lineTag, &searcher)) != NULL)
     {
@@ -1763,20 +2367,20 @@ static int CmdSetLineBlocking(void)
     return SCRIPT_CONTINUE;
 }
 
-static int CmdSetLineSpecial(void)
+static int CmdSetLineSpecial(acs_vm_t *vm)
 {
     line_t *line;
     int lineTag;
     int special, arg1, arg2, arg3, arg4, arg5;
     int searcher;
 
-    arg5 = Pop();
-    arg4 = Pop();
-    arg3 = Pop();
-    arg2 = Pop();
-    arg1 = Pop();
-    special = Pop();
-    lineTag = Pop();
+    arg5 = Pop(vm);
+    arg4 = Pop(vm);
+    arg3 = Pop(vm);
+    arg2 = Pop(vm);
+    arg1 = Pop(vm);
+    special = Pop(vm);
+    lineTag = Pop(vm);
     searcher = -1;
     while ((line = P_FindLine(lineTag, &searcher)) != NULL)
     {
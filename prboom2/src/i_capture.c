@@ -33,6 +33,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "i_sound.h"
 #include "i_video.h"
 #include "lprintf.h"
@@ -62,16 +63,127 @@ static pipeinfo_t soundpipe;
 static pipeinfo_t videopipe;
 static pipeinfo_t muxpipe;
 
+// Frames are copied into a bounded ring and written to the pipes by a
+// writer thread per pipe, so the game only waits when the encoder falls
+// a whole ring behind (or never, when dropping frames)
+
+#define SOUND_QUEUE_FRAMES 64 // sound is small, and is never dropped
+
+typedef size_t (*capture_convert_t) (unsigned char *dest, const unsigned char *src, int width, int height);
+
+typedef struct
+{
+  unsigned char *data;
+  size_t size;
+  size_t capacity;
+  int width;
+  int height;
+  int repeats; // frames dropped after this one, written as copies of it
+} capture_slot_t;
+
+typedef struct
+{
+  pipeinfo_t *pipe;
+  capture_slot_t *slots;
+  int size;
+  capture_convert_t convert; // applied by the writer thread
+  unsigned char *scratch;
+  size_t scratch_capacity;
+  int head; // written by the game thread
+  int tail; // written by the writer thread
+  dboolean closing;
+  dboolean drop;
+  SDL_mutex *mutex;
+  SDL_cond *cond;
+  SDL_Thread *thread; // NULL if frames are written by the game thread
+
+  // statistics
+  int frames;
+  int dropped;
+  int blocked;
+  int max_depth;
+  double total_depth;
+  Uint32 blocked_ms;
+  int write_errors; // only touched by the writer until it is joined
+} capture_queue_t;
+
+static capture_queue_t soundqueue;
+static capture_queue_t videoqueue;
+
+// BT.601 studio swing, the yuv420p that ffmpeg assumes
+#define CAP_Y(r, g, b) (((66 * (r) + 129 * (g) + 25 * (b) + 128) >> 8) + 16)
+#define CAP_U(r, g, b) (((-38 * (r) - 74 * (g) + 112 * (b) + 128) >> 8) + 128)
+#define CAP_V(r, g, b) (((112 * (r) - 94 * (g) - 18 * (b) + 128) >> 8) + 128)
+
+// RGB24 to planar YUV 4:2:0, each chroma sample from a 2x2 block
+// (odd sizes round the chroma planes up, as ffmpeg does).
+// The loops are kept simple so the compiler can vectorize them.
+static size_t ConvertYUV420 (unsigned char *dest, const unsigned char *src, int width, int height)
+{
+  int cw = (width + 1) / 2;
+  int ch = (height + 1) / 2;
+  unsigned char *py = dest;
+  unsigned char *pu = py + width * height;
+  unsigned char *pv = pu + cw * ch;
+  int x, y;
+
+  if (!dest)
+    return width * height + 2 * cw * ch;
+
+  for (y = 0; y < height; y++)
+  {
+    const unsigned char *s = src + y * width * 3;
+    unsigned char *d = py + y * width;
+
+    for (x = 0; x < width; x++)
+      d[x] = CAP_Y (s[3 * x], s[3 * x + 1], s[3 * x + 2]);
+  }
+
+  for (y = 0; y < ch; y++)
+  {
+    const unsigned char *s0 = src + 2 * y * width * 3;
+    const unsigned char *s1 = 2 * y + 1 < height ? s0 + width * 3 : s0;
+    unsigned char *du = pu + y * cw;
+    unsigned char *dv = pv + y * cw;
+
+    for (x = 0; x < cw; x++)
+    {
+      int x0 = 6 * x;
+      int x1 = 2 * x + 1 < width ? x0 + 3 : x0;
+      int r = (s0[x0] + s0[x1] + s1[x0] + s1[x1] + 2) >> 2;
+      int g = (s0[x0 + 1] + s0[x1 + 1] + s1[x0 + 1] + s1[x1 + 1] + 2) >> 2;
+      int b = (s0[x0 + 2] + s0[x1 + 2] + s1[x0 + 2] + s1[x1 + 2] + 2) >> 2;
+
+      du[x] = CAP_U (r, g, b);
+      dv[x] = CAP_V (r, g, b);
+    }
+  }
+
+  return width * height + 2 * cw * ch;
+}
+
 int cap_fps;
 int cap_frac;
 int cap_wipescreen;
 
+// video pipe formats
+enum
+{
+  cap_rgb24,
+  cap_yuv420p, // converted by the writer thread, half the pipe traffic
+};
+
+static int cap_pixel_format;
+
+static const char *cap_pixel_format_names[] = { "rgb24", "yuv420p" };
+
 // parses a command with simple printf-style replacements.
 
 // %w video width (px)
 // %h video height (px)
 // %s sound rate (hz)
 // %f filename passed to -viddump
+// %p pixel format of the video pipe (ffmpeg name)
 // %% single percent sign
 // TODO: add aspect ratio information
 //
@@ -102,6 +214,9 @@ static int parsecommand (char *out, const char *in, int len)
         case 'r':
           i = snprintf (out, len, "%u", cap_fps);
           break;
+        case 'p':
+          i = snprintf (out, len, "%s", cap_pixel_format_names[cap_pixel_format]);
+          break;
         case '%':
           i = snprintf (out, len, "%%");
           break;
@@ -487,6 +602,231 @@ static int threadstderrproc (void *data)
   return 1;
 }
 
+// Returns the frame in the pipe's format, in size bytes
+static const unsigned char *ConvertCaptureFrame (capture_queue_t *q, const unsigned char *data,
+                                                 size_t *size, int width, int height)
+{
+  size_t needed;
+
+  if (!*size || !q->convert)
+    return data;
+
+  needed = q->convert (NULL, NULL, width, height);
+
+  if (needed > q->scratch_capacity)
+  {
+    free (q->scratch);
+    q->scratch = malloc (needed);
+    q->scratch_capacity = q->scratch ? needed : 0;
+  }
+
+  if (!q->scratch)
+  {
+    *size = 0;
+    return data;
+  }
+
+  *size = q->convert (q->scratch, data, width, height);
+  return q->scratch;
+}
+
+static void WriteCaptureFrame (capture_queue_t *q, const unsigned char *data, size_t size)
+{
+  if (size && fwrite (data, size, 1, q->pipe->f_stdin) != 1)
+    q->write_errors++;
+}
+
+static int threadwriterproc (void *data)
+{ // writes queued frames to a pipe
+  capture_queue_t *q = (capture_queue_t *) data;
+
+  while (1)
+  {
+    capture_slot_t *slot;
+    const unsigned char *data;
+    size_t size;
+    int i, repeats;
+
+    SDL_LockMutex (q->mutex);
+    while (q->tail == q->head && !q->closing)
+      SDL_CondWait (q->cond, q->mutex);
+    if (q->tail == q->head)
+    {
+      SDL_UnlockMutex (q->mutex);
+      break;
+    }
+    slot = &q->slots[q->tail % q->size];
+    SDL_UnlockMutex (q->mutex);
+
+    size = slot->size;
+    data = ConvertCaptureFrame (q, slot->data, &size, slot->width, slot->height);
+    WriteCaptureFrame (q, data, size);
+
+    // the game thread only adds repeats to the newest frame, and only
+    // while the ring is full, so once this is the oldest they are final
+    SDL_LockMutex (q->mutex);
+    repeats = slot->repeats;
+    slot->repeats = 0;
+    SDL_UnlockMutex (q->mutex);
+
+    for (i = 0; i < repeats; i++)
+      WriteCaptureFrame (q, data, size);
+
+    SDL_LockMutex (q->mutex);
+    q->tail++;
+    SDL_CondSignal (q->cond);
+    SDL_UnlockMutex (q->mutex);
+  }
+
+  return 1;
+}
+
+static void StartCaptureQueue (capture_queue_t *q, pipeinfo_t *pipe, int size, dboolean drop,
+                               capture_convert_t convert, const char *name)
+{
+  memset (q, 0, sizeof (*q));
+  q->pipe = pipe;
+  q->size = size;
+  q->drop = drop;
+  q->convert = convert;
+  q->slots = calloc (size, sizeof (*q->slots));
+  q->mutex = SDL_CreateMutex ();
+  q->cond = SDL_CreateCond ();
+
+  if (q->slots && q->mutex && q->cond)
+    q->thread = SDL_CreateThread (threadwriterproc, name, q);
+
+  if (!q->thread)
+  {
+    // write each frame as it is captured, as before the queue existed
+    lprintf (LO_WARN, "I_CapturePrep: unable to start %s, writing frames directly: %s\n",
+             name, SDL_GetError ());
+    free (q->slots);
+    q->slots = NULL;
+    q->size = 0;
+    if (q->cond)
+      SDL_DestroyCond (q->cond);
+    q->cond = NULL;
+    if (q->mutex)
+      SDL_DestroyMutex (q->mutex);
+    q->mutex = NULL;
+  }
+}
+
+// Returns the slot to fill, or NULL if the frame is dropped
+static capture_slot_t *ReserveCaptureSlot (capture_queue_t *q)
+{
+  static capture_slot_t direct; // never filled, frames are written at once
+
+  capture_slot_t *slot;
+
+  if (!q->thread)
+    return &direct;
+
+  SDL_LockMutex (q->mutex);
+
+  if (q->head - q->tail == q->size)
+  {
+    if (q->drop)
+    {
+      // keep audio and video in sync by repeating the newest frame
+      q->slots[(q->head - 1) % q->size].repeats++;
+      q->dropped++;
+      SDL_UnlockMutex (q->mutex);
+      return NULL;
+    }
+    else
+    {
+      Uint32 start = SDL_GetTicks ();
+
+      q->blocked++;
+      while (q->head - q->tail == q->size)
+        SDL_CondWait (q->cond, q->mutex);
+      q->blocked_ms += SDL_GetTicks () - start;
+    }
+  }
+
+  slot = &q->slots[q->head % q->size];
+  SDL_UnlockMutex (q->mutex);
+
+  return slot;
+}
+
+static void QueueCaptureFrame (capture_queue_t *q, capture_slot_t *slot, const unsigned char *data,
+                               size_t size, int width, int height)
+{
+  int depth;
+
+  if (!q->thread)
+  {
+    data = ConvertCaptureFrame (q, data, &size, width, height);
+    WriteCaptureFrame (q, data, size);
+    q->frames++;
+    return;
+  }
+
+  if (size > slot->capacity)
+  {
+    unsigned char *newdata = realloc (slot->data, size);
+
+    if (!newdata)
+      size = 0;
+    else
+    {
+      slot->data = newdata;
+      slot->capacity = size;
+    }
+  }
+
+  if (size)
+    memcpy (slot->data, data, size);
+  slot->size = size;
+  slot->width = width;
+  slot->height = height;
+
+  SDL_LockMutex (q->mutex);
+  q->head++;
+  depth = q->head - q->tail;
+  SDL_CondSignal (q->cond);
+  SDL_UnlockMutex (q->mutex);
+
+  q->frames++;
+  q->total_depth += depth;
+  if (depth > q->max_depth)
+    q->max_depth = depth;
+}
+
+// Writes out what is left in the queue, then reports on it
+static void FinishCaptureQueue (capture_queue_t *q, const char *name)
+{
+  int s, i;
+
+  if (q->thread)
+  {
+    SDL_LockMutex (q->mutex);
+    q->closing = true;
+    SDL_CondSignal (q->cond);
+    SDL_UnlockMutex (q->mutex);
+    SDL_WaitThread (q->thread, &s);
+  }
+
+  lprintf (LO_INFO, "I_CaptureFinish: %s: %d frames, %d dropped, blocked %d times for %u ms, "
+           "queue depth %.1f average, %d peak of %d\n",
+           name, q->frames, q->dropped, q->blocked, q->blocked_ms,
+           q->frames ? q->total_depth / q->frames : 0.0, q->max_depth, q->size);
+  if (q->write_errors)
+    lprintf (LO_WARN, "I_CaptureFinish: %d errors writing %s\n", q->write_errors, name);
+
+  for (i = 0; i < q->size; i++)
+    free (q->slots[i].data);
+  free (q->slots);
+  free (q->scratch);
+  if (q->cond)
+    SDL_DestroyCond (q->cond);
+  if (q->mutex)
+    SDL_DestroyMutex (q->mutex);
+  memset (q, 0, sizeof (*q));
+}
 
 // init and open sound, video pipes
 // fn is filename passed from command line, typically final output file
@@ -501,6 +841,10 @@ void I_CapturePrep (const char *fn)
   cap_muxcommand = dsda_StringConfig(dsda_config_cap_muxcommand);
   cap_wipescreen = dsda_IntConfig(dsda_config_cap_wipescreen);
   cap_fps = dsda_IntConfig(dsda_config_cap_fps);
+  cap_pixel_format = dsda_IntConfig(dsda_config_cap_pixel_format);
+
+  if (cap_pixel_format != cap_rgb24 && !strstr (cap_videocommand, "%p"))
+    lprintf (LO_WARN, "I_CapturePrep: cap_videocommand should take the pixel format from %%p\n");
 
   vid_fname = fn;
 
@@ -552,6 +896,12 @@ void I_CapturePrep (const char *fn)
   videopipe.outthread = SDL_CreateThread (threadstdoutproc, "videopipe.outthread", &videopipe);
   videopipe.errthread = SDL_CreateThread (threadstderrproc, "videopipe.errthread", &videopipe);
 
+  // start writer threads
+  StartCaptureQueue (&soundqueue, &soundpipe, SOUND_QUEUE_FRAMES, false, NULL, "soundpipe.writer");
+  StartCaptureQueue (&videoqueue, &videopipe, dsda_IntConfig(dsda_config_cap_queue_frames),
+                     dsda_IntConfig(dsda_config_cap_drop_frames),
+                     cap_pixel_format == cap_yuv420p ? ConvertYUV420 : NULL, "videopipe.writer");
+
   I_AtExit (I_CaptureFinish, true, "I_CaptureFinish", exit_priority_normal);
 }
 
@@ -564,6 +914,7 @@ void I_CaptureFrame (void)
 {
   unsigned char *snd;
   unsigned char *vid;
+  capture_slot_t *slot;
   static int partsof35 = 0; // correct for sync when samplerate % 35 != 0
   int nsampreq;
 
@@ -581,17 +932,20 @@ void I_CaptureFrame (void)
   snd = I_GrabSound (nsampreq);
   if (snd)
   {
-    if (fwrite (snd, nsampreq * 4, 1, soundpipe.f_stdin) != 1)
-      lprintf(LO_WARN, "I_CaptureFrame: error writing soundpipe.\n");
+    slot = ReserveCaptureSlot (&soundqueue);
+    QueueCaptureFrame (&soundqueue, slot, snd, nsampreq * 4, 0, 0);
     //Z_Free (snd); // static buffer
   }
+
+  // a dropped frame isn't grabbed at all
+  slot = ReserveCaptureSlot (&videoqueue);
+  if (!slot)
+    return;
+
   vid = I_GrabScreen ();
   if (vid)
-  {
-    if (fwrite (vid, renderW * renderH * 3, 1, videopipe.f_stdin) != 1)
-      lprintf(LO_WARN, "I_CaptureFrame: error writing videopipe.\n");
-    //Z_Free (vid); // static buffer
-  }
+    QueueCaptureFrame (&videoqueue, slot, vid, renderW * renderH * 3, renderW, renderH);
+  //Z_Free (vid); // static buffer
 
 }
 
@@ -610,10 +964,12 @@ void I_CaptureFinish (void)
   // is there a better way to do this?
 
   // (on windows, it doesn't matter what order we do it in)
+  FinishCaptureQueue (&videoqueue, "videopipe");
   my_pclose3 (&videopipe);
   SDL_WaitThread (videopipe.outthread, &s);
   SDL_WaitThread (videopipe.errthread, &s);
 
+  FinishCaptureQueue (&soundqueue, "soundpipe");
   my_pclose3 (&soundpipe);
   SDL_WaitThread (soundpipe.outthread, &s);
   SDL_WaitThread (soundpipe.errthread, &s);
@@ -49,6 +49,9 @@
 // Init at program start...
 void I_InitSound(void);
 
+// Times the sound effect mixer on synthetic channels
+int I_BenchmarkSoundMixer(int channel_count);
+
 // ... shut down and relase at program termination.
 void I_ShutdownSound(void);
 
@@ -80,6 +83,10 @@ dboolean I_AnySoundStillPlaying(void);
 //  and pitch of a sound channel.
 void I_UpdateSoundParams(int handle, sfx_params_t *params);
 
+// Updates several channels at once; the mixer sees all of the
+//  changes in the same block.
+void I_UpdateSoundParamsBatch(const int *handles, sfx_params_t *params, int count);
+
 // NSM sound capture routines
 // silences sound output, and instead allows sound capture to work
 // call this before sound startup
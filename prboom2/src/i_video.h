@@ -69,6 +69,9 @@ void I_HandleCapture(void);
 void I_FinishUpdate (void);
 
 int I_ScreenShot (const char *fname);
+int I_BurstScreenShot (const char *fname);
+int I_ScreenShotErrors (void);
+void I_FinishScreenShots (void);
 // NSM expose lower level screen data grab for vidcap
 unsigned char *I_GrabScreen (void);
 
@@ -265,6 +265,7 @@ static int M_stat(const char *path, struct stat *buf)
   // incompatible with struct stat*. We copy only the required compatible
   // field.
   buf->st_mode = wbuf.st_mode;
+  buf->st_size = wbuf.st_size;
   buf->st_mtime = wbuf.st_mtime;
 
   Z_Free(wpath);
@@ -310,6 +311,20 @@ int M_MakeDir(const char *path, int require) {
   return error;
 }
 
+// Returns false if the file can't be found
+dboolean M_FileInfo(const char *name, size_t *size, time_t *mtime)
+{
+  struct stat sbuf;
+
+  if (M_stat(name, &sbuf))
+    return false;
+
+  *size = sbuf.st_size;
+  *mtime = sbuf.st_mtime;
+
+  return true;
+}
+
 dboolean M_IsDir(const char *name)
 {
   struct stat sbuf;
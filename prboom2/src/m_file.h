@@ -35,6 +35,7 @@
 #define __M_FILE__
 
 #include <stdio.h>
+#include <time.h>
 
 #include "doomtype.h"
 
@@ -46,6 +47,7 @@ dboolean M_IsDir(const char *name);
 FILE* M_OpenFile(const char *name, const char *mode);
 int M_OpenRB(const char *name);
 dboolean M_FileExists(const char *name);
+dboolean M_FileInfo(const char *name, size_t *size, time_t *mtime);
 dboolean M_WriteFile (char const* name, const void* source, size_t length);
 int M_ReadFile (char const* name,byte** buffer);
 int M_ReadFileToString(char const *name, char **buffer);
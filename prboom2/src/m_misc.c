@@ -92,6 +92,7 @@ cfg_def_t cfg_defs[] =
   MIGRATED_SETTING(dsda_config_startup_delay_ms),
   MIGRATED_SETTING(dsda_config_ansi_endoom),
   MIGRATED_SETTING(dsda_config_announce_map),
+  MIGRATED_SETTING(dsda_config_patch_cache_size),
 
   SETTING_HEADING("Game settings"),
   MIGRATED_SETTING(dsda_config_default_complevel),
@@ -115,6 +116,7 @@ cfg_def_t cfg_defs[] =
   MIGRATED_SETTING(dsda_config_sfx_volume),
   MIGRATED_SETTING(dsda_config_music_volume),
   MIGRATED_SETTING(dsda_config_mus_pause_opt),
+  MIGRATED_SETTING(dsda_config_mus_cache),
   MIGRATED_SETTING(dsda_config_snd_channels),
   MIGRATED_SETTING(dsda_config_snd_midiplayer),
   MIGRATED_SETTING(dsda_config_snd_mididev),
@@ -326,6 +328,9 @@ cfg_def_t cfg_defs[] =
   MIGRATED_SETTING(dsda_config_cap_remove_tempfiles),
   MIGRATED_SETTING(dsda_config_cap_wipescreen),
   MIGRATED_SETTING(dsda_config_cap_fps),
+  MIGRATED_SETTING(dsda_config_cap_queue_frames),
+  MIGRATED_SETTING(dsda_config_cap_drop_frames),
+  MIGRATED_SETTING(dsda_config_cap_pixel_format),
 
   SETTING_HEADING("Overrun settings"),
   MIGRATED_SETTING(dsda_config_overrun_spechit_warn),
@@ -873,14 +878,10 @@ const char* M_CheckWritableDir(const char *dir)
   return result;
 }
 
-void M_ScreenShot(void)
+static const char* M_ScreenShotDir(void)
 {
-  static int shot;
-  char       *lbmname = NULL;
-  int        startshot;
   const char *shot_dir = NULL;
   dsda_arg_t *arg;
-  int        success = 0;
 
   arg = dsda_Arg(dsda_arg_shotdir);
   if (arg->found)
@@ -894,6 +895,19 @@ void M_ScreenShot(void)
     shot_dir = (M_WriteAccess(SCREENSHOT_DIR) ? SCREENSHOT_DIR : NULL);
 #endif
 
+  return shot_dir;
+}
+
+void M_ScreenShot(void)
+{
+  static int shot;
+  char       *lbmname = NULL;
+  int        startshot;
+  const char *shot_dir;
+  int        success = 0;
+
+  shot_dir = M_ScreenShotDir();
+
   if (shot_dir)
   {
     startshot = shot; // CPhipps - prevent infinite loop
@@ -919,6 +933,92 @@ void M_ScreenShot(void)
   return;
 }
 
+//
+// Screenshot bursts save every frame to burstNNNN-FFFFFF files. Frames
+// the encoder can't keep up with are dropped rather than stalling the
+// game, which shows up as gaps in the frame numbers.
+//
+
+static char *burst_name;
+static int burst_frame;
+static int burst_dropped;
+
+static void M_StopScreenShotBurst(void)
+{
+  doom_printf("Screenshot burst: %d frames, %d dropped", burst_frame, burst_dropped);
+  Z_Free(burst_name);
+  burst_name = NULL;
+}
+
+void M_ToggleScreenShotBurst(void)
+{
+  static int burst;
+  char       *name = NULL;
+  int        startburst;
+  const char *shot_dir;
+
+  if (burst_name)
+  {
+    M_StopScreenShotBurst();
+    return;
+  }
+
+  shot_dir = M_ScreenShotDir();
+
+  if (shot_dir)
+  {
+    startburst = burst;
+
+    do {
+      int size = snprintf(NULL, 0, "%s/burst%04d-%06d" SCREENSHOT_EXT, shot_dir, burst, 0);
+      name = Z_Realloc(name, size+1);
+      snprintf(name, size+1, "%s/burst%04d-%06d" SCREENSHOT_EXT, shot_dir, burst, 0);
+      burst++;
+    } while (M_FileExists(name) && (burst != startburst) && (burst < 10000));
+
+    if (!M_FileExists(name))
+    {
+      int size = snprintf(NULL, 0, "%s/burst%04d", shot_dir, burst - 1);
+      burst_name = Z_Malloc(size+1);
+      snprintf(burst_name, size+1, "%s/burst%04d", shot_dir, burst - 1);
+      burst_frame = 0;
+      burst_dropped = 0;
+      doom_printf("Screenshot burst: saving to %s", burst_name);
+    }
+    Z_Free(name);
+    if (burst_name) return;
+  }
+
+  doom_printf ("M_ScreenShot: Couldn't create screenshot");
+}
+
+// Called once per displayed frame
+void M_BurstScreenShot(void)
+{
+  char *name;
+  int size;
+  int result;
+
+  if (!burst_name)
+    return;
+
+  size = snprintf(NULL, 0, "%s-%06d" SCREENSHOT_EXT, burst_name, burst_frame);
+  name = Z_Malloc(size+1);
+  snprintf(name, size+1, "%s-%06d" SCREENSHOT_EXT, burst_name, burst_frame);
+
+  result = I_BurstScreenShot(name);
+  Z_Free(name);
+  burst_frame++;
+
+  if (result > 0)
+    burst_dropped++;
+  else if (result < 0)
+  {
+    doom_printf("M_ScreenShot: Error writing screenshot\n");
+    M_StopScreenShotBurst();
+  }
+}
+
 // Safe string copy function that works like OpenBSD's strlcpy().
 // Returns true if the string was not truncated.
 
@@ -42,6 +42,8 @@
 
 void M_ScreenShot (void);
 void M_DoScreenShot (const char*); // cph
+void M_ToggleScreenShotBurst (void);
+void M_BurstScreenShot (void);
 
 void M_LoadDefaults (void);
 void M_SaveDefaults (void);
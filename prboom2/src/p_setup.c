@@ -35,6 +35,8 @@
 #include <math.h>
 #include <zlib.h>
 
+#include "SDL.h"
+
 #include "doomstat.h"
 #include "m_bbox.h"
 #include "g_game.h"
@@ -63,6 +65,7 @@
 #include "dsda/compatibility.h"
 #include "dsda/destructible.h"
 #include "dsda/id_list.h"
+#include "dsda/level_cache.h"
 #include "dsda/line_special.h"
 #include "dsda/map_format.h"
 #include "dsda/mapinfo.h"
@@ -70,6 +73,8 @@
 #include "dsda/scroll.h"
 #include "dsda/settings.h"
 #include "dsda/skip.h"
+#include "dsda/thread_pool.h"
+#include "dsda/time.h"
 #include "dsda/tranmap.h"
 #include "dsda/udmf.h"
 #include "dsda/utility.h"
@@ -1499,7 +1504,21 @@ static void P_LoadZNodes(int lump, int glnodes)
       nodesVersion == ZDOOM_ZGL2_NODES ||
       nodesVersion == ZDOOM_ZGL3_NODES)
   {
-    output = P_DecompressData(&data, &len);
+    const byte *cached;
+    int cached_len;
+
+    cached = dsda_LevelCacheSection(dsda_lc_znodes, &cached_len);
+
+    if (cached)
+    {
+      data = cached;
+      len = cached_len;
+    }
+    else
+    {
+      output = P_DecompressData(&data, &len);
+      dsda_StoreLevelCacheSection(dsda_lc_znodes, data, len);
+    }
   }
 
   // Read extra vertices added during node building
@@ -2680,11 +2699,14 @@ static void P_LoadUDMFSideDefs(int lump)
                                  // jff 10/8/98 use guardband>0
                                  // jff 10/12/98 0 ok with + 1 in rows,cols
 
-typedef struct linelist_t        // type used to list lines in each block
+typedef struct
 {
-  long num;
-  struct linelist_t *next;
-} linelist_t;
+  int first_line, last_line;     // lines [first_line, last_line) of the map
+  int *count;                    // number of lines in each block
+  int *done;                     // last line (+1) added to each block
+  int *pairs;                    // block, line pairs in line order
+  size_t pair_count, max_pairs;
+} blockmap_chunk_t;
 
 //
 // Subroutine to add a line number to a block list
@@ -2693,24 +2715,27 @@ typedef struct linelist_t        // type used to list lines in each block
 
 static void AddBlockLine
 (
-  linelist_t **lists,
-  int *count,
-  int *done,
+  blockmap_chunk_t *chunk,
   int blockno,
-  long lineno
+  int lineno
 )
 {
-  linelist_t *l;
-
-  if (done[blockno])
+  if (chunk->done[blockno] == lineno + 1)
     return;
 
-  l = Z_Malloc(sizeof(linelist_t));
-  l->num = lineno;
-  l->next = lists[blockno];
-  lists[blockno] = l;
-  count[blockno]++;
-  done[blockno] = 1;
+  if (chunk->pair_count == chunk->max_pairs)
+  {
+    chunk->max_pairs = chunk->max_pairs ? chunk->max_pairs * 2 : 1024;
+    chunk->pairs = realloc(chunk->pairs, chunk->max_pairs * 2 * sizeof(*chunk->pairs));
+    if (!chunk->pairs)
+      I_Error("AddBlockLine: out of memory");
+  }
+
+  chunk->pairs[chunk->pair_count * 2] = blockno;
+  chunk->pairs[chunk->pair_count * 2 + 1] = lineno;
+  chunk->pair_count++;
+  chunk->count[blockno]++;
+  chunk->done[blockno] = lineno + 1;
 }
 
 blockmap_t original_blockmap;
@@ -2738,87 +2763,75 @@ void P_RestoreOriginalBlockMap(void)
 // row lines at the left and bottom of each blockmap cell. It then
 // adds the line to all block lists touching the intersection.
 //
+// The build runs as a background task while the nodes load, so it
+// works from a snapshot of the line coordinates and only uses malloc.
+//
+// Large maps split the lines into chunks that are walked in parallel.
+// Each block list holds its lines in descending order, so the chunks
+// are written back to front and the lump does not depend on the number
+// of chunks.
+//
 
-static void P_CreateBlockMap(void)
-{
-  int xorg,yorg;                 // blockmap origin (lower left)
-  int nrows,ncols;               // blockmap dimensions
-  linelist_t **blocklists=NULL;  // array of pointers to lists of lines
-  int *blockcount=NULL;          // array of counters of line lists
-  int *blockdone=NULL;           // array keeping track of blocks/line
-  int NBlocks;                   // number of cells = nrows*ncols
-  long linetotal=0;              // total length of all blocklists
-  int i,j;
-  int map_minx=INT_MAX;          // init for map limits search
-  int map_miny=INT_MAX;
-  int map_maxx=INT_MIN;
-  int map_maxy=INT_MIN;
-
-  // scan for map limits, which the blockmap must enclose
-
-  // This fixes MBF's code, which has a bug where maxx/maxy
-  // are wrong if the 0th node has the largest x or y
-  if (numvertexes)
-  {
-    map_minx = map_maxx = vertexes[0].x;
-    map_miny = map_maxy = vertexes[0].y;
-  }
+#define BLOCKMAP_CHUNK_LINES 4096
+#define BLOCKMAP_CHUNK_MEMORY (64 * 1024 * 1024)
 
-  for (i=0;i<numvertexes;i++)
-  {
-    fixed_t t;
-
-    if ((t=vertexes[i].x) < map_minx)
-      map_minx = t;
-    else if (t > map_maxx)
-      map_maxx = t;
-    if ((t=vertexes[i].y) < map_miny)
-      map_miny = t;
-    else if (t > map_maxy)
-      map_maxy = t;
-  }
-  map_minx >>= FRACBITS;    // work in map coords, not fixed_t
-  map_maxx >>= FRACBITS;
-  map_miny >>= FRACBITS;
-  map_maxy >>= FRACBITS;
+typedef struct
+{
+  int xorg, yorg;                // blockmap origin (lower left)
+  int nrows, ncols;              // blockmap dimensions
+  int numlines;
+  int *coords;                   // x1, y1, x2, y2 of each line in map coords
+  int chunk_count;               // 0 picks a count for the thread pool
+  blockmap_chunk_t *chunks;
+  int *lump;                     // the finished blockmap lump
+  long lump_count;
+  Uint64 build_time;
+} blockmap_build_t;
+
+static blockmap_build_t blockmap_build;
+static dsda_task_t *blockmap_task;
+static dboolean blockmap_pending;
+
+static int P_BlockMapChunkCount(blockmap_build_t *build)
+{
+  int count;
+  size_t chunk_memory;
 
-  // set up blockmap area to enclose level plus margin
+  if (build->chunk_count)
+    return build->chunk_count;
 
-  xorg = map_minx-blkmargin;
-  yorg = map_miny-blkmargin;
-  ncols = (map_maxx+blkmargin-xorg+1+blkmask)>>blkshift;  //jff 10/12/98
-  nrows = (map_maxy+blkmargin-yorg+1+blkmask)>>blkshift;  //+1 needed for
-  NBlocks = ncols*nrows;                                  //map exactly 1 cell
+  count = dsda_ThreadPoolSize();
 
-  // create the array of pointers on NBlocks to blocklists
-  // also create an array of linelist counts on NBlocks
-  // finally make an array in which we can mark blocks done per line
+  if (count > build->numlines / BLOCKMAP_CHUNK_LINES)
+    count = build->numlines / BLOCKMAP_CHUNK_LINES;
 
-  // CPhipps - calloc's
-  blocklists = Z_Calloc(NBlocks,sizeof(linelist_t *));
-  blockcount = Z_Calloc(NBlocks,sizeof(int));
-  blockdone = Z_Malloc(NBlocks*sizeof(int));
+  // Each chunk keeps two counters per block
+  chunk_memory = 2 * sizeof(int) * build->ncols * build->nrows;
+  if (count > BLOCKMAP_CHUNK_MEMORY / chunk_memory)
+    count = BLOCKMAP_CHUNK_MEMORY / chunk_memory;
 
-  // initialize each blocklist, and enter the trailing -1 in all blocklists
-  // note the linked list of lines grows backwards
+  return count < 1 ? 1 : count;
+}
 
-  for (i=0;i<NBlocks;i++)
-  {
-    blocklists[i] = Z_Malloc(sizeof(linelist_t));
-    blocklists[i]->num = -1;
-    blocklists[i]->next = NULL;
-    blockcount[i]++;
-  }
+//
+// For each linedef in the chunk, determine all blockmap blocks it touches,
+// and add the linedef number to the lists for those blocks
+//
 
-  // For each linedef in the wad, determine all blockmap blocks it touches,
-  // and add the linedef number to the blocklists for those blocks
+static void P_CollectBlockLines(int index, void *data)
+{
+  blockmap_build_t *build = data;
+  blockmap_chunk_t *chunk = &build->chunks[index];
+  int xorg = build->xorg, yorg = build->yorg;
+  int nrows = build->nrows, ncols = build->ncols;
+  int i,j;
 
-  for (i=0;i<numlines;i++)
+  for (i=chunk->first_line;i<chunk->last_line;i++)
   {
-    int x1 = lines[i].v1->x>>FRACBITS;         // lines[i] map coords
-    int y1 = lines[i].v1->y>>FRACBITS;
-    int x2 = lines[i].v2->x>>FRACBITS;
-    int y2 = lines[i].v2->y>>FRACBITS;
+    int x1 = build->coords[i * 4];             // lines[i] map coords
+    int y1 = build->coords[i * 4 + 1];
+    int x2 = build->coords[i * 4 + 2];
+    int y2 = build->coords[i * 4 + 3];
     int dx = x2-x1;
     int dy = y2-y1;
     int vert = !dx;                            // lines[i] slopetype
@@ -2831,18 +2844,14 @@ static void P_CreateBlockMap(void)
     int miny = y1>y2? y2 : y1;
     int maxy = y1>y2? y1 : y2;
 
-    // no blocks done for this linedef yet
-
-    memset(blockdone,0,NBlocks*sizeof(int));
-
     // The line always belongs to the blocks containing its endpoints
 
     bx = (x1-xorg)>>blkshift;
     by = (y1-yorg)>>blkshift;
-    AddBlockLine(blocklists,blockcount,blockdone,by*ncols+bx,i);
+    AddBlockLine(chunk,by*ncols+bx,i);
     bx = (x2-xorg)>>blkshift;
     by = (y2-yorg)>>blkshift;
-    AddBlockLine(blocklists,blockcount,blockdone,by*ncols+bx,i);
+    AddBlockLine(chunk,by*ncols+bx,i);
 
 
     // For each column, see where the line along its left edge, which
@@ -2851,7 +2860,11 @@ static void P_CreateBlockMap(void)
 
     if (!vert)    // don't interesect vertical lines with columns
     {
-      for (j=0;j<ncols;j++)
+      // only the columns between the line's endpoints can intersect it
+      int first = (minx-xorg+blkmask)>>blkshift;
+      int last = (maxx-xorg)>>blkshift;
+
+      for (j=first<0?0:first;j<ncols && j<=last;j++)
       {
         // intersection of Linedef with x=xorg+(j<<blkshift)
         // (y-y1)*dx = dy*(x-x1)
@@ -2870,7 +2883,7 @@ static void P_CreateBlockMap(void)
 
         // The cell that contains the intersection point is always added
 
-        AddBlockLine(blocklists,blockcount,blockdone,ncols*yb+j,i);
+        AddBlockLine(chunk,ncols*yb+j,i);
 
         // if the intersection is at a corner it depends on the slope
         // (and whether the line extends past the intersection) which
@@ -2881,23 +2894,23 @@ static void P_CreateBlockMap(void)
           if (sneg)       //   \ - blocks x,y-, x-,y
           {
             if (yb>0 && miny<y)
-              AddBlockLine(blocklists,blockcount,blockdone,ncols*(yb-1)+j,i);
+              AddBlockLine(chunk,ncols*(yb-1)+j,i);
             if (j>0 && minx<x)
-              AddBlockLine(blocklists,blockcount,blockdone,ncols*yb+j-1,i);
+              AddBlockLine(chunk,ncols*yb+j-1,i);
           }
           else if (spos)  //   / - block x-,y-
           {
             if (yb>0 && j>0 && minx<x)
-              AddBlockLine(blocklists,blockcount,blockdone,ncols*(yb-1)+j-1,i);
+              AddBlockLine(chunk,ncols*(yb-1)+j-1,i);
           }
           else if (horiz) //   - - block x-,y
           {
             if (j>0 && minx<x)
-              AddBlockLine(blocklists,blockcount,blockdone,ncols*yb+j-1,i);
+              AddBlockLine(chunk,ncols*yb+j-1,i);
           }
         }
         else if (j>0 && minx<x) // else not at corner: x-,y
-          AddBlockLine(blocklists,blockcount,blockdone,ncols*yb+j-1,i);
+          AddBlockLine(chunk,ncols*yb+j-1,i);
       }
     }
 
@@ -2907,7 +2920,11 @@ static void P_CreateBlockMap(void)
 
     if (!horiz)
     {
-      for (j=0;j<nrows;j++)
+      // only the rows between the line's endpoints can intersect it
+      int first = (miny-yorg+blkmask)>>blkshift;
+      int last = (maxy-yorg)>>blkshift;
+
+      for (j=first<0?0:first;j<nrows && j<=last;j++)
       {
         // intersection of Linedef with y=yorg+(j<<blkshift)
         // (x,y) on Linedef i satisfies: (y-y1)*dx = dy*(x-x1)
@@ -2926,7 +2943,7 @@ static void P_CreateBlockMap(void)
 
         // The cell that contains the intersection point is always added
 
-        AddBlockLine(blocklists,blockcount,blockdone,ncols*j+xb,i);
+        AddBlockLine(chunk,ncols*j+xb,i);
 
         // if the intersection is at a corner it depends on the slope
         // (and whether the line extends past the intersection) which
@@ -2937,72 +2954,622 @@ static void P_CreateBlockMap(void)
           if (sneg)       //   \ - blocks x,y-, x-,y
           {
             if (j>0 && miny<y)
-              AddBlockLine(blocklists,blockcount,blockdone,ncols*(j-1)+xb,i);
+              AddBlockLine(chunk,ncols*(j-1)+xb,i);
             if (xb>0 && minx<x)
-              AddBlockLine(blocklists,blockcount,blockdone,ncols*j+xb-1,i);
+              AddBlockLine(chunk,ncols*j+xb-1,i);
           }
           else if (vert)  //   | - block x,y-
           {
             if (j>0 && miny<y)
-              AddBlockLine(blocklists,blockcount,blockdone,ncols*(j-1)+xb,i);
+              AddBlockLine(chunk,ncols*(j-1)+xb,i);
           }
           else if (spos)  //   / - block x-,y-
           {
             if (xb>0 && j>0 && miny<y)
-              AddBlockLine(blocklists,blockcount,blockdone,ncols*(j-1)+xb-1,i);
+              AddBlockLine(chunk,ncols*(j-1)+xb-1,i);
           }
         }
         else if (j>0 && miny<y) // else not on a corner: x,y-
-          AddBlockLine(blocklists,blockcount,blockdone,ncols*(j-1)+xb,i);
+          AddBlockLine(chunk,ncols*(j-1)+xb,i);
       }
     }
   }
+}
 
-  // Add initial 0 to all blocklists
+//
+// Copy the chunk's lines into the lump, back to front
+// The count of each block has been turned into the end of the chunk's run
+//
+
+static void P_WriteBlockLines(int index, void *data)
+{
+  blockmap_build_t *build = data;
+  blockmap_chunk_t *chunk = &build->chunks[index];
+  size_t i;
+
+  for (i = 0; i < chunk->pair_count; i++)
+    build->lump[--chunk->count[chunk->pairs[i * 2]]] = chunk->pairs[i * 2 + 1];
+}
+
+static void P_BuildBlockMap(void *data)
+{
+  blockmap_build_t *build = data;
+  int NBlocks;                   // number of cells = nrows*ncols
+  int chunk_count;
+  long linetotal=0;              // total length of all blocklists
+  long offs;
+  int i,c;
+  Uint64 start_time;
+
+  start_time = SDL_GetPerformanceCounter();
+
+  NBlocks = build->ncols*build->nrows;
+
+  // split the lines into chunks, each with its own block counters
+
+  chunk_count = P_BlockMapChunkCount(build);
+  build->chunks = calloc(chunk_count, sizeof(*build->chunks));
+  if (!build->chunks)
+    I_Error("P_BuildBlockMap: out of memory");
+
+  for (c=0;c<chunk_count;c++)
+  {
+    blockmap_chunk_t *chunk = &build->chunks[c];
+
+    chunk->first_line = (int) ((long long) build->numlines * c / chunk_count);
+    chunk->last_line = (int) ((long long) build->numlines * (c + 1) / chunk_count);
+    chunk->count = calloc(NBlocks,sizeof(int));
+    chunk->done = calloc(NBlocks,sizeof(int));
+
+    if (!chunk->count || !chunk->done)
+      I_Error("P_BuildBlockMap: out of memory");
+  }
+
+  dsda_ParallelFor(chunk_count, P_CollectBlockLines, build);
+
+  // every block list is a 0, its lines, and a trailing -1
   // count the total number of lines (and 0's and -1's)
 
-  memset(blockdone,0,NBlocks*sizeof(int));
-  for (i=0,linetotal=0;i<NBlocks;i++)
+  for (c=0;c<chunk_count;c++)
   {
-    AddBlockLine(blocklists,blockcount,blockdone,i,0);
-    linetotal += blockcount[i];
+    free(build->chunks[c].done);
+    linetotal += build->chunks[c].pair_count;
   }
+  linetotal += 2 * NBlocks;
 
   // Create the blockmap lump
 
-  blockmaplump = malloc_IfSameLevel(blockmaplump, sizeof(*blockmaplump) * (4 + NBlocks + linetotal));
+  build->lump_count = 4 + NBlocks + linetotal;
+  build->lump = malloc(sizeof(*build->lump) * build->lump_count);
+  if (!build->lump)
+    I_Error("P_BuildBlockMap: out of memory");
+
   // blockmap header
 
-  blockmaplump[0] = bmaporgx = xorg << FRACBITS;
-  blockmaplump[1] = bmaporgy = yorg << FRACBITS;
-  blockmaplump[2] = bmapwidth  = ncols;
-  blockmaplump[3] = bmapheight = nrows;
+  build->lump[0] = build->xorg << FRACBITS;
+  build->lump[1] = build->yorg << FRACBITS;
+  build->lump[2] = build->ncols;
+  build->lump[3] = build->nrows;
 
-  // offsets to lists and block lists
+  // offsets to lists, list terminators, and where each chunk's run ends
 
+  offs = 4 + NBlocks;
   for (i=0;i<NBlocks;i++)
   {
-    linelist_t *bl = blocklists[i];
-    long offs = blockmaplump[4+i] =   // set offset to block's list
-      (i? blockmaplump[4+i-1] : 4+NBlocks) + (i? blockcount[i-1] : 0);
+    build->lump[4+i] = offs;         // set offset to block's list
+    build->lump[offs++] = 0;
+
+    for (c=chunk_count-1;c>=0;c--)
+    {
+      offs += build->chunks[c].count[i];
+      build->chunks[c].count[i] = offs;
+    }
+
+    build->lump[offs++] = -1;
+  }
+
+  // add the lines in each block's list to the blockmap lump
+
+  dsda_ParallelFor(chunk_count, P_WriteBlockLines, build);
+
+  // free all temporary storage
+
+  for (c=0;c<chunk_count;c++)
+  {
+    free(build->chunks[c].count);
+    free(build->chunks[c].pairs);
+  }
+  free(build->chunks);
+  build->chunks = NULL;
+
+  build->build_time = SDL_GetPerformanceCounter() - start_time;
+}
+
+//
+// P_CreateBlockMap
+//
+// The original serial builder, with its linked block lists and a full
+// clear of the block marks for every line. It is only kept as the
+// reference for P_BenchmarkBlockMap.
+//
+
+typedef struct linelist_t        // type used to list lines in each block
+{
+  long num;
+  struct linelist_t *next;
+} linelist_t;
+
+static void AddBlockListLine
+(
+  linelist_t **lists,
+  int *count,
+  int *done,
+  int blockno,
+  long lineno
+)
+{
+  linelist_t *l;
+
+  if (done[blockno])
+    return;
+
+  l = malloc(sizeof(linelist_t));
+  if (!l)
+    I_Error("AddBlockListLine: out of memory");
+  l->num = lineno;
+  l->next = lists[blockno];
+  lists[blockno] = l;
+  count[blockno]++;
+  done[blockno] = 1;
+}
+
+static void P_CreateBlockMap(void *data)
+{
+  blockmap_build_t *build = data;
+  int xorg = build->xorg, yorg = build->yorg;
+  int nrows = build->nrows, ncols = build->ncols;
+  linelist_t **blocklists=NULL;  // array of pointers to lists of lines
+  int *blockcount=NULL;          // array of counters of line lists
+  int *blockdone=NULL;           // array keeping track of blocks/line
+  int NBlocks;                   // number of cells = nrows*ncols
+  long linetotal=0;              // total length of all blocklists
+  int i,j;
+  Uint64 start_time;
+
+  start_time = SDL_GetPerformanceCounter();
+
+  NBlocks = ncols*nrows;
+
+  blocklists = calloc(NBlocks,sizeof(linelist_t *));
+  blockcount = calloc(NBlocks,sizeof(int));
+  blockdone = malloc(NBlocks*sizeof(int));
+
+  if (!blocklists || !blockcount || !blockdone)
+    I_Error("P_CreateBlockMap: out of memory");
+
+  // initialize each blocklist, and enter the trailing -1 in all blocklists
+  // note the linked list of lines grows backwards
+
+  for (i=0;i<NBlocks;i++)
+  {
+    blocklists[i] = malloc(sizeof(linelist_t));
+    if (!blocklists[i])
+      I_Error("P_CreateBlockMap: out of memory");
+    blocklists[i]->num = -1;
+    blocklists[i]->next = NULL;
+    blockcount[i]++;
+  }
+
+  for (i=0;i<build->numlines;i++)
+  {
+    int x1 = build->coords[i * 4];
+    int y1 = build->coords[i * 4 + 1];
+    int x2 = build->coords[i * 4 + 2];
+    int y2 = build->coords[i * 4 + 3];
+    int dx = x2-x1;
+    int dy = y2-y1;
+    int vert = !dx;
+    int horiz = !dy;
+    int spos = (dx^dy) > 0;
+    int sneg = (dx^dy) < 0;
+    int bx,by;
+    int minx = x1>x2? x2 : x1;
+    int maxx = x1>x2? x1 : x2;
+    int miny = y1>y2? y2 : y1;
+    int maxy = y1>y2? y1 : y2;
+
+    memset(blockdone,0,NBlocks*sizeof(int));
+
+    bx = (x1-xorg)>>blkshift;
+    by = (y1-yorg)>>blkshift;
+    AddBlockListLine(blocklists,blockcount,blockdone,by*ncols+bx,i);
+    bx = (x2-xorg)>>blkshift;
+    by = (y2-yorg)>>blkshift;
+    AddBlockListLine(blocklists,blockcount,blockdone,by*ncols+bx,i);
+
+    if (!vert)
+    {
+      for (j=0;j<ncols;j++)
+      {
+        int x = xorg+(j<<blkshift);
+        int y = (dy*(x-x1))/dx+y1;
+        int yb = (y-yorg)>>blkshift;
+        int yp = (y-yorg)&blkmask;
+
+        if (yb<0 || yb>nrows-1)
+          continue;
+
+        if (x<minx || x>maxx)
+          continue;
 
-    // add the lines in each block's list to the blockmaplump
-    // delete each list node as we go
+        AddBlockListLine(blocklists,blockcount,blockdone,ncols*yb+j,i);
+
+        if (yp==0)
+        {
+          if (sneg)
+          {
+            if (yb>0 && miny<y)
+              AddBlockListLine(blocklists,blockcount,blockdone,ncols*(yb-1)+j,i);
+            if (j>0 && minx<x)
+              AddBlockListLine(blocklists,blockcount,blockdone,ncols*yb+j-1,i);
+          }
+          else if (spos)
+          {
+            if (yb>0 && j>0 && minx<x)
+              AddBlockListLine(blocklists,blockcount,blockdone,ncols*(yb-1)+j-1,i);
+          }
+          else if (horiz)
+          {
+            if (j>0 && minx<x)
+              AddBlockListLine(blocklists,blockcount,blockdone,ncols*yb+j-1,i);
+          }
+        }
+        else if (j>0 && minx<x)
+          AddBlockListLine(blocklists,blockcount,blockdone,ncols*yb+j-1,i);
+      }
+    }
+
+    if (!horiz)
+    {
+      for (j=0;j<nrows;j++)
+      {
+        int y = yorg+(j<<blkshift);
+        int x = (dx*(y-y1))/dy+x1;
+        int xb = (x-xorg)>>blkshift;
+        int xp = (x-xorg)&blkmask;
+
+        if (xb<0 || xb>ncols-1)
+          continue;
+
+        if (y<miny || y>maxy)
+          continue;
+
+        AddBlockListLine(blocklists,blockcount,blockdone,ncols*j+xb,i);
+
+        if (xp==0)
+        {
+          if (sneg)
+          {
+            if (j>0 && miny<y)
+              AddBlockListLine(blocklists,blockcount,blockdone,ncols*(j-1)+xb,i);
+            if (xb>0 && minx<x)
+              AddBlockListLine(blocklists,blockcount,blockdone,ncols*j+xb-1,i);
+          }
+          else if (vert)
+          {
+            if (j>0 && miny<y)
+              AddBlockListLine(blocklists,blockcount,blockdone,ncols*(j-1)+xb,i);
+          }
+          else if (spos)
+          {
+            if (xb>0 && j>0 && miny<y)
+              AddBlockListLine(blocklists,blockcount,blockdone,ncols*(j-1)+xb-1,i);
+          }
+        }
+        else if (j>0 && miny<y)
+          AddBlockListLine(blocklists,blockcount,blockdone,ncols*(j-1)+xb,i);
+      }
+    }
+  }
+
+  // Add initial 0 to all blocklists
+  // count the total number of lines (and 0's and -1's)
+
+  memset(blockdone,0,NBlocks*sizeof(int));
+  for (i=0,linetotal=0;i<NBlocks;i++)
+  {
+    AddBlockListLine(blocklists,blockcount,blockdone,i,0);
+    linetotal += blockcount[i];
+  }
+
+  build->lump_count = 4 + NBlocks + linetotal;
+  build->lump = malloc(sizeof(*build->lump) * build->lump_count);
+  if (!build->lump)
+    I_Error("P_CreateBlockMap: out of memory");
+
+  build->lump[0] = xorg << FRACBITS;
+  build->lump[1] = yorg << FRACBITS;
+  build->lump[2] = ncols;
+  build->lump[3] = nrows;
+
+  for (i=0;i<NBlocks;i++)
+  {
+    linelist_t *bl = blocklists[i];
+    long offs = build->lump[4+i] =
+      (i? build->lump[4+i-1] : 4+NBlocks) + (i? blockcount[i-1] : 0);
 
     while (bl)
     {
       linelist_t *tmp = bl->next;
-      blockmaplump[offs++] = bl->num;
-      Z_Free(bl);
+      build->lump[offs++] = bl->num;
+      free(bl);
       bl = tmp;
     }
   }
 
-  // free all temporary storage
+  free(blocklists);
+  free(blockcount);
+  free(blockdone);
+
+  build->build_time = SDL_GetPerformanceCounter() - start_time;
+}
+
+//
+// P_BenchmarkBlockMap
+//
+// Build the blockmap of a synthetic map with the original builder, with
+// one chunk, and with several chunks on the thread pool. Both chunked
+// lumps must match the original one; the first mismatch fails the run.
+//
+
+#define BENCHMARK_RUNS 3
+
+static double P_BenchmarkBlockMapBuild(blockmap_build_t *build,
+                                       dsda_task_func_t func, int chunk_count)
+{
+  int run;
+  double best = 0;
+
+  build->chunk_count = chunk_count;
+
+  for (run = 0; run < BENCHMARK_RUNS; run++)
+  {
+    double ms;
+
+    free(build->lump);
+    build->lump = NULL;
+
+    func(build);
+
+    ms = (double) build->build_time * 1000 / SDL_GetPerformanceFrequency();
+    if (!run || ms < best)
+      best = ms;
+  }
+
+  return best;
+}
+
+static dboolean P_CompareBlockMaps(const blockmap_build_t *reference,
+                                   const blockmap_build_t *build,
+                                   const char *name)
+{
+  long i;
+
+  if (build->lump_count != reference->lump_count)
+  {
+    lprintf(LO_ERROR, "P_BenchmarkBlockMap: %s: %ld entries instead of %ld\n",
+            name, build->lump_count, reference->lump_count);
+    return false;
+  }
+
+  for (i = 0; i < reference->lump_count; i++)
+    if (build->lump[i] != reference->lump[i])
+    {
+      lprintf(LO_ERROR, "P_BenchmarkBlockMap: %s: entry %ld is %d instead of %d\n",
+              name, i, build->lump[i], reference->lump[i]);
+      return false;
+    }
+
+  return true;
+}
+
+int P_BenchmarkBlockMap(int line_count)
+{
+  blockmap_build_t reference = { 0 };
+  blockmap_build_t serial;
+  blockmap_build_t parallel;
+  unsigned int seed = 1;
+  int span, i, chunk_count;
+  double reference_ms, serial_ms, parallel_ms;
+  dboolean match;
+
+  // Square rooms of 64 units, with some long and diagonal lines thrown in
+  span = (int) sqrt(line_count) * 64;
+  if (span > 60000)
+    span = 60000;
+
+  reference.coords = malloc(line_count * 4 * sizeof(*reference.coords));
+  if (!reference.coords)
+    I_Error("P_BenchmarkBlockMap: out of memory");
+
+  for (i = 0; i < line_count; i++)
+  {
+    int *coords = &reference.coords[i * 4];
+    int length;
+
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+
+    coords[0] = (int) (seed % span) & ~63;
+    coords[1] = (int) ((seed >> 8) % span) & ~63;
+    length = (seed & 0x1000) ? 64 : 64 + (seed >> 20) % 1024;
+
+    switch (seed & 3)
+    {
+      case 0: coords[2] = coords[0] + length; coords[3] = coords[1]; break;
+      case 1: coords[2] = coords[0]; coords[3] = coords[1] + length; break;
+      case 2: coords[2] = coords[0] + length; coords[3] = coords[1] + length; break;
+      default: coords[2] = coords[0] + length; coords[3] = coords[1] - length; break;
+    }
+
+    coords[0] -= span / 2;
+    coords[1] -= span / 2;
+    coords[2] -= span / 2;
+    coords[3] -= span / 2;
+  }
+
+  reference.numlines = line_count;
+  reference.xorg = -span / 2 - 2048 - blkmargin;
+  reference.yorg = -span / 2 - 2048 - blkmargin;
+  reference.ncols = (span + 4096 + 2 * blkmargin + 1 + blkmask) >> blkshift;
+  reference.nrows = reference.ncols;
+  serial = reference;
+  parallel = reference;
+
+  // Always split the lines, even without pool threads to run the chunks
+  chunk_count = dsda_ThreadPoolSize();
+  if (chunk_count < 4)
+    chunk_count = 4;
+
+  reference_ms = P_BenchmarkBlockMapBuild(&reference, P_CreateBlockMap, 0);
+  serial_ms = P_BenchmarkBlockMapBuild(&serial, P_BuildBlockMap, 1);
+  parallel_ms = P_BenchmarkBlockMapBuild(&parallel, P_BuildBlockMap, chunk_count);
+
+  match = P_CompareBlockMaps(&reference, &serial, "1 chunk") &&
+          P_CompareBlockMaps(&reference, &parallel, "chunked");
+
+  lprintf(LO_INFO, "P_BenchmarkBlockMap: %d lines, %d x %d blocks\n",
+          line_count, reference.ncols, reference.nrows);
+  lprintf(LO_INFO, "  original: %.2f ms\n", reference_ms);
+  lprintf(LO_INFO, "  1 chunk: %.2f ms\n", serial_ms);
+  lprintf(LO_INFO, "  %d chunks: %.2f ms\n", chunk_count, parallel_ms);
+
+  free(reference.coords);
+  free(reference.lump);
+  free(serial.lump);
+  free(parallel.lump);
+
+  return match ? 0 : 1;
+}
+
+static void P_StartBlockMapBuild(void)
+{
+  int i;
+  int map_minx=INT_MAX;          // init for map limits search
+  int map_miny=INT_MAX;
+  int map_maxx=INT_MIN;
+  int map_maxy=INT_MIN;
+
+  // scan for map limits, which the blockmap must enclose
+
+  // This fixes MBF's code, which has a bug where maxx/maxy
+  // are wrong if the 0th node has the largest x or y
+  if (numvertexes)
+  {
+    map_minx = map_maxx = vertexes[0].x;
+    map_miny = map_maxy = vertexes[0].y;
+  }
+
+  for (i=0;i<numvertexes;i++)
+  {
+    fixed_t t;
+
+    if ((t=vertexes[i].x) < map_minx)
+      map_minx = t;
+    else if (t > map_maxx)
+      map_maxx = t;
+    if ((t=vertexes[i].y) < map_miny)
+      map_miny = t;
+    else if (t > map_maxy)
+      map_maxy = t;
+  }
+  map_minx >>= FRACBITS;    // work in map coords, not fixed_t
+  map_maxx >>= FRACBITS;
+  map_miny >>= FRACBITS;
+  map_maxy >>= FRACBITS;
+
+  // set up blockmap area to enclose level plus margin
+
+  blockmap_build.xorg = map_minx-blkmargin;
+  blockmap_build.yorg = map_miny-blkmargin;
+  blockmap_build.ncols =                                  //jff 10/12/98
+    (map_maxx+blkmargin-blockmap_build.xorg+1+blkmask)>>blkshift;
+  blockmap_build.nrows =                                  //+1 needed for
+    (map_maxy+blkmargin-blockmap_build.yorg+1+blkmask)>>blkshift;
+
+  // The nodes may reallocate the vertexes while the build runs
+  blockmap_build.numlines = numlines;
+  blockmap_build.coords = malloc(numlines * 4 * sizeof(*blockmap_build.coords));
+  if (numlines && !blockmap_build.coords)
+    I_Error("P_StartBlockMapBuild: out of memory");
+
+  for (i=0;i<numlines;i++)
+  {
+    blockmap_build.coords[i * 4] = lines[i].v1->x>>FRACBITS;
+    blockmap_build.coords[i * 4 + 1] = lines[i].v1->y>>FRACBITS;
+    blockmap_build.coords[i * 4 + 2] = lines[i].v2->x>>FRACBITS;
+    blockmap_build.coords[i * 4 + 3] = lines[i].v2->y>>FRACBITS;
+  }
+
+  blockmap_task = dsda_StartTask(P_BuildBlockMap, &blockmap_build);
+}
+
+static void P_FinishBlockMapBuild(void)
+{
+  dsda_FinishTask(blockmap_task);
+  blockmap_task = NULL;
+
+  blockmaplump = malloc_IfSameLevel(blockmaplump,
+    sizeof(*blockmaplump) * blockmap_build.lump_count);
+  memcpy(blockmaplump, blockmap_build.lump,
+         sizeof(*blockmaplump) * blockmap_build.lump_count);
+
+  bmaporgx = blockmaplump[0];
+  bmaporgy = blockmaplump[1];
+  bmapwidth = blockmaplump[2];
+  bmapheight = blockmaplump[3];
+
+  dsda_StoreLevelCacheSection(dsda_lc_blockmap, blockmaplump,
+                              sizeof(*blockmaplump) * blockmap_build.lump_count);
+
+  lprintf(LO_DEBUG, "P_SetupLevel: blockmap built in %.2f ms\n",
+          (double) blockmap_build.build_time * 1000 / SDL_GetPerformanceFrequency());
+
+  free(blockmap_build.coords);
+  free(blockmap_build.lump);
+  blockmap_build.coords = NULL;
+  blockmap_build.lump = NULL;
+}
+
+//
+// P_LoadCachedBlockMap
+//
+// Reuse the blockmap P_BuildBlockMap built the last time this map was loaded
+//
+
+static dboolean P_LoadCachedBlockMap(void)
+{
+  const int *data;
+  int length;
 
-  Z_Free (blocklists);
-  Z_Free (blockcount);
-  Z_Free (blockdone);
+  data = dsda_LevelCacheSection(dsda_lc_blockmap, &length);
+
+  if (!data || length < 4 * sizeof(*data))
+    return false;
+
+  if (length / sizeof(*data) < 4 + (size_t) data[2] * data[3])
+    return false;
+
+  blockmaplump = malloc_IfSameLevel(blockmaplump, length);
+  memcpy(blockmaplump, data, length);
+
+  bmaporgx = blockmaplump[0];
+  bmaporgy = blockmaplump[1];
+  bmapwidth = blockmaplump[2];
+  bmapheight = blockmaplump[3];
+
+  return true;
 }
 
 // jff 10/6/98
@@ -3102,7 +3669,8 @@ static void P_LoadBlockMap (int lump)
     (count /= 2) >= 0x10000 //e6y
   )
   {
-    P_CreateBlockMap();
+    if (!P_LoadCachedBlockMap())
+      P_StartBlockMapBuild();
   }
   else
   {
@@ -3141,6 +3709,26 @@ static void P_LoadBlockMap (int lump)
     }
   }
 
+  blockmap_pending = true;
+}
+
+//
+// P_FinishBlockMap
+//
+// Wait for a blockmap build started by P_LoadBlockMap and set up the
+// structures that depend on the blockmap dimensions
+//
+
+static void P_FinishBlockMap(void)
+{
+  if (!blockmap_pending)
+    return;
+
+  blockmap_pending = false;
+
+  if (blockmap_task)
+    P_FinishBlockMapBuild();
+
   RememberOriginalBlockMap();
 
   // clear out mobj chains - CPhipps - use calloc
@@ -3779,6 +4367,40 @@ void P_InitSubsectorsLines(void)
 
 static dboolean must_rebuild_blockmap;
 
+//
+// P_OpenLevelCache
+//
+// Key the level cache by the lumps that feed the cached stages
+//
+
+static void P_OpenLevelCache(void)
+{
+  int lumps[] = {
+    level_components.vertexes,
+    level_components.linedefs,
+    level_components.nodes,
+    level_components.znodes,
+    udmf_map ? level_components.label + ML_TEXTMAP : LUMP_NOT_FOUND,
+  };
+
+  dsda_OpenLevelCache(lumps, sizeof(lumps) / sizeof(lumps[0]),
+                      (udmf_map << 16) | (has_behavior << 8) | nodesVersion);
+}
+
+//
+// P_SetupLevelStage
+//
+// Report how long the previous setup stage took (shown with -verbose)
+//
+
+static void P_SetupLevelStage(const char *stage)
+{
+  lprintf(LO_DEBUG, "P_SetupLevel: %s in %.2f ms\n", stage,
+          (double) dsda_ElapsedTime(dsda_timer_level_setup) / 1000);
+
+  dsda_StartTimer(dsda_timer_level_setup);
+}
+
 void P_MustRebuildBlockmap(void)
 {
   must_rebuild_blockmap = true;
@@ -3801,6 +4423,11 @@ void P_SetupLevel(int episode, int map, int playermask, int skill)
   //e6y
   totallive = 0;
 
+  dsda_StartTimer(dsda_timer_level_setup);
+
+  // translucency maps requested by the level are generated concurrently
+  dsda_BeginTranMapBatch();
+
   main_tranmap = dsda_DefaultTranMap();
 
   dsda_WatchBeforeLevelSetup();
@@ -3873,6 +4500,10 @@ void P_SetupLevel(int episode, int map, int playermask, int skill)
 
   dsda_WatchNewLevel();
 
+  P_OpenLevelCache();
+
+  P_SetupLevelStage("level cache");
+
   if (!samelevel)
   {
     // proff 11/99: clean the memory from textures etc.
@@ -3902,9 +4533,11 @@ void P_SetupLevel(int episode, int map, int playermask, int skill)
 
   P_PostProcessLineDefs();
 
+  P_SetupLevelStage("map lumps");
+
   // e6y: speedup of level reloading
   // Do not reload BlockMap for same level,
-  // because in case of big level P_CreateBlockMap eats much time
+  // because in case of big level P_BuildBlockMap eats much time
   //
   // BlockMap should be reloaded after OVERFLOW_INTERCEPT,
   // because bmapwidth/bmapheight/bmaporgx/bmaporgy can be overwritten
@@ -3918,6 +4551,9 @@ void P_SetupLevel(int episode, int map, int playermask, int skill)
     memset(blocklinks, 0, bmapwidth*bmapheight*sizeof(*blocklinks));
   }
 
+  P_SetupLevelStage("blockmap");
+
+  // The blockmap build (if any) runs in the background until P_FinishBlockMap
   switch (nodesVersion)
   {
     case GL_V1_NODES:
@@ -3976,6 +4612,13 @@ void P_SetupLevel(int episode, int map, int playermask, int skill)
   map_subsectors = calloc_IfSameLevel(map_subsectors,
     numsubsectors, sizeof(map_subsectors[0]));
 
+  P_SetupLevelStage("nodes");
+
+  // P_GroupLines in P_LoadReject needs the blockmap
+  P_FinishBlockMap();
+
+  P_SetupLevelStage("blockmap wait");
+
   // reject loading and underflow padding separated out into new function
   P_LoadReject(level_components.reject);
 
@@ -3984,6 +4627,10 @@ void P_SetupLevel(int episode, int map, int playermask, int skill)
   // should be after P_RemoveSlimeTrails, because it changes vertexes
   R_CalcSegsLength();
 
+  dsda_CloseLevelCache();
+
+  P_SetupLevelStage("reject, line groups and segs");
+
   {
     void A_ResetPlayerCorpseQueue(void);
 
@@ -4066,6 +4713,8 @@ void P_SetupLevel(int episode, int map, int playermask, int skill)
   // clear special respawning que
   iquehead = iquetail = 0;
 
+  P_SetupLevelStage("things");
+
   // set up world state
   P_SpawnSpecials();
 
@@ -4077,9 +4726,17 @@ void P_SetupLevel(int episode, int map, int playermask, int skill)
 
   dsda_ApplyFadeTable();
 
+  P_SetupLevelStage("specials");
+
+  dsda_EndTranMapBatch();
+
+  P_SetupLevelStage("translucency maps");
+
   // preload graphics
   R_PrecacheLevel();
 
+  P_SetupLevelStage("precache");
+
   if (V_IsOpenGLMode())
   {
     // e6y
@@ -4090,6 +4747,8 @@ void P_SetupLevel(int episode, int map, int playermask, int skill)
     {
       // proff 11/99: calculate all OpenGL specific tables etc.
       gld_PreprocessLevel();
+
+      P_SetupLevelStage("opengl preprocessing");
     }
   }
 
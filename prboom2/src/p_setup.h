@@ -67,6 +67,7 @@ typedef struct
 extern blockmap_t original_blockmap;
 
 void P_RestoreOriginalBlockMap(void);
+int P_BenchmarkBlockMap(int line_count);
 
 typedef struct
 {
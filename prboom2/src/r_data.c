@@ -37,6 +37,7 @@
 #include "r_draw.h"
 #include "r_main.h"
 #include "r_sky.h"
+#include "r_patch.h"
 #include "i_system.h"
 #include "r_bsp.h"
 #include "r_things.h"
@@ -50,6 +51,8 @@
 #include "dsda/map_format.h"
 #include "dsda/utility.h"
 #include "dsda/palette.h"
+#include "dsda/startup_cache.h"
+#include "dsda/startup_report.h"
 #include "m_random.h"
 
 //
@@ -142,6 +145,8 @@ static int R_FilterValidPatch(int lump_num, const char *name)
   return lump_num;
 }
 
+static void R_InitTextureLookup(void);
+
 static void R_InitTextures (void)
 {
   const maptexture_t *mtexture;
@@ -316,6 +321,18 @@ static void R_InitTextures (void)
             errors, dsda_BaseName(info->wadfile->name), doomverstr);
   }
 
+  R_InitTextureLookup();
+}
+
+//
+// R_InitTextureLookup
+// Builds the animation and hash tables of the texture list
+//
+
+static void R_InitTextureLookup(void)
+{
+  int i;
+
   // Create translation table for global animation.
   // killough 4/9/98: make column offsets 32-bit;
   // clean up malloc-ing to use sizeof
@@ -336,17 +353,24 @@ static void R_InitTextures (void)
     }
 }
 
+static void R_InitFlatLookup(void);
+
 //
 // R_InitFlats
 //
 static void R_InitFlats(void)
 {
-  int i;
-
   firstflat = W_GetNumForName("F_START") + 1;
   lastflat  = W_GetNumForName("F_END") - 1;
   numflats  = lastflat - firstflat + 1;
 
+  R_InitFlatLookup();
+}
+
+static void R_InitFlatLookup(void)
+{
+  int i;
+
   // Create translation table for global animation.
   // killough 4/9/98: make column offsets 32-bit;
   // clean up malloc-ing to use sizeof
@@ -370,6 +394,163 @@ static void R_InitSpriteLumps(void)
   numspritelumps = lastspritelump - firstspritelump + 1;
 }
 
+//
+// R_ReadDataCache
+// The texture list and the flat and sprite ranges only depend on the
+// loaded wads, so they are kept in the startup cache. A launch with the
+// same wads reads them back instead of resolving every patch again.
+//
+// The table is a list of ints: numtextures, firstflat, lastflat,
+// firstspritelump and lastspritelump, then each texture's name (as two
+// ints), width, height and patchcount, followed by the originx, originy
+// and patch of each of its patches.
+//
+
+#define DATA_CACHE_HEADER 5
+#define DATA_CACHE_TEXTURE 5
+#define DATA_CACHE_PATCH 3
+
+static dboolean R_CheckDataCache(const int *data, int count)
+{
+  int i, pos;
+
+  if (count < DATA_CACHE_HEADER || data[0] < 0)
+    return false;
+
+  if (data[1] < 0 || data[2] >= numlumps || data[1] > data[2] + 1 ||
+      data[3] < 0 || data[4] >= numlumps || data[3] > data[4] + 1)
+    return false;
+
+  pos = DATA_CACHE_HEADER;
+  for (i = 0; i < data[0]; i++)
+  {
+    int j, patchcount;
+
+    if (count - pos < DATA_CACHE_TEXTURE)
+      return false;
+
+    patchcount = data[pos + 4];
+    pos += DATA_CACHE_TEXTURE;
+
+    if (patchcount < 0 || patchcount > (count - pos) / DATA_CACHE_PATCH)
+      return false;
+
+    for (j = 0; j < patchcount; j++, pos += DATA_CACHE_PATCH)
+      if (data[pos + 2] < 0 || data[pos + 2] >= numlumps)
+        return false;
+  }
+
+  return pos == count;
+}
+
+static dboolean R_ReadDataCache(dsda_startup_cache_t *cache)
+{
+  int *data;
+  int length;
+  int i, pos;
+
+  data = dsda_ReadStartupCacheTable(cache, &length);
+  if (!data)
+    return false;
+
+  if (length % sizeof(*data) || !R_CheckDataCache(data, length / sizeof(*data)))
+  {
+    lprintf(LO_WARN, "R_ReadDataCache: ignoring invalid cache %s\n",
+            dsda_StartupCacheFile(cache));
+    Z_Free(data);
+    return false;
+  }
+
+  numtextures = data[0];
+  firstflat = data[1];
+  lastflat = data[2];
+  numflats = lastflat - firstflat + 1;
+  firstspritelump = data[3];
+  lastspritelump = data[4];
+  numspritelumps = lastspritelump - firstspritelump + 1;
+
+  textures = Z_Malloc(numtextures*sizeof*textures);
+  textureheight = Z_Malloc(numtextures*sizeof*textureheight);
+
+  pos = DATA_CACHE_HEADER;
+  for (i = 0; i < numtextures; i++)
+  {
+    texture_t *texture;
+    int j;
+
+    texture = textures[i] =
+      Z_Malloc(sizeof(texture_t) + sizeof(texpatch_t)*(data[pos + 4]-1));
+
+    memcpy(texture->name, &data[pos], sizeof(texture->name));
+    texture->width = data[pos + 2];
+    texture->height = data[pos + 3];
+    texture->patchcount = data[pos + 4];
+    pos += DATA_CACHE_TEXTURE;
+
+    for (j = 0; j < texture->patchcount; j++, pos += DATA_CACHE_PATCH)
+    {
+      texture->patches[j].originx = data[pos];
+      texture->patches[j].originy = data[pos + 1];
+      texture->patches[j].patch = data[pos + 2];
+    }
+
+    for (j=1; j*2 <= texture->width; j<<=1)
+      ;
+    texture->widthmask = j-1;
+    textureheight[i] = texture->height<<FRACBITS;
+  }
+
+  Z_Free(data);
+
+  R_InitTextureLookup();
+  R_InitFlatLookup();
+
+  return true;
+}
+
+static void R_WriteDataCache(dsda_startup_cache_t *cache)
+{
+  int *data;
+  int count;
+  int i, pos;
+
+  count = DATA_CACHE_HEADER + numtextures * DATA_CACHE_TEXTURE;
+  for (i = 0; i < numtextures; i++)
+    count += textures[i]->patchcount * DATA_CACHE_PATCH;
+
+  data = Z_Malloc(count * sizeof(*data));
+
+  data[0] = numtextures;
+  data[1] = firstflat;
+  data[2] = lastflat;
+  data[3] = firstspritelump;
+  data[4] = lastspritelump;
+
+  pos = DATA_CACHE_HEADER;
+  for (i = 0; i < numtextures; i++)
+  {
+    const texture_t *texture = textures[i];
+    int j;
+
+    memcpy(&data[pos], texture->name, sizeof(texture->name));
+    data[pos + 2] = texture->width;
+    data[pos + 3] = texture->height;
+    data[pos + 4] = texture->patchcount;
+    pos += DATA_CACHE_TEXTURE;
+
+    for (j = 0; j < texture->patchcount; j++, pos += DATA_CACHE_PATCH)
+    {
+      data[pos] = texture->patches[j].originx;
+      data[pos + 1] = texture->patches[j].originy;
+      data[pos + 2] = texture->patches[j].patch;
+    }
+  }
+
+  dsda_WriteStartupCache(cache, data, count * sizeof(*data));
+
+  Z_Free(data);
+}
+
 //
 // R_InitColormaps
 //
@@ -459,12 +640,32 @@ int R_ColormapNumForName(const char *name)
 
 void R_InitData(void)
 {
-  lprintf(LO_DEBUG, "Textures ");
-  R_InitTextures();
-  lprintf(LO_DEBUG, "Flats ");
-  R_InitFlats();
-  lprintf(LO_DEBUG, "Sprites ");
-  R_InitSpriteLumps();
+  dsda_startup_cache_t cache;
+  dboolean cacheable;
+
+  dsda_StartupPhase("R_ReadDataCache");
+  dsda_OpenStartupCache(&cache, "rdata");
+  cacheable = dsda_HashStartupCacheWads(&cache);
+
+  if (!cacheable || !R_ReadDataCache(&cache))
+  {
+    lprintf(LO_DEBUG, "Textures ");
+    dsda_StartupPhase("R_InitTextures");
+    R_InitTextures();
+    lprintf(LO_DEBUG, "Flats ");
+    dsda_StartupPhase("R_InitFlats");
+    R_InitFlats();
+    lprintf(LO_DEBUG, "Sprites ");
+    dsda_StartupPhase("R_InitSpriteLumps");
+    R_InitSpriteLumps();
+
+    if (cacheable)
+      R_WriteDataCache(&cache);
+  }
+
+  dsda_CloseStartupCache(&cache);
+
+  dsda_StartupPhase("R_InitColormaps");
   R_InitColormaps();                    // killough 3/20/98
 }
 
@@ -560,6 +761,9 @@ int PUREFUNC R_SafeTextureNumForName(const char *name, int snum)
 // Totally rewritten by Lee Killough to use less memory,
 // to avoid using alloca(), and to improve performance.
 // cph - new wad lump handling, calls cache functions but acquires no locks
+//
+// The texture composites and sprite patches are then built on the thread
+// pool, so they are usually ready before they are first seen.
 
 static inline void precache_lump(int l)
 {
@@ -570,6 +774,8 @@ void R_PrecacheLevel(void)
 {
   register int i;
   register byte *hitlist;
+  int *texture_list, texture_count;
+  int *sprite_lumps, sprite_lump_count, max_sprite_lumps;
 
   if (timingdemo)
     return;
@@ -616,6 +822,9 @@ void R_PrecacheLevel(void)
     hitlist[skytexture] = 1;
   }
 
+  texture_list = Z_Malloc(numtextures * sizeof(*texture_list));
+  texture_count = 0;
+
   for (i = numtextures; --i >= 0; )
     if (hitlist[i])
       {
@@ -623,6 +832,7 @@ void R_PrecacheLevel(void)
         int j = texture->patchcount;
         while (--j >= 0)
           precache_lump(texture->patches[j].patch);
+        texture_list[texture_count++] = i;
       }
 
   // Precache sprites.
@@ -635,6 +845,10 @@ void R_PrecacheLevel(void)
         hitlist[((mobj_t *)th)->sprite] = 1;
   }
 
+  sprite_lumps = NULL;
+  sprite_lump_count = 0;
+  max_sprite_lumps = 0;
+
   for (i=num_sprites; --i >= 0;)
     if (hitlist[i])
       {
@@ -644,11 +858,29 @@ void R_PrecacheLevel(void)
             short *sflump = sprites[i].spriteframes[j].lump;
             int k = 7;
             do
-              precache_lump(firstspritelump + sflump[k]);
+              {
+                precache_lump(firstspritelump + sflump[k]);
+
+                if (sflump[k] < 0)
+                  continue;
+
+                if (sprite_lump_count == max_sprite_lumps)
+                  {
+                    max_sprite_lumps = max_sprite_lumps ? max_sprite_lumps * 2 : 256;
+                    sprite_lumps = Z_Realloc(sprite_lumps, max_sprite_lumps * sizeof(*sprite_lumps));
+                  }
+                sprite_lumps[sprite_lump_count++] = firstspritelump + sflump[k];
+              }
             while (--k >= 0);
           }
       }
   Z_Free(hitlist);
+
+  // every lump the builders read is loaded now, so they can run in the background
+  R_PrecachePatches(sprite_lumps, sprite_lump_count, texture_list, texture_count);
+
+  Z_Free(sprite_lumps);
+  Z_Free(texture_list);
 }
 
 // Proff - Added for OpenGL
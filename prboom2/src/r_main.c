@@ -68,6 +68,7 @@
 #include "dsda/render_stats.h"
 #include "dsda/settings.h"
 #include "dsda/signal_context.h"
+#include "dsda/startup_report.h"
 #include "dsda/stretch.h"
 #include "dsda/gl/render_scale.h"
 
@@ -780,9 +781,11 @@ void R_Init (void)
   //  initialise in code
   // current column draw function
   lprintf(LO_DEBUG, "\nR_LoadTrigTables: ");
+  dsda_StartupPhase("R_LoadTrigTables");
   R_LoadTrigTables();
   lprintf(LO_DEBUG, "\nR_InitData: ");
   R_InitData();
+  dsda_StartupPhase("R_Init");
   R_SetViewSize();
   lprintf(LO_DEBUG, "\nR_Init: R_InitPlanes ");
   R_InitPlanes();
@@ -71,7 +71,10 @@
 #include "lprintf.h"
 #include "r_patch.h"
 #include "v_video.h"
+#include "dsda/configuration.h"
+#include "dsda/thread_pool.h"
 #include <assert.h>
+#include <stdlib.h>
 
 #include "dsda/palette.h"
 
@@ -108,6 +111,50 @@ static rpatch_t *patches = 0;
 
 static rpatch_t *texture_composites = 0;
 
+// Patches can be built ahead of time on the thread pool by R_PrecachePatches.
+// While a build is pending, these hold the index of its chunk plus one.
+static int *patch_precache_chunk = 0;
+static int *composite_precache_chunk = 0;
+
+#define PRECACHE_CHUNK_SIZE 16
+
+typedef struct {
+  int id;
+  dboolean composite;
+} precache_job_t;
+
+typedef struct {
+  int first_job;
+  int last_job;
+  dsda_task_t *task;
+} precache_chunk_t;
+
+static precache_job_t *precache_jobs;
+static precache_chunk_t *precache_chunks;
+static int precache_chunk_count;
+
+// Built patches are kept in a least recently used list, and the oldest are
+// freed between frames when the total goes over patch_cache_size megabytes.
+// Entries [0, numlumps) are patches, the rest are texture composites.
+// Anything used during the current frame is never evicted.
+typedef struct {
+  int prev;
+  int next;
+  int size;
+  unsigned int frame;
+  dboolean resident;
+} patch_cache_entry_t;
+
+static patch_cache_entry_t *patch_cache = 0;
+static int patch_cache_head = -1; // most recently used
+static int patch_cache_tail = -1; // least recently used
+static unsigned int patch_cache_frame = 1;
+static size_t patch_cache_bytes;
+static int patch_cache_count;
+static unsigned long long patch_cache_hits;
+static unsigned long long patch_cache_misses;
+static unsigned long long patch_cache_evictions;
+
 // indices of two duplicate PLAYPAL entries, second is -1 if none found
 static int playpal_transparent, playpal_duplicate;
 
@@ -129,6 +176,12 @@ void R_InitPatches(void) {
     // clear out new patches to signal they're uninitialized
     memset(texture_composites, 0, sizeof(rpatch_t)*numtextures);
   }
+  if (!patch_precache_chunk)
+    patch_precache_chunk = Z_Calloc(numlumps, sizeof(*patch_precache_chunk));
+  if (!composite_precache_chunk)
+    composite_precache_chunk = Z_Calloc(numtextures, sizeof(*composite_precache_chunk));
+  if (!patch_cache)
+    patch_cache = Z_Calloc(numlumps + numtextures, sizeof(*patch_cache));
 
   dsda_InitPlayPal();
   R_UpdatePlayPal();
@@ -137,6 +190,9 @@ void R_InitPatches(void) {
 void R_UpdatePlayPal(void) {
   dsda_playpal_t* playpal_data;
 
+  // pending builds must not see the transparent index change under them
+  R_FinishPatchPrecache();
+
   playpal_data = dsda_PlayPalData();
   playpal_transparent = playpal_data->transparent;
   playpal_duplicate = playpal_data->duplicate;
@@ -148,8 +204,24 @@ void R_UpdatePlayPal(void) {
 void R_FlushAllPatches(void) {
   int i;
 
+  R_FinishPatchPrecache();
+
+  Z_Free(patch_precache_chunk);
+  patch_precache_chunk = NULL;
+  Z_Free(composite_precache_chunk);
+  composite_precache_chunk = NULL;
+
+  Z_Free(patch_cache);
+  patch_cache = NULL;
+  patch_cache_head = patch_cache_tail = -1;
+  patch_cache_bytes = 0;
+  patch_cache_count = 0;
+
   if (patches)
   {
+    for (i=0; i<numlumps; i++)
+      if (patches[i].data)
+        free(patches[i].data);
     Z_Free(patches);
     patches = NULL;
   }
@@ -157,12 +229,131 @@ void R_FlushAllPatches(void) {
   {
     for (i=0; i<numtextures; i++)
       if (texture_composites[i].data)
-        Z_Free(texture_composites[i].data);
+        free(texture_composites[i].data);
     Z_Free(texture_composites);
     texture_composites = NULL;
   }
 }
 
+//---------------------------------------------------------------------------
+// Patches may be built on the thread pool, so their memory comes from
+// malloc rather than the zone
+static void *R_PatchMalloc(size_t size)
+{
+  void *p = malloc(size);
+
+  if (!p && size)
+    I_Error("R_PatchMalloc: Failure trying to allocate %lu bytes", (unsigned long) size);
+
+  return p;
+}
+
+//---------------------------------------------------------------------------
+static rpatch_t *R_PatchCacheEntryPatch(int entry)
+{
+  if (entry < numlumps)
+    return &patches[entry];
+
+  return &texture_composites[entry - numlumps];
+}
+
+static void R_UnlinkPatchCacheEntry(int entry)
+{
+  patch_cache_entry_t *e = &patch_cache[entry];
+
+  if (e->prev >= 0)
+    patch_cache[e->prev].next = e->next;
+  else
+    patch_cache_head = e->next;
+
+  if (e->next >= 0)
+    patch_cache[e->next].prev = e->prev;
+  else
+    patch_cache_tail = e->prev;
+}
+
+static void R_LinkPatchCacheEntry(int entry)
+{
+  patch_cache_entry_t *e = &patch_cache[entry];
+
+  e->prev = -1;
+  e->next = patch_cache_head;
+
+  if (patch_cache_head >= 0)
+    patch_cache[patch_cache_head].prev = entry;
+  else
+    patch_cache_tail = entry;
+
+  patch_cache_head = entry;
+}
+
+// Called on the main thread whenever a built patch is handed out
+static void R_TouchPatchCacheEntry(int entry)
+{
+  patch_cache_entry_t *e = &patch_cache[entry];
+
+  if (!e->resident)
+  {
+    e->resident = true;
+    patch_cache_bytes += e->size;
+    ++patch_cache_count;
+  }
+  else if (e->frame == patch_cache_frame)
+    return;
+  else
+    R_UnlinkPatchCacheEntry(entry);
+
+  R_LinkPatchCacheEntry(entry);
+  e->frame = patch_cache_frame;
+}
+
+static void R_EvictPatchCacheEntry(int entry)
+{
+  patch_cache_entry_t *e = &patch_cache[entry];
+  rpatch_t *patch = R_PatchCacheEntryPatch(entry);
+
+  R_UnlinkPatchCacheEntry(entry);
+  e->resident = false;
+  patch_cache_bytes -= e->size;
+  --patch_cache_count;
+  ++patch_cache_evictions;
+
+  free(patch->data);
+  memset(patch, 0, sizeof(*patch));
+}
+
+// Called once per frame, before anything is drawn
+void R_UpdatePatchCache(void)
+{
+  size_t budget;
+
+  if (!patch_cache)
+    return;
+
+  budget = (size_t) dsda_IntConfig(dsda_config_patch_cache_size) * 1024 * 1024;
+
+  if (budget)
+    while (patch_cache_bytes > budget &&
+           patch_cache_tail >= 0 &&
+           patch_cache[patch_cache_tail].frame != patch_cache_frame)
+      R_EvictPatchCacheEntry(patch_cache_tail);
+
+  ++patch_cache_frame;
+}
+
+void R_PrintPatchCacheStats(void)
+{
+  unsigned long long lookups = patch_cache_hits + patch_cache_misses;
+
+  lprintf(LO_INFO, "Patch cache: %d patches, %.1f MB resident, %d MB budget\n",
+          patch_cache_count, (double) patch_cache_bytes / (1024 * 1024),
+          dsda_IntConfig(dsda_config_patch_cache_size));
+  lprintf(LO_INFO, "  %llu hits, %llu misses (%.1f%% hit rate), %llu evictions\n",
+          patch_cache_hits, patch_cache_misses,
+          lookups ? 100.0 * patch_cache_hits / lookups : 0.0,
+          patch_cache_evictions);
+}
+
 //---------------------------------------------------------------------------
 int R_NumPatchWidth(int lump)
 {
@@ -249,7 +440,7 @@ static void FillEmptySpace(rpatch_t *patch)
 
   // alternate between two buffers to avoid "overlapping memcpy"-like symptoms
   orig = patch->pixels;
-  copy = Z_Malloc(numpix);
+  copy = R_PatchMalloc(numpix);
 
   for (pass = 0; pass < 8; pass++) // arbitrarily chosen limit (must be even)
   {
@@ -301,7 +492,7 @@ static void FillEmptySpace(rpatch_t *patch)
       break; // avoid infinite loop on entirely transparent patches
   }
 
-  Z_Free(copy);
+  free(copy);
 
   // copy top row of patch into any space at bottom, and vice versa
   // a hack to fix erroneous row of pixels at top of firing chaingun
@@ -434,7 +625,7 @@ static void createPatch(int id) {
   columnsDataSize = sizeof(rcolumn_t) * patch->width;
 
   // count the number of posts in each column
-  numPostsInColumn = Z_Malloc(sizeof(int) * patch->width);
+  numPostsInColumn = R_PatchMalloc(sizeof(int) * patch->width);
   numPostsTotal = 0;
 
   for (x=0; x<patch->width; x++) {
@@ -451,7 +642,8 @@ static void createPatch(int id) {
 
   // allocate our data chunk
   dataSize = pixelDataSize + columnsDataSize + postsDataSize;
-  patch->data = (unsigned char*) Z_Malloc(dataSize);
+  patch->data = (unsigned char*) R_PatchMalloc(dataSize);
+  patch_cache[id].size = dataSize;
   memset(patch->data, 0, dataSize);
 
   // set out pixel, column, and post pointers into our data array
@@ -541,7 +733,7 @@ static void createPatch(int id) {
 
   FillEmptySpace(patch);
 
-  Z_Free(numPostsInColumn);
+  free(numPostsInColumn);
 }
 
 typedef struct {
@@ -622,7 +814,8 @@ static void createTextureCompositePatch(int id) {
   columnsDataSize = sizeof(rcolumn_t) * composite_patch->width;
 
   // count the number of posts in each column
-  countsInColumn = (count_t *)Z_Calloc(sizeof(count_t), composite_patch->width);
+  countsInColumn = (count_t *)R_PatchMalloc(sizeof(count_t) * composite_patch->width);
+  memset(countsInColumn, 0, sizeof(count_t) * composite_patch->width);
   numPostsTotal = 0;
 
   for (i=0; i<texture->patchcount; i++) {
@@ -653,7 +846,8 @@ static void createTextureCompositePatch(int id) {
 
   // allocate our data chunk
   dataSize = pixelDataSize + columnsDataSize + postsDataSize;
-  composite_patch->data = (unsigned char*) Z_Malloc(dataSize);
+  composite_patch->data = (unsigned char*) R_PatchMalloc(dataSize);
+  patch_cache[numlumps + id].size = dataSize;
   memset(composite_patch->data, 0, dataSize);
 
   // set out pixel, column, and post pointers into our data array
@@ -823,7 +1017,136 @@ static void createTextureCompositePatch(int id) {
 
   FillEmptySpace(composite_patch);
 
-  Z_Free(countsInColumn);
+  free(countsInColumn);
+}
+
+//---------------------------------------------------------------------------
+static void R_BuildPrecacheChunk(void *data) {
+  precache_chunk_t *chunk = data;
+  int i;
+
+  for (i = chunk->first_job; i < chunk->last_job; ++i)
+    if (precache_jobs[i].composite)
+      createTextureCompositePatch(precache_jobs[i].id);
+    else
+      createPatch(precache_jobs[i].id);
+}
+
+static void R_FinishPrecacheChunk(int index) {
+  precache_chunk_t *chunk = &precache_chunks[index];
+  int i;
+
+  if (!chunk->task)
+    return;
+
+  dsda_FinishTask(chunk->task);
+  chunk->task = NULL;
+
+  for (i = chunk->first_job; i < chunk->last_job; ++i)
+  {
+    int entry;
+
+    if (precache_jobs[i].composite)
+    {
+      composite_precache_chunk[precache_jobs[i].id] = 0;
+      entry = numlumps + precache_jobs[i].id;
+    }
+    else
+    {
+      patch_precache_chunk[precache_jobs[i].id] = 0;
+      entry = precache_jobs[i].id;
+    }
+
+    // account for the patch without pinning it to this frame
+    R_TouchPatchCacheEntry(entry);
+    patch_cache[entry].frame = patch_cache_frame - 1;
+  }
+}
+
+void R_FinishPatchPrecache(void) {
+  int i;
+
+  for (i = 0; i < precache_chunk_count; ++i)
+    R_FinishPrecacheChunk(i);
+
+  Z_Free(precache_jobs);
+  precache_jobs = NULL;
+  Z_Free(precache_chunks);
+  precache_chunks = NULL;
+  precache_chunk_count = 0;
+}
+
+//---------------------------------------------------------------------------
+// Builds the given sprite patches and texture composites on the thread pool.
+// Lookups of a patch that is still pending block on (or run) its chunk.
+// The lumps must already be loaded, since the workers can't load them.
+void R_PrecachePatches(const int *lumps, int lump_count, const int *textures, int texture_count) {
+  int i;
+  int job_count;
+
+  if (!patches || !texture_composites)
+    return;
+
+  R_FinishPatchPrecache();
+
+  precache_jobs = Z_Malloc((lump_count + texture_count) * sizeof(*precache_jobs));
+  job_count = 0;
+
+  // textures first, since walls are usually the first thing on screen
+  for (i = 0; i < texture_count; ++i) {
+    int id = textures[i];
+
+    if (texture_composites[id].data || composite_precache_chunk[id])
+      continue;
+
+    // mark as pending now so duplicates are skipped
+    composite_precache_chunk[id] = 1;
+    precache_jobs[job_count].id = id;
+    precache_jobs[job_count].composite = true;
+    ++job_count;
+  }
+
+  for (i = 0; i < lump_count; ++i) {
+    int id = lumps[i];
+
+    // invalid patches are left to fail on first use, as before
+    if (patches[id].data || patch_precache_chunk[id] || !CheckIfPatch(id))
+      continue;
+
+    patch_precache_chunk[id] = 1;
+    precache_jobs[job_count].id = id;
+    precache_jobs[job_count].composite = false;
+    ++job_count;
+  }
+
+  if (!job_count) {
+    Z_Free(precache_jobs);
+    precache_jobs = NULL;
+    return;
+  }
+
+  precache_chunk_count = (job_count + PRECACHE_CHUNK_SIZE - 1) / PRECACHE_CHUNK_SIZE;
+  precache_chunks = Z_Malloc(precache_chunk_count * sizeof(*precache_chunks));
+
+  for (i = 0; i < precache_chunk_count; ++i) {
+    precache_chunk_t *chunk = &precache_chunks[i];
+    int j;
+
+    chunk->first_job = i * PRECACHE_CHUNK_SIZE;
+    chunk->last_job = chunk->first_job + PRECACHE_CHUNK_SIZE;
+    if (chunk->last_job > job_count)
+      chunk->last_job = job_count;
+
+    for (j = chunk->first_job; j < chunk->last_job; ++j)
+      if (precache_jobs[j].composite)
+        composite_precache_chunk[precache_jobs[j].id] = i + 1;
+      else
+        patch_precache_chunk[precache_jobs[j].id] = i + 1;
+  }
+
+  // the table is complete before any task can touch it
+  for (i = 0; i < precache_chunk_count; ++i)
+    precache_chunks[i].task = dsda_StartTask(R_BuildPrecacheChunk, &precache_chunks[i]);
 }
 
 //---------------------------------------------------------------------------
@@ -836,8 +1159,18 @@ const rpatch_t *R_PatchByNum(int id) {
     I_Error("createPatch: %i >= numlumps", id);
 #endif
 
+  if (patch_precache_chunk[id])
+    R_FinishPrecacheChunk(patch_precache_chunk[id] - 1);
+
   if (!patches[id].data)
+  {
     createPatch(id);
+    ++patch_cache_misses;
+  }
+  else
+    ++patch_cache_hits;
+
+  R_TouchPatchCacheEntry(id);
 
   return &patches[id];
 }
@@ -852,8 +1185,18 @@ const rpatch_t *R_TextureCompositePatchByNum(int id) {
     I_Error("createTextureCompositePatch: %i >= numtextures", id);
 #endif
 
+  if (composite_precache_chunk[id])
+    R_FinishPrecacheChunk(composite_precache_chunk[id] - 1);
+
   if (!texture_composites[id].data)
+  {
     createTextureCompositePatch(id);
+    ++patch_cache_misses;
+  }
+  else
+    ++patch_cache_hits;
+
+  R_TouchPatchCacheEntry(numlumps + id);
 
   return &texture_composites[id];
 
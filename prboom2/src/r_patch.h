@@ -107,4 +107,10 @@ void R_InitPatches();
 void R_UpdatePlayPal();
 void R_FlushAllPatches();
 
+void R_PrecachePatches(const int *lumps, int lump_count, const int *textures, int texture_count);
+void R_FinishPatchPrecache(void);
+
+void R_UpdatePatchCache(void);
+void R_PrintPatchCacheStats(void);
+
 #endif
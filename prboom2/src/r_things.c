@@ -47,6 +47,7 @@
 #include "dsda/configuration.h"
 #include "dsda/render_stats.h"
 #include "dsda/settings.h"
+#include "dsda/startup_cache.h"
 
 #define BASEYCENTER 100
 
@@ -206,7 +207,7 @@ static void R_InstallSpriteLump(int lump, unsigned frame,
 }
 
 //
-// R_InitSpriteDefs
+// R_BuildSpriteDefs
 // Pass a null terminated list of sprite names
 // (4 chars exactly) to be used.
 //
@@ -231,15 +232,12 @@ static void R_InstallSpriteLump(int lump, unsigned frame,
 
 #define R_SpriteNameHash(s) ((unsigned)((s)[0]-((s)[1]*3-(s)[3]*2-(s)[2])*2))
 
-static void R_InitSpriteDefs(const char * const * namelist)
+static void R_BuildSpriteDefs(const char * const * namelist)
 {
   size_t numentries = lastspritelump-firstspritelump+1;
   struct { int index, next; } *hash;
   int i;
 
-  if (!numentries || !*namelist)
-    return;
-
   sprites = Z_Calloc(num_sprites, sizeof(*sprites));
 
   // Create hash table based on just the first four letters of each sprite
@@ -387,6 +385,166 @@ static void R_InitSpriteDefs(const char * const * namelist)
   Z_Free(hash);             // free hash table
 }
 
+//
+// The sprite definitions only depend on the loaded wads and the sprite
+// names, so they are kept in the startup cache. The table is a list of
+// ints: num_sprites, then each sprite's numframes, followed by the
+// rotate, flip and 16 lumps of each of its frames.
+//
+
+#define SPRITE_CACHE_FRAME 18
+
+static dboolean R_CheckSpriteDefCache(const int *data, int count)
+{
+  int i, pos;
+
+  if (count < 1 || data[0] != num_sprites)
+    return false;
+
+  pos = 1;
+  for (i = 0; i < num_sprites; i++)
+  {
+    int j, numframes;
+
+    if (pos == count)
+      return false;
+
+    numframes = data[pos++];
+
+    if (numframes < 0 || numframes > MAX_SPRITE_FRAMES ||
+        numframes > (count - pos) / SPRITE_CACHE_FRAME)
+      return false;
+
+    for (j = 0; j < numframes * SPRITE_CACHE_FRAME; j++, pos++)
+      if (j % SPRITE_CACHE_FRAME >= 2 &&
+          (data[pos] < 0 || data[pos] >= numspritelumps))
+        return false;
+  }
+
+  return pos == count;
+}
+
+static dboolean R_ReadSpriteDefCache(dsda_startup_cache_t *cache)
+{
+  int *data;
+  int length;
+  int i, pos;
+
+  data = dsda_ReadStartupCacheTable(cache, &length);
+  if (!data)
+    return false;
+
+  if (length % sizeof(*data) || !R_CheckSpriteDefCache(data, length / sizeof(*data)))
+  {
+    lprintf(LO_WARN, "R_ReadSpriteDefCache: ignoring invalid cache %s\n",
+            dsda_StartupCacheFile(cache));
+    Z_Free(data);
+    return false;
+  }
+
+  sprites = Z_Calloc(num_sprites, sizeof(*sprites));
+
+  pos = 1;
+  for (i = 0; i < num_sprites; i++)
+  {
+    int frame;
+
+    if (!(sprites[i].numframes = data[pos++]))
+      continue;
+
+    sprites[i].spriteframes =
+      Z_Malloc (sprites[i].numframes * sizeof(spriteframe_t));
+
+    for (frame = 0; frame < sprites[i].numframes; frame++)
+    {
+      spriteframe_t *spriteframe = &sprites[i].spriteframes[frame];
+      int rot;
+
+      spriteframe->rotate = data[pos++];
+      spriteframe->flip = data[pos++];
+      for (rot = 0; rot < 16; rot++)
+        spriteframe->lump[rot] = data[pos++];
+    }
+  }
+
+  Z_Free(data);
+
+  return true;
+}
+
+static void R_WriteSpriteDefCache(dsda_startup_cache_t *cache)
+{
+  int *data;
+  int count;
+  int i, pos;
+
+  count = 1 + num_sprites;
+  for (i = 0; i < num_sprites; i++)
+    count += sprites[i].numframes * SPRITE_CACHE_FRAME;
+
+  data = Z_Malloc(count * sizeof(*data));
+
+  data[0] = num_sprites;
+
+  pos = 1;
+  for (i = 0; i < num_sprites; i++)
+  {
+    int frame;
+
+    data[pos++] = sprites[i].numframes;
+
+    for (frame = 0; frame < sprites[i].numframes; frame++)
+    {
+      const spriteframe_t *spriteframe = &sprites[i].spriteframes[frame];
+      int rot;
+
+      data[pos++] = spriteframe->rotate;
+      data[pos++] = spriteframe->flip;
+      for (rot = 0; rot < 16; rot++)
+        data[pos++] = spriteframe->lump[rot];
+    }
+  }
+
+  dsda_WriteStartupCache(cache, data, count * sizeof(*data));
+
+  Z_Free(data);
+}
+
+//
+// R_InitSpriteDefs
+// Reads the sprite definitions from the startup cache, or builds them
+//
+
+static void R_InitSpriteDefs(const char * const * namelist)
+{
+  size_t numentries = lastspritelump-firstspritelump+1;
+  dsda_startup_cache_t cache;
+  dboolean cacheable;
+  int i;
+
+  if (!numentries || !*namelist)
+    return;
+
+  dsda_OpenStartupCache(&cache, "spritedefs");
+  cacheable = dsda_HashStartupCacheWads(&cache);
+
+  for (i = 0; i < num_sprites; i++)
+    if (namelist[i])
+      dsda_HashStartupCacheData(&cache, namelist[i], strlen(namelist[i]));
+    else
+      dsda_HashStartupCacheData(&cache, "", 0);
+
+  if (!cacheable || !R_ReadSpriteDefCache(&cache))
+  {
+    R_BuildSpriteDefs(namelist);
+
+    if (cacheable)
+      R_WriteSpriteDefCache(&cache);
+  }
+
+  dsda_CloseStartupCache(&cache);
+}
+
 //
 // GAME FUNCTIONS
 //
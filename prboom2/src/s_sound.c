@@ -96,6 +96,19 @@ typedef struct
 static channel_t channels[MAX_CHANNELS];
 static degenmobj_t sobjs[MAX_CHANNELS];
 
+// Min-heap of channel numbers by score, ties going to the lower number,
+// so the top is the channel S_getChannel replaces when all are busy
+static int channel_heap[MAX_CHANNELS];
+static int channel_heap_pos[MAX_CHANNELS];
+
+// Where the sound is heard from, worked out once per update
+typedef struct
+{
+  fixed_t x, y;             // for the distance
+  fixed_t angle_x, angle_y; // for the separation
+  angle_t angle;
+} sound_listener_t;
+
 // Maximum volume of a sound effect.
 // Internal default is max out of 0-15.
 int snd_SfxVolume;
@@ -129,7 +142,12 @@ void S_StopChannel(int cnum);
 
 int S_AdjustSoundParams(mobj_t *listener, mobj_t *source, channel_t *channel, sfx_params_t *params);
 
+static void S_SetListener(sound_listener_t *sl, mobj_t *listener);
+static int S_SpatializeSound(const sound_listener_t *sl, mobj_t *source, channel_t *channel, sfx_params_t *params);
+
 static int S_getChannel(void *origin, sfxinfo_t *sfxinfo, sfx_params_t *params);
+static void S_BuildChannelHeap(void);
+static void S_SetChannelPriority(int cnum, int priority);
 
 
 // heretic
@@ -182,6 +200,7 @@ void S_Init(void)
     // Reset channel memory
     memset(channels, 0, sizeof(channels));
     memset(sobjs, 0, sizeof(sobjs));
+    S_BuildChannelHeap();
 
     if (first_s_init)
     {
@@ -400,7 +419,7 @@ void S_StartSoundAtVolume(void *origin_p, int sfx_id, int volume, int loop_timeo
     {
       channels[cnum].handle = h;
       channels[cnum].pitch = params.pitch;
-      channels[cnum].priority = params.priority;
+      S_SetChannelPriority(cnum, params.priority);
       channels[cnum].ambient = params.ambient;
       channels[cnum].attenuation = params.attenuation;
       channels[cnum].volume_factor = params.volume_factor;
@@ -566,7 +585,12 @@ void S_ResumeSound(void)
 void S_UpdateSounds(void)
 {
   mobj_t *listener;
-  int cnum;
+  sound_listener_t sl;
+  int cnum, i, count, updated;
+  int cnums[MAX_CHANNELS];
+  int handles[MAX_CHANNELS];
+  int audible[MAX_CHANNELS];
+  sfx_params_t params[MAX_CHANNELS];
 
   //jff 1/22/98 return if sound is not enabled
   if (nosfxparm)
@@ -586,6 +610,8 @@ void S_UpdateSounds(void)
     SN_UpdateActiveSequences();
   }
 
+  // Retire finished sounds and collect the ones that move with their origin
+  count = 0;
   for (cnum = 0; cnum < numChannels; cnum++)
   {
     channel_t *channel = &channels[cnum];
@@ -598,27 +624,55 @@ void S_UpdateSounds(void)
       }
       else if (I_SoundIsPlaying(channel->handle))
       {
-        sfx_params_t params;
-
         // check non-local sounds for distance clipping
         // or modify their params
         if (channel->origin && listener != channel->origin) // killough 3/20/98
-        {
-          if (S_AdjustSoundParams(listener, channel->origin, channel, &params))
-          {
-            I_UpdateSoundParams(channel->handle, &params);
-            channel->priority = params.priority;
-          }
-          else
-          {
-            raven ? S_StopSound(channel->origin) : S_StopChannel(cnum);
-          }
-        }
+          cnums[count++] = cnum;
       }
       else   // if channel is allocated but sound has stopped, free it
         S_StopChannel(cnum);
     }
   }
+
+  if (!count)
+    return;
+
+  // e6y
+  if (listener)
+  {
+    S_SetListener(&sl, listener);
+
+    for (i = 0; i < count; i++)
+    {
+      channel_t *channel = &channels[cnums[i]];
+
+      audible[i] = S_SpatializeSound(&sl, channel->origin, channel, &params[i]);
+    }
+  }
+  else
+    memset(audible, 0, count * sizeof(audible[0]));
+
+  for (i = 0; i < count; i++)
+    if (!audible[i] && channels[cnums[i]].active)
+      raven ? S_StopSound(channels[cnums[i]].origin) : S_StopChannel(cnums[i]);
+
+  // Stopping an origin can take other collected channels with it
+  updated = 0;
+  for (i = 0; i < count; i++)
+  {
+    channel_t *channel = &channels[cnums[i]];
+
+    if (audible[i] && channel->active)
+    {
+      channel->priority = params[i].priority;
+      handles[updated] = channel->handle;
+      params[updated] = params[i];
+      updated++;
+    }
+  }
+
+  I_UpdateSoundParamsBatch(handles, params, updated);
+  S_BuildChannelHeap();
 }
 
 // Starts some music with the music id found in sounds.h.
@@ -798,9 +852,7 @@ void S_StopChannel(int cnum)
 
 int S_AdjustSoundParams(mobj_t *listener, mobj_t *source, channel_t *channel, sfx_params_t *params)
 {
-  fixed_t adx, ady;
-  ufixed_t approx_dist;
-  angle_t angle;
+  sound_listener_t sl;
 
   //jff 1/22/98 return if sound is not enabled
   if (nosfxparm)
@@ -810,6 +862,37 @@ int S_AdjustSoundParams(mobj_t *listener, mobj_t *source, channel_t *channel, sf
   if (!listener)
     return 0;
 
+  S_SetListener(&sl, listener);
+
+  return S_SpatializeSound(&sl, source, channel, params);
+}
+
+static void S_SetListener(sound_listener_t *sl, mobj_t *listener)
+{
+  if (walkcamera.type > 1)
+  {
+    sl->x = walkcamera.x;
+    sl->y = walkcamera.y;
+  }
+  else
+  {
+    sl->x = listener->x;
+    sl->y = listener->y;
+  }
+
+  sl->angle_x = listener->x;
+  sl->angle_y = listener->y;
+  sl->angle = listener->angle;
+}
+
+// S_AdjustSoundParams for a listener that has already been set up;
+// S_UpdateSounds runs this over all of the moving channels in one pass
+static int S_SpatializeSound(const sound_listener_t *sl, mobj_t *source, channel_t *channel, sfx_params_t *params)
+{
+  fixed_t adx, ady;
+  ufixed_t approx_dist;
+  angle_t angle;
+
   if (channel)
   {
     params->ambient = channel->ambient;
@@ -821,16 +904,8 @@ int S_AdjustSoundParams(mobj_t *listener, mobj_t *source, channel_t *channel, sf
 
   // calculate the distance to sound origin
   //  and clip it if necessary
-  if (walkcamera.type > 1)
-  {
-    adx = D_abs(walkcamera.x - source->x);
-    ady = D_abs(walkcamera.y - source->y);
-  }
-  else
-  {
-    adx = D_abs(listener->x - source->x);
-    ady = D_abs(listener->y - source->y);
-  }
+  adx = D_abs(sl->x - source->x);
+  ady = D_abs(sl->y - source->y);
 
   approx_dist = P_AproxDistance(adx, ady);
   approx_dist >>= FRACBITS;
@@ -842,11 +917,11 @@ int S_AdjustSoundParams(mobj_t *listener, mobj_t *source, channel_t *channel, sf
     return 0;
 
   // angle of source to listener
-  angle = R_PointToAngle2(listener->x, listener->y, source->x, source->y);
+  angle = R_PointToAngle2(sl->angle_x, sl->angle_y, source->x, source->y);
 
-  if (angle <= listener->angle)
+  if (angle <= sl->angle)
     angle += 0xffffffff;
-  angle -= listener->angle;
+  angle -= sl->angle;
   angle >>= ANGLETOFINESHIFT;
 
   // stereo separation
@@ -899,24 +974,86 @@ static int S_ChannelScore(channel_t *channel)
   return channel->priority;
 }
 
-static int S_LowestScoreChannel(void)
+static dboolean S_ChannelHeapLess(int a, int b)
 {
-  int cnum;
-  int lowest_score = INT_MAX;
-  int lowest_cnum = channel_not_found;
+  int score_a = S_ChannelScore(&channels[a]);
+  int score_b = S_ChannelScore(&channels[b]);
 
-  for (cnum = 0; cnum < numChannels; ++cnum)
+  return score_a < score_b || (score_a == score_b && a < b);
+}
+
+static void S_SwapChannelHeap(int i, int j)
+{
+  int cnum = channel_heap[i];
+
+  channel_heap[i] = channel_heap[j];
+  channel_heap[j] = cnum;
+  channel_heap_pos[channel_heap[i]] = i;
+  channel_heap_pos[channel_heap[j]] = j;
+}
+
+static void S_SiftChannelUp(int i)
+{
+  while (i > 0)
   {
-    int score = S_ChannelScore(&channels[cnum]);
+    int parent = (i - 1) / 2;
 
-    if (score < lowest_score)
-    {
-      lowest_score = score;
-      lowest_cnum = cnum;
-    }
+    if (!S_ChannelHeapLess(channel_heap[i], channel_heap[parent]))
+      break;
+
+    S_SwapChannelHeap(i, parent);
+    i = parent;
   }
+}
+
+static void S_SiftChannelDown(int i)
+{
+  while (1)
+  {
+    int child = 2 * i + 1;
+
+    if (child >= numChannels)
+      break;
+
+    if (child + 1 < numChannels &&
+        S_ChannelHeapLess(channel_heap[child + 1], channel_heap[child]))
+      child++;
+
+    if (!S_ChannelHeapLess(channel_heap[child], channel_heap[i]))
+      break;
+
+    S_SwapChannelHeap(i, child);
+    i = child;
+  }
+}
+
+static void S_BuildChannelHeap(void)
+{
+  int i;
+
+  for (i = 0; i < numChannels; i++)
+  {
+    channel_heap[i] = i;
+    channel_heap_pos[i] = i;
+  }
+
+  for (i = numChannels / 2 - 1; i >= 0; i--)
+    S_SiftChannelDown(i);
+}
+
+static void S_SetChannelPriority(int cnum, int priority)
+{
+  channels[cnum].priority = priority;
+  S_SiftChannelUp(channel_heap_pos[cnum]);
+  S_SiftChannelDown(channel_heap_pos[cnum]);
+}
+
+static int S_LowestScoreChannel(void)
+{
+  if (!numChannels || S_ChannelScore(&channels[channel_heap[0]]) == INT_MAX)
+    return channel_not_found;
 
-  return lowest_cnum;
+  return channel_heap[0];
 }
 
 static int S_getChannel(void *origin, sfxinfo_t *sfxinfo, sfx_params_t *params)
@@ -1209,7 +1346,7 @@ static void Raven_S_StartSoundAtVolume(void *_origin, int sound_id, int volume,
   channels[cnum].handle = I_StartSound(sound_id, cnum, &params);
   channels[cnum].origin = origin;
   channels[cnum].sfxinfo = sfx;
-  channels[cnum].priority = params.priority;
+  S_SetChannelPriority(cnum, params.priority);
   channels[cnum].volume = volume; // original volume, not attenuated volume
   channels[cnum].ambient = params.ambient;
   channels[cnum].attenuation = params.attenuation;
@@ -1269,7 +1406,7 @@ void S_StartAmbientSound(void *_origin, int sound_id, int volume)
   channels[i].handle = I_StartSound(sound_id, i, &params);
   channels[i].origin = origin;
   channels[i].sfxinfo = sfx;
-  channels[i].priority = params.priority;
+  S_SetChannelPriority(i, params.priority);
   channels[i].ambient = params.ambient;
   channels[i].attenuation = params.attenuation;
   channels[i].volume_factor = params.volume_factor;
@@ -75,6 +75,10 @@ const void *W_LumpByNum(int lump)
     I_Error ("W_LumpByNum: %i >= numlumps",lump);
 #endif
 
+  // wads from a zip are already in memory
+  if (lumpinfo[lump].wadfile && lumpinfo[lump].wadfile->data)
+    return (const byte *) lumpinfo[lump].wadfile->data + lumpinfo[lump].position;
+
   // read the lump in
   if (!lump_data[lump]) {
     lump_data[lump] = Z_Malloc(W_LumpLength(lump));
@@ -118,7 +118,7 @@ void W_InitCache(void)
     {
       int wad_index = (int)(lumpinfo[i].wadfile-wadfiles);
 
-      if (!lumpinfo[i].wadfile)
+      if (!lumpinfo[i].wadfile || lumpinfo[i].wadfile->data)
         continue;
 #ifdef RANGECHECK
       if ((wad_index<0)||((size_t)wad_index>=numwadfiles))
@@ -170,6 +170,8 @@ const void* W_LumpByNum(int lump)
 #endif
   if (!lumpinfo[lump].wadfile)
     return NULL;
+  if (lumpinfo[lump].wadfile->data)
+    return (const byte *) lumpinfo[lump].wadfile->data + lumpinfo[lump].position;
   return (void*)((unsigned char *)mapped_wad[wad_index].data+lumpinfo[lump].position);
 }
 
@@ -188,14 +190,14 @@ void W_InitCache(void)
   {
     int i;
     for (i=0; i<numlumps; i++)
-      if (lumpinfo[i].wadfile)
+      if (lumpinfo[i].wadfile && !lumpinfo[i].wadfile->data)
         if (lumpinfo[i].wadfile->handle > maxfd) maxfd = lumpinfo[i].wadfile->handle;
   }
   mapped_wad = Z_Calloc(maxfd+1,sizeof *mapped_wad);
   {
     int i;
     for (i=0; i<numlumps; i++) {
-      if (lumpinfo[i].wadfile) {
+      if (lumpinfo[i].wadfile && !lumpinfo[i].wadfile->data) {
         int fd = lumpinfo[i].wadfile->handle;
         if (!mapped_wad[fd])
           if ((mapped_wad[fd] = mmap(NULL,I_Filelength(fd),PROT_READ,MAP_SHARED,fd,0)) == MAP_FAILED)
@@ -210,7 +212,7 @@ void W_DoneCache(void)
   {
     int i;
     for (i=0; i<numlumps; i++)
-      if (lumpinfo[i].wadfile) {
+      if (lumpinfo[i].wadfile && !lumpinfo[i].wadfile->data) {
         int fd = lumpinfo[i].wadfile->handle;
         if (fd > 0 && mapped_wad[fd]) {
           if (munmap(mapped_wad[fd],I_Filelength(fd)))
@@ -232,6 +234,10 @@ const void* W_LumpByNum(int lump)
   if (!lumpinfo[lump].wadfile)
     return NULL;
 
+  // wads from a zip are already in memory
+  if (lumpinfo[lump].wadfile->data)
+    return (const byte *) lumpinfo[lump].wadfile->data + lumpinfo[lump].position;
+
   return
     (const void *) (
       ((const byte *) (mapped_wad[lumpinfo[lump].wadfile->handle]))
@@ -55,6 +55,8 @@
 #include "lprintf.h"
 #include "e6y.h"
 
+#include "dsda/time.h"
+
 //
 // GLOBALS
 //
@@ -122,6 +124,24 @@ char *AddDefaultExtension(char *path, const char *ext)
 // Reload hack removed by Lee Killough
 // CPhipps - source is an enum
 //
+// Read part of a wad, from its file or from the memory it was unzipped to
+
+static void W_ReadFile(wadfile_info_t *wadfile, int position, void *dest, int size)
+{
+  if (wadfile->data)
+  {
+    if (position < 0 || size < 0 || (size_t) position + size > wadfile->length)
+      I_Error("W_ReadFile: %s is truncated", wadfile->name);
+
+    memcpy(dest, (const byte *) wadfile->data + position, size);
+  }
+  else
+  {
+    lseek(wadfile->handle, position, SEEK_SET);
+    I_Read(wadfile->handle, dest, size);
+  }
+}
+
 // proff - changed using pointer to wadfile_info_t
 static void W_AddFile(wadfile_info_t *wadfile)
 // killough 1/31/98: static, const
@@ -149,7 +169,7 @@ static void W_AddFile(wadfile_info_t *wadfile)
 
   // open the file and add to directory
 
-  wadfile->handle = M_OpenRB(wadfile->name);
+  wadfile->handle = wadfile->data ? 0 : M_OpenRB(wadfile->name);
   if (wadfile->handle == -1)
     {
       if (  strlen(wadfile->name)<=4 ||      // add error check -- killough
@@ -188,14 +208,15 @@ static void W_AddFile(wadfile_info_t *wadfile)
       // single lump file
       fileinfo = &singleinfo;
       singleinfo.filepos = 0;
-      singleinfo.size = LittleLong(I_Filelength(wadfile->handle));
+      singleinfo.size = LittleLong(wadfile->data ? (int) wadfile->length :
+                                                   I_Filelength(wadfile->handle));
       ExtractFileBase(wadfile->name, singleinfo.name);
       numlumps++;
     }
   else
     {
       // WAD file
-      I_Read(wadfile->handle, &header, sizeof(header));
+      W_ReadFile(wadfile, 0, &header, sizeof(header));
       if (strncmp(header.identification,"IWAD",4) &&
           strncmp(header.identification,"PWAD",4))
         I_Error("W_AddFile: Wad file %s doesn't have IWAD or PWAD id", wadfile->name);
@@ -203,8 +224,7 @@ static void W_AddFile(wadfile_info_t *wadfile)
       header.infotableofs = LittleLong(header.infotableofs);
       length = header.numlumps*sizeof(filelump_t);
       fileinfo2free = fileinfo = Z_Malloc(length);    // killough
-      lseek(wadfile->handle, header.infotableofs, SEEK_SET),
-      I_Read(wadfile->handle, fileinfo, length);
+      W_ReadFile(wadfile, header.infotableofs, fileinfo, length);
       numlumps += header.numlumps;
     }
 
@@ -341,6 +361,57 @@ unsigned W_LumpNameHash(const char *s)
   return hash;
 }
 
+// Lump names packed into an integer, upper case and zero padded,
+// so that comparing two keys is the same as strncasecmp(a, b, 8)
+
+uint64_t W_LumpNameKey(const char *s)
+{
+  uint64_t key = 0;
+  int i;
+
+  for (i = 0; i < 8 && s[i]; i++)
+    key |= (uint64_t) (unsigned char) toupper(s[i]) << (i * 8);
+
+  return key;
+}
+
+//
+// The lump directory is an open addressing table with one slot for
+// each name and namespace, holding the latest lump. Older lumps with
+// the same name and namespace follow through lumpinfo[].next.
+//
+
+typedef struct
+{
+  uint64_t key;
+  li_namespace_e li_namespace;
+  int lump;
+} lump_slot_t;
+
+static lump_slot_t *lump_slots;
+static unsigned int lump_slot_mask;
+
+static unsigned int W_LumpSlot(uint64_t key, li_namespace_e li_namespace)
+{
+  key ^= (uint64_t) li_namespace * 0x9e3779b97f4a7c15ull;
+  key ^= key >> 33;
+  key *= 0xff51afd7ed558ccdull;
+  key ^= key >> 33;
+
+  return (unsigned int) key & lump_slot_mask;
+}
+
+static lump_slot_t *W_FindLumpSlot(uint64_t key, li_namespace_e li_namespace)
+{
+  unsigned int i = W_LumpSlot(key, li_namespace);
+
+  while (lump_slots[i].lump != LUMP_NOT_FOUND &&
+         (lump_slots[i].key != key || lump_slots[i].li_namespace != li_namespace))
+    i = (i + 1) & lump_slot_mask;
+
+  return &lump_slots[i];
+}
+
 //
 // W_CheckNumForName
 // Returns LUMP_NOT_FOUND if name not found.
@@ -351,47 +422,43 @@ unsigned W_LumpNameHash(const char *s)
 // lump name lookup is used so often, and the original Doom used a sequential
 // search. For large wads with > 1000 lumps this meant an average of over
 // 500 were probed during every search. Now the average is under 2 probes per
-// search. There is no significant benefit to packing the names into longwords
-// with this new hashing algorithm, because the work to do the packing is
-// just as much work as simply doing the string comparisons with the new
-// algorithm, which minimizes the expected number of comparisons to under 2.
+// search.
 //
 // killough 4/17/98: add namespace parameter to prevent collisions
 // between different resources such as flats, sprites, colormaps
 //
+// The names are now packed into 64-bit keys when the wads are loaded,
+// and the namespace is part of the table key, so a lookup compares
+// integers and never walks past lumps of another name or namespace.
+//
 
 // W_FindNumFromName, an iterative version of W_CheckNumForName
 // returns list of lump numbers for a given name (latest first)
 //
 int W_FindNumFromName2(const char *name, int li_namespace, int i)
 {
-  // Hash function maps the name to one of possibly numlump chains.
-  // It has been tuned so that the average chain length never exceeds 2.
+  uint64_t key;
+  int j;
 
   // proff 2001/09/07 - check numlumps==0, this happens when called before WAD loaded
   if (numlumps == 0)
-    i = LUMP_NOT_FOUND;
-  else
-  {
-    if (i < 0)
-      i = lumpinfo[W_LumpNameHash(name) % (unsigned) numlumps].index;
-    else
-      i = lumpinfo[i].next;
+    return LUMP_NOT_FOUND;
 
-  // We search along the chain until end, looking for case-insensitive
-  // matches which also match a namespace tag. Separate hash tables are
-  // not used for each namespace, because the performance benefit is not
-  // worth the overhead, considering namespace collisions are rare in
-  // Doom wads.
+  key = W_LumpNameKey(name);
 
-  while (i != LUMP_NOT_FOUND && (strncasecmp(lumpinfo[i].name, name, 8) ||
-                                 lumpinfo[i].li_namespace != li_namespace))
-    i = lumpinfo[i].next;
-  }
+  if (i < 0)
+    return W_FindLumpSlot(key, li_namespace)->lump;
 
-  // Return the matching lump, or LUMP_NOT_FOUND if none found.
+  if (lumpinfo[i].key == key && lumpinfo[i].li_namespace == li_namespace)
+    return lumpinfo[i].next;
 
-  return i;
+  // Continuing from a lump of another name: find the latest match before it
+
+  for (j = W_FindLumpSlot(key, li_namespace)->lump;
+       j != LUMP_NOT_FOUND && j >= i;
+       j = lumpinfo[j].next);
+
+  return j;
 }
 
 //
@@ -401,24 +468,95 @@ int W_FindNumFromName2(const char *name, int li_namespace, int i)
 void W_HashLumps(void)
 {
   int i;
+  unsigned int size, j;
 
-  for (i=0; i<numlumps; i++)
-    lumpinfo[i].index = LUMP_NOT_FOUND;         // mark slots empty
+  // Keep the table at most half full so probe runs stay short
+
+  for (size = 16; size < 2 * (unsigned int) numlumps; size <<= 1);
+
+  Z_Free(lump_slots);
+  lump_slots = Z_Malloc(size * sizeof(*lump_slots));
+  lump_slot_mask = size - 1;
 
-  // Insert nodes to the beginning of each chain, in first-to-last
-  // lump order, so that the last lump of a given name appears first
-  // in any chain, observing pwad ordering rules. killough
+  for (j = 0; j < size; j++)
+    lump_slots[j].lump = LUMP_NOT_FOUND;        // mark slots empty
+
+  // Insert the lumps in first-to-last order, so that the last lump of a
+  // given name appears first in any chain, observing pwad ordering rules.
 
   for (i=0; i<numlumps; i++)
-    {                                           // hash function:
-      int j = W_LumpNameHash(lumpinfo[i].name) % (unsigned) numlumps;
-      lumpinfo[i].next = lumpinfo[j].index;     // Prepend to list
-      lumpinfo[j].index = i;
-    }
+  {
+    lump_slot_t *slot;
+
+    lumpinfo[i].key = W_LumpNameKey(lumpinfo[i].name);
+
+    slot = W_FindLumpSlot(lumpinfo[i].key, lumpinfo[i].li_namespace);
+    slot->key = lumpinfo[i].key;
+    slot->li_namespace = lumpinfo[i].li_namespace;
+    lumpinfo[i].next = slot->lump;              // Prepend to list
+    slot->lump = i;
+  }
 }
 
 // End of lump hashing -- killough 1/31/98
 
+//
+// W_BenchmarkLumpLookups
+//
+// Time the lump directory with the wads of a real startup (-bench_lumps),
+// and check that every lump can be reached from the latest of its name
+//
+
+#define BENCHMARK_ROUNDS 100
+
+int W_BenchmarkLumpLookups(void)
+{
+  int i, round;
+  int errors = 0;
+  int found = 0;
+  double ms;
+
+  dsda_StartTimer(dsda_timer_temp);
+  W_HashLumps();
+  ms = (double) dsda_ElapsedTime(dsda_timer_temp) / 1000;
+
+  lprintf(LO_INFO, "W_BenchmarkLumpLookups: %d lumps hashed in %.2f ms\n", numlumps, ms);
+
+  for (i = 0; i < numlumps; i++)
+  {
+    int lump, previous = numlumps;
+
+    for (lump = W_CheckNumForName2(lumpinfo[i].name, lumpinfo[i].li_namespace);
+         lump != LUMP_NOT_FOUND && lump > i;
+         lump = W_FindNumFromName2(lumpinfo[i].name, lumpinfo[i].li_namespace, lump))
+    {
+      if (lump >= previous)
+        break;
+
+      previous = lump;
+    }
+
+    if (lump != i)
+    {
+      lprintf(LO_ERROR, "W_BenchmarkLumpLookups: lump %d (%.8s) not found\n", i, lumpinfo[i].name);
+      ++errors;
+    }
+  }
+
+  dsda_StartTimer(dsda_timer_temp);
+
+  for (round = 0; round < BENCHMARK_ROUNDS; round++)
+    for (i = 0; i < numlumps; i++)
+      found += W_CheckNumForName2(lumpinfo[i].name, lumpinfo[i].li_namespace) != LUMP_NOT_FOUND;
+
+  ms = (double) dsda_ElapsedTime(dsda_timer_temp) / 1000;
+
+  lprintf(LO_INFO, "W_BenchmarkLumpLookups: %d lookups in %.2f ms (%.1f ns each)\n",
+          found, ms, found ? ms * 1000000 / found : 0);
+
+  return errors ? 1 : 0;
+}
+
 
 
 // W_GetNumForName
@@ -563,10 +701,7 @@ void W_ReadLump(int lump, void *dest)
 
     {
       if (l->wadfile)
-      {
-        lseek(l->wadfile->handle, l->position, SEEK_SET);
-        I_Read(l->wadfile->handle, dest, l->size);
-      }
+        W_ReadFile(l->wadfile, l->position, dest, l->size);
     }
 }
 
@@ -578,8 +713,7 @@ char* W_ReadLumpToString(int lump)
   if (lump >= 0 && lump < numlumps && l->wadfile)
   {
     buffer = Z_Malloc(l->size + 1);
-    lseek(l->wadfile->handle, l->position, SEEK_SET);
-    I_Read(l->wadfile->handle, buffer, l->size);
+    W_ReadFile(l->wadfile, l->position, buffer, l->size);
     buffer[l->size] = '\0';
   }
 
@@ -36,6 +36,7 @@
 #define __W_WAD__
 
 #include <stddef.h>
+#include <inttypes.h>
 
 //
 // TYPES
@@ -86,6 +87,8 @@ typedef struct {
   char* name;
   wad_source_t src;
   int handle;
+  void* data;     // contents of a file read from a zip, or NULL
+  size_t length;
 } wadfile_info_t;
 
 extern wadfile_info_t *wadfiles;
@@ -116,7 +119,9 @@ typedef struct
   int   size;
 
   // killough 1/31/98: hash table fields, used for ultra-fast hash table lookup
-  int index, next;
+  // next is the previous lump with the same key and namespace
+  uint64_t key;
+  int next;
 
   // killough 4/17/98: namespace tags, to prevent conflicts between resources
   li_namespace_e li_namespace; // haleyjd 05/21/02: renamed from "namespace"
@@ -173,7 +178,9 @@ int W_LumpNameExists2(const char *name, int ns);
 char *AddDefaultExtension(char *, const char *);  // killough 1/18/98
 void ExtractFileBase(const char *, char *);       // killough
 unsigned W_LumpNameHash(const char *s);           // killough 1/31/98
+uint64_t W_LumpNameKey(const char *s);
 void W_HashLumps(void);                           // cph 2001/07/07 - made public
+int W_BenchmarkLumpLookups(void);
 int W_LumpNumInPortWad(int lump);
 
 #endif
@@ -78,6 +78,8 @@ static const size_t HEADER_SIZE = sizeof(memblock_t);
 
 static memblock_t *blockbytag[ZONE_MAX];
 
+static unsigned long long total_allocated;
+
 /* Z_Malloc
  * cph - the algorithm here was a very simple first-fit round-robin
  *  one - just keep looping around, freeing everything we can until
@@ -113,6 +115,8 @@ static void *Z_MallocTag(size_t size, int tag)
     blockbytag[tag]->prev = block;
   }
 
+  total_allocated += size;
+
   block->size = size;
   block->signature = ZONE_SIGNATURE;
   block->tag = tag;           // tag
@@ -207,6 +211,12 @@ char *Z_Strdup(const char *s)
   return Z_StrdupTag(s, ZONE_STATIC);
 }
 
+// Bytes requested since startup, for the startup report
+unsigned long long Z_TotalAllocated(void)
+{
+  return total_allocated;
+}
+
 void Z_FreeLevel(void)
 {
   return Z_FreeTag(ZONE_LEVEL);